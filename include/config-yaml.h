@@ -65,6 +65,7 @@ extern "C" {
 #define YAML_POWER_NAME "power"       /*!< Name to identify power file */
 #define YAML_QOS_NAME "qos"           /*!< Name to identify qos file */
 #define YAML_THERMAL_NAME "thermal"   /*!< Name to identify thermal file */
+#define YAML_BUFMON_NAME "bufmond"    /*!< Name to identify buffer monitoring file */
 
 /**
  * If defined, then the dscp map cos remark capability will be disabled.
@@ -109,6 +110,10 @@ typedef struct {
     char    *name;      /*!< Name identifier for the bus */
     char    *devname;   /*!< /dev/<name> used to access the bus */
     bool    smbus;      /*!< True if the bus is an SMBUS */
+    char    *parent_subsyst;    /*!< Subsystem of parent_device, or NULL */
+    char    *parent_device;     /*!< Device of another subsystem, e.g. a
+                                     mux channel of the base system, that
+                                     the bus is reached through, or NULL */
 } YamlBus;
 
 /************************************************************************//**
@@ -436,6 +441,32 @@ typedef struct {
    char *vendor;
 } YamlFruInfo;
 
+/************************************************************************//**
+ * ENUM for the queuing algorithm of a schedule profile entry
+ ***************************************************************************/
+typedef enum {
+    QOS_ALGORITHM_STRICT,   /*!< Algorithm is "strict" */
+    QOS_ALGORITHM_DWRR      /*!< Algorithm is "dwrr" */
+} YamlQosAlgorithm;
+
+/************************************************************************//**
+ * ENUM for the color values used by the COS and DSCP map entries
+ ***************************************************************************/
+typedef enum {
+    QOS_COLOR_GREEN,    /*!< Color is "green" */
+    QOS_COLOR_YELLOW,   /*!< Color is "yellow" */
+    QOS_COLOR_RED       /*!< Color is "red" */
+} YamlQosColor;
+
+/************************************************************************//**
+ * ENUM for the default QOS trust value
+ ***************************************************************************/
+typedef enum {
+    QOS_TRUST_NONE,         /*!< Trust is "none" */
+    QOS_TRUST_COS,          /*!< Trust is "cos" */
+    QOS_TRUST_DSCP          /*!< Trust is "dscp" */
+} YamlQosTrust;
+
 /************************************************************************//**
  * STRUCT that contains the contents of the schedule profile
  * entry section of the qos.yaml file.
@@ -444,6 +475,7 @@ typedef struct {
     int     queue;          /*!< Queue number - index into schedule profile */
     char    *algorithm;     /*!< queuing algorithm */
     int     weight;         /*!< weight, if algorithm is wrr */
+    YamlQosAlgorithm algorithm_id;  /*!< algorithm decoded at parse time */
 } YamlScheduleProfileEntry;
 
 /************************************************************************//**
@@ -465,6 +497,7 @@ typedef struct {
     char    *description;   /*!< Entry description */
     int     local_priority; /*!< COS priority */
     char    *color;         /*!< color */
+    YamlQosColor color_id;  /*!< color decoded at parse time */
 } YamlCosMapEntry;
 
 /************************************************************************//**
@@ -481,8 +514,28 @@ typedef struct {
 #else
     int     priority_code_point; /*!< Priority code point */
 #endif
+    YamlQosColor color_id;  /*!< color decoded at parse time */
 } YamlDscpMapEntry;
 
+/************************************************************************//**
+ * Number of code points in the COS (802.1p priority) map.
+ ***************************************************************************/
+#define QOS_COS_MAP_SIZE    8
+
+/************************************************************************//**
+ * Number of code points in the DSCP map.
+ ***************************************************************************/
+#define QOS_DSCP_MAP_SIZE   64
+
+/************************************************************************//**
+ * STRUCT for one slot of the packed COS and DSCP lookup tables. The tables
+ *    are indexed by code point.
+ ***************************************************************************/
+typedef struct {
+    unsigned char   local_priority; /*!< COS priority */
+    unsigned char   color;          /*!< YamlQosColor value */
+} YamlQosMapValue;
+
 /************************************************************************//**
  * STRUCT that contains the contents of the qos_info section of the
  *    qos.yaml file.
@@ -491,14 +544,403 @@ typedef struct {
     char    *trust;         /*! Default QOS trust value */
     char    *default_name;  /*! Name of default profiles */
     char    *factory_default_name;  /*! Name of factory-default profiles */
+    YamlQosTrust trust_id;  /*! Trust value decoded at parse time */
 } YamlQosInfo;
 
+/************************************************************************//**
+ * Number of '/' separated segments in a buffer monitoring counter name
+ *    (realm/counter/x/y).
+ ***************************************************************************/
+#define BUFMON_NAME_SEGMENTS    4
+
+/************************************************************************//**
+ * STRUCT that contains the capabilities at the top of the bufmond.yaml file.
+ ***************************************************************************/
+typedef struct {
+    bool    cap_mode_current;   /*!< Current value collection supported */
+    bool    cap_mode_peak;      /*!< Peak value collection supported */
+    bool    cap_snapshot_on_threshold_trigger; /*!< Snapshot on trigger */
+    bool    cap_threshold_trigger_collection;  /*!< Trigger collection */
+} YamlBufmonInfo;
+
+/************************************************************************//**
+ * STRUCT that describes one counter of the bufmond.yaml file. The strings
+ *    are interned by the library and must not be freed. Vendor specific
+ *    values that are not present are set to -1.
+ ***************************************************************************/
+typedef struct {
+    const char  *name[BUFMON_NAME_SEGMENTS]; /*!< Name segments, e.g.
+                                                  "ingress-port-priority-group",
+                                                  "um-share-buffer-count",
+                                                  "1", "1" */
+    const char  *counter_name;      /*!< Vendor specific counter name */
+    int         port;               /*!< Vendor specific port */
+    int         priority_group;     /*!< Vendor specific priority group */
+    int         queue;              /*!< Vendor specific queue */
+    int         service_pool;       /*!< Vendor specific service pool */
+    int         hw_unit_id;         /*!< Hardware unit */
+    unsigned long long trigger_threshold; /*!< Trigger threshold */
+    bool        enabled;            /*!< Counter is enabled */
+} YamlBufmonCounter;
+
+/************************************************************************//**
+ * STRUCT for a range of the sorted buffer monitoring counter index returned
+ *    by yaml_get_bufmon_sorted_counters().
+ ***************************************************************************/
+typedef struct {
+    unsigned int    first;  /*!< Position of the first counter in the index */
+    unsigned int    count;  /*!< Number of counters in the range */
+} YamlBufmonRange;
+
+/************************************************************************//**
+ * ENUM for the buffer monitoring threshold evaluation modes
+ ***************************************************************************/
+typedef enum {
+    BUFMON_MODE_CURRENT,    /*!< Compare each sample with the threshold */
+    BUFMON_MODE_PEAK        /*!< Compare the highest sample seen since the
+                                 last bufmon_engine_reset_peaks() call */
+} YamlBufmonMode;
+
+/************************************************************************//**
+ * ENUM for the buffer monitoring threshold engine implementations
+ ***************************************************************************/
+typedef enum {
+    BUFMON_IMPL_SCALAR,     /*!< Portable C */
+    BUFMON_IMPL_SSE2,       /*!< 2 counters per step (x86-64 only) */
+    BUFMON_IMPL_AVX2        /*!< 4 counters per step, if the CPU has AVX2 */
+} YamlBufmonImpl;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque buffer monitoring threshold engine
+ ***************************************************************************/
+typedef struct YamlBufmonEngine YamlBufmonEngine;
+
+/************************************************************************//**
+ * ENUM for the alarm levels computed by the thermal policy engine. Higher
+ *    values are more severe, except that LOW_CRITICAL and MIN are below
+ *    NORMAL.
+ ***************************************************************************/
+typedef enum {
+    THERMAL_ALARM_LOW_CRITICAL, /*!< At or below low_crit */
+    THERMAL_ALARM_MIN,          /*!< At or below min */
+    THERMAL_ALARM_NORMAL,       /*!< Between min and max */
+    THERMAL_ALARM_MAX,          /*!< Between max_on/max_off and critical */
+    THERMAL_ALARM_CRITICAL,     /*!< Between critical_on/critical_off and
+                                     emergency */
+    THERMAL_ALARM_EMERGENCY     /*!< At or above emergency_on, until below
+                                     emergency_off */
+} YamlThermalAlarm;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque thermal policy engine
+ ***************************************************************************/
+typedef struct YamlThermalEngine YamlThermalEngine;
+
+/************************************************************************//**
+ * STRUCT for one register of yaml_register_read_list()
+ ***************************************************************************/
+typedef struct {
+    const char      *device;            /*!< Name of the device */
+    unsigned char   register_address;   /*!< Register to read */
+    unsigned char   register_size;      /*!< 1, 2 or 4 byte register */
+    unsigned int    value;              /*!< Value read, little endian */
+    int             rc;                 /*!< 0 if the read succeeded, else
+                                             errno */
+} YamlRegisterRead;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque shadow register write cache
+ ***************************************************************************/
+typedef struct YamlShadowCache YamlShadowCache;
+
+/************************************************************************//**
+ * ENUM for the status bits of a power supply
+ ***************************************************************************/
+typedef enum {
+    PSU_STATUS_PRESENT,         /*!< psu_present */
+    PSU_STATUS_INPUT_OK,        /*!< psu_input_ok */
+    PSU_STATUS_OUTPUT_OK,       /*!< psu_output_ok */
+    PSU_STATUS_COUNT
+} YamlPsuStatus;
+
+/************************************************************************//**
+ * STRUCT for a PSU status bit that changed, returned by yaml_psu_sweep()
+ ***************************************************************************/
+typedef struct {
+    unsigned int    psu;        /*!< Index of the PSU in power.yaml */
+    YamlPsuStatus   status;     /*!< Status bit that changed */
+    bool            value;      /*!< New value, true if asserted */
+} YamlPsuEdge;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque PSU status sweep
+ ***************************************************************************/
+typedef struct YamlPsuSweep YamlPsuSweep;
+
+/************************************************************************//**
+ * STRUCT for a module presence change, returned by yaml_presence_scan()
+ ***************************************************************************/
+typedef struct {
+    unsigned int    port;       /*!< Index of the port in ports.yaml */
+    bool            present;    /*!< True if a module is present */
+} YamlPresenceEdge;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque interrupt-gated module presence scan
+ ***************************************************************************/
+typedef struct YamlPresenceScan YamlPresenceScan;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque module EEPROM cache
+ ***************************************************************************/
+typedef struct YamlEepromCache YamlEepromCache;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque platform poller
+ ***************************************************************************/
+typedef struct YamlPoller YamlPoller;
+
+/************************************************************************//**
+ * TYPEDEF for the callback of a poller subscription. It is called without
+ *    the poller locked, so it may subscribe and unsubscribe, but it must
+ *    not call yaml_poller_tick().
+ *
+ * @param[in] id      :Subscription id
+ * @param[in] rc      :0 if the read succeeded, else errno
+ * @param[in] value   :Register value, or 1 if a bit op signal is asserted
+ *                     and 0 if it isn't
+ * @param[in] context :Context passed when subscribing
+ ***************************************************************************/
+typedef void (*YamlPollerCallback)(int id, int rc, unsigned int value, void *context);
+
+/************************************************************************//**
+ * STRUCT with the result for one subsystem of yaml_init_subsystems()
+ ***************************************************************************/
+typedef struct {
+    const char          *subsyst;   /*!< Name of the subsystem */
+    int                 parse_rc;   /*!< 0 if all description files parsed */
+    int                 init_rc;    /*!< yaml_init_devices() result, or -1
+                                         if the files failed to parse */
+    unsigned long long  parse_usec; /*!< Time spent parsing */
+    unsigned long long  init_usec;  /*!< Time spent initializing devices */
+} YamlSubsystemInitResult;
+
 /************************************************************************//**
  * TYPEDEF for the opaque Yaml config handle used for each call. The handle
  *    is returned by the yaml_new_config_handle() function.
  ***************************************************************************/
 typedef void *YamlConfigHandle;
 
+/************************************************************************//**
+ * STRUCT for an i2c bus backend. i2c_execute() and i2c_execute_list() use
+ *    the Linux i2c-dev adapters unless another backend is installed with
+ *    yaml_set_i2c_backend(), e.g. the simulator of yaml_i2c_sim_new().
+ ***************************************************************************/
+typedef struct {
+    void    *context;   /*!< Passed to every function of the backend */
+
+    /*!< Opens a bus for exclusive use. The thread that has the bus open
+         can open it again, e.g. in a bus session. Returns 0 or errno. */
+    int     (*open_bus)(void *context, const YamlBus *bus, void **bus_handle);
+
+    /*!< Releases a bus opened by open_bus */
+    void    (*close_bus)(void *context, void *bus_handle);
+
+    /*!< Performs count commands on an open bus: one combined transfer on an
+         I2C_RDWR bus, one SMBus command per command otherwise. cmd_rc, if
+         not NULL, receives the status of each command. Returns 0 or errno
+         of the last failure. */
+    int     (*transfer)(void *context, void *bus_handle,
+                        YamlConfigHandle handle, const char *subsyst,
+                        const YamlBus *bus, i2c_op **cmds,
+                        unsigned int count, int *cmd_rc);
+} YamlI2cBackend;
+
+/************************************************************************//**
+ * STRUCT for the timing model of the i2c simulator
+ ***************************************************************************/
+typedef struct {
+    unsigned int    bus_khz;        /*!< Bus clock, 100 if 0 */
+    unsigned int    transaction_ns; /*!< Fixed cost of each transaction,
+                                         e.g. the ioctl and START/STOP */
+    bool            realtime;       /*!< Sleep for the modeled time, else
+                                         only account for it */
+} YamlI2cSimConfig;
+
+/************************************************************************//**
+ * STRUCT for the counters of the i2c simulator
+ ***************************************************************************/
+typedef struct {
+    unsigned long long  transactions;   /*!< ioctl or SMBus transactions */
+    unsigned long long  messages;       /*!< Messages, incl. mux selection */
+    unsigned long long  bytes;          /*!< Bytes on the wire, incl.
+                                             addresses */
+    unsigned long long  elapsed_ns;     /*!< Modeled bus time */
+    unsigned long long  faults;         /*!< Failed commands */
+} YamlI2cSimStats;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque i2c simulator
+ ***************************************************************************/
+typedef struct YamlI2cSim YamlI2cSim;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque i2c transaction recorder
+ ***************************************************************************/
+typedef struct YamlI2cRecorder YamlI2cRecorder;
+
+/************************************************************************//**
+ * STRUCT for the outcome of an i2c trace replay
+ ***************************************************************************/
+typedef struct {
+    unsigned long long  transfers;      /*!< Transfers replayed */
+    unsigned long long  messages;       /*!< Commands replayed */
+    unsigned long long  mismatches;     /*!< Commands whose status differs
+                                             from the recorded one */
+    unsigned long long  recorded_usec;  /*!< Recorded bus time */
+    unsigned long long  span_usec;      /*!< Recorded time from the first
+                                             to the last transfer */
+    unsigned long long  elapsed_usec;   /*!< Wall time of the replay */
+} YamlI2cReplayStats;
+
+/************************************************************************//**
+ * ENUM for the phases of an i2c transaction
+ ***************************************************************************/
+typedef enum {
+    YAML_I2C_PHASE_LOCK_WAIT,   /*!< Waiting for the bus */
+    YAML_I2C_PHASE_PRE,         /*!< Mux selection */
+    YAML_I2C_PHASE_PAYLOAD,     /*!< The commands themselves */
+    YAML_I2C_PHASE_POST,        /*!< Mux deselection */
+    YAML_I2C_PHASE_COUNT
+} YamlI2cPhase;
+
+#define YAML_I2C_HISTOGRAM_BUCKETS  272     /*!< 1 ns to 68 s, 8 per octave */
+#define YAML_I2C_STATS_ERRNOS       136     /*!< The last counts larger ones */
+
+/************************************************************************//**
+ * STRUCT for a latency histogram. Below 8 ns a bucket is 1 ns wide; above,
+ *    each power of two is split into 8 buckets, so a value is known to
+ *    within 12.5%.
+ ***************************************************************************/
+typedef struct {
+    unsigned long long  count;
+    unsigned long long  total_ns;
+    unsigned long long  max_ns;
+    unsigned long long  buckets[YAML_I2C_HISTOGRAM_BUCKETS];
+} YamlI2cHistogram;
+
+/************************************************************************//**
+ * STRUCT for the i2c counters of a bus or a device
+ ***************************************************************************/
+typedef struct {
+    const char          *name;          /*!< Bus or device name */
+    bool                bus;            /*!< True for a bus */
+    unsigned long long  transactions;   /*!< Command lists on a bus;
+                                             i2c_execute() calls or
+                                             i2c_execute_list() ops on a
+                                             device */
+    unsigned long long  commands;       /*!< Commands, incl. mux selection */
+    unsigned long long  bytes;          /*!< Data bytes of the commands */
+    unsigned long long  errors[YAML_I2C_STATS_ERRNOS];  /*!< Failed
+                                             transactions by errno */
+    YamlI2cHistogram    phases[YAML_I2C_PHASE_COUNT];
+} YamlI2cStatsEntry;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque i2c statistics of a handle
+ ***************************************************************************/
+typedef struct YamlI2cStats YamlI2cStats;
+
+/************************************************************************//**
+ * STRUCT for the route to a device: the adapter it is reached through and
+ *    the pre and post operations of every mux on the way, across
+ *    subsystems. The operations of other subsystems name their devices as
+ *    <subsystem>:<device>.
+ ***************************************************************************/
+typedef struct {
+    const YamlBus   *bus;       /*!< Adapter, a bus of root_subsyst */
+    const char      *root_subsyst;  /*!< Subsystem of the adapter */
+    i2c_op          **pre;      /*!< Mux selections, outermost first,
+                                     NULL terminated, or NULL if none */
+    unsigned int    npre;       /*!< Number of pre operations */
+    i2c_op          **post;     /*!< Mux releases, innermost first, NULL
+                                     terminated, or NULL if none */
+    unsigned int    npost;      /*!< Number of post operations */
+} YamlI2cRoute;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque route cache of a handle
+ ***************************************************************************/
+typedef struct YamlI2cRoutes YamlI2cRoutes;
+
+/************************************************************************//**
+ * STRUCT for the lock counters of a bus device
+ ***************************************************************************/
+typedef struct {
+    unsigned long long  acquisitions;   /*!< Outermost locks */
+    unsigned long long  nested;         /*!< Locks by the holder, e.g. in a
+                                             bus session, which cost nothing */
+    unsigned long long  contended;      /*!< Outermost locks that waited for
+                                             another thread */
+    unsigned long long  wait_ns;        /*!< Time spent waiting for other
+                                             threads */
+    unsigned long long  flocks;         /*!< Cross-process locks taken, not
+                                             counting handovers */
+    unsigned long long  flock_contended;/*!< ... that waited for another
+                                             process */
+} YamlBusLockStats;
+
+#define YAML_PARSE_CACHE_MAX_IDLE   16      /*!< Documents kept when unused */
+
+/************************************************************************//**
+ * STRUCT for the counters of the process-wide parse cache
+ ***************************************************************************/
+typedef struct {
+    unsigned long long  hits;           /*!< Files whose content was already
+                                             parsed */
+    unsigned long long  misses;         /*!< Files parsed */
+    unsigned long long  parse_errors;   /*!< ... that failed to parse */
+    unsigned long long  entries;        /*!< Parsed documents kept */
+    unsigned long long  bytes;          /*!< Size of their files */
+} YamlParseCacheStats;
+
+/************************************************************************//**
+ * STRUCT for a description file of a platform in the catalog index
+ ***************************************************************************/
+typedef struct {
+    const char          *name;          /*!< Name in the manifest */
+    const char          *filename;      /*!< File name in the manifest */
+    unsigned long long  hash;           /*!< yaml_catalog_hash_file() of the
+                                             file */
+} YamlCatalogFile;
+
+/************************************************************************//**
+ * STRUCT for a platform in the catalog index
+ ***************************************************************************/
+typedef struct {
+    const char          *manufacturer;  /*!< From the manifest */
+    const char          *product_name;  /*!< From the manifest */
+    const char          *dir;           /*!< Subsystem directory, for
+                                             yaml_add_subsystem() */
+    const YamlCatalogFile *files;       /*!< Files of the manifest */
+    unsigned int        file_count;
+} YamlCatalogPlatform;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque catalog index of yaml_catalog_open()
+ ***************************************************************************/
+typedef struct YamlCatalog YamlCatalog;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque lock of a bus device
+ ***************************************************************************/
+typedef struct YamlBusLock YamlBusLock;
+
+/************************************************************************//**
+ * TYPEDEF for the opaque bus session of yaml_i2c_bus_session_begin()
+ ***************************************************************************/
+typedef struct YamlI2cBusSession YamlI2cBusSession;
+
 /************************************************************************//**
  * Returns a unique handle to identify a specific subsystem. There will be
  * one handle per subsystem.
@@ -507,6 +949,50 @@ typedef void *YamlConfigHandle;
  ***************************************************************************/
 extern YamlConfigHandle yaml_new_config_handle(void);
 
+/************************************************************************//**
+ * Installs the i2c bus backend of a handle
+ *
+ * @param[in] handle  :YamlConfigHandle
+ * @param[in] backend :Backend, or NULL for the Linux i2c-dev adapters. It
+ *                     must stay valid while it is installed.
+ ***************************************************************************/
+extern void yaml_set_i2c_backend(YamlConfigHandle handle, const YamlI2cBackend *backend);
+
+/************************************************************************//**
+ * Returns the i2c bus backend of a handle
+ *
+ * @param[in] handle  :YamlConfigHandle
+ *
+ * @return YamlI2cBackend *, or NULL for the Linux i2c-dev adapters
+ ***************************************************************************/
+extern const YamlI2cBackend *yaml_get_i2c_backend(YamlConfigHandle handle);
+
+/************************************************************************//**
+ * Returns the Linux i2c-dev backend, used when a handle has no backend
+ *
+ * @return YamlI2cBackend *
+ ***************************************************************************/
+extern const YamlI2cBackend *yaml_i2c_default_backend(void);
+
+/************************************************************************//**
+ * Returns the i2c statistics of a handle. i2c_execute() and
+ * i2c_execute_list() keep them for every bus and device they access.
+ *
+ * @param[in] handle  :YamlConfigHandle
+ *
+ * @return YamlI2cStats *
+ ***************************************************************************/
+extern YamlI2cStats *yaml_get_i2c_stats(YamlConfigHandle handle);
+
+/************************************************************************//**
+ * Returns the route cache of a handle, see yaml_i2c_route()
+ *
+ * @param[in] handle  :YamlConfigHandle
+ *
+ * @return YamlI2cRoutes *
+ ***************************************************************************/
+extern YamlI2cRoutes *yaml_get_i2c_routes(YamlConfigHandle handle);
+
 /************************************************************************//**
  * Adds a new subsystem to the config-yaml internal database. It finds
  * and parses the "manifest.yaml" file for this subsystem.
@@ -520,12 +1006,35 @@ extern YamlConfigHandle yaml_new_config_handle(void);
  ***************************************************************************/
 extern int yaml_add_subsystem(YamlConfigHandle handle, const char *subsyst, const char *dir_name);
 
+/************************************************************************//**
+ * Returns a device of a subsystem, in name order
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] idx       :Index for the specific device to retrieve
+ *
+ * @return YamlDevice * on success, else NULL on failure
+ ***************************************************************************/
+extern const YamlDevice * yaml_get_device(YamlConfigHandle handle, const char *subsyst, unsigned int idx);
+
+/************************************************************************//**
+ * Returns number of devices in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return number of devices on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_get_device_count(YamlConfigHandle handle, const char *subsyst);
+
 /************************************************************************//**
  * Locates device information for a given device name
  *
  * @param[in] handle   :YamlConfigHandle for this subsystem
  * @param[in] subsyst  :Name of the subsystem
- * @param[in] dev_name :Name of the device to locate
+ * @param[in] dev_name :Name of the device to locate, or
+ *                      <subsystem>:<device> for a device of another
+ *                      subsystem
  *
  * @return YamlDevice * on success, else NULL on failure
  ***************************************************************************/
@@ -544,15 +1053,57 @@ extern const YamlDevice * yaml_find_device(YamlConfigHandle handle, const char *
 extern int yaml_add_device(YamlConfigHandle handle, const char *subsystem, const char *dev_name, const YamlDevice *device);
 
 /************************************************************************//**
- * Initializes the i2c devices in a subsystem
+ * Initializes the i2c devices in a subsystem. The init ops are performed
+ * with i2c_execute_list(), and the status of each op is kept for
+ * yaml_get_init_op_status().
  *
  * @param[in] handle    :YamlConfigHandle for this subsystem
  * @param[in] subsystem :Name of the subsystem
  *
- * @return 0 on success, else -1 on failure
+ * @return 0 on success, errno of the first failed op, else -1 if the
+ *         subsystem is unknown
  ***************************************************************************/
 extern int yaml_init_devices(YamlConfigHandle handle, const char *subsyst);
 
+/************************************************************************//**
+ * Returns the number of init ops in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return number of init ops, else -1 on failure
+ ***************************************************************************/
+extern int yaml_get_init_op_count(YamlConfigHandle handle, const char *subsyst);
+
+/************************************************************************//**
+ * Returns the status of an init op from the last yaml_init_devices()
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] idx       :Index of the init op
+ *
+ * @return 0 if the op succeeded, errno if it failed, else -1 if the
+ *         subsystem or op is unknown or the devices were not initialized
+ ***************************************************************************/
+extern int yaml_get_init_op_status(YamlConfigHandle handle, const char *subsyst, size_t idx);
+
+/************************************************************************//**
+ * Parses the description files of every subsystem in the handle and
+ * initializes their devices. Up to workers subsystems are done at the same
+ * time; subsystems that share an i2c adapter are serialized by the bus lock.
+ * Every subsystem is parsed before the devices of any are initialized.
+ * The results are returned in subsystem name order.
+ *
+ * @param[in] handle      :YamlConfigHandle with the subsystems
+ * @param[in] workers     :Maximum number of concurrent subsystems, or 0 for
+ *                         one per subsystem
+ * @param[out] results    :Array for the result of each subsystem
+ * @param[in] max_results :Number of entries in results
+ *
+ * @return number of subsystems, else -1 on failure
+ ***************************************************************************/
+extern int yaml_init_subsystems(YamlConfigHandle handle, unsigned int workers, YamlSubsystemInitResult *results, unsigned int max_results);
+
 /************************************************************************//**
  * Returns a pointer to a specific sensor
  *
@@ -574,6 +1125,18 @@ extern const YamlSensor * yaml_get_sensor(YamlConfigHandle handle, const char *s
  ***************************************************************************/
 extern int yaml_get_sensor_count(YamlConfigHandle handle, const char *subsyst);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of sensors in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of sensors in the returned array
+ *
+ * @return YamlSensor * on success, else NULL on failure or if there
+ *         are no sensors
+ ***************************************************************************/
+extern const YamlSensor * yaml_get_sensors_array(YamlConfigHandle handle, const char *subsyst, unsigned int *count);
+
 /************************************************************************//**
  * Returns a pointer to thermal info for a subsystem
  *
@@ -591,7 +1154,8 @@ extern const YamlThermalInfo * yaml_get_thermal_info(YamlConfigHandle handle, co
  * @param[in] subsyst   :Name of the subsystem
  * @param[in] idx       :Index for the specific port to retrieve
  *
- * @return YamlPort * on success, else NULL on failure
+ * @return YamlPort * on success, else NULL on failure or if the port of
+ *         yaml_parse_ports_lazy() is malformed
  ***************************************************************************/
 extern const YamlPort * yaml_get_port(YamlConfigHandle handle, const char *subsyst, unsigned int idx);
 
@@ -605,6 +1169,18 @@ extern const YamlPort * yaml_get_port(YamlConfigHandle handle, const char *subsy
  ***************************************************************************/
 extern int yaml_get_port_count(YamlConfigHandle handle, const char *subsyst);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of ports in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of ports in the returned array
+ *
+ * @return YamlPort * on success, else NULL on failure, if there are no
+ *         ports, or if a port of yaml_parse_ports_lazy() is malformed
+ ***************************************************************************/
+extern const YamlPort * yaml_get_ports_array(YamlConfigHandle handle, const char *subsyst, unsigned int *count);
+
 /************************************************************************//**
  * Returns a pointer to generic port info for a subsystem
  *
@@ -636,6 +1212,18 @@ extern const YamlFanFru * yaml_get_fan_fru(YamlConfigHandle handle, const char *
  ***************************************************************************/
 extern int yaml_get_fan_fru_count(YamlConfigHandle handle, const char *subsyst);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of fan FRUs in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of fan FRUs in the returned array
+ *
+ * @return YamlFanFru * on success, else NULL on failure or if there
+ *         are no fan FRUs
+ ***************************************************************************/
+extern const YamlFanFru * yaml_get_fan_frus_array(YamlConfigHandle handle, const char *subsyst, unsigned int *count);
+
 /************************************************************************//**
  * Returns a pointer to generic fan FRU info for a subsystem
  *
@@ -687,17 +1275,50 @@ extern int yaml_parse_thermal(YamlConfigHandle handle, const char *subsyst);
 extern int yaml_parse_ports(YamlConfigHandle handle, const char *subsyst);
 
 /************************************************************************//**
- * Parses and stores internally the information in the fans.yaml file
+ * Parses the ports.yaml file like yaml_parse_ports(), but only indexes the
+ * ports: the port count and yaml_get_port_info() are available at once,
+ * and each port and its module signals are decoded on first access by
+ * yaml_get_port(), then kept. yaml_get_ports_array() decodes every port.
  *
  * @param[in] handle    :YamlConfigHandle for this subsystem
  * @param[in] subsyst   :Name of the subsystem
  *
  * @return 0 on success, else -1 on failure
  ***************************************************************************/
-extern int yaml_parse_fans(YamlConfigHandle handle, const char *subsyst);
+extern int yaml_parse_ports_lazy(YamlConfigHandle handle, const char *subsyst);
 
 /************************************************************************//**
- * Parses and stores internally the information in the power.yaml file
+ * Returns the counters of the parse cache. The description files are
+ * parsed once per content: a file with the same content as a file parsed
+ * before, in any subsystem and handle, comment lines aside, reuses its
+ * parsed document. Only the YAML document is shared; each subsystem still
+ * builds its own structures from it. Documents in use are kept, and the
+ * YAML_PARSE_CACHE_MAX_IDLE most recently used of the others; older ones
+ * are freed. bufmon.yaml is streamed and not cached.
+ *
+ * @param[out] stats    :Counters, since the last yaml_parse_cache_clear()
+ ***************************************************************************/
+extern void yaml_get_parse_cache_stats(YamlParseCacheStats *stats);
+
+/************************************************************************//**
+ * Drops the parsed documents of the parse cache that aren't in use and
+ * resets its hit and miss counters. Documents of ports being decoded by
+ * yaml_parse_ports_lazy() are kept.
+ ***************************************************************************/
+extern void yaml_parse_cache_clear(void);
+
+/************************************************************************//**
+ * Parses and stores internally the information in the fans.yaml file
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_parse_fans(YamlConfigHandle handle, const char *subsyst);
+
+/************************************************************************//**
+ * Parses and stores internally the information in the power.yaml file
  *
  * @param[in] handle    :YamlConfigHandle for this subsystem
  * @param[in] subsyst   :Name of the subsystem
@@ -717,7 +1338,10 @@ extern int yaml_parse_psus(YamlConfigHandle handle, const char *subsyst);
 extern int yaml_parse_leds(YamlConfigHandle handle, const char *subsyst);
 
 /************************************************************************//**
- * Performs the list of i2c commands for the specified i2c device
+ * Performs the list of i2c commands for the specified i2c device. The
+ * commands are sent on the adapter of the device's route, behind the pre
+ * and post operations of the route; they must all have the same route
+ * adapter.
  *
  * @param[in] handle    :YamlConfigHandle for this subsystem
  * @param[in] subsyst   :Name of the subsystem
@@ -728,6 +1352,159 @@ extern int yaml_parse_leds(YamlConfigHandle handle, const char *subsyst);
  ***************************************************************************/
 extern int i2c_execute(YamlConfigHandle handle, const char *subsyst, const YamlDevice *device, i2c_op **ops);
 
+/************************************************************************//**
+ * Performs a list of independent i2c commands, each on its own device.
+ * Each bus is opened and locked once, and the buses run in parallel, so
+ * commands on different adapters run in no fixed order. While the calling
+ * thread has a bus session open, the buses run one after the other in the
+ * calling thread instead.
+ * Consecutive commands on a bus whose devices share a mux path are sent
+ * in one transfer behind a single set of pre and post operations.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] ops       :Array of i2c commands
+ * @param[in] count     :Number of commands in ops
+ * @param[out] results  :Array of count entries, set to 0 or errno for
+ *                       each command
+ *
+ * @return 0 on success, else errno of the first failed command
+ ***************************************************************************/
+extern int i2c_execute_list(YamlConfigHandle handle, const char *subsyst, i2c_op *ops, unsigned int count, int *results);
+
+/************************************************************************//**
+ * Performs a list of i2c commands like i2c_execute_list(), but in list
+ * order across buses: each run of consecutive commands on one adapter is
+ * batched, and the runs are performed one after another in the calling
+ * thread. For commands whose order matters, like device initialization.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] ops       :Array of i2c commands
+ * @param[in] count     :Number of commands in ops
+ * @param[out] results  :Array of count entries, set to 0 or errno for
+ *                       each command
+ *
+ * @return 0 on success, else errno of the first failed command
+ ***************************************************************************/
+extern int i2c_execute_list_ordered(YamlConfigHandle handle, const char *subsyst, i2c_op *ops, unsigned int count, int *results);
+
+/************************************************************************//**
+ * Reads a device register. On an I2C_RDWR bus, the register address write
+ * and the data read are one combined transfer.
+ *
+ * @param[in] handle           :YamlConfigHandle for this subsystem
+ * @param[in] subsyst          :Name of the subsystem
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :Register to read
+ * @param[in] register_size    :1, 2 or 4 byte register
+ * @param[out] value           :Value read, little endian
+ *
+ * @return 0 on success, else errno on failure
+ ***************************************************************************/
+extern int yaml_register_read(YamlConfigHandle handle, const char *subsyst, const char *device, unsigned char register_address, unsigned char register_size, unsigned int *value);
+
+/************************************************************************//**
+ * Reads consecutive bytes of a device, e.g. an EEPROM, starting at a
+ * register. On an I2C_RDWR bus it is one combined transfer.
+ *
+ * @param[in] handle           :YamlConfigHandle for this subsystem
+ * @param[in] subsyst          :Name of the subsystem
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :First register to read
+ * @param[out] data            :Bytes read
+ * @param[in] count            :Number of bytes to read, at most up to
+ *                              register 255
+ *
+ * @return 0 on success, else errno on failure
+ ***************************************************************************/
+extern int yaml_register_read_block(YamlConfigHandle handle, const char *subsyst, const char *device, unsigned char register_address, unsigned char *data, unsigned int count);
+
+/************************************************************************//**
+ * Writes a device register. 4 byte registers need an I2C_RDWR bus.
+ *
+ * @param[in] handle           :YamlConfigHandle for this subsystem
+ * @param[in] subsyst          :Name of the subsystem
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :Register to write
+ * @param[in] register_size    :1, 2 or 4 byte register
+ * @param[in] value            :Value to write, little endian
+ *
+ * @return 0 on success, else errno on failure
+ ***************************************************************************/
+extern int yaml_register_write(YamlConfigHandle handle, const char *subsyst, const char *device, unsigned char register_address, unsigned char register_size, unsigned int value);
+
+/************************************************************************//**
+ * Reads a list of device registers with one i2c_execute_list() call
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in,out] reads :Registers to read; value and rc are set for each
+ * @param[in] count     :Number of entries in reads
+ *
+ * @return 0 on success, else errno of the first failed read
+ ***************************************************************************/
+extern int yaml_register_read_list(YamlConfigHandle handle, const char *subsyst, YamlRegisterRead *reads, unsigned int count);
+
+/************************************************************************//**
+ * Reads a bit op. The masked bits are shifted down to bit 0, and inverted
+ * first if the bit op has negative polarity, so a single bit signal reads
+ * 1 when it is asserted.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] op        :Bit op to read
+ * @param[out] value    :Value of the bit op
+ *
+ * @return 0 on success, else errno on failure
+ ***************************************************************************/
+extern int yaml_bit_op_read(YamlConfigHandle handle, const char *subsyst, const i2c_bit_op *op, unsigned int *value);
+
+/************************************************************************//**
+ * Writes a bit op with a read-modify-write of its register. The value is
+ * shifted up to the lowest bit of the mask, and inverted if the bit op has
+ * negative polarity; the other bits of the register are kept.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] op        :Bit op to write
+ * @param[in] value     :Value of the bit op
+ *
+ * @return 0 on success, else errno on failure
+ ***************************************************************************/
+extern int yaml_bit_op_write(YamlConfigHandle handle, const char *subsyst, const i2c_bit_op *op, unsigned int value);
+
+/************************************************************************//**
+ * Reads a list of bit ops, like yaml_bit_op_read(). Each distinct register
+ * is read once, and all the reads are one i2c_execute_list() call.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] ops       :Bit ops to read
+ * @param[in] count     :Number of bit ops
+ * @param[out] values   :Value of each bit op
+ * @param[out] results  :0 or errno for each bit op
+ *
+ * @return 0 on success, else errno of the first failed bit op
+ ***************************************************************************/
+extern int yaml_bit_op_read_list(YamlConfigHandle handle, const char *subsyst, const i2c_bit_op **ops, unsigned int count, unsigned int *values, int *results);
+
+/************************************************************************//**
+ * Writes a list of bit ops, like yaml_bit_op_write(). Each distinct
+ * register is read once, all of its bit ops are applied, and it is written
+ * once if its value changed.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] ops       :Bit ops to write
+ * @param[in] count     :Number of bit ops
+ * @param[in] values    :Value of each bit op
+ * @param[out] results  :0 or errno for each bit op
+ *
+ * @return 0 on success, else errno of the first failed bit op
+ ***************************************************************************/
+extern int yaml_bit_op_write_list(YamlConfigHandle handle, const char *subsyst, const i2c_bit_op **ops, unsigned int count, const unsigned int *values, int *results);
+
 /************************************************************************//**
  * Returns info for a specific bus
  *
@@ -781,6 +1558,19 @@ extern const YamlPsu *yaml_get_psu(YamlConfigHandle handle, const char *subsyst,
  ***************************************************************************/
 extern int yaml_get_psu_count(YamlConfigHandle handle, const char *subsyst);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of power supplies in a
+ * subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of power supplies in the returned array
+ *
+ * @return YamlPsu * on success, else NULL on failure or if there
+ *         are no power supplies
+ ***************************************************************************/
+extern const YamlPsu *yaml_get_psus_array(YamlConfigHandle handle, const char *subsyst, unsigned int *count);
+
 /************************************************************************//**
  * Returns a pointer to the LED Info in the leds.yaml file
  *
@@ -823,6 +1613,18 @@ extern const YamlLedType *yaml_get_led_type(YamlConfigHandle handle, const char
  ***************************************************************************/
 extern int yaml_get_led_count(YamlConfigHandle handle, const char *subsyst);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of LEDs in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of LEDs in the returned array
+ *
+ * @return YamlLed * on success, else NULL on failure or if there
+ *         are no LEDs
+ ***************************************************************************/
+extern const YamlLed *yaml_get_leds_array(YamlConfigHandle handle, const char *subsyst, unsigned int *count);
+
 /************************************************************************//**
  * Returns number of LED Types in a subsystem
  *
@@ -898,6 +1700,22 @@ extern const YamlCosMapEntry *yaml_get_cos_map_entry(YamlConfigHandle handle,
                                                      const char *subsyst,
                                                      unsigned int idx);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of COS map entries in a
+ * subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of entries in the returned array
+ *
+ * @return YamlCosMapEntry * on success, else NULL on failure or if
+ *         there are no entries
+ ***************************************************************************/
+extern const YamlCosMapEntry *yaml_get_cos_map_entries_array(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     unsigned int *count);
+
 /************************************************************************//**
  * Returns number of DSCP map entries in a subsystem
  *
@@ -922,6 +1740,84 @@ extern const YamlDscpMapEntry *yaml_get_dscp_map_entry(YamlConfigHandle handle,
                                                        const char *subsyst,
                                                        unsigned int idx);
 
+/************************************************************************//**
+ * Returns a pointer to the contiguous array of DSCP map entries in a
+ * subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of entries in the returned array
+ *
+ * @return YamlDscpMapEntry * on success, else NULL on failure or if
+ *         there are no entries
+ ***************************************************************************/
+extern const YamlDscpMapEntry *yaml_get_dscp_map_entries_array(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     unsigned int *count);
+
+/************************************************************************//**
+ * Returns the COS map lookup table slot for a code point. The table is
+ * built when the qos.yaml file is parsed.
+ *
+ * @param[in] handle     :YamlConfigHandle for this subsystem
+ * @param[in] subsyst    :Name of the subsystem
+ * @param[in] code_point :COS code point, 0 to QOS_COS_MAP_SIZE - 1
+ *
+ * @return YamlQosMapValue * on success, else NULL on failure or if the
+ *         COS map does not cover every code point
+ ***************************************************************************/
+extern const YamlQosMapValue *yaml_get_cos_map_value(YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     unsigned int code_point);
+
+/************************************************************************//**
+ * Returns the DSCP map lookup table slot for a code point. The table is
+ * built when the qos.yaml file is parsed.
+ *
+ * @param[in] handle     :YamlConfigHandle for this subsystem
+ * @param[in] subsyst    :Name of the subsystem
+ * @param[in] code_point :DSCP code point, 0 to QOS_DSCP_MAP_SIZE - 1
+ *
+ * @return YamlQosMapValue * on success, else NULL on failure or if the
+ *         DSCP map does not cover every code point
+ ***************************************************************************/
+extern const YamlQosMapValue *yaml_get_dscp_map_value(YamlConfigHandle handle,
+                                                      const char *subsyst,
+                                                      unsigned int code_point);
+
+/************************************************************************//**
+ * Copies the complete COS map lookup table, in code point order, into a
+ * caller supplied buffer
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] table    :Buffer to receive the table
+ * @param[in] size      :Number of slots in the buffer, must be at least
+ *                       QOS_COS_MAP_SIZE
+ *
+ * @return number of slots copied on success, else -1 on failure or if the
+ *         COS map does not cover every code point
+ ***************************************************************************/
+extern int yaml_export_cos_map(YamlConfigHandle handle, const char *subsyst,
+                               YamlQosMapValue *table, unsigned int size);
+
+/************************************************************************//**
+ * Copies the complete DSCP map lookup table, in code point order, into a
+ * caller supplied buffer
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] table    :Buffer to receive the table
+ * @param[in] size      :Number of slots in the buffer, must be at least
+ *                       QOS_DSCP_MAP_SIZE
+ *
+ * @return number of slots copied on success, else -1 on failure or if the
+ *         DSCP map does not cover every code point
+ ***************************************************************************/
+extern int yaml_export_dscp_map(YamlConfigHandle handle, const char *subsyst,
+                                YamlQosMapValue *table, unsigned int size);
+
 /************************************************************************//**
  * Returns number of default schedule-profile entries in a
  * subsystem
@@ -974,6 +1870,1245 @@ extern const YamlQueueProfileEntry *yaml_get_queue_profile_entry(
                                                      YamlConfigHandle handle,
                                                      const char *subsyst,
                                                      unsigned int idx);
+
+/************************************************************************//**
+ * Returns number of named schedule profiles in a subsystem. The flat
+ *    schedule_profile_entries list counts as the profile named by
+ *    qos_info default_name.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return number of profiles on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_get_schedule_profile_count(YamlConfigHandle handle,
+                                      const char *subsyst);
+
+/************************************************************************//**
+ * Returns the name of a specific schedule profile
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] idx       :Index for the specific profile
+ *
+ * @return profile name on success, else NULL on failure
+ ***************************************************************************/
+extern const char *yaml_get_schedule_profile_name(YamlConfigHandle handle,
+                                             const char *subsyst,
+                                             unsigned int idx);
+
+/************************************************************************//**
+ * Returns the entries of a named schedule profile, sorted by queue
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] profile   :Name of the profile, or NULL for the default profile
+ * @param[out] count    :Number of entries in the returned array
+ *
+ * @return YamlScheduleProfileEntry * on success, else NULL with *count set
+ *         to 0 if the profile does not exist or is empty
+ ***************************************************************************/
+extern const YamlScheduleProfileEntry *yaml_get_schedule_profile_entries(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     const char *profile,
+                                                     unsigned int *count);
+
+/************************************************************************//**
+ * Locates the entry for a queue in a named schedule profile
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] profile   :Name of the profile, or NULL for the default profile
+ * @param[in] queue     :Queue number
+ *
+ * @return YamlScheduleProfileEntry * on success, else NULL on failure
+ ***************************************************************************/
+extern const YamlScheduleProfileEntry *yaml_find_schedule_profile_entry(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     const char *profile,
+                                                     unsigned int queue);
+
+/************************************************************************//**
+ * Returns number of named queue profiles in a subsystem. The flat
+ *    queue_profile_entries list counts as the profile named by
+ *    qos_info default_name.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return number of profiles on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_get_queue_profile_count(YamlConfigHandle handle,
+                                      const char *subsyst);
+
+/************************************************************************//**
+ * Returns the name of a specific queue profile
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] idx       :Index for the specific profile
+ *
+ * @return profile name on success, else NULL on failure
+ ***************************************************************************/
+extern const char *yaml_get_queue_profile_name(YamlConfigHandle handle,
+                                             const char *subsyst,
+                                             unsigned int idx);
+
+/************************************************************************//**
+ * Returns the entries of a named queue profile, sorted by queue
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] profile   :Name of the profile, or NULL for the default profile
+ * @param[out] count    :Number of entries in the returned array
+ *
+ * @return YamlQueueProfileEntry * on success, else NULL with *count set
+ *         to 0 if the profile does not exist or is empty
+ ***************************************************************************/
+extern const YamlQueueProfileEntry *yaml_get_queue_profile_entries(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     const char *profile,
+                                                     unsigned int *count);
+
+/************************************************************************//**
+ * Locates the entry for a queue in a named queue profile
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] profile   :Name of the profile, or NULL for the default profile
+ * @param[in] queue     :Queue number
+ *
+ * @return YamlQueueProfileEntry * on success, else NULL on failure
+ ***************************************************************************/
+extern const YamlQueueProfileEntry *yaml_find_queue_profile_entry(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     const char *profile,
+                                                     unsigned int queue);
+
+/************************************************************************//**
+ * Reads and parses the buffer monitoring yaml file for this subsystem.
+ *    The file is streamed rather than loaded as a document, and the
+ *    counters are stored in a compact columnar layout.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_parse_bufmon(YamlConfigHandle handle, const char *subsyst);
+
+/************************************************************************//**
+ * Returns buffer monitoring capabilities information
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return YamlBufmonInfo * on success, else NULL on failure
+ ***************************************************************************/
+extern const YamlBufmonInfo *yaml_get_bufmon_info(YamlConfigHandle handle,
+                                                  const char *subsyst);
+
+/************************************************************************//**
+ * Returns number of buffer monitoring counters in a subsystem
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return number of counters on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_get_bufmon_counter_count(YamlConfigHandle handle,
+                                         const char *subsyst);
+
+/************************************************************************//**
+ * Fills in the description of a specific buffer monitoring counter
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] idx       :Index for the specific counter
+ * @param[out] counter  :Counter description
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_get_bufmon_counter(YamlConfigHandle handle,
+                                   const char *subsyst, unsigned int idx,
+                                   YamlBufmonCounter *counter);
+
+/************************************************************************//**
+ * Formats the full name of a specific buffer monitoring counter
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] idx       :Index for the specific counter
+ * @param[out] buf      :Buffer for the name
+ * @param[in] size      :Size of buf
+ *
+ * @return length of the name on success, else -1 on failure or if buf is
+ *         too small
+ ***************************************************************************/
+extern int yaml_get_bufmon_counter_name(YamlConfigHandle handle,
+                                        const char *subsyst, unsigned int idx,
+                                        char *buf, unsigned int size);
+
+/************************************************************************//**
+ * Locates a buffer monitoring counter by its full name, for example
+ *    "ingress-port-priority-group/um-share-buffer-count/1/1"
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] name      :Name of the counter
+ *
+ * @return index of the counter on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_find_bufmon_counter(YamlConfigHandle handle,
+                                    const char *subsyst, const char *name);
+
+/************************************************************************//**
+ * Returns the indexes of the buffer monitoring counters for a port, sorted
+ *    by priority group and then by file order
+ *
+ * @param[in] handle         :YamlConfigHandle for this subsystem
+ * @param[in] subsyst        :Name of the subsystem
+ * @param[in] port           :Vendor specific port
+ * @param[in] priority_group :Vendor specific priority group, or -1 for all
+ *                            counters of the port
+ * @param[out] count         :Number of indexes in the returned array
+ *
+ * @return array of counter indexes on success, else NULL with *count set
+ *         to 0 if there are no matching counters
+ ***************************************************************************/
+extern const unsigned int *yaml_get_bufmon_port_counters(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     int port,
+                                                     int priority_group,
+                                                     unsigned int *count);
+
+/************************************************************************//**
+ * Returns the buffer monitoring counter indexes sorted by name, segment by
+ *    segment. Counters that share leading name segments are adjacent, so
+ *    the results of yaml_query_bufmon_counters() are ranges of this array.
+ *    Segments are grouped in the order they first appear in the file, not
+ *    alphabetically.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[out] count    :Number of indexes in the returned array
+ *
+ * @return array of counter indexes on success, else NULL with *count set
+ *         to 0 if there are no counters
+ ***************************************************************************/
+extern const unsigned int *yaml_get_bufmon_sorted_counters(
+                                                     YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     unsigned int *count);
+
+/************************************************************************//**
+ * Finds the buffer monitoring counters that match a name pattern. The
+ *    pattern has up to BUFMON_NAME_SEGMENTS '/' separated segments. Each
+ *    segment is either an exact name segment or "*", and missing trailing
+ *    segments match anything. For example "ingress-port-priority-group"
+ *    selects a whole realm, and "* / * /17" (without the spaces) selects
+ *    every counter whose third segment is 17.
+ *
+ * @param[in] handle     :YamlConfigHandle for this subsystem
+ * @param[in] subsyst    :Name of the subsystem
+ * @param[in] pattern    :Name pattern
+ * @param[out] ranges    :Ranges of the yaml_get_bufmon_sorted_counters()
+ *                        array that match, in array order
+ * @param[in] max_ranges :Number of entries in ranges
+ *
+ * @return total number of ranges on success, which may be more than
+ *         max_ranges, else -1 on failure or if the pattern is malformed
+ ***************************************************************************/
+extern int yaml_query_bufmon_counters(YamlConfigHandle handle,
+                                      const char *subsyst,
+                                      const char *pattern,
+                                      YamlBufmonRange *ranges,
+                                      unsigned int max_ranges);
+
+/************************************************************************//**
+ * Creates a threshold engine for the buffer monitoring counters of a
+ *    subsystem, using their trigger_threshold and enabled values. The
+ *    samples passed to bufmon_engine_evaluate() must be in counter index
+ *    order.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] mode      :Evaluation mode
+ *
+ * @return YamlBufmonEngine * on success, else NULL on failure. The engine
+ *         is freed with bufmon_engine_free().
+ ***************************************************************************/
+extern YamlBufmonEngine *yaml_new_bufmon_engine(YamlConfigHandle handle,
+                                                const char *subsyst,
+                                                YamlBufmonMode mode);
+
+/************************************************************************//**
+ * Creates a thermal policy engine for the sensors of a subsystem. The
+ *    temperatures passed to thermal_engine_evaluate() must be in sensor
+ *    index order.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return YamlThermalEngine * on success, else NULL on failure. The engine
+ *         is freed with thermal_engine_free().
+ ***************************************************************************/
+extern YamlThermalEngine *yaml_new_thermal_engine(YamlConfigHandle handle,
+                                                  const char *subsyst);
+
+/************************************************************************//**
+ * Creates a platform poller for a subsystem. The periods of the
+ * subscriptions are rounded up to a multiple of granularity_ms, and the
+ * poller ticks at the greatest common divisor of the periods. Each tick
+ * reads every register that is due once, whatever the number of
+ * subscriptions to it, and passes the value to all of them.
+ *
+ * @param[in] handle         :YamlConfigHandle for this subsystem
+ * @param[in] subsyst        :Name of the subsystem
+ * @param[in] granularity_ms :Smallest tick in milliseconds, or 0 for 1ms
+ *
+ * @return YamlPoller * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlPoller *yaml_poller_new(YamlConfigHandle handle, const char *subsyst,
+                                   unsigned int granularity_ms);
+
+/************************************************************************//**
+ * Stops and frees a platform poller
+ *
+ * @param[in] poller :Poller to free
+ ***************************************************************************/
+extern void yaml_poller_free(YamlPoller *poller);
+
+/************************************************************************//**
+ * Subscribes to a bit op, e.g. a PSU, fan fault or port module signal
+ *
+ * @param[in] poller    :Poller
+ * @param[in] op        :Bit op to read
+ * @param[in] period_ms :Polling period in milliseconds
+ * @param[in] callback  :Function called with each value
+ * @param[in] context   :Passed to the callback
+ *
+ * @return subscription id on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_poller_subscribe_bit_op(YamlPoller *poller,
+                                        const i2c_bit_op *op,
+                                        unsigned int period_ms,
+                                        YamlPollerCallback callback,
+                                        void *context);
+
+/************************************************************************//**
+ * Subscribes to a device register, e.g. the value register of a sensor
+ *
+ * @param[in] poller           :Poller
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :Register to read
+ * @param[in] register_size    :Size of the register, 1 to 4 bytes
+ * @param[in] period_ms        :Polling period in milliseconds
+ * @param[in] callback         :Function called with each value
+ * @param[in] context          :Passed to the callback
+ *
+ * @return subscription id on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_poller_subscribe_register(YamlPoller *poller,
+                                          const char *device,
+                                          unsigned char register_address,
+                                          unsigned char register_size,
+                                          unsigned int period_ms,
+                                          YamlPollerCallback callback,
+                                          void *context);
+
+/************************************************************************//**
+ * Removes a subscription. Once this returns, its callback isn't called
+ * again; if another thread is in a tick, this waits for the tick to end.
+ *
+ * @param[in] poller :Poller
+ * @param[in] id     :Subscription id
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_poller_unsubscribe(YamlPoller *poller, int id);
+
+/************************************************************************//**
+ * Returns the shared tick of a poller
+ *
+ * @param[in] poller :Poller
+ *
+ * @return tick in milliseconds, or 0 if there are no subscriptions
+ ***************************************************************************/
+extern unsigned int yaml_poller_get_tick(YamlPoller *poller);
+
+/************************************************************************//**
+ * Performs one tick: reads the registers that are due and calls their
+ * subscribers. Called by the poller thread, or directly by a caller that
+ * runs its own timer.
+ *
+ * @param[in] poller :Poller
+ *
+ * @return number of registers read, else -1 on failure
+ ***************************************************************************/
+extern int yaml_poller_tick(YamlPoller *poller);
+
+/************************************************************************//**
+ * Starts a thread that calls yaml_poller_tick() every tick
+ *
+ * @param[in] poller :Poller
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_poller_start(YamlPoller *poller);
+
+/************************************************************************//**
+ * Stops the thread started by yaml_poller_start()
+ *
+ * @param[in] poller :Poller
+ ***************************************************************************/
+extern void yaml_poller_stop(YamlPoller *poller);
+
+/************************************************************************//**
+ * Creates a shadow register write cache for a subsystem. Bit op writes are
+ * staged with yaml_shadow_set(), and yaml_shadow_flush() performs at most
+ * one read-modify-write per register. The read uses the cached register
+ * value until it is resync_ms old, and the write is skipped if the register
+ * value doesn't change.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] resync_ms :Age at which a cached register is read again, or 0
+ *                       to read it only after a failure or
+ *                       yaml_shadow_invalidate()
+ *
+ * @return YamlShadowCache * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlShadowCache *yaml_shadow_new(YamlConfigHandle handle,
+                                        const char *subsyst,
+                                        unsigned int resync_ms);
+
+/************************************************************************//**
+ * Frees a shadow register write cache. Staged writes are dropped.
+ *
+ * @param[in] cache :Cache to free
+ ***************************************************************************/
+extern void yaml_shadow_free(YamlShadowCache *cache);
+
+/************************************************************************//**
+ * Stages a bit op write, e.g. a fan speed or LED setting. The value is in
+ * register position; only its bit_mask bits are written. A later write to
+ * the same bits before the flush replaces this one.
+ *
+ * @param[in] cache :Cache
+ * @param[in] op    :Bit op to write
+ * @param[in] value :Register value to write under the bit mask
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int yaml_shadow_set(YamlShadowCache *cache, const i2c_bit_op *op,
+                           unsigned int value);
+
+/************************************************************************//**
+ * Returns the cached bits of a bit op, in register position
+ *
+ * @param[in] cache  :Cache
+ * @param[in] op     :Bit op
+ * @param[out] value :Cached register value under the bit mask
+ *
+ * @return 0 on success, else -1 if the register isn't cached
+ ***************************************************************************/
+extern int yaml_shadow_get(YamlShadowCache *cache, const i2c_bit_op *op,
+                           unsigned int *value);
+
+/************************************************************************//**
+ * Writes the staged bit ops, with one read-modify-write per register.
+ * Registers that fail keep their staged bits and are read again on the
+ * next flush.
+ *
+ * @param[in] cache :Cache
+ *
+ * @return number of registers written, else -1 if any register failed
+ ***************************************************************************/
+extern int yaml_shadow_flush(YamlShadowCache *cache);
+
+/************************************************************************//**
+ * Marks every cached register stale, so the next flush reads it again
+ *
+ * @param[in] cache :Cache
+ ***************************************************************************/
+extern void yaml_shadow_invalidate(YamlShadowCache *cache);
+
+/************************************************************************//**
+ * Creates a PSU status sweep for the power supplies of a subsystem. The
+ * distinct registers of their status bit ops are found once here.
+ * yaml_parse_psus() must have been called.
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ *
+ * @return YamlPsuSweep * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlPsuSweep *yaml_psu_sweep_new(YamlConfigHandle handle,
+                                        const char *subsyst);
+
+/************************************************************************//**
+ * Frees a PSU status sweep
+ *
+ * @param[in] sweep :Sweep to free
+ ***************************************************************************/
+extern void yaml_psu_sweep_free(YamlPsuSweep *sweep);
+
+/************************************************************************//**
+ * Reads the PSU status registers, each once, and returns the status bits
+ * that changed since the previous sweep. The first sweep returns every
+ * status bit. Bits that don't fit in edges, or whose register read failed,
+ * keep their previous value and are returned by a later sweep.
+ *
+ * @param[in] sweep       :Sweep
+ * @param[out] edges      :Status bits that changed
+ * @param[in] max_edges   :Number of entries in edges
+ * @param[out] edge_count :Number of edges returned
+ *
+ * @return 0 on success, else errno of the first failed register read
+ ***************************************************************************/
+extern int yaml_psu_sweep(YamlPsuSweep *sweep, YamlPsuEdge *edges,
+                          unsigned int max_edges, unsigned int *edge_count);
+
+/************************************************************************//**
+ * Creates a module presence scan for the pluggable ports of a subsystem.
+ * The interrupt and presence registers of the ports are found once here.
+ * yaml_parse_ports() must have been called.
+ *
+ * @param[in] handle        :YamlConfigHandle for this subsystem
+ * @param[in] subsyst       :Name of the subsystem
+ * @param[in] full_sweep_ms :Interval of the full sweeps that read every
+ *                           presence register, or 0 for only the first
+ *                           scan
+ *
+ * @return YamlPresenceScan * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlPresenceScan *yaml_presence_scan_new(YamlConfigHandle handle,
+                                                const char *subsyst,
+                                                unsigned int full_sweep_ms);
+
+/************************************************************************//**
+ * Frees a module presence scan
+ *
+ * @param[in] scan :Scan to free
+ ***************************************************************************/
+extern void yaml_presence_scan_free(YamlPresenceScan *scan);
+
+/************************************************************************//**
+ * Reads the interrupt registers of the ports, then the presence registers
+ * of the ports whose interrupt is asserted or that have no interrupt, and
+ * returns the ports whose module presence changed. The first scan, and one
+ * every full_sweep_ms, reads every presence register and unmasks the
+ * port interrupts. An interrupt that is asserted without a presence change
+ * is masked until the next full sweep, if the port has an interrupt mask.
+ * Ports that don't fit in edges, or whose register read failed, keep their
+ * previous state and are returned by a later scan.
+ *
+ * @param[in] scan        :Scan
+ * @param[out] edges      :Ports whose module presence changed
+ * @param[in] max_edges   :Number of entries in edges
+ * @param[out] edge_count :Number of edges returned
+ *
+ * @return 0 on success, else errno of the first failed i2c operation
+ ***************************************************************************/
+extern int yaml_presence_scan(YamlPresenceScan *scan, YamlPresenceEdge *edges,
+                              unsigned int max_edges,
+                              unsigned int *edge_count);
+
+/************************************************************************//**
+ * Creates a module EEPROM cache for the pluggable ports of a subsystem.
+ * The static identity and vendor region of a module EEPROM is read once
+ * until the port is invalidated; the diagnostic region is read again when
+ * it is older than diag_refresh_ms. yaml_parse_ports() must have been
+ * called.
+ *
+ * The cache doesn't watch the ports itself. The caller must pass the
+ * edges of every yaml_presence_scan() to yaml_eeprom_presence_changed(),
+ * and call yaml_eeprom_invalidate() after it resets a module; otherwise
+ * the static region of a replaced or reset module is served stale.
+ *
+ * @param[in] handle          :YamlConfigHandle for this subsystem
+ * @param[in] subsyst         :Name of the subsystem
+ * @param[in] diag_refresh_ms :Age at which the diagnostic region is read
+ *                             again, or 0 to read it on every read
+ *
+ * @return YamlEepromCache * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlEepromCache *yaml_eeprom_cache_new(YamlConfigHandle handle,
+                                              const char *subsyst,
+                                              unsigned int diag_refresh_ms);
+
+/************************************************************************//**
+ * Frees a module EEPROM cache
+ *
+ * @param[in] cache :Cache to free
+ ***************************************************************************/
+extern void yaml_eeprom_cache_free(YamlEepromCache *cache);
+
+/************************************************************************//**
+ * Reads bytes of the module EEPROM of a port, from the cache if possible.
+ * For QSFP+ and QSFP28 modules, bytes 0-127 are diagnostic and bytes
+ * 128-255 (upper page 00h) are static. For SFP+ modules, all 256 bytes
+ * are static.
+ *
+ * @param[in] cache     :Cache
+ * @param[in] port_idx  :Index of the port in ports.yaml
+ * @param[in] offset    :First byte to read
+ * @param[in] length    :Number of bytes to read
+ * @param[out] data     :Bytes read
+ *
+ * @return 0 on success, else errno on failure
+ ***************************************************************************/
+extern int yaml_eeprom_read(YamlEepromCache *cache, unsigned int port_idx,
+                            unsigned int offset, unsigned int length,
+                            unsigned char *data);
+
+/************************************************************************//**
+ * Drops the cached EEPROM of a port, e.g. after its module is reset, and
+ * starts a new generation
+ *
+ * @param[in] cache     :Cache
+ * @param[in] port_idx  :Index of the port in ports.yaml
+ ***************************************************************************/
+extern void yaml_eeprom_invalidate(YamlEepromCache *cache,
+                                   unsigned int port_idx);
+
+/************************************************************************//**
+ * Drops the cached EEPROM of the ports returned by yaml_presence_scan()
+ *
+ * @param[in] cache :Cache
+ * @param[in] edges :Ports whose module presence changed
+ * @param[in] count :Number of edges
+ ***************************************************************************/
+extern void yaml_eeprom_presence_changed(YamlEepromCache *cache,
+                                         const YamlPresenceEdge *edges,
+                                         unsigned int count);
+
+/************************************************************************//**
+ * Returns the generation of a port's cached EEPROM. It changes whenever
+ * the port is invalidated, so a client can tell that its module changed.
+ *
+ * @param[in] cache     :Cache
+ * @param[in] port_idx  :Index of the port in ports.yaml
+ *
+ * @return generation of the port, or 0 for an unknown port
+ ***************************************************************************/
+extern unsigned int yaml_eeprom_get_generation(YamlEepromCache *cache,
+                                               unsigned int port_idx);
+
+/************************************************************************//**
+ * Creates an i2c simulator with a 256 byte register file for every device
+ * of a subsystem. A command reaches the device at its bus and address
+ * whose mux pre operations are in effect, so a device behind an
+ * unselected mux channel doesn't respond. Install it on the handle with
+ * yaml_set_i2c_backend(yaml_i2c_sim_backend(sim)).
+ *
+ * @param[in] handle    :YamlConfigHandle for this subsystem
+ * @param[in] subsyst   :Name of the subsystem
+ * @param[in] config    :Timing model, or NULL for a 100 kHz bus without
+ *                       transaction cost
+ *
+ * @return YamlI2cSim * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlI2cSim *yaml_i2c_sim_new(YamlConfigHandle handle,
+                                    const char *subsyst,
+                                    const YamlI2cSimConfig *config);
+
+/************************************************************************//**
+ * Frees an i2c simulator. It must not be installed on a handle.
+ *
+ * @param[in] sim :Simulator to free
+ ***************************************************************************/
+extern void yaml_i2c_sim_free(YamlI2cSim *sim);
+
+/************************************************************************//**
+ * Returns the bus backend of an i2c simulator
+ *
+ * @param[in] sim :Simulator
+ *
+ * @return YamlI2cBackend * for yaml_set_i2c_backend()
+ ***************************************************************************/
+extern const YamlI2cBackend *yaml_i2c_sim_backend(YamlI2cSim *sim);
+
+/************************************************************************//**
+ * Sets a register of a simulated device
+ *
+ * @param[in] sim              :Simulator
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :Register to set
+ * @param[in] value            :Value of the register
+ *
+ * @return 0 on success, else EINVAL for an unknown device
+ ***************************************************************************/
+extern int yaml_i2c_sim_set_register(YamlI2cSim *sim, const char *device,
+                                     unsigned char register_address,
+                                     unsigned char value);
+
+/************************************************************************//**
+ * Returns a register of a simulated device
+ *
+ * @param[in] sim              :Simulator
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :Register to return
+ * @param[out] value           :Value of the register
+ *
+ * @return 0 on success, else EINVAL for an unknown device
+ ***************************************************************************/
+extern int yaml_i2c_sim_get_register(YamlI2cSim *sim, const char *device,
+                                     unsigned char register_address,
+                                     unsigned char *value);
+
+/************************************************************************//**
+ * Makes commands to a simulated device fail
+ *
+ * @param[in] sim              :Simulator
+ * @param[in] device           :Name of the device
+ * @param[in] register_address :Register whose commands fail, or -1 for all
+ * @param[in] error            :errno of the failed commands, e.g. EIO
+ * @param[in] count            :Number of commands to fail, or 0 until
+ *                              yaml_i2c_sim_clear_faults()
+ *
+ * @return 0 on success, else EINVAL or ENOMEM
+ ***************************************************************************/
+extern int yaml_i2c_sim_inject_fault(YamlI2cSim *sim, const char *device,
+                                     int register_address, int error,
+                                     unsigned int count);
+
+/************************************************************************//**
+ * Removes all injected faults
+ *
+ * @param[in] sim :Simulator
+ ***************************************************************************/
+extern void yaml_i2c_sim_clear_faults(YamlI2cSim *sim);
+
+/************************************************************************//**
+ * Returns the counters of an i2c simulator
+ *
+ * @param[in] sim    :Simulator
+ * @param[out] stats :Counters since the simulator was created or reset
+ ***************************************************************************/
+extern void yaml_i2c_sim_get_stats(YamlI2cSim *sim, YamlI2cSimStats *stats);
+
+/************************************************************************//**
+ * Resets the counters of an i2c simulator
+ *
+ * @param[in] sim :Simulator
+ ***************************************************************************/
+extern void yaml_i2c_sim_reset_stats(YamlI2cSim *sim);
+
+/************************************************************************//**
+ * Starts recording the i2c transactions of a handle to a binary trace. The
+ * recorder is installed as the backend of the handle and passes every
+ * transfer to the backend that was installed before. Each transfer is
+ * logged with its start time, duration and bus, and each command with its
+ * address, direction, register, byte count, status and written bytes. Read
+ * data isn't logged.
+ *
+ * @param[in] handle  :YamlConfigHandle
+ * @param[in] subsyst :Name of the subsystem
+ * @param[in] path    :Trace file, truncated if it exists
+ *
+ * @return YamlI2cRecorder * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlI2cRecorder *yaml_i2c_recorder_new(YamlConfigHandle handle,
+                                              const char *subsyst,
+                                              const char *path);
+
+/************************************************************************//**
+ * Stops recording, reinstalls the previous backend of the handle and
+ * closes the trace
+ *
+ * @param[in] recorder :Recorder
+ ***************************************************************************/
+extern void yaml_i2c_recorder_free(YamlI2cRecorder *recorder);
+
+/************************************************************************//**
+ * Replays an i2c trace into the backend installed on a handle, normally an
+ * i2c simulator. Devices are looked up by name in the subsystem.
+ *
+ * @param[in] handle  :YamlConfigHandle with a backend installed
+ * @param[in] subsyst :Name of the subsystem
+ * @param[in] path    :Trace file of yaml_i2c_recorder_new()
+ * @param[in] speedup :1 for the recorded pace, n for n times faster, 0 for
+ *                     no pacing
+ * @param[out] stats  :Outcome of the replay, or NULL
+ *
+ * @return int :0 on success, EINVAL if the handle has no backend, a device
+ *              is unknown or the trace is malformed, or errno of the file
+ ***************************************************************************/
+extern int yaml_i2c_trace_replay(YamlConfigHandle handle, const char *subsyst,
+                                 const char *path, unsigned int speedup,
+                                 YamlI2cReplayStats *stats);
+
+/************************************************************************//**
+ * Creates an empty set of i2c statistics. Every handle has one, see
+ * yaml_get_i2c_stats().
+ *
+ * @return YamlI2cStats * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlI2cStats *yaml_i2c_stats_new(void);
+
+/************************************************************************//**
+ * Frees a set of i2c statistics
+ *
+ * @param[in] stats :Statistics
+ ***************************************************************************/
+extern void yaml_i2c_stats_free(YamlI2cStats *stats);
+
+/************************************************************************//**
+ * Adds the duration of a phase to the histogram of a bus or a device. Safe
+ * to call from any thread; it takes no lock.
+ *
+ * @param[in] stats :Statistics, or NULL to do nothing
+ * @param[in] key   :The YamlBus or YamlDevice
+ * @param[in] name  :Its name, kept for snapshots
+ * @param[in] bus   :True for a bus
+ * @param[in] phase :Phase
+ * @param[in] ns    :Duration
+ ***************************************************************************/
+extern void yaml_i2c_stats_add_time(YamlI2cStats *stats, const void *key,
+                                    const char *name, bool bus,
+                                    YamlI2cPhase phase,
+                                    unsigned long long ns);
+
+/************************************************************************//**
+ * Counts a transaction of a bus or a device. Safe to call from any thread;
+ * it takes no lock.
+ *
+ * @param[in] stats    :Statistics, or NULL to do nothing
+ * @param[in] key      :The YamlBus or YamlDevice
+ * @param[in] name     :Its name, kept for snapshots
+ * @param[in] bus      :True for a bus
+ * @param[in] commands :Commands of the transaction
+ * @param[in] bytes    :Data bytes of the commands
+ * @param[in] rc       :0, or errno of the failure
+ ***************************************************************************/
+extern void yaml_i2c_stats_add_transaction(YamlI2cStats *stats,
+                                           const void *key, const char *name,
+                                           bool bus, unsigned int commands,
+                                           unsigned int bytes, int rc);
+
+/************************************************************************//**
+ * Copies the counters of every bus and device, in no particular order.
+ * The counters keep running while they are copied.
+ *
+ * @param[in] stats       :Statistics
+ * @param[out] entries    :Counters
+ * @param[in] max_entries :Size of entries
+ *
+ * @return int :Number of buses and devices, which may exceed max_entries
+ ***************************************************************************/
+extern int yaml_i2c_stats_snapshot(YamlI2cStats *stats,
+                                   YamlI2cStatsEntry *entries,
+                                   unsigned int max_entries);
+
+/************************************************************************//**
+ * Zeroes the counters of every bus and device
+ *
+ * @param[in] stats :Statistics
+ ***************************************************************************/
+extern void yaml_i2c_stats_reset(YamlI2cStats *stats);
+
+/************************************************************************//**
+ * Returns a percentile of a histogram, as the upper bound of its bucket
+ *
+ * @param[in] histogram  :Histogram
+ * @param[in] percentile :0 to 100
+ *
+ * @return unsigned long long :Latency in ns, 0 if the histogram is empty
+ ***************************************************************************/
+extern unsigned long long yaml_i2c_histogram_percentile(
+                                    const YamlI2cHistogram *histogram,
+                                    double percentile);
+
+/************************************************************************//**
+ * Locks a bus device for the calling thread. Each device has one lock and
+ * one descriptor per process. The outermost lock of a thread takes an
+ * in-process mutex, then flock() on the descriptor for other processes;
+ * the thread that holds the lock can lock it again at no cost. A thread
+ * that waited for the mutex may be handed the flock() of the previous
+ * holder. The descriptor is close-on-exec, and a forked child reopens it
+ * with every lock released; do not fork while holding a bus lock.
+ *
+ * @param[in] devname :Device file of the bus, e.g. /dev/i2c-0
+ * @param[out] lock   :Lock, to pass to yaml_bus_unlock()
+ *
+ * @return int :0 on success, else errno of the device open
+ ***************************************************************************/
+extern int yaml_bus_lock(const char *devname, YamlBusLock **lock);
+
+/************************************************************************//**
+ * Returns the descriptor of a locked bus device
+ *
+ * @param[in] lock :Lock of yaml_bus_lock()
+ *
+ * @return int :Descriptor, open for the life of the process
+ ***************************************************************************/
+extern int yaml_bus_lock_fd(const YamlBusLock *lock);
+
+/************************************************************************//**
+ * Releases a lock of yaml_bus_lock(). The outermost unlock releases the
+ * mutex, and the flock() unless it hands it over to a waiting thread.
+ *
+ * @param[in] lock :Lock
+ ***************************************************************************/
+extern void yaml_bus_unlock(YamlBusLock *lock);
+
+/************************************************************************//**
+ * Returns the lock counters of a bus device
+ *
+ * @param[in] devname :Device file of the bus
+ * @param[out] stats  :Counters
+ *
+ * @return int :0 on success, EINVAL if the device was never locked
+ ***************************************************************************/
+extern int yaml_bus_lock_get_stats(const char *devname,
+                                   YamlBusLockStats *stats);
+
+/************************************************************************//**
+ * Holds a bus for the calling thread across several i2c_execute() or
+ * i2c_execute_list() calls, which then don't lock the bus again. Other
+ * threads and processes wait until the session ends, so keep it short.
+ *
+ * @param[in] handle   :YamlConfigHandle
+ * @param[in] subsyst  :Name of the subsystem
+ * @param[in] bus_name :Name of the bus
+ *
+ * @return YamlI2cBusSession * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlI2cBusSession *yaml_i2c_bus_session_begin(YamlConfigHandle handle,
+                                                     const char *subsyst,
+                                                     const char *bus_name);
+
+/************************************************************************//**
+ * Ends a bus session
+ *
+ * @param[in] session :Session
+ ***************************************************************************/
+extern void yaml_i2c_bus_session_end(YamlI2cBusSession *session);
+
+/************************************************************************//**
+ * Tells whether the calling thread has a bus session open. Only this
+ * thread can lock the bus of the session again, so i2c_execute_list()
+ * doesn't hand buses to other threads while it is true.
+ *
+ * @return bool :true if a session is open in the calling thread
+ ***************************************************************************/
+extern bool yaml_i2c_bus_session_active(void);
+
+/************************************************************************//**
+ * Creates an empty route cache. Every handle has one, see
+ * yaml_get_i2c_routes().
+ *
+ * @return YamlI2cRoutes * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlI2cRoutes *yaml_i2c_routes_new(void);
+
+/************************************************************************//**
+ * Frees a route cache and its routes
+ *
+ * @param[in] routes :Route cache, may be NULL
+ ***************************************************************************/
+extern void yaml_i2c_routes_free(YamlI2cRoutes *routes);
+
+/************************************************************************//**
+ * Forgets every route. A route that a thread found after
+ * yaml_i2c_routes_enter() stays valid until every such thread has left.
+ *
+ * @param[in] routes :Route cache, may be NULL
+ ***************************************************************************/
+extern void yaml_i2c_routes_clear(YamlI2cRoutes *routes);
+
+/************************************************************************//**
+ * Forgets the routes of the devices of a subsystem and the routes that go
+ * through it to a parent adapter, e.g. when the subsystem is parsed again.
+ * A route that a thread found after yaml_i2c_routes_enter() stays valid
+ * until every such thread has left.
+ *
+ * @param[in] routes  :Route cache, may be NULL
+ * @param[in] subsyst :Name of the subsystem
+ ***************************************************************************/
+extern void yaml_i2c_routes_invalidate(YamlI2cRoutes *routes,
+                                       const char *subsyst);
+
+/************************************************************************//**
+ * Starts using the routes of a cache. The routes found until
+ * yaml_i2c_routes_leave() aren't freed before it, even if they are
+ * forgotten. i2c_execute() and i2c_execute_list() do this themselves.
+ *
+ * @param[in] routes :Route cache, may be NULL
+ ***************************************************************************/
+extern void yaml_i2c_routes_enter(YamlI2cRoutes *routes);
+
+/************************************************************************//**
+ * Stops using the routes of a cache. The last thread to leave frees the
+ * routes that were forgotten.
+ *
+ * @param[in] routes :Route cache, may be NULL
+ ***************************************************************************/
+extern void yaml_i2c_routes_leave(YamlI2cRoutes *routes);
+
+/************************************************************************//**
+ * Returns the route to a device. It follows the pre operations of the
+ * device's subsystem to the device's bus, then, if the bus has a parent
+ * device, the route of the parent device in its subsystem, and so on. The
+ * route is resolved on first use and cached until its subsystem or a
+ * parent subsystem is parsed again; safe to call from any thread. Call it
+ * between yaml_i2c_routes_enter() and yaml_i2c_routes_leave() to keep
+ * using the route while another thread parses.
+ *
+ * @param[in] handle  :YamlConfigHandle
+ * @param[in] subsyst :Name of the subsystem of the device
+ * @param[in] dev     :Device
+ *
+ * @return YamlI2cRoute * on success, else NULL if a bus or device of the
+ *         route is unknown, a mux isn't on the bus of its device, or the
+ *         parents form a loop
+ ***************************************************************************/
+extern const YamlI2cRoute *yaml_i2c_route(YamlConfigHandle handle,
+                                          const char *subsyst,
+                                          const YamlDevice *dev);
+
+/************************************************************************//**
+ * Builds the catalog index of the platforms under a directory, e.g. the
+ * directory holding Accton/, Generic-x86/ and OpenSwitch/: every
+ * <root>/<vendor>/<platform>/manifest.yaml is parsed for its manufacturer,
+ * product name and files, and every listed file is hashed. The index
+ * replaces index_file atomically.
+ *
+ * @param[in] root       :Directory of the vendor directories
+ * @param[in] index_file :Index file to write
+ *
+ * @return 0 on success, else ENOENT if a listed file is missing, EINVAL if
+ *         a manifest is malformed, EEXIST if two platforms have the same
+ *         manufacturer and product name, or another errno
+ ***************************************************************************/
+extern int yaml_catalog_build(const char *root, const char *index_file);
+
+/************************************************************************//**
+ * Writes a catalog index of platforms, in any order. Used by
+ * yaml_catalog_build().
+ *
+ * @param[in] index_file :Index file to write, replaced atomically
+ * @param[in] platforms  :Platforms
+ * @param[in] count      :Number of platforms
+ *
+ * @return 0 on success, else EEXIST if two platforms have the same
+ *         manufacturer and product name, or another errno
+ ***************************************************************************/
+extern int yaml_catalog_write(const char *index_file,
+                              const YamlCatalogPlatform *platforms,
+                              unsigned int count);
+
+/************************************************************************//**
+ * Reads a catalog index, in one read and without parsing any YAML
+ *
+ * @param[in] index_file :Index file
+ *
+ * @return YamlCatalog * on success, else NULL with errno set, EINVAL if the
+ *         file isn't a valid index
+ ***************************************************************************/
+extern YamlCatalog *yaml_catalog_open(const char *index_file);
+
+/************************************************************************//**
+ * Frees a catalog index and its platforms
+ *
+ * @param[in] catalog :Catalog, may be NULL
+ ***************************************************************************/
+extern void yaml_catalog_close(YamlCatalog *catalog);
+
+/************************************************************************//**
+ * Returns the platforms of a catalog, sorted by product name then
+ * manufacturer
+ *
+ * @param[in]  catalog :Catalog
+ * @param[out] count   :Number of platforms
+ *
+ * @return YamlCatalogPlatform * on success, else NULL on failure
+ ***************************************************************************/
+extern const YamlCatalogPlatform *yaml_catalog_get_platforms(
+                                            const YamlCatalog *catalog,
+                                            unsigned int *count);
+
+/************************************************************************//**
+ * Finds the platform of a product, e.g. as read from the system EEPROM
+ *
+ * @param[in] catalog      :Catalog
+ * @param[in] manufacturer :Manufacturer, or NULL for any
+ * @param[in] product_name :Product name
+ *
+ * @return YamlCatalogPlatform * on success, else NULL if unknown
+ ***************************************************************************/
+extern const YamlCatalogPlatform *yaml_catalog_find(const YamlCatalog *catalog,
+                                                    const char *manufacturer,
+                                                    const char *product_name);
+
+/************************************************************************//**
+ * Checks that the files of a platform are unchanged since the index was
+ * built
+ *
+ * @param[in] platform :Platform of the catalog
+ *
+ * @return 0 if every file has its hash, else ESTALE if one changed, or the
+ *         errno of reading one
+ ***************************************************************************/
+extern int yaml_catalog_verify(const YamlCatalogPlatform *platform);
+
+/************************************************************************//**
+ * Hashes the content of a file, with 64 bit FNV-1a
+ *
+ * @param[in]  path :File
+ * @param[out] hash :Hash
+ *
+ * @return 0 on success, else errno
+ ***************************************************************************/
+extern int yaml_catalog_hash_file(const char *path, unsigned long long *hash);
+
+/************************************************************************//**
+ * Creates a threshold engine from arrays of thresholds and enabled flags.
+ *    The fastest implementation supported by the CPU is selected.
+ *
+ * @param[in] count      :Number of counters
+ * @param[in] thresholds :Threshold of each counter
+ * @param[in] enabled    :Enabled flag of each counter, or NULL if all
+ *                        counters are enabled
+ * @param[in] mode       :Evaluation mode
+ *
+ * @return YamlBufmonEngine * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlBufmonEngine *bufmon_engine_new(unsigned int count,
+                                           const unsigned long long *thresholds,
+                                           const bool *enabled,
+                                           YamlBufmonMode mode);
+
+/************************************************************************//**
+ * Frees a threshold engine
+ *
+ * @param[in] engine    :Engine to free, may be NULL
+ ***************************************************************************/
+extern void bufmon_engine_free(YamlBufmonEngine *engine);
+
+/************************************************************************//**
+ * Changes the threshold and enabled flag of one counter
+ *
+ * @param[in] engine    :Threshold engine
+ * @param[in] idx       :Counter index
+ * @param[in] threshold :New threshold
+ * @param[in] enabled   :New enabled flag
+ *
+ * @return 0 on success, else -1 on failure
+ ***************************************************************************/
+extern int bufmon_engine_set_threshold(YamlBufmonEngine *engine,
+                                       unsigned int idx,
+                                       unsigned long long threshold,
+                                       bool enabled);
+
+/************************************************************************//**
+ * Forces a specific implementation, e.g. for testing or benchmarking
+ *
+ * @param[in] engine    :Threshold engine
+ * @param[in] impl      :Implementation to use
+ *
+ * @return 0 on success, else -1 if the CPU does not support impl
+ ***************************************************************************/
+extern int bufmon_engine_set_impl(YamlBufmonEngine *engine,
+                                  YamlBufmonImpl impl);
+
+/************************************************************************//**
+ * Returns the implementation used by a threshold engine
+ *
+ * @param[in] engine    :Threshold engine
+ *
+ * @return YamlBufmonImpl
+ ***************************************************************************/
+extern YamlBufmonImpl bufmon_engine_get_impl(const YamlBufmonEngine *engine);
+
+/************************************************************************//**
+ * Clears the peak values of a BUFMON_MODE_PEAK engine
+ *
+ * @param[in] engine    :Threshold engine
+ ***************************************************************************/
+extern void bufmon_engine_reset_peaks(YamlBufmonEngine *engine);
+
+/************************************************************************//**
+ * Returns the peak values of a BUFMON_MODE_PEAK engine, in counter order
+ *
+ * @param[in] engine    :Threshold engine
+ *
+ * @return array of peak values, else NULL if engine is not in peak mode
+ ***************************************************************************/
+extern const unsigned long long *bufmon_engine_get_peaks(
+                                            const YamlBufmonEngine *engine);
+
+/************************************************************************//**
+ * Compares a sample of every counter with its threshold. Bit (idx % 64)
+ *    of bitmap[idx / 64] is set if counter idx is enabled and its sample
+ *    (or, in peak mode, its peak) is greater than its threshold.
+ *
+ * @param[in] engine    :Threshold engine
+ * @param[in] samples   :Sample of each counter, in counter order
+ * @param[in] count     :Number of samples, must match the engine
+ * @param[out] bitmap   :Bitmap of crossed thresholds
+ * @param[in] words     :Number of words in bitmap, at least (count + 63) / 64
+ *
+ * @return number of crossed thresholds on success, else -1 on failure
+ ***************************************************************************/
+extern int bufmon_engine_evaluate(YamlBufmonEngine *engine,
+                                  const unsigned long long *samples,
+                                  unsigned int count,
+                                  unsigned long long *bitmap,
+                                  unsigned int words);
+
+/************************************************************************//**
+ * Creates a thermal policy engine from the alarm and fan thresholds of an
+ *    array of sensors
+ *
+ * @param[in] count   :Number of sensors
+ * @param[in] sensors :Array of sensors
+ *
+ * @return YamlThermalEngine * on success, else NULL on failure
+ ***************************************************************************/
+extern YamlThermalEngine *thermal_engine_new(unsigned int count,
+                                             const YamlSensor *sensors);
+
+/************************************************************************//**
+ * Frees a thermal policy engine
+ *
+ * @param[in] engine :Engine to free
+ ***************************************************************************/
+extern void thermal_engine_free(YamlThermalEngine *engine);
+
+/************************************************************************//**
+ * Returns the number of sensors of a thermal policy engine
+ *
+ * @param[in] engine :Engine
+ *
+ * @return number of sensors
+ ***************************************************************************/
+extern unsigned int thermal_engine_get_count(const YamlThermalEngine *engine);
+
+/************************************************************************//**
+ * Computes the alarm level and fan speed of every sensor. The alarm and fan
+ *    speed arrays hold the previous state on input, which drives the
+ *    hysteresis, and the new state on output. Start with
+ *    THERMAL_ALARM_NORMAL and NORMAL. The call doesn't allocate memory.
+ *
+ * @param[in] engine        :Engine
+ * @param[in] temps         :Temperature of each sensor, in sensor order
+ * @param[in,out] alarms    :YamlThermalAlarm of each sensor
+ * @param[in,out] fan_speeds:YamlFanSpeed required by each sensor
+ * @param[in] count         :Number of sensors, must match the engine
+ *
+ * @return highest YamlFanSpeed required by any sensor, else -1 on failure
+ ***************************************************************************/
+extern int thermal_engine_evaluate(const YamlThermalEngine *engine,
+                                   const float *temps, int *alarms,
+                                   int *fan_speeds, unsigned int count);
 #ifdef __cplusplus
 };
 #endif
@@ -38,7 +38,7 @@ typedef struct {
     char            *device;
     unsigned char   register_address;
     unsigned char   register_size;      // 1, 2, or 4 byte register
-    unsigned char   bit_mask;
+    unsigned int    bit_mask;
     bool            negative_polarity;
 } i2c_bit_op;
 
@@ -0,0 +1,575 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Register and bit op access. A register read on an I2C_RDWR bus is one
+ * combined transfer: a write of the register address followed by a read of
+ * register_size bytes. On an SMBus adapter it is an SMBus read of the
+ * register. Multi-byte registers are little endian, like SMBus words.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+#define MAX_REGISTER_SIZE   4
+
+/* Returns true if the device is on an I2C_RDWR (not SMBus) bus */
+static bool
+on_rdwr_bus(YamlConfigHandle handle, const char *subsyst, const YamlDevice *dev)
+{
+    const YamlBus *bus = yaml_find_bus(handle, subsyst, dev->bus);
+
+    return(bus != NULL && !bus->smbus);
+}
+
+static unsigned int
+bytes_to_value(const unsigned char *data, unsigned char size)
+{
+    unsigned int value = 0;
+    int byte;
+
+    for (byte = size - 1; byte >= 0; byte--) {
+        value = (value << 8) | data[byte];
+    }
+
+    return(value);
+}
+
+/* Fills the one or two ops that read byte_count bytes from a register.
+ * The select write points at register_address, so it must outlive the ops.
+ * Returns the op count. */
+static int
+build_read(bool rdwr, const char *device, unsigned char *register_address,
+           int byte_count, unsigned char *data, i2c_op *ops)
+{
+    int count = 0;
+
+    memset(ops, 0, 2 * sizeof(i2c_op));
+
+    if (rdwr) {
+        ops[count].direction = WRITE;
+        ops[count].device = (char *)device;
+        ops[count].byte_count = 1;
+        ops[count].data = register_address;
+        count++;
+    }
+
+    ops[count].direction = READ;
+    ops[count].device = (char *)device;
+    ops[count].byte_count = byte_count;
+    ops[count].set_register = true;
+    ops[count].register_address = *register_address;
+    ops[count].data = data;
+    count++;
+
+    return(count);
+}
+
+/* Fills the op that writes a register. data needs room for the register
+ * address and MAX_REGISTER_SIZE bytes. */
+static void
+build_write(bool rdwr, const char *device, unsigned char register_address,
+            unsigned char register_size, unsigned int value,
+            unsigned char *data, i2c_op *op)
+{
+    int offset = rdwr ? 1 : 0;
+    int byte;
+
+    memset(op, 0, sizeof(i2c_op));
+
+    // an I2C_RDWR write carries the register in its first byte
+    if (rdwr) {
+        data[0] = register_address;
+    }
+    for (byte = 0; byte < register_size; byte++) {
+        data[offset + byte] = (value >> (8 * byte)) & 0xff;
+    }
+
+    op->direction = WRITE;
+    op->device = (char *)device;
+    op->byte_count = register_size + offset;
+    op->set_register = true;
+    op->register_address = register_address;
+    op->data = data;
+}
+
+int
+yaml_register_read_list(YamlConfigHandle handle, const char *subsyst,
+                        YamlRegisterRead *reads, unsigned int count)
+{
+    i2c_op *ops;
+    int *results;
+    int *read_op;
+    unsigned char (*data)[MAX_REGISTER_SIZE];
+    unsigned int op_count = 0;
+    unsigned int idx;
+    int final_rc = 0;
+
+    if (handle == NULL || reads == NULL) {
+        return(EINVAL);
+    }
+
+    if (count == 0) {
+        return(0);
+    }
+
+    ops = (i2c_op *)calloc(2 * count, sizeof(i2c_op));
+    results = (int *)calloc(2 * count, sizeof(int));
+    read_op = (int *)calloc(count, sizeof(int));
+    data = calloc(count, MAX_REGISTER_SIZE);
+
+    if (ops == NULL || results == NULL || read_op == NULL || data == NULL) {
+        free(ops);
+        free(results);
+        free(read_op);
+        free(data);
+        return(ENOMEM);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        const YamlDevice *dev;
+
+        reads[idx].value = 0;
+        reads[idx].rc = 0;
+        read_op[idx] = -1;
+
+        dev = yaml_find_device(handle, subsyst, reads[idx].device);
+        if (dev == NULL || reads[idx].register_size == 0 ||
+                reads[idx].register_size > MAX_REGISTER_SIZE) {
+            reads[idx].rc = EINVAL;
+            continue;
+        }
+
+        op_count += build_read(on_rdwr_bus(handle, subsyst, dev),
+                               reads[idx].device,
+                               &reads[idx].register_address,
+                               reads[idx].register_size, data[idx],
+                               &ops[op_count]);
+        read_op[idx] = op_count - 1;
+    }
+
+    i2c_execute_list(handle, subsyst, ops, op_count, results);
+
+    for (idx = 0; idx < count; idx++) {
+        int op = read_op[idx];
+
+        if (op < 0) {
+            continue;
+        }
+
+        // a failed register select fails the read behind it
+        reads[idx].rc = results[op];
+        if (reads[idx].rc == 0 && op > 0 && ops[op - 1].direction == WRITE &&
+                ops[op - 1].data == &reads[idx].register_address) {
+            reads[idx].rc = results[op - 1];
+        }
+        if (reads[idx].rc == 0) {
+            reads[idx].value = bytes_to_value(data[idx],
+                                              reads[idx].register_size);
+        }
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        if (final_rc == 0 && reads[idx].rc != 0) {
+            final_rc = reads[idx].rc;
+        }
+    }
+
+    free(ops);
+    free(results);
+    free(read_op);
+    free(data);
+
+    return(final_rc);
+}
+
+int
+yaml_register_read(YamlConfigHandle handle, const char *subsyst,
+                   const char *device, unsigned char register_address,
+                   unsigned char register_size, unsigned int *value)
+{
+    const YamlDevice *dev;
+    unsigned char data[MAX_REGISTER_SIZE] = { 0 };
+    i2c_op ops[2];
+    i2c_op *cmds[3] = { NULL, NULL, NULL };
+    int count;
+    int idx;
+    int rc;
+
+    if (handle == NULL || device == NULL || value == NULL ||
+            register_size == 0 || register_size > MAX_REGISTER_SIZE) {
+        return(EINVAL);
+    }
+
+    dev = yaml_find_device(handle, subsyst, device);
+    if (dev == NULL) {
+        return(EINVAL);
+    }
+
+    count = build_read(on_rdwr_bus(handle, subsyst, dev), device,
+                       &register_address, register_size, data, ops);
+    for (idx = 0; idx < count; idx++) {
+        cmds[idx] = &ops[idx];
+    }
+
+    rc = i2c_execute(handle, subsyst, dev, cmds);
+    if (rc == 0) {
+        *value = bytes_to_value(data, register_size);
+    }
+
+    return(rc);
+}
+
+int
+yaml_register_read_block(YamlConfigHandle handle, const char *subsyst,
+                         const char *device, unsigned char register_address,
+                         unsigned char *data, unsigned int count)
+{
+    const YamlDevice *dev;
+    i2c_op ops[2];
+    i2c_op *cmds[3] = { NULL, NULL, NULL };
+    int op_count;
+    int idx;
+
+    if (handle == NULL || device == NULL || data == NULL || count == 0 ||
+            register_address + count > 256) {
+        return(EINVAL);
+    }
+
+    dev = yaml_find_device(handle, subsyst, device);
+    if (dev == NULL) {
+        return(EINVAL);
+    }
+
+    op_count = build_read(on_rdwr_bus(handle, subsyst, dev), device,
+                          &register_address, count, data, ops);
+    for (idx = 0; idx < op_count; idx++) {
+        cmds[idx] = &ops[idx];
+    }
+
+    return(i2c_execute(handle, subsyst, dev, cmds));
+}
+
+int
+yaml_register_write(YamlConfigHandle handle, const char *subsyst,
+                    const char *device, unsigned char register_address,
+                    unsigned char register_size, unsigned int value)
+{
+    const YamlDevice *dev;
+    unsigned char data[MAX_REGISTER_SIZE + 1];
+    i2c_op op;
+    i2c_op *cmds[2];
+
+    if (handle == NULL || device == NULL ||
+            register_size == 0 || register_size > MAX_REGISTER_SIZE) {
+        return(EINVAL);
+    }
+
+    dev = yaml_find_device(handle, subsyst, device);
+    if (dev == NULL) {
+        return(EINVAL);
+    }
+
+    build_write(on_rdwr_bus(handle, subsyst, dev), device, register_address,
+                register_size, value, data, &op);
+    cmds[0] = &op;
+    cmds[1] = NULL;
+
+    return(i2c_execute(handle, subsyst, dev, cmds));
+}
+
+static unsigned char
+bit_op_size(const i2c_bit_op *op)
+{
+    return(op->register_size == 0 ? 1 : op->register_size);
+}
+
+/* Shift of the lowest bit of the mask */
+static unsigned int
+bit_op_shift(const i2c_bit_op *op)
+{
+    return(op->bit_mask == 0 ? 0 : __builtin_ctz(op->bit_mask));
+}
+
+/* Returns the field value of a bit op in a register value */
+static unsigned int
+bit_op_decode(const i2c_bit_op *op, unsigned int reg_value)
+{
+    if (op->negative_polarity) {
+        reg_value = ~reg_value;
+    }
+
+    return((reg_value & op->bit_mask) >> bit_op_shift(op));
+}
+
+/* Returns a register value with the field of a bit op replaced */
+static unsigned int
+bit_op_encode(const i2c_bit_op *op, unsigned int reg_value, unsigned int value)
+{
+    unsigned int bits = value << bit_op_shift(op);
+
+    if (op->negative_polarity) {
+        bits = ~bits;
+    }
+
+    return((reg_value & ~op->bit_mask) | (bits & op->bit_mask));
+}
+
+int
+yaml_bit_op_read(YamlConfigHandle handle, const char *subsyst,
+                 const i2c_bit_op *op, unsigned int *value)
+{
+    unsigned int reg_value;
+    int rc;
+
+    if (op == NULL || value == NULL) {
+        return(EINVAL);
+    }
+
+    rc = yaml_register_read(handle, subsyst, op->device, op->register_address,
+                            bit_op_size(op), &reg_value);
+    if (rc == 0) {
+        *value = bit_op_decode(op, reg_value);
+    }
+
+    return(rc);
+}
+
+int
+yaml_bit_op_write(YamlConfigHandle handle, const char *subsyst,
+                  const i2c_bit_op *op, unsigned int value)
+{
+    unsigned int reg_value;
+    int rc;
+
+    if (op == NULL) {
+        return(EINVAL);
+    }
+
+    rc = yaml_register_read(handle, subsyst, op->device, op->register_address,
+                            bit_op_size(op), &reg_value);
+    if (rc != 0) {
+        return(rc);
+    }
+
+    return(yaml_register_write(handle, subsyst, op->device,
+                               op->register_address, bit_op_size(op),
+                               bit_op_encode(op, reg_value, value)));
+}
+
+/* Reads the distinct registers of a list of bit ops. reg_of receives the
+ * register read of each op. Returns the YamlRegisterRead array, or NULL. */
+static YamlRegisterRead *
+read_bit_op_registers(YamlConfigHandle handle, const char *subsyst,
+                      const i2c_bit_op **ops, unsigned int count,
+                      int *reg_of, unsigned int *reg_count)
+{
+    YamlRegisterRead *reads;
+    unsigned int idx;
+    unsigned int reg;
+
+    reads = (YamlRegisterRead *)calloc(count + 1, sizeof(YamlRegisterRead));
+    if (reads == NULL) {
+        return(NULL);
+    }
+
+    *reg_count = 0;
+
+    for (idx = 0; idx < count; idx++) {
+        reg_of[idx] = -1;
+
+        if (ops[idx] == NULL || ops[idx]->device == NULL) {
+            continue;
+        }
+
+        for (reg = 0; reg < *reg_count; reg++) {
+            if (reads[reg].register_address == ops[idx]->register_address &&
+                    reads[reg].register_size == bit_op_size(ops[idx]) &&
+                    strcmp(reads[reg].device, ops[idx]->device) == 0) {
+                break;
+            }
+        }
+
+        if (reg == *reg_count) {
+            reads[reg].device = ops[idx]->device;
+            reads[reg].register_address = ops[idx]->register_address;
+            reads[reg].register_size = bit_op_size(ops[idx]);
+            (*reg_count)++;
+        }
+
+        reg_of[idx] = reg;
+    }
+
+    yaml_register_read_list(handle, subsyst, reads, *reg_count);
+
+    return(reads);
+}
+
+int
+yaml_bit_op_read_list(YamlConfigHandle handle, const char *subsyst,
+                      const i2c_bit_op **ops, unsigned int count,
+                      unsigned int *values, int *results)
+{
+    YamlRegisterRead *reads;
+    unsigned int reg_count;
+    unsigned int idx;
+    int *reg_of;
+    int final_rc = 0;
+
+    if (handle == NULL || ops == NULL || values == NULL || results == NULL) {
+        return(EINVAL);
+    }
+
+    reg_of = (int *)calloc(count + 1, sizeof(int));
+    if (reg_of == NULL) {
+        return(ENOMEM);
+    }
+
+    reads = read_bit_op_registers(handle, subsyst, ops, count, reg_of,
+                                  &reg_count);
+    if (reads == NULL) {
+        free(reg_of);
+        return(ENOMEM);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        values[idx] = 0;
+        results[idx] = reg_of[idx] < 0 ? EINVAL : reads[reg_of[idx]].rc;
+
+        if (results[idx] == 0) {
+            values[idx] = bit_op_decode(ops[idx], reads[reg_of[idx]].value);
+        } else if (final_rc == 0) {
+            final_rc = results[idx];
+        }
+    }
+
+    free(reads);
+    free(reg_of);
+
+    return(final_rc);
+}
+
+/* The new value of a register written by yaml_bit_op_write_list() */
+typedef struct {
+    unsigned int    value;
+    int             write;      /* index of its write op, or -1 */
+    unsigned char   data[MAX_REGISTER_SIZE + 1];
+} register_write;
+
+int
+yaml_bit_op_write_list(YamlConfigHandle handle, const char *subsyst,
+                       const i2c_bit_op **ops, unsigned int count,
+                       const unsigned int *values, int *results)
+{
+    YamlRegisterRead *reads;
+    register_write *regs;
+    i2c_op *writes;
+    int *write_rc;
+    unsigned int write_count = 0;
+    unsigned int reg_count;
+    unsigned int idx;
+    unsigned int reg;
+    int *reg_of;
+    int final_rc = 0;
+
+    if (handle == NULL || ops == NULL || values == NULL || results == NULL) {
+        return(EINVAL);
+    }
+
+    reg_of = (int *)calloc(count + 1, sizeof(int));
+    if (reg_of == NULL) {
+        return(ENOMEM);
+    }
+
+    // read each register once, then apply all of its fields
+    reads = read_bit_op_registers(handle, subsyst, ops, count, reg_of,
+                                  &reg_count);
+    if (reads == NULL) {
+        free(reg_of);
+        return(ENOMEM);
+    }
+
+    regs = (register_write *)calloc(reg_count + 1, sizeof(register_write));
+    writes = (i2c_op *)calloc(reg_count + 1, sizeof(i2c_op));
+    write_rc = (int *)calloc(reg_count + 1, sizeof(int));
+
+    if (regs == NULL || writes == NULL || write_rc == NULL) {
+        free(regs);
+        free(writes);
+        free(write_rc);
+        free(reads);
+        free(reg_of);
+        return(ENOMEM);
+    }
+
+    for (reg = 0; reg < reg_count; reg++) {
+        regs[reg].value = reads[reg].value;
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        if (reg_of[idx] >= 0 && reads[reg_of[idx]].rc == 0) {
+            regs[reg_of[idx]].value = bit_op_encode(ops[idx],
+                                                    regs[reg_of[idx]].value,
+                                                    values[idx]);
+        }
+    }
+
+    // registers whose value is unchanged are not written
+    for (reg = 0; reg < reg_count; reg++) {
+        const YamlDevice *dev;
+
+        regs[reg].write = -1;
+
+        if (reads[reg].rc != 0 || regs[reg].value == reads[reg].value) {
+            continue;
+        }
+
+        dev = yaml_find_device(handle, subsyst, reads[reg].device);
+        build_write(on_rdwr_bus(handle, subsyst, dev), reads[reg].device,
+                    reads[reg].register_address, reads[reg].register_size,
+                    regs[reg].value, regs[reg].data, &writes[write_count]);
+        regs[reg].write = write_count++;
+    }
+
+    i2c_execute_list(handle, subsyst, writes, write_count, write_rc);
+
+    for (idx = 0; idx < count; idx++) {
+        if (reg_of[idx] < 0) {
+            results[idx] = EINVAL;
+        } else if (reads[reg_of[idx]].rc != 0) {
+            results[idx] = reads[reg_of[idx]].rc;
+        } else if (regs[reg_of[idx]].write >= 0) {
+            results[idx] = write_rc[regs[reg_of[idx]].write];
+        } else {
+            results[idx] = 0;
+        }
+
+        if (final_rc == 0 && results[idx] != 0) {
+            final_rc = results[idx];
+        }
+    }
+
+    free(regs);
+    free(writes);
+    free(write_rc);
+    free(reads);
+    free(reg_of);
+
+    return(final_rc);
+}
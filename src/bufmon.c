@@ -0,0 +1,346 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Buffer monitoring threshold engine. The thresholds, peaks and enabled
+ * bits of the bufmond.yaml counters are kept in 32 byte aligned arrays, and
+ * a sample array in counter order is compared against them 2 (SSE2) or 4
+ * (AVX2) counters at a time. The result is a bitmap with one bit per
+ * counter, set when the sampled (or peak) value exceeds the threshold.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BUFMON_HAVE_X86_SIMD
+#endif
+
+#include "config-yaml.h"
+
+#define BUFMON_ALIGN            32
+#define BUFMON_LANES            4   /* arrays are padded to the AVX2 width */
+#define BUFMON_WORD_BITS        64
+
+struct YamlBufmonEngine {
+    unsigned int        count;
+    unsigned int        words;
+    YamlBufmonMode      mode;
+    YamlBufmonImpl      impl;
+    unsigned long long  *thresholds;
+    unsigned long long  *peaks;
+    unsigned long long  *enabled;   /* one bit per counter */
+};
+
+static void *
+alloc_aligned(size_t size)
+{
+    void *ptr = NULL;
+
+    if (posix_memalign(&ptr, BUFMON_ALIGN, size) != 0) {
+        return(NULL);
+    }
+    memset(ptr, 0, size);
+    return(ptr);
+}
+
+/* Compares one word's worth of counters starting at first. In peak mode the
+ * samples are first folded into the stored peaks. */
+static unsigned long long
+eval_word_scalar(YamlBufmonEngine *engine, const unsigned long long *samples,
+                 unsigned int first, unsigned int last)
+{
+    unsigned long long word = 0;
+    unsigned int idx;
+
+    for (idx = first; idx < last; idx++) {
+        unsigned long long value = samples[idx];
+
+        if (engine->mode == BUFMON_MODE_PEAK) {
+            if (value > engine->peaks[idx]) {
+                engine->peaks[idx] = value;
+            }
+            value = engine->peaks[idx];
+        }
+
+        word |= (unsigned long long)(value > engine->thresholds[idx])
+                << (idx - first);
+    }
+
+    return(word);
+}
+
+#ifdef BUFMON_HAVE_X86_SIMD
+
+/* Unsigned 64-bit a > b, returned in the sign bit of each lane. It is the
+ * borrow out of b - a, since SSE2 has no 64-bit compare. */
+static inline __m128i
+sse2_gt_u64(__m128i a, __m128i b)
+{
+    __m128i diff = _mm_sub_epi64(b, a);
+
+    return(_mm_or_si128(_mm_andnot_si128(b, a),
+                        _mm_andnot_si128(_mm_xor_si128(b, a), diff)));
+}
+
+static unsigned long long
+eval_word_sse2(YamlBufmonEngine *engine, const unsigned long long *samples,
+               unsigned int first, unsigned int last)
+{
+    unsigned long long word = 0;
+    unsigned int idx;
+
+    for (idx = first; idx + 2 <= last; idx += 2) {
+        __m128i value = _mm_loadu_si128((const __m128i *)&samples[idx]);
+        __m128i thresh = _mm_load_si128((const __m128i *)&engine->thresholds[idx]);
+
+        if (engine->mode == BUFMON_MODE_PEAK) {
+            __m128i peak = _mm_load_si128((const __m128i *)&engine->peaks[idx]);
+            __m128i mask = sse2_gt_u64(value, peak);
+
+            /* spread the sign bit over the whole lane */
+            mask = _mm_shuffle_epi32(_mm_srai_epi32(mask, 31),
+                                     _MM_SHUFFLE(3, 3, 1, 1));
+            value = _mm_or_si128(_mm_and_si128(mask, value),
+                                 _mm_andnot_si128(mask, peak));
+            _mm_store_si128((__m128i *)&engine->peaks[idx], value);
+        }
+
+        word |= (unsigned long long)_mm_movemask_pd(
+                    _mm_castsi128_pd(sse2_gt_u64(value, thresh)))
+                << (idx - first);
+    }
+
+    if (idx < last) {
+        word |= eval_word_scalar(engine, samples, idx, last) << (idx - first);
+    }
+
+    return(word);
+}
+
+__attribute__((target("avx2")))
+static unsigned long long
+eval_word_avx2(YamlBufmonEngine *engine, const unsigned long long *samples,
+               unsigned int first, unsigned int last)
+{
+    const __m256i bias = _mm256_set1_epi64x((long long)(1ULL << 63));
+    unsigned long long word = 0;
+    unsigned int idx;
+
+    for (idx = first; idx + 4 <= last; idx += 4) {
+        __m256i value = _mm256_loadu_si256((const __m256i *)&samples[idx]);
+        __m256i thresh = _mm256_load_si256((const __m256i *)&engine->thresholds[idx]);
+
+        if (engine->mode == BUFMON_MODE_PEAK) {
+            __m256i peak = _mm256_load_si256((const __m256i *)&engine->peaks[idx]);
+            __m256i mask = _mm256_cmpgt_epi64(_mm256_xor_si256(value, bias),
+                                              _mm256_xor_si256(peak, bias));
+
+            value = _mm256_blendv_epi8(peak, value, mask);
+            _mm256_store_si256((__m256i *)&engine->peaks[idx], value);
+        }
+
+        word |= (unsigned long long)_mm256_movemask_pd(_mm256_castsi256_pd(
+                    _mm256_cmpgt_epi64(_mm256_xor_si256(value, bias),
+                                       _mm256_xor_si256(thresh, bias))))
+                << (idx - first);
+    }
+
+    if (idx < last) {
+        word |= eval_word_scalar(engine, samples, idx, last) << (idx - first);
+    }
+
+    return(word);
+}
+
+#endif /* BUFMON_HAVE_X86_SIMD */
+
+static bool
+impl_supported(YamlBufmonImpl impl)
+{
+    switch (impl) {
+    case BUFMON_IMPL_SCALAR:
+        return(true);
+#ifdef BUFMON_HAVE_X86_SIMD
+    case BUFMON_IMPL_SSE2:
+        return(true);
+    case BUFMON_IMPL_AVX2:
+        __builtin_cpu_init();
+        return(__builtin_cpu_supports("avx2"));
+#endif
+    default:
+        return(false);
+    }
+}
+
+YamlBufmonEngine *
+bufmon_engine_new(unsigned int count, const unsigned long long *thresholds,
+                  const bool *enabled, YamlBufmonMode mode)
+{
+    YamlBufmonEngine *engine;
+    unsigned int padded = (count + BUFMON_LANES) & ~(BUFMON_LANES - 1);
+    unsigned int idx;
+
+    engine = (YamlBufmonEngine *)calloc(1, sizeof(YamlBufmonEngine));
+    if (engine == NULL) {
+        return(NULL);
+    }
+
+    engine->count = count;
+    engine->words = (count + BUFMON_WORD_BITS - 1) / BUFMON_WORD_BITS;
+    engine->mode = mode;
+
+    engine->thresholds = alloc_aligned(padded * sizeof(unsigned long long));
+    engine->peaks = alloc_aligned(padded * sizeof(unsigned long long));
+    engine->enabled = alloc_aligned(
+                            (engine->words + 1) * sizeof(unsigned long long));
+
+    if (engine->thresholds == NULL || engine->peaks == NULL ||
+            engine->enabled == NULL) {
+        bufmon_engine_free(engine);
+        return(NULL);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        bufmon_engine_set_threshold(engine, idx, thresholds[idx],
+                                    enabled == NULL || enabled[idx]);
+    }
+
+    if (impl_supported(BUFMON_IMPL_AVX2)) {
+        engine->impl = BUFMON_IMPL_AVX2;
+    } else if (impl_supported(BUFMON_IMPL_SSE2)) {
+        engine->impl = BUFMON_IMPL_SSE2;
+    } else {
+        engine->impl = BUFMON_IMPL_SCALAR;
+    }
+
+    return(engine);
+}
+
+void
+bufmon_engine_free(YamlBufmonEngine *engine)
+{
+    if (engine == NULL) {
+        return;
+    }
+
+    free(engine->thresholds);
+    free(engine->peaks);
+    free(engine->enabled);
+    free(engine);
+}
+
+int
+bufmon_engine_set_threshold(YamlBufmonEngine *engine, unsigned int idx,
+                            unsigned long long threshold, bool enabled)
+{
+    unsigned long long bit = 1ULL << (idx % BUFMON_WORD_BITS);
+
+    if (engine == NULL || idx >= engine->count) {
+        return(-1);
+    }
+
+    engine->thresholds[idx] = threshold;
+
+    if (enabled) {
+        engine->enabled[idx / BUFMON_WORD_BITS] |= bit;
+    } else {
+        engine->enabled[idx / BUFMON_WORD_BITS] &= ~bit;
+    }
+
+    return(0);
+}
+
+int
+bufmon_engine_set_impl(YamlBufmonEngine *engine, YamlBufmonImpl impl)
+{
+    if (engine == NULL || !impl_supported(impl)) {
+        return(-1);
+    }
+
+    engine->impl = impl;
+    return(0);
+}
+
+YamlBufmonImpl
+bufmon_engine_get_impl(const YamlBufmonEngine *engine)
+{
+    return(engine->impl);
+}
+
+void
+bufmon_engine_reset_peaks(YamlBufmonEngine *engine)
+{
+    if (engine == NULL) {
+        return;
+    }
+
+    memset(engine->peaks, 0, engine->count * sizeof(unsigned long long));
+}
+
+const unsigned long long *
+bufmon_engine_get_peaks(const YamlBufmonEngine *engine)
+{
+    if (engine == NULL || engine->mode != BUFMON_MODE_PEAK) {
+        return(NULL);
+    }
+
+    return(engine->peaks);
+}
+
+int
+bufmon_engine_evaluate(YamlBufmonEngine *engine,
+                       const unsigned long long *samples, unsigned int count,
+                       unsigned long long *bitmap, unsigned int words)
+{
+    unsigned int word;
+    int crossed = 0;
+
+    if (engine == NULL || samples == NULL || bitmap == NULL ||
+            count != engine->count || words < engine->words) {
+        return(-1);
+    }
+
+    for (word = 0; word < engine->words; word++) {
+        unsigned int first = word * BUFMON_WORD_BITS;
+        unsigned int last = first + BUFMON_WORD_BITS;
+        unsigned long long bits;
+
+        if (last > count) {
+            last = count;
+        }
+
+        switch (engine->impl) {
+#ifdef BUFMON_HAVE_X86_SIMD
+        case BUFMON_IMPL_AVX2:
+            bits = eval_word_avx2(engine, samples, first, last);
+            break;
+        case BUFMON_IMPL_SSE2:
+            bits = eval_word_sse2(engine, samples, first, last);
+            break;
+#endif
+        default:
+            bits = eval_word_scalar(engine, samples, first, last);
+            break;
+        }
+
+        bitmap[word] = bits & engine->enabled[word];
+        crossed += __builtin_popcountll(bitmap[word]);
+    }
+
+    return(crossed);
+}
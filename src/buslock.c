@@ -0,0 +1,383 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Bus lock manager. Each bus device file has one lock per process:
+ *  - a recursive mutex serializes the threads of the process, and counts
+ *    the acquisitions that had to wait;
+ *  - flock() on a descriptor kept open for the process serializes the
+ *    processes. It is taken by the outermost lock of a thread only, so a
+ *    batch or a bus session pays for it once. When another thread of the
+ *    process waits for the mutex, the outermost unlock hands the flock()
+ *    over to it rather than releasing it, up to BUS_LOCK_MAX_HANDOVERS
+ *    times in a row so that other processes still get the bus. A lone
+ *    i2c_execute() still pays for a flock() and its release.
+ * The descriptors are close-on-exec. A forked child reopens them, so that
+ * its flock() excludes its parent, and starts with every lock released;
+ * a thread must not fork while it holds a bus lock.
+ * The locks live in a fixed table, created on first use and published
+ * with a compare-and-swap, so finding a lock takes no lock.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <pthread.h>
+
+#include "config-yaml.h"
+
+#define BUS_LOCK_SLOTS      64
+#define BUS_LOCK_MAX_HANDOVERS  8
+
+struct YamlBusLock {
+    char                *devname;
+    int                 fd;
+    pthread_mutex_t     mutex;      /* recursive */
+    unsigned int        depth;      /* of the holder */
+    unsigned int        waiters;    /* threads waiting for the mutex */
+    bool                flocked;    /* flock() held, by the mutex */
+    unsigned int        handovers;  /* of the flock() in a row */
+    YamlBusLockStats    stats;
+};
+
+struct YamlI2cBusSession {
+    const YamlI2cBackend    *backend;
+    void                    *bus_handle;
+};
+
+static YamlBusLock *bus_locks[BUS_LOCK_SLOTS];
+
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+/* Bus sessions open in the calling thread */
+static __thread unsigned int thread_sessions;
+
+#define ATOMIC_ADD(ptr, value) \
+    __atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED)
+
+static unsigned long long
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static unsigned int
+hash_name(const char *name)
+{
+    unsigned int hash = 5381;
+
+    while (*name != '\0') {
+        hash = hash * 33 + (unsigned char)*name++;
+    }
+
+    return(hash % BUS_LOCK_SLOTS);
+}
+
+static void
+init_mutex(pthread_mutex_t *mutex)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/*
+ * Reopens the descriptors in a forked child. The child shares the open
+ * file descriptions of its parent, and with them their flock(); its own
+ * descriptions make it wait for its parent like any other process. The
+ * threads that held the mutexes do not exist in the child.
+ */
+static void
+atfork_child(void)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < BUS_LOCK_SLOTS; idx++) {
+        YamlBusLock *lock = bus_locks[idx];
+
+        if (lock == NULL) {
+            continue;
+        }
+
+        close(lock->fd);
+        lock->fd = open(lock->devname, O_RDWR | O_CLOEXEC);
+        init_mutex(&lock->mutex);
+        lock->depth = 0;
+        lock->waiters = 0;
+        lock->flocked = false;
+        lock->handovers = 0;
+    }
+}
+
+static void
+register_atfork(void)
+{
+    pthread_atfork(NULL, NULL, atfork_child);
+}
+
+/* Returns the lock of a device, or NULL if it was never locked */
+static YamlBusLock *
+find_lock(const char *devname)
+{
+    unsigned int idx = hash_name(devname);
+    unsigned int probe;
+
+    for (probe = 0; probe < BUS_LOCK_SLOTS; probe++) {
+        YamlBusLock *lock = __atomic_load_n(&bus_locks[idx],
+                                            __ATOMIC_ACQUIRE);
+
+        if (lock == NULL || strcmp(lock->devname, devname) == 0) {
+            return(lock);
+        }
+
+        idx = (idx + 1) % BUS_LOCK_SLOTS;
+    }
+
+    return(NULL);
+}
+
+/* Returns the lock of a device, opening the device on first use */
+static int
+get_lock(const char *devname, YamlBusLock **result)
+{
+    unsigned int idx = hash_name(devname);
+    unsigned int probe;
+    YamlBusLock *created = NULL;
+
+    pthread_once(&atfork_once, register_atfork);
+
+    for (probe = 0; probe < BUS_LOCK_SLOTS; probe++) {
+        YamlBusLock *lock = __atomic_load_n(&bus_locks[idx],
+                                            __ATOMIC_ACQUIRE);
+
+        if (lock == NULL) {
+            if (created == NULL) {
+                created = (YamlBusLock *)calloc(1, sizeof(YamlBusLock));
+                if (created == NULL) {
+                    return(ENOMEM);
+                }
+                created->devname = strdup(devname);
+                created->fd = open(devname, O_RDWR | O_CLOEXEC);
+                if (created->devname == NULL || created->fd < 0) {
+                    int rc = created->fd < 0 ? errno : ENOMEM;
+
+                    if (created->fd >= 0) {
+                        close(created->fd);
+                    }
+                    free(created->devname);
+                    free(created);
+                    return(rc);
+                }
+                init_mutex(&created->mutex);
+            }
+
+            if (__atomic_compare_exchange_n(&bus_locks[idx], &lock, created,
+                                            false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                *result = created;
+                return(0);
+            }
+            // another thread took the slot; lock is now its lock
+        }
+
+        if (strcmp(lock->devname, devname) == 0) {
+            if (created != NULL) {
+                pthread_mutex_destroy(&created->mutex);
+                close(created->fd);
+                free(created->devname);
+                free(created);
+            }
+            *result = lock;
+            return(0);
+        }
+
+        idx = (idx + 1) % BUS_LOCK_SLOTS;
+    }
+
+    return(ENOSPC);
+}
+
+int
+yaml_bus_lock(const char *devname, YamlBusLock **result)
+{
+    YamlBusLock *lock;
+    int rc;
+
+    if (devname == NULL || result == NULL) {
+        return(EINVAL);
+    }
+
+    rc = get_lock(devname, &lock);
+    if (rc != 0) {
+        return(rc);
+    }
+
+    // the holder gets the recursive mutex at once
+    if (pthread_mutex_trylock(&lock->mutex) != 0) {
+        unsigned long long start = now_ns();
+
+        __atomic_fetch_add(&lock->waiters, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&lock->mutex);
+        __atomic_fetch_sub(&lock->waiters, 1, __ATOMIC_SEQ_CST);
+        ATOMIC_ADD(&lock->stats.contended, 1);
+        ATOMIC_ADD(&lock->stats.wait_ns, now_ns() - start);
+    }
+
+    if (lock->depth++ > 0) {
+        ATOMIC_ADD(&lock->stats.nested, 1);
+        *result = lock;
+        return(0);
+    }
+
+    ATOMIC_ADD(&lock->stats.acquisitions, 1);
+
+    // the previous holder may have handed its flock() over
+    if (!lock->flocked) {
+        ATOMIC_ADD(&lock->stats.flocks, 1);
+        if (flock(lock->fd, LOCK_EX | LOCK_NB) != 0) {
+            ATOMIC_ADD(&lock->stats.flock_contended, 1);
+            while (flock(lock->fd, LOCK_EX) != 0 && errno == EINTR) {
+            }
+        }
+        lock->flocked = true;
+        lock->handovers = 0;
+    }
+
+    *result = lock;
+
+    return(0);
+}
+
+int
+yaml_bus_lock_fd(const YamlBusLock *lock)
+{
+    return(lock == NULL ? -1 : lock->fd);
+}
+
+void
+yaml_bus_unlock(YamlBusLock *lock)
+{
+    if (lock == NULL) {
+        return;
+    }
+
+    if (--lock->depth == 0) {
+        // a waiting thread takes the mutex next and keeps the flock()
+        if (__atomic_load_n(&lock->waiters, __ATOMIC_SEQ_CST) > 0 &&
+            lock->handovers < BUS_LOCK_MAX_HANDOVERS) {
+            lock->handovers++;
+        } else {
+            flock(lock->fd, LOCK_UN);
+            lock->flocked = false;
+        }
+    }
+
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+int
+yaml_bus_lock_get_stats(const char *devname, YamlBusLockStats *stats)
+{
+    YamlBusLock *lock;
+
+    if (devname == NULL || stats == NULL) {
+        return(EINVAL);
+    }
+
+    lock = find_lock(devname);
+    if (lock == NULL) {
+        return(EINVAL);
+    }
+
+    stats->acquisitions = __atomic_load_n(&lock->stats.acquisitions,
+                                          __ATOMIC_RELAXED);
+    stats->nested = __atomic_load_n(&lock->stats.nested, __ATOMIC_RELAXED);
+    stats->contended = __atomic_load_n(&lock->stats.contended,
+                                       __ATOMIC_RELAXED);
+    stats->wait_ns = __atomic_load_n(&lock->stats.wait_ns, __ATOMIC_RELAXED);
+    stats->flocks = __atomic_load_n(&lock->stats.flocks, __ATOMIC_RELAXED);
+    stats->flock_contended = __atomic_load_n(&lock->stats.flock_contended,
+                                             __ATOMIC_RELAXED);
+
+    return(0);
+}
+
+YamlI2cBusSession *
+yaml_i2c_bus_session_begin(YamlConfigHandle handle, const char *subsyst,
+                           const char *bus_name)
+{
+    YamlI2cBusSession *session;
+    const YamlBus *bus;
+
+    if (handle == NULL || subsyst == NULL || bus_name == NULL) {
+        return(NULL);
+    }
+
+    bus = yaml_find_bus(handle, subsyst, bus_name);
+    if (bus == NULL) {
+        return(NULL);
+    }
+
+    session = (YamlI2cBusSession *)calloc(1, sizeof(YamlI2cBusSession));
+    if (session == NULL) {
+        return(NULL);
+    }
+
+    session->backend = yaml_get_i2c_backend(handle);
+    if (session->backend == NULL) {
+        session->backend = yaml_i2c_default_backend();
+    }
+
+    if (session->backend->open_bus(session->backend->context, bus,
+                                   &session->bus_handle) != 0) {
+        free(session);
+        return(NULL);
+    }
+
+    thread_sessions++;
+
+    return(session);
+}
+
+void
+yaml_i2c_bus_session_end(YamlI2cBusSession *session)
+{
+    if (session == NULL) {
+        return;
+    }
+
+    session->backend->close_bus(session->backend->context,
+                                session->bus_handle);
+    free(session);
+
+    thread_sessions--;
+}
+
+bool
+yaml_i2c_bus_session_active(void)
+{
+    return(thread_sessions > 0);
+}
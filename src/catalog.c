@@ -0,0 +1,541 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Platform catalog index. yaml_catalog_build() scans the manifests of the
+ * platform directories and hands the platforms to yaml_catalog_write(),
+ * which stores them in one binary file:
+ *
+ *   header | platform records | file records | string table
+ *
+ * The records are fixed size, refer to the strings by offset, and are
+ * sorted by product name then manufacturer, so yaml_catalog_open() reads
+ * the file in one read() and yaml_catalog_find() is a binary search. The
+ * index is written in host byte order, on the target, by the installer.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "config-yaml.h"
+
+#define CATALOG_MAGIC       0x54414359      /* "YCAT" */
+#define CATALOG_VERSION     1
+#define CATALOG_MAX_SIZE    (4 * 1024 * 1024)
+
+typedef struct {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            size;           /* of the file */
+    uint32_t            checksum;       /* of what follows the header */
+    uint32_t            platforms;
+    uint32_t            files;
+    uint32_t            strings;        /* offset of the string table */
+    uint32_t            pad;
+} catalog_header;
+
+typedef struct {
+    uint32_t            manufacturer;   /* offsets in the string table */
+    uint32_t            product_name;
+    uint32_t            dir;
+    uint32_t            first_file;
+    uint32_t            file_count;
+    uint32_t            pad;
+} catalog_platform;
+
+typedef struct {
+    uint64_t            hash;
+    uint32_t            name;           /* offsets in the string table */
+    uint32_t            filename;
+} catalog_file;
+
+struct YamlCatalog {
+    char                *buffer;        /* the file */
+    YamlCatalogPlatform *platforms;
+    unsigned int        count;
+    YamlCatalogFile     *files;
+};
+
+/* FNV-1a, 32 bits */
+static uint32_t
+checksum(const char *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    size_t idx;
+
+    for (idx = 0; idx < size; idx++) {
+        hash = (hash ^ (unsigned char)data[idx]) * 16777619u;
+    }
+
+    return(hash);
+}
+
+int
+yaml_catalog_hash_file(const char *path, unsigned long long *hash)
+{
+    unsigned char data[4096];
+    unsigned long long value = 14695981039346656037ULL;
+    ssize_t count;
+    ssize_t idx;
+    int fd;
+
+    if (path == NULL || hash == NULL) {
+        return(EINVAL);
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return(errno);
+    }
+
+    // FNV-1a, 64 bits
+    while ((count = read(fd, data, sizeof(data))) != 0) {
+        if (count < 0) {
+            int rc = errno;
+
+            if (rc == EINTR) {
+                continue;
+            }
+            close(fd);
+            return(rc);
+        }
+        for (idx = 0; idx < count; idx++) {
+            value = (value ^ data[idx]) * 1099511628211ULL;
+        }
+    }
+
+    close(fd);
+    *hash = value;
+
+    return(0);
+}
+
+static int
+compare_platforms(const YamlCatalogPlatform *a, const YamlCatalogPlatform *b)
+{
+    int rc = strcmp(a->product_name, b->product_name);
+
+    return(rc != 0 ? rc : strcmp(a->manufacturer, b->manufacturer));
+}
+
+static int
+compare_sorted(const void *a, const void *b)
+{
+    return(compare_platforms(*(const YamlCatalogPlatform * const *)a,
+                             *(const YamlCatalogPlatform * const *)b));
+}
+
+/* Appends a string to the string table, returning its offset */
+static uint32_t
+add_string(char *strings, uint32_t *used, const char *str)
+{
+    uint32_t offset = *used;
+
+    strcpy(strings + offset, str);
+    *used += strlen(str) + 1;
+
+    return(offset);
+}
+
+int
+yaml_catalog_write(const char *index_file,
+                   const YamlCatalogPlatform *platforms, unsigned int count)
+{
+    const YamlCatalogPlatform **sorted;
+    catalog_header *header;
+    catalog_platform *records;
+    catalog_file *files;
+    char *buffer;
+    char *strings;
+    char *tmp_name;
+    size_t file_count = 0;
+    size_t string_size = 0;
+    size_t size;
+    uint32_t used = 0;
+    uint32_t file_idx = 0;
+    unsigned int idx;
+    unsigned int file;
+    ssize_t written;
+    int rc = 0;
+    int fd;
+
+    if (index_file == NULL || (platforms == NULL && count != 0)) {
+        return(EINVAL);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        const YamlCatalogPlatform *platform = &platforms[idx];
+
+        if (platform->manufacturer == NULL || platform->product_name == NULL ||
+                platform->dir == NULL ||
+                (platform->files == NULL && platform->file_count != 0)) {
+            return(EINVAL);
+        }
+        string_size += strlen(platform->manufacturer) +
+                       strlen(platform->product_name) +
+                       strlen(platform->dir) + 3;
+        for (file = 0; file < platform->file_count; file++) {
+            if (platform->files[file].name == NULL ||
+                    platform->files[file].filename == NULL) {
+                return(EINVAL);
+            }
+            string_size += strlen(platform->files[file].name) +
+                           strlen(platform->files[file].filename) + 2;
+        }
+        file_count += platform->file_count;
+    }
+
+    size = sizeof(catalog_header) + count * sizeof(catalog_platform) +
+           file_count * sizeof(catalog_file) + string_size;
+    if (size > CATALOG_MAX_SIZE) {
+        return(EFBIG);
+    }
+
+    sorted = (const YamlCatalogPlatform **)calloc(count + 1,
+                                                 sizeof(*sorted));
+    buffer = (char *)calloc(1, size);
+    tmp_name = (char *)malloc(strlen(index_file) + 5);
+    if (sorted == NULL || buffer == NULL || tmp_name == NULL) {
+        free(sorted);
+        free(buffer);
+        free(tmp_name);
+        return(ENOMEM);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        sorted[idx] = &platforms[idx];
+    }
+    qsort(sorted, count, sizeof(*sorted), compare_sorted);
+
+    header = (catalog_header *)buffer;
+    records = (catalog_platform *)(header + 1);
+    files = (catalog_file *)(records + count);
+    strings = (char *)(files + file_count);
+
+    for (idx = 0; idx < count; idx++) {
+        const YamlCatalogPlatform *platform = sorted[idx];
+
+        // the lookup can't tell two entries for a product apart
+        if (idx > 0 && compare_platforms(sorted[idx - 1], platform) == 0) {
+            rc = EEXIST;
+            goto out;
+        }
+
+        records[idx].manufacturer = add_string(strings, &used,
+                                               platform->manufacturer);
+        records[idx].product_name = add_string(strings, &used,
+                                               platform->product_name);
+        records[idx].dir = add_string(strings, &used, platform->dir);
+        records[idx].first_file = file_idx;
+        records[idx].file_count = platform->file_count;
+
+        for (file = 0; file < platform->file_count; file++, file_idx++) {
+            files[file_idx].hash = platform->files[file].hash;
+            files[file_idx].name = add_string(strings, &used,
+                                              platform->files[file].name);
+            files[file_idx].filename =
+                add_string(strings, &used, platform->files[file].filename);
+        }
+    }
+
+    header->magic = CATALOG_MAGIC;
+    header->version = CATALOG_VERSION;
+    header->size = size;
+    header->platforms = count;
+    header->files = file_count;
+    header->strings = strings - buffer;
+    header->checksum = checksum(buffer + sizeof(catalog_header),
+                                size - sizeof(catalog_header));
+
+    // readers see the old index or the new one, never a partial one
+    sprintf(tmp_name, "%s.tmp", index_file);
+    fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        rc = errno;
+        goto out;
+    }
+    written = write(fd, buffer, size);
+    if (written != (ssize_t)size) {
+        rc = written < 0 ? errno : EIO;
+    } else if (fsync(fd) != 0) {
+        rc = errno;
+    }
+    close(fd);
+    if (rc == 0 && rename(tmp_name, index_file) != 0) {
+        rc = errno;
+    }
+    if (rc != 0) {
+        unlink(tmp_name);
+    }
+
+out:
+    free(sorted);
+    free(buffer);
+    free(tmp_name);
+
+    return(rc);
+}
+
+/* Returns the string at an offset of the table, or NULL if it isn't in the
+ * table */
+static const char *
+get_string(const YamlCatalog *catalog, uint32_t offset)
+{
+    const catalog_header *header = (const catalog_header *)catalog->buffer;
+
+    if (offset >= header->size - header->strings) {
+        return(NULL);
+    }
+
+    return(catalog->buffer + header->strings + offset);
+}
+
+/* Checks the header and decodes the records of a catalog */
+static int
+decode(YamlCatalog *catalog, size_t size)
+{
+    const catalog_header *header = (const catalog_header *)catalog->buffer;
+    const catalog_platform *records;
+    const catalog_file *files;
+    unsigned int idx;
+    unsigned int file;
+
+    if (size < sizeof(catalog_header) || header->magic != CATALOG_MAGIC ||
+            header->version != CATALOG_VERSION || header->size != size) {
+        return(EINVAL);
+    }
+    if (header->platforms > size / sizeof(catalog_platform) ||
+            header->files > size / sizeof(catalog_file) ||
+            header->strings != sizeof(catalog_header) +
+                               header->platforms * sizeof(catalog_platform) +
+                               header->files * sizeof(catalog_file) ||
+            header->strings > size ||
+            (header->strings < size && catalog->buffer[size - 1] != '\0')) {
+        return(EINVAL);
+    }
+    if (header->checksum != checksum(catalog->buffer + sizeof(catalog_header),
+                                     size - sizeof(catalog_header))) {
+        return(EINVAL);
+    }
+
+    records = (const catalog_platform *)(header + 1);
+    files = (const catalog_file *)(records + header->platforms);
+
+    catalog->count = header->platforms;
+    catalog->platforms = (YamlCatalogPlatform *)
+        calloc(header->platforms + 1, sizeof(YamlCatalogPlatform));
+    catalog->files = (YamlCatalogFile *)calloc(header->files + 1,
+                                               sizeof(YamlCatalogFile));
+    if (catalog->platforms == NULL || catalog->files == NULL) {
+        return(ENOMEM);
+    }
+
+    for (file = 0; file < header->files; file++) {
+        catalog->files[file].name = get_string(catalog, files[file].name);
+        catalog->files[file].filename = get_string(catalog,
+                                                   files[file].filename);
+        catalog->files[file].hash = files[file].hash;
+        if (catalog->files[file].name == NULL ||
+                catalog->files[file].filename == NULL) {
+            return(EINVAL);
+        }
+    }
+
+    for (idx = 0; idx < header->platforms; idx++) {
+        YamlCatalogPlatform *platform = &catalog->platforms[idx];
+
+        platform->manufacturer = get_string(catalog,
+                                            records[idx].manufacturer);
+        platform->product_name = get_string(catalog,
+                                            records[idx].product_name);
+        platform->dir = get_string(catalog, records[idx].dir);
+        if (platform->manufacturer == NULL ||
+                platform->product_name == NULL || platform->dir == NULL ||
+                records[idx].first_file > header->files ||
+                records[idx].file_count > header->files -
+                                          records[idx].first_file) {
+            return(EINVAL);
+        }
+        platform->files = &catalog->files[records[idx].first_file];
+        platform->file_count = records[idx].file_count;
+    }
+
+    return(0);
+}
+
+YamlCatalog *
+yaml_catalog_open(const char *index_file)
+{
+    YamlCatalog *catalog;
+    struct stat st;
+    ssize_t count;
+    int rc;
+    int fd;
+
+    if (index_file == NULL) {
+        errno = EINVAL;
+        return(NULL);
+    }
+
+    fd = open(index_file, O_RDONLY);
+    if (fd < 0) {
+        return(NULL);
+    }
+    if (fstat(fd, &st) != 0) {
+        rc = errno;
+        close(fd);
+        errno = rc;
+        return(NULL);
+    }
+    if (st.st_size > CATALOG_MAX_SIZE) {
+        rc = EFBIG;
+        close(fd);
+        errno = rc;
+        return(NULL);
+    }
+
+    catalog = (YamlCatalog *)calloc(1, sizeof(YamlCatalog));
+    if (catalog == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return(NULL);
+    }
+    catalog->buffer = (char *)malloc(st.st_size + 1);
+    if (catalog->buffer == NULL) {
+        close(fd);
+        free(catalog);
+        errno = ENOMEM;
+        return(NULL);
+    }
+
+    do {
+        count = read(fd, catalog->buffer, st.st_size);
+    } while (count < 0 && errno == EINTR);
+    rc = count < 0 ? errno : 0;
+    close(fd);
+
+    if (rc == 0) {
+        rc = count == st.st_size ? decode(catalog, st.st_size) : EINVAL;
+    }
+    if (rc != 0) {
+        yaml_catalog_close(catalog);
+        errno = rc;
+        return(NULL);
+    }
+
+    return(catalog);
+}
+
+void
+yaml_catalog_close(YamlCatalog *catalog)
+{
+    if (catalog == NULL) {
+        return;
+    }
+
+    free(catalog->platforms);
+    free(catalog->files);
+    free(catalog->buffer);
+    free(catalog);
+}
+
+const YamlCatalogPlatform *
+yaml_catalog_get_platforms(const YamlCatalog *catalog, unsigned int *count)
+{
+    if (catalog == NULL || count == NULL) {
+        return(NULL);
+    }
+
+    *count = catalog->count;
+
+    return(catalog->platforms);
+}
+
+const YamlCatalogPlatform *
+yaml_catalog_find(const YamlCatalog *catalog, const char *manufacturer,
+                  const char *product_name)
+{
+    unsigned int low = 0;
+    unsigned int high;
+
+    if (catalog == NULL || product_name == NULL) {
+        return(NULL);
+    }
+
+    // the first platform not below the product, then its manufacturers
+    high = catalog->count;
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+        const YamlCatalogPlatform *platform = &catalog->platforms[mid];
+        int rc = strcmp(platform->product_name, product_name);
+
+        if (rc == 0 && manufacturer != NULL) {
+            rc = strcmp(platform->manufacturer, manufacturer);
+        }
+        if (rc < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == catalog->count ||
+            strcmp(catalog->platforms[low].product_name, product_name) != 0 ||
+            (manufacturer != NULL &&
+             strcmp(catalog->platforms[low].manufacturer, manufacturer) != 0)) {
+        return(NULL);
+    }
+
+    return(&catalog->platforms[low]);
+}
+
+int
+yaml_catalog_verify(const YamlCatalogPlatform *platform)
+{
+    unsigned long long hash;
+    unsigned int idx;
+    char *path;
+    int rc = 0;
+
+    if (platform == NULL) {
+        return(EINVAL);
+    }
+
+    for (idx = 0; idx < platform->file_count && rc == 0; idx++) {
+        const YamlCatalogFile *file = &platform->files[idx];
+
+        path = (char *)malloc(strlen(platform->dir) +
+                              strlen(file->filename) + 2);
+        if (path == NULL) {
+            return(ENOMEM);
+        }
+        sprintf(path, "%s/%s", platform->dir, file->filename);
+
+        rc = yaml_catalog_hash_file(path, &hash);
+        if (rc == 0 && hash != file->hash) {
+            rc = ESTALE;
+        }
+        free(path);
+    }
+
+    return(rc);
+}
@@ -16,10 +16,21 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
 
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -33,6 +44,52 @@ using namespace std;
 
 #define QOS_MAX_STRING_LENGTH 64
 
+/* Profile queues are indexed by a dense array, so bound them */
+#define QOS_MAX_QUEUES 64
+
+/* A named schedule or queue profile. The entries are sorted by queue, and
+ * queue_index maps a queue number to its slot in entries (-1 if unused). */
+template <typename T>
+struct YamlQosProfile {
+    string      name;
+    vector<T>   entries;
+    vector<int> queue_index;
+};
+
+typedef YamlQosProfile<YamlScheduleProfileEntry> YamlScheduleProfile;
+typedef YamlQosProfile<YamlQueueProfileEntry>    YamlQueueProfile;
+
+#define BUFMON_MAX_STRINGS      65536
+#define BUFMON_SEGMENT_BITS     16
+#define BUFMON_SEGMENT_MASK     0xffffULL
+
+// A parsed description file, shared by every subsystem with the same content
+struct ParsedDocument;
+static void release_document(ParsedDocument *parsed);
+
+/* Buffer monitoring counters, stored one column per field. Every string is
+ * interned in strings, and a counter name is packed into name_key as one
+ * BUFMON_SEGMENT_BITS wide string id per segment, realm first. */
+typedef struct {
+    YamlBufmonInfo              info;
+
+    vector<string>              strings;
+    map<string, unsigned int>   string_map;
+
+    vector<unsigned long long>  name_key;
+    vector<unsigned short>      counter_name;
+    vector<int>                 port;
+    vector<int>                 priority_group;
+    vector<int>                 queue;
+    vector<int>                 service_pool;
+    vector<int>                 hw_unit_id;
+    vector<unsigned long long>  trigger_threshold;
+    vector<bool>                enabled;
+
+    vector<unsigned int>        name_index;     /* sorted by name_key */
+    vector<unsigned int>        port_index;     /* sorted by port, pg */
+} YamlBufmon;
+
 typedef struct {
     map<string, YamlDevice> device_map;
 
@@ -48,6 +105,13 @@ typedef struct {
     YamlPortInfo            port_info;
     vector<YamlPort>        ports;
 
+    // yaml_parse_ports_lazy() keeps ports.yaml until every port is decoded
+    ParsedDocument          *ports_doc;
+    vector<const YAML::Node *> port_nodes;
+    vector<unsigned char>   port_decoded;
+    size_t                  ports_pending;
+    pthread_mutex_t         ports_lock;
+
     vector<YamlFanFru>      fan_frus;
     YamlFanInfo             fan_info;
 
@@ -63,16 +127,30 @@ typedef struct {
     YamlQosInfo             qos_info;
     vector<YamlScheduleProfileEntry> schedule_profile_entries;
     vector<YamlQueueProfileEntry>    queue_profile_entries;
+    vector<YamlScheduleProfile>      schedule_profiles;
+    map<string, size_t>              schedule_profile_map;
+    vector<YamlQueueProfile>         queue_profiles;
+    map<string, size_t>              queue_profile_map;
     vector<YamlCosMapEntry>          cos_map_entries;
     vector<YamlDscpMapEntry>         dscp_map_entries;
+    YamlQosMapValue                  cos_map_table[QOS_COS_MAP_SIZE];
+    bool                             cos_map_table_valid;
+    YamlQosMapValue                  dscp_map_table[QOS_DSCP_MAP_SIZE];
+    bool                             dscp_map_table_valid;
+
+    YamlBufmon              bufmon;
 
     vector<i2c_op>          init_ops;
+    vector<int>             init_op_status;     // of the last yaml_init_devices
 
     string                  dir_name;
 } YamlSubsystem;
 
 typedef struct {
     map<string, YamlSubsystem*> subsystem_map;
+    const YamlI2cBackend        *i2c_backend;   // NULL for Linux i2c-dev
+    YamlI2cStats                *i2c_stats;
+    YamlI2cRoutes               *i2c_routes;    // per device, lazily
 } YamlConfigHandlePrivate;
 
 static void operator >> (const YAML::Node &node, YamlSubsysInfo &sub_info)
@@ -276,9 +354,10 @@ static void operator >> (const YAML::Node &node, i2c_bit_op &op)
     op.register_address = (unsigned char)strtoul(str.c_str(), 0, 0);
 
     node["bitmask"] >> str;
-    op.bit_mask = (unsigned char)strtoul(str.c_str(), 0, 0);
+    op.bit_mask = (unsigned int)strtoul(str.c_str(), 0, 0);
     op.register_size = str.size()/2 - 1;    // must be hex bytes with leading 0x!
 
+    op.negative_polarity = false;
     if (const YAML::Node *pNode = node.FindValue("polarity")) {
         string str;
         *pNode >> str;
@@ -459,6 +538,9 @@ static void operator >> (const YAML::Node &node, YamlPort &port)
 
     strs.clear();
 
+    // signals that aren't listed stay NULL
+    memset(&port.module_signals, 0, sizeof(YamlModuleSignals));
+
     if (port.pluggable) {
         node["module_eeprom"] >> str;
         port.module_eeprom = strdup(str.c_str());
@@ -469,8 +551,6 @@ static void operator >> (const YAML::Node &node, YamlPort &port)
             node["module_signals"] >> port.module_signals.qsfp;
         } else if (strcmp(port.connector, QSFP28) == 0) {
             node["module_signals"] >> port.module_signals.qsfp28;
-        } else {
-            memset(&port.module_signals, 0, sizeof(YamlModuleSignals));
         }
     }
 
@@ -841,8 +921,26 @@ static void operator >> (const YAML::Node &node, YamlBus &bus)
     string str;
     node["name"] >> str;
     bus.name = strdup(str.c_str());
-    node["dev_name"] >> str;
-    bus.devname = strdup(str.c_str());
+
+    bus.parent_subsyst = NULL;
+    bus.parent_device = NULL;
+
+    // a bus behind another subsystem's mux uses the adapter of its parent
+    if (const YAML::Node *pNode = node.FindValue("parent_device")) {
+        *pNode >> str;
+        bus.parent_device = strdup(str.c_str());
+        node["parent_subsystem"] >> str;
+        bus.parent_subsyst = strdup(str.c_str());
+        bus.devname = NULL;
+        if (const YAML::Node *pDevName = node.FindValue("dev_name")) {
+            *pDevName >> str;
+            bus.devname = strdup(str.c_str());
+        }
+    } else {
+        node["dev_name"] >> str;
+        bus.devname = strdup(str.c_str());
+    }
+
     node["smbus"] >> bus.smbus;
 }
 
@@ -858,6 +956,52 @@ static void operator >> (const YAML::Node &node, map<string, YamlBus> &buses)
 /*======*/
 /* QOS. */
 /*======*/
+static bool
+qos_algorithm_from_string(const char *str, YamlQosAlgorithm &algorithm)
+{
+    if (strncmp(str, "strict", QOS_MAX_STRING_LENGTH) == 0) {
+        algorithm = QOS_ALGORITHM_STRICT;
+    } else if (strncmp(str, "dwrr", QOS_MAX_STRING_LENGTH) == 0) {
+        algorithm = QOS_ALGORITHM_DWRR;
+    } else {
+        return(false);
+    }
+
+    return(true);
+}
+
+static bool
+qos_color_from_string(const char *str, YamlQosColor &color)
+{
+    if (strncmp(str, "green", QOS_MAX_STRING_LENGTH) == 0) {
+        color = QOS_COLOR_GREEN;
+    } else if (strncmp(str, "yellow", QOS_MAX_STRING_LENGTH) == 0) {
+        color = QOS_COLOR_YELLOW;
+    } else if (strncmp(str, "red", QOS_MAX_STRING_LENGTH) == 0) {
+        color = QOS_COLOR_RED;
+    } else {
+        return(false);
+    }
+
+    return(true);
+}
+
+static bool
+qos_trust_from_string(const char *str, YamlQosTrust &trust)
+{
+    if (strncmp(str, "none", QOS_MAX_STRING_LENGTH) == 0) {
+        trust = QOS_TRUST_NONE;
+    } else if (strncmp(str, "cos", QOS_MAX_STRING_LENGTH) == 0) {
+        trust = QOS_TRUST_COS;
+    } else if (strncmp(str, "dscp", QOS_MAX_STRING_LENGTH) == 0) {
+        trust = QOS_TRUST_DSCP;
+    } else {
+        return(false);
+    }
+
+    return(true);
+}
+
 static void operator >> (const YAML::Node &node, YamlQosInfo &qos_info)
 {
     string str;
@@ -882,12 +1026,10 @@ static void operator >> (const YAML::Node &node, YamlQosInfo &qos_info)
 
     node["default_qos_trust"] >> str;
     qos_info.trust = strdup(str.c_str());
-    if (qos_info.trust != NULL &&
-            strncmp(qos_info.trust, "none", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(qos_info.trust, "cos", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(qos_info.trust, "dscp", QOS_MAX_STRING_LENGTH) != 0) {
+    if (!qos_trust_from_string(str.c_str(), qos_info.trust_id)) {
         std::cout << "config-yaml|ERR|Unexpected qos trust: "
-                << qos_info.trust << std::endl;
+                << str << std::endl;
+        throw "QOS trust value is incorrect: " + str;
     }
 }
 
@@ -900,15 +1042,16 @@ static void operator >> (const YAML::Node &node, YamlScheduleProfileEntry &entry
 
     node["algorithm"] >> str;
     entry.algorithm = strdup(str.c_str());
-    if (entry.algorithm != NULL &&
-            strncmp(entry.algorithm, "strict", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(entry.algorithm, "dwrr", QOS_MAX_STRING_LENGTH) != 0) {
+    if (!qos_algorithm_from_string(str.c_str(), entry.algorithm_id)) {
         std::cout << "config-yaml|ERR|Unexpected algorithm: "
-                << entry.algorithm << std::endl;
+                << str << std::endl;
+        throw "Schedule algorithm value is incorrect: " + str;
     }
 
+    entry.weight = 0;
+
     /* Only check for weight if "dwrr" algorithm */
-    if (strncmp(entry.algorithm, "dwrr", QOS_MAX_STRING_LENGTH) == 0) {
+    if (entry.algorithm_id == QOS_ALGORITHM_DWRR) {
         node["weight"] >> str;
         entry.weight = strtol(str.c_str(), 0, 0);
         if (entry.weight < 1) {
@@ -983,12 +1126,10 @@ static void operator >> (const YAML::Node &node, YamlCosMapEntry &entry)
 
     node["color"] >> str;
     entry.color = strdup(str.c_str());
-    if (entry.color != NULL &&
-            strncmp(entry.color, "green", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(entry.color, "yellow", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(entry.color, "red", QOS_MAX_STRING_LENGTH) != 0) {
+    if (!qos_color_from_string(str.c_str(), entry.color_id)) {
         std::cout << "config-yaml|ERR|Unexpected color: "
-                << entry.color << std::endl;
+                << str << std::endl;
+        throw "QOS color value is incorrect: " + str;
     }
 }
 
@@ -1015,12 +1156,10 @@ static void operator >> (const YAML::Node &node, YamlDscpMapEntry &entry)
 
     node["color"] >> str;
     entry.color = strdup(str.c_str());
-    if (entry.color != NULL &&
-            strncmp(entry.color, "green", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(entry.color, "yellow", QOS_MAX_STRING_LENGTH) != 0 &&
-            strncmp(entry.color, "red", QOS_MAX_STRING_LENGTH) != 0) {
+    if (!qos_color_from_string(str.c_str(), entry.color_id)) {
         std::cout << "config-yaml|ERR|Unexpected color: "
-                << entry.color << std::endl;
+                << str << std::endl;
+        throw "QOS color value is incorrect: " + str;
     }
 
     /* description is name */
@@ -1057,256 +1196,833 @@ static void operator >> (const YAML::Node &node, vector<YamlDscpMapEntry> &entri
         entries.push_back(entry);
     }
 }
-/*======*/
-/*======*/
 
-void
-init_info_fields(YamlSubsystem *sub)
+/* Fill a code point indexed lookup table from a COS or DSCP map. Returns
+ * false unless every code point is mapped exactly once. */
+template <typename T>
+static bool
+build_qos_map_table(const vector<T> &entries, YamlQosMapValue *table,
+                    size_t size, const char *map_name)
 {
-    YamlPsuInfo             psu_info;
-
-    YamlLedInfo             led_info;
+    vector<bool> seen(size, false);
+    bool valid = true;
 
-    // YamlSubsysInfo
-    sub->subsys_info.info = NULL;
+    memset(table, 0, sizeof(YamlQosMapValue) * size);
 
-    // YamlThermalInfo
-    sub->thermal.number_sensors = 0;
-    sub->thermal.polling_period = 0;
-    sub->thermal.auto_shutdown = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const T &entry = entries[i];
 
-    // YamlPortInfo
-    sub->port_info.number_ports = 0;
-    sub->port_info.max_port_speed = 0;
-    sub->port_info.max_transmission_unit = 0;
-    sub->port_info.max_lag_count = 0;
-    sub->port_info.max_lag_member_count = 0;
-    sub->port_info.l3_port_requires_internal_vlan = 0;
+        /* out of range code points were reported when the entry was
+         * parsed */
+        if ((entry.code_point < 0) || ((size_t)entry.code_point >= size)) {
+            valid = false;
+            continue;
+        }
 
-    // YamlFanInfo
-    sub->fan_info.number_fan_frus = 0;
-    sub->fan_info.fans_per_fru = 0;
-    sub->fan_info.fan_speed_control_type = SINGLE;
-    sub->fan_info.fan_speed_control = NULL;
-    sub->fan_info.fan_speed_min = NORMAL;
-    sub->fan_info.fan_speed_settings.slow = '\0';
-    sub->fan_info.fan_speed_settings.normal = '\0';
-    sub->fan_info.fan_speed_settings.medium = '\0';
-    sub->fan_info.fan_speed_settings.fast = '\0';
-    sub->fan_info.fan_speed_settings.max = '\0';
-    sub->fan_info.direction = F2B;
-    sub->fan_info.fan_direction_control = NULL;
-    sub->fan_info.direction_values.f2b = '\0';
-    sub->fan_info.direction_values.b2f = '\0';
-    sub->fan_info.direction_control_values.f2b = '\0';
-    sub->fan_info.direction_control_values.b2f = '\0';
-    sub->fan_info.fan_speed_multiplier = 0;
-    sub->fan_info.fan_led_values.off = '\0';
-    sub->fan_info.fan_led_values.good = '\0';
-    sub->fan_info.fan_led_values.fault = '\0';
+        if (seen[entry.code_point]) {
+            std::cout << "config-yaml|ERR|Duplicate " << map_name
+                    << " map code point: " << entry.code_point << std::endl;
+            valid = false;
+            continue;
+        }
+        seen[entry.code_point] = true;
 
-    // YamlPsuInfo
-    sub->psu_info.number_psus = 0;
-    sub->psu_info.polling_period = 0;
+        if ((entry.local_priority < 0) || (entry.local_priority > UCHAR_MAX)) {
+            std::cout << "config-yaml|ERR|Out of range value for local priority: "
+                    << entry.local_priority << std::endl;
+            valid = false;
+            continue;
+        }
 
-    // YamlLedInfo
-    sub->led_info.number_leds = 0;
-    sub->led_info.number_types = 0;
+        table[entry.code_point].local_priority =
+                                    (unsigned char)entry.local_priority;
+        table[entry.code_point].color = (unsigned char)entry.color_id;
+    }
 
-    // YamlFruInfo
-    sub->fru_info.country_code = '\0';
-    sub->fru_info.device_version = 0;
-    sub->fru_info.diag_version = '\0';
-    sub->fru_info.label_revision = '\0';
-    sub->fru_info.manufacture_date = '\0';
-    sub->fru_info.manufacturer = '\0';
-    sub->fru_info.num_macs = 0;
-    sub->fru_info.onie_version = '\0';
-    sub->fru_info.part_number = '\0';
-    sub->fru_info.platform_name = '\0';
-    sub->fru_info.product_name = '\0';
-    sub->fru_info.serial_number = '\0';
-    sub->fru_info.service_tag = '\0';
-    sub->fru_info.vendor = '\0';
-    sub->fru_info.base_mac_address = '\0';
+    for (size_t code_point = 0; code_point < size; code_point++) {
+        if (!seen[code_point]) {
+            std::cout << "config-yaml|ERR|Missing " << map_name
+                    << " map code point: " << code_point << std::endl;
+            valid = false;
+        }
+    }
 
-    // YamlQosInfo
-    sub->qos_info.trust = NULL;
+    return(valid);
 }
 
-extern "C" const YamlLedType *
-yaml_get_led_type(YamlConfigHandle handle, const char *subsyst,
-                                    unsigned int idx)
+template <typename T>
+static void operator >> (const YAML::Node &node, YamlQosProfile<T> &profile)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-    string sub_str = subsyst;
+    node["name"] >> profile.name;
+    if (profile.name.size() > QOS_MAX_STRING_LENGTH) {
+        std::cout << "config-yaml|ERR|The maximum length is "
+                << QOS_MAX_STRING_LENGTH << " characters: "
+                << profile.name << std::endl;
+    }
 
-    YamlSubsystem *sub = NULL;
+    node["entries"] >> profile.entries;
+}
 
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(NULL);
+template <typename T>
+static void operator >> (const YAML::Node &node, vector<YamlQosProfile<T> > &profiles)
+{
+    for (size_t i = 0; i < node.size(); i++) {
+        YamlQosProfile<T> profile;
+        node[i] >> profile;
+        profiles.push_back(profile);
     }
+}
 
-    if ((size_t)idx >= sub->led_types.size()) {
-        return(NULL);
-    }
-    return(&sub->led_types[idx]);
+template <typename T>
+static bool
+qos_entry_queue_less(const T &a, const T &b)
+{
+    return(a.queue < b.queue);
 }
 
-extern "C" const YamlLedInfo *
-yaml_get_led_info(YamlConfigHandle handle, const char *subsyst)
+/* Sort each profile's entries by queue and build the name and queue
+ * indexes. Returns false on duplicate profile names or queues. */
+template <typename T>
+static bool
+index_qos_profiles(vector<YamlQosProfile<T> > &profiles,
+                   map<string, size_t> &profile_map, const char *kind)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-    string sub_str = subsyst;
+    profile_map.clear();
 
-    YamlSubsystem *sub = NULL;
+    for (size_t i = 0; i < profiles.size(); i++) {
+        YamlQosProfile<T> &profile = profiles[i];
 
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(NULL);
+        if (profile_map.find(profile.name) != profile_map.end()) {
+            std::cout << "config-yaml|ERR|Duplicate " << kind
+                    << " profile: " << profile.name << std::endl;
+            return(false);
+        }
+        profile_map[profile.name] = i;
+
+        stable_sort(profile.entries.begin(), profile.entries.end(),
+                    qos_entry_queue_less<T>);
+
+        profile.queue_index.clear();
+
+        for (size_t idx = 0; idx < profile.entries.size(); idx++) {
+            int queue = profile.entries[idx].queue;
+
+            if (queue < 0 || queue >= QOS_MAX_QUEUES) {
+                std::cout << "config-yaml|ERR|Out of range value for queue: "
+                        << queue << std::endl;
+                return(false);
+            }
+
+            if ((size_t)queue >= profile.queue_index.size()) {
+                profile.queue_index.resize(queue + 1, -1);
+            }
+
+            if (profile.queue_index[queue] != -1) {
+                std::cout << "config-yaml|ERR|Duplicate queue " << queue
+                        << " in " << kind << " profile: "
+                        << profile.name << std::endl;
+                return(false);
+            }
+            profile.queue_index[queue] = (int)idx;
+        }
     }
 
-    return(&sub->led_info);
+    return(true);
 }
 
-extern "C" const YamlLed *
-yaml_get_led(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+/* Look up a profile by name, or the default profile if name is NULL */
+template <typename T>
+static const YamlQosProfile<T> *
+find_qos_profile(const YamlSubsystem *sub,
+                 const vector<YamlQosProfile<T> > &profiles,
+                 const map<string, size_t> &profile_map, const char *name)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-    string sub_str = subsyst;
-
-    YamlSubsystem *sub = NULL;
+    if (name == NULL) {
+        name = sub->qos_info.default_name;
+    }
 
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
+    if (name == NULL) {
         return(NULL);
     }
 
-    if ((size_t)idx >= sub->leds.size()) {
+    map<string, size_t>::const_iterator it = profile_map.find(name);
+
+    if (it == profile_map.end()) {
         return(NULL);
     }
-    return(&sub->leds[idx]);
+    return(&profiles[it->second]);
 }
-
-extern "C" int
-yaml_get_led_type_count(YamlConfigHandle handle, const char *subsyst)
+/*======*/
+/* Returns the id of an interned bufmon string, adding it if needed */
+static bool
+bufmon_intern(YamlBufmon &bufmon, const string &str, unsigned int &id)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-
-    string sub_str = subsyst;
+    map<string, unsigned int>::iterator it = bufmon.string_map.find(str);
 
-    YamlSubsystem *sub = NULL;
+    if (it != bufmon.string_map.end()) {
+        id = it->second;
+        return(true);
+    }
 
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(-1);
+    if (bufmon.strings.size() >= BUFMON_MAX_STRINGS) {
+        std::cout << "config-yaml|ERR|Too many distinct bufmon strings"
+                << std::endl;
+        return(false);
     }
 
-    return(sub->led_types.size());
+    id = bufmon.strings.size();
+    bufmon.strings.push_back(str);
+    bufmon.string_map[str] = id;
+    return(true);
 }
 
-extern "C" int
-yaml_get_led_count(YamlConfigHandle handle, const char *subsyst)
+/* Packs a realm/counter/x/y name into a key. If intern is false, unknown
+ * segments fail the lookup instead of being added. */
+static bool
+bufmon_name_key(YamlBufmon &bufmon, const string &name, bool intern,
+                unsigned long long &key)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    size_t start = 0;
 
-    string sub_str = subsyst;
+    key = 0;
 
-    YamlSubsystem *sub = NULL;
+    for (int seg = 0; seg < BUFMON_NAME_SEGMENTS; seg++) {
+        size_t end = name.find('/', start);
 
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(-1);
+        if ((end == string::npos) != (seg == BUFMON_NAME_SEGMENTS - 1)) {
+            return(false);
+        }
+
+        string segment = name.substr(start, end - start);
+        unsigned int id;
+
+        if (intern) {
+            if (!bufmon_intern(bufmon, segment, id)) {
+                return(false);
+            }
+        } else {
+            map<string, unsigned int>::const_iterator it =
+                                        bufmon.string_map.find(segment);
+            if (it == bufmon.string_map.end()) {
+                return(false);
+            }
+            id = it->second;
+        }
+
+        key = (key << BUFMON_SEGMENT_BITS) | id;
+        start = end + 1;
     }
 
-    return(sub->leds.size());
+    return(true);
 }
 
-extern "C" const YamlPsuInfo *
-yaml_get_psu_info(YamlConfigHandle handle, const char *subsyst)
+static bool
+bufmon_to_bool(const string &str, bool &value)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-    string sub_str = subsyst;
-
-    YamlSubsystem *sub = NULL;
-
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(NULL);
+    if (str == "true" || str == "True" || str == "yes") {
+        value = true;
+    } else if (str == "false" || str == "False" || str == "no") {
+        value = false;
+    } else {
+        return(false);
     }
 
-    return(&sub->psu_info);
+    return(true);
 }
 
-extern "C" const YamlFruInfo *
-yaml_get_fru_info(YamlConfigHandle handle, const char *subsyst)
+static bool
+bufmon_to_ull(const string &str, unsigned long long &value)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-    string sub_str = subsyst;
+    char *end = NULL;
 
-    YamlSubsystem *sub = NULL;
-
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(NULL);
+    if (str.empty() || str[0] == '-') {
+        return(false);
     }
-
-    return(&sub->fru_info);
+    value = strtoull(str.c_str(), &end, 0);
+    return(*end == '\0');
 }
 
-extern "C" const YamlPsu *
-yaml_get_psu(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+static bool
+bufmon_to_int(const string &str, int &value)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
-    string sub_str = subsyst;
+    char *end = NULL;
+    long val;
 
-    YamlSubsystem *sub = NULL;
-
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(NULL);
+    if (str.empty()) {
+        return(false);
     }
-
-    if ((size_t)idx >= sub->psus.size()) {
-        return(NULL);
+    val = strtol(str.c_str(), &end, 0);
+    if (*end != '\0' || val < 0 || val > INT_MAX) {
+        return(false);
     }
-    return(&sub->psus[idx]);
+    value = (int)val;
+    return(true);
 }
 
-extern "C" int
-yaml_get_psu_count(YamlConfigHandle handle, const char *subsyst)
-{
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+/* Event handler that fills a YamlBufmon while the bufmond.yaml file is
+ * streamed, so the counters are never held as a YAML::Node tree. */
+class BufmonEventHandler : public YAML::EventHandler {
+public:
+    BufmonEventHandler(YamlBufmon &bufmon) : m_bufmon(bufmon), m_error(false)
+    {
+        clear_counter();
+    }
 
-    string sub_str = subsyst;
+    bool failed() const { return(m_error); }
 
-    YamlSubsystem *sub = NULL;
+    virtual void OnDocumentStart(const YAML::Mark &) {}
+    virtual void OnDocumentEnd() {}
 
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(-1);
+    virtual void OnNull(const YAML::Mark &, YAML::anchor_t)
+    {
+        OnValue("");
     }
 
-    return(sub->psus.size());
-}
+    virtual void OnAlias(const YAML::Mark &, YAML::anchor_t)
+    {
+        fail("aliases are not supported");
+    }
 
-extern "C" const YamlDevice *
-yaml_find_device(YamlConfigHandle handle, const char *subsyst, const char *dev_name)
-{
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    virtual void OnScalar(const YAML::Mark &, const string &,
+                          YAML::anchor_t, const string &value)
+    {
+        OnValue(value);
+    }
 
-    string name = dev_name;
-    string sub_str = subsyst;
+    virtual void OnSequenceStart(const YAML::Mark &, const string &,
+                                 YAML::anchor_t)
+    {
+        push(false);
+    }
+
+    virtual void OnSequenceEnd()
+    {
+        pop();
+    }
+
+    virtual void OnMapStart(const YAML::Mark &, const string &,
+                            YAML::anchor_t)
+    {
+        push(true);
+    }
+
+    virtual void OnMapEnd()
+    {
+        if (in_counter() && m_frames.size() == 3) {
+            add_counter();
+        }
+        pop();
+    }
+
+private:
+    struct Frame {
+        bool    is_map;
+        bool    have_key;
+        string  key;
+    };
+
+    YamlBufmon      &m_bufmon;
+    vector<Frame>   m_frames;
+    bool            m_error;
+
+    bool            m_has_name;
+    string          m_name;
+    string          m_counter_name;
+    int             m_port;
+    int             m_priority_group;
+    int             m_queue;
+    int             m_service_pool;
+    int             m_hw_unit_id;
+    unsigned long long m_trigger_threshold;
+    bool            m_enabled;
+
+    void fail(const string &msg)
+    {
+        if (!m_error) {
+            std::cout << "config-yaml|ERR|bufmon: " << msg << std::endl;
+        }
+        m_error = true;
+    }
+
+    void push(bool is_map)
+    {
+        Frame frame;
+
+        frame.is_map = is_map;
+        frame.have_key = false;
+        m_frames.push_back(frame);
+
+        if (in_counter() && m_frames.size() == 3) {
+            clear_counter();
+        }
+    }
+
+    void pop()
+    {
+        m_frames.pop_back();
+        if (!m_frames.empty() && m_frames.back().is_map) {
+            m_frames.back().have_key = false;
+        }
+    }
+
+    /* root map -> counters sequence -> counter map */
+    bool in_counter() const
+    {
+        return(m_frames.size() >= 3 && m_frames[0].key == "counters" &&
+               !m_frames[1].is_map && m_frames[2].is_map);
+    }
+
+    void clear_counter()
+    {
+        m_has_name = false;
+        m_name.clear();
+        m_counter_name.clear();
+        m_port = -1;
+        m_priority_group = -1;
+        m_queue = -1;
+        m_service_pool = -1;
+        m_hw_unit_id = 0;
+        m_trigger_threshold = 0;
+        m_enabled = true;
+    }
+
+    void OnValue(const string &value)
+    {
+        if (m_frames.empty()) {
+            return;
+        }
+
+        Frame &top = m_frames.back();
+
+        if (top.is_map && !top.have_key) {
+            top.key = value;
+            top.have_key = true;
+            return;
+        }
+
+        if (m_frames.size() == 1) {
+            root_value(top.key, value);
+        } else if (in_counter() && m_frames.size() == 3) {
+            counter_value(top.key, value);
+        } else if (in_counter() && m_frames.size() == 4 &&
+                   m_frames[2].key == "counter_vendor_specific_info") {
+            vendor_value(top.key, value);
+        }
+
+        if (top.is_map) {
+            top.have_key = false;
+        }
+    }
+
+    void root_value(const string &key, const string &value)
+    {
+        bool *field = NULL;
+
+        if (key == "cap_mode_current") {
+            field = &m_bufmon.info.cap_mode_current;
+        } else if (key == "cap_mode_peak") {
+            field = &m_bufmon.info.cap_mode_peak;
+        } else if (key == "cap_snapshot_on_threshold_trigger") {
+            field = &m_bufmon.info.cap_snapshot_on_threshold_trigger;
+        } else if (key == "cap_threshold_trigger_collection") {
+            field = &m_bufmon.info.cap_threshold_trigger_collection;
+        } else {
+            return;
+        }
+
+        if (!bufmon_to_bool(value, *field)) {
+            fail("Unexpected value for " + key + ": " + value);
+        }
+    }
+
+    void counter_value(const string &key, const string &value)
+    {
+        bool ok = true;
+
+        if (key == "name") {
+            m_name = value;
+            m_has_name = true;
+        } else if (key == "enabled") {
+            ok = bufmon_to_bool(value, m_enabled);
+        } else if (key == "hw_unit_id") {
+            ok = bufmon_to_int(value, m_hw_unit_id);
+        } else if (key == "trigger_threshold") {
+            ok = bufmon_to_ull(value, m_trigger_threshold);
+        }
+
+        if (!ok) {
+            fail("Unexpected value for " + key + ": " + value);
+        }
+    }
+
+    void vendor_value(const string &key, const string &value)
+    {
+        bool ok = true;
+
+        if (key == "counter_name") {
+            m_counter_name = value;
+        } else if (key == "port") {
+            ok = bufmon_to_int(value, m_port);
+        } else if (key == "priority-group") {
+            ok = bufmon_to_int(value, m_priority_group);
+        } else if (key == "queue") {
+            ok = bufmon_to_int(value, m_queue);
+        } else if (key == "service-pool") {
+            ok = bufmon_to_int(value, m_service_pool);
+        }
+
+        if (!ok) {
+            fail("Unexpected value for " + key + ": " + value);
+        }
+    }
+
+    void add_counter()
+    {
+        unsigned long long key;
+        unsigned int counter_name;
+
+        if (m_error) {
+            return;
+        }
+
+        if (!m_has_name ||
+                !bufmon_name_key(m_bufmon, m_name, true, key)) {
+            fail("Invalid counter name: " + m_name);
+            return;
+        }
+
+        if (!bufmon_intern(m_bufmon, m_counter_name, counter_name)) {
+            m_error = true;
+            return;
+        }
+
+        m_bufmon.name_key.push_back(key);
+        m_bufmon.counter_name.push_back(counter_name);
+        m_bufmon.port.push_back(m_port);
+        m_bufmon.priority_group.push_back(m_priority_group);
+        m_bufmon.queue.push_back(m_queue);
+        m_bufmon.service_pool.push_back(m_service_pool);
+        m_bufmon.hw_unit_id.push_back(m_hw_unit_id);
+        m_bufmon.trigger_threshold.push_back(m_trigger_threshold);
+        m_bufmon.enabled.push_back(m_enabled);
+    }
+};
+
+struct BufmonNameLess {
+    const YamlBufmon &bufmon;
+
+    BufmonNameLess(const YamlBufmon &b) : bufmon(b) {}
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        return(bufmon.name_key[a] < bufmon.name_key[b]);
+    }
+    bool operator()(unsigned int a, unsigned long long key) const
+    {
+        return(bufmon.name_key[a] < key);
+    }
+};
+
+/* A port and priority group to search for. A priority group of -1
+ * matches every counter of the port. */
+struct BufmonPortKey {
+    int port;
+    int priority_group;
+
+    BufmonPortKey(int p, int pg) : port(p), priority_group(pg) {}
+};
+
+/* Orders counters by port and then priority group. Counters without a
+ * priority group sort first within their port. */
+struct BufmonPortLess {
+    const YamlBufmon &bufmon;
+
+    BufmonPortLess(const YamlBufmon &b) : bufmon(b) {}
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        if (bufmon.port[a] != bufmon.port[b]) {
+            return(bufmon.port[a] < bufmon.port[b]);
+        }
+        return(bufmon.priority_group[a] < bufmon.priority_group[b]);
+    }
+    bool operator()(unsigned int a, const BufmonPortKey &key) const
+    {
+        if (bufmon.port[a] != key.port || key.priority_group < 0) {
+            return(bufmon.port[a] < key.port);
+        }
+        return(bufmon.priority_group[a] < key.priority_group);
+    }
+    bool operator()(const BufmonPortKey &key, unsigned int a) const
+    {
+        if (bufmon.port[a] != key.port || key.priority_group < 0) {
+            return(key.port < bufmon.port[a]);
+        }
+        return(key.priority_group < bufmon.priority_group[a]);
+    }
+};
+
+static unsigned int
+bufmon_segment_id(const YamlBufmon &bufmon, unsigned int idx, int seg)
+{
+    int shift = (BUFMON_NAME_SEGMENTS - 1 - seg) * BUFMON_SEGMENT_BITS;
+
+    return((bufmon.name_key[idx] >> shift) & BUFMON_SEGMENT_MASK);
+}
+
+static const char *
+bufmon_name_segment(const YamlBufmon &bufmon, unsigned int idx, int seg)
+{
+    return(bufmon.strings[bufmon_segment_id(bufmon, idx, seg)].c_str());
+}
+
+/* A string id to search for in one name segment */
+struct BufmonSegmentId {
+    unsigned int id;
+
+    BufmonSegmentId(unsigned int i) : id(i) {}
+};
+
+/* Compares one name segment of a counter with a string id, for searching
+ * a name_index range whose leading segments are all equal. */
+struct BufmonSegmentLess {
+    const YamlBufmon &bufmon;
+    int seg;
+
+    BufmonSegmentLess(const YamlBufmon &b, int s) : bufmon(b), seg(s) {}
+
+    bool operator()(unsigned int idx, const BufmonSegmentId &key) const
+    {
+        return(bufmon_segment_id(bufmon, idx, seg) < key.id);
+    }
+    bool operator()(const BufmonSegmentId &key, unsigned int idx) const
+    {
+        return(key.id < bufmon_segment_id(bufmon, idx, seg));
+    }
+};
+
+#define BUFMON_WILDCARD     BUFMON_MAX_STRINGS
+
+/* Collects the name_index ranges in [lo, hi) that match ids[seg..]. All
+ * counters in [lo, hi) share their first seg name segments. */
+static void
+query_bufmon(const YamlBufmon &bufmon, const unsigned int *ids, int seg,
+             size_t lo, size_t hi, vector<YamlBufmonRange> &ranges)
+{
+    vector<unsigned int>::const_iterator base = bufmon.name_index.begin();
+    bool constrained = false;
+
+    if (lo >= hi) {
+        return;
+    }
+
+    for (int next = seg; next < BUFMON_NAME_SEGMENTS; next++) {
+        constrained = constrained || ids[next] != BUFMON_WILDCARD;
+    }
+
+    if (!constrained) {
+        // Everything left matches; merge with the previous range if adjacent
+        if (!ranges.empty() &&
+                ranges.back().first + ranges.back().count == lo) {
+            ranges.back().count += hi - lo;
+        } else {
+            YamlBufmonRange range;
+
+            range.first = lo;
+            range.count = hi - lo;
+            ranges.push_back(range);
+        }
+        return;
+    }
+
+    if (ids[seg] == BUFMON_WILDCARD) {
+        // Descend into each group of counters sharing this segment
+        while (lo < hi) {
+            BufmonSegmentId key(bufmon_segment_id(bufmon, base[lo], seg));
+            size_t end = upper_bound(base + lo, base + hi, key,
+                                     BufmonSegmentLess(bufmon, seg)) - base;
+
+            query_bufmon(bufmon, ids, seg + 1, lo, end, ranges);
+            lo = end;
+        }
+        return;
+    }
+
+    pair<vector<unsigned int>::const_iterator,
+         vector<unsigned int>::const_iterator> range;
+
+    range = equal_range(base + lo, base + hi, BufmonSegmentId(ids[seg]),
+                        BufmonSegmentLess(bufmon, seg));
+
+    query_bufmon(bufmon, ids, seg + 1, range.first - base,
+                 range.second - base, ranges);
+}
+
+/* Builds the name and port indexes. Returns false on duplicate names. */
+static bool
+index_bufmon(YamlBufmon &bufmon)
+{
+    size_t count = bufmon.name_key.size();
+
+    bufmon.name_index.clear();
+    bufmon.port_index.clear();
+
+    for (size_t idx = 0; idx < count; idx++) {
+        bufmon.name_index.push_back(idx);
+        if (bufmon.port[idx] >= 0) {
+            bufmon.port_index.push_back(idx);
+        }
+    }
+
+    sort(bufmon.name_index.begin(), bufmon.name_index.end(),
+         BufmonNameLess(bufmon));
+
+    for (size_t idx = 1; idx < count; idx++) {
+        if (bufmon.name_key[bufmon.name_index[idx]] ==
+                bufmon.name_key[bufmon.name_index[idx - 1]]) {
+            unsigned int dup = bufmon.name_index[idx];
+            std::cout << "config-yaml|ERR|Duplicate bufmon counter: "
+                    << bufmon_name_segment(bufmon, dup, 0) << "/"
+                    << bufmon_name_segment(bufmon, dup, 1) << "/"
+                    << bufmon_name_segment(bufmon, dup, 2) << "/"
+                    << bufmon_name_segment(bufmon, dup, 3) << std::endl;
+            return(false);
+        }
+    }
+
+    stable_sort(bufmon.port_index.begin(), bufmon.port_index.end(),
+                BufmonPortLess(bufmon));
+
+    return(true);
+}
+
+/*======*/
+
+void
+init_info_fields(YamlSubsystem *sub)
+{
+    YamlPsuInfo             psu_info;
+
+    YamlLedInfo             led_info;
+
+    // YamlSubsysInfo
+    sub->subsys_info.info = NULL;
+
+    // YamlThermalInfo
+    sub->thermal.number_sensors = 0;
+    sub->thermal.polling_period = 0;
+    sub->thermal.auto_shutdown = 0;
+
+    // YamlPortInfo
+    sub->port_info.number_ports = 0;
+    sub->port_info.max_port_speed = 0;
+    sub->port_info.max_transmission_unit = 0;
+    sub->port_info.max_lag_count = 0;
+    sub->port_info.max_lag_member_count = 0;
+    sub->port_info.l3_port_requires_internal_vlan = 0;
+
+    // YamlFanInfo
+    sub->fan_info.number_fan_frus = 0;
+    sub->fan_info.fans_per_fru = 0;
+    sub->fan_info.fan_speed_control_type = SINGLE;
+    sub->fan_info.fan_speed_control = NULL;
+    sub->fan_info.fan_speed_min = NORMAL;
+    sub->fan_info.fan_speed_settings.slow = '\0';
+    sub->fan_info.fan_speed_settings.normal = '\0';
+    sub->fan_info.fan_speed_settings.medium = '\0';
+    sub->fan_info.fan_speed_settings.fast = '\0';
+    sub->fan_info.fan_speed_settings.max = '\0';
+    sub->fan_info.direction = F2B;
+    sub->fan_info.fan_direction_control = NULL;
+    sub->fan_info.direction_values.f2b = '\0';
+    sub->fan_info.direction_values.b2f = '\0';
+    sub->fan_info.direction_control_values.f2b = '\0';
+    sub->fan_info.direction_control_values.b2f = '\0';
+    sub->fan_info.fan_speed_multiplier = 0;
+    sub->fan_info.fan_led_values.off = '\0';
+    sub->fan_info.fan_led_values.good = '\0';
+    sub->fan_info.fan_led_values.fault = '\0';
+
+    // YamlPsuInfo
+    sub->psu_info.number_psus = 0;
+    sub->psu_info.polling_period = 0;
+
+    // YamlLedInfo
+    sub->led_info.number_leds = 0;
+    sub->led_info.number_types = 0;
+
+    // YamlFruInfo
+    sub->fru_info.country_code = '\0';
+    sub->fru_info.device_version = 0;
+    sub->fru_info.diag_version = '\0';
+    sub->fru_info.label_revision = '\0';
+    sub->fru_info.manufacture_date = '\0';
+    sub->fru_info.manufacturer = '\0';
+    sub->fru_info.num_macs = 0;
+    sub->fru_info.onie_version = '\0';
+    sub->fru_info.part_number = '\0';
+    sub->fru_info.platform_name = '\0';
+    sub->fru_info.product_name = '\0';
+    sub->fru_info.serial_number = '\0';
+    sub->fru_info.service_tag = '\0';
+    sub->fru_info.vendor = '\0';
+    sub->fru_info.base_mac_address = '\0';
+
+    // YamlQosInfo
+    sub->qos_info.trust = NULL;
+    sub->cos_map_table_valid = false;
+    sub->dscp_map_table_valid = false;
+
+    // YamlBufmonInfo
+    sub->bufmon.info.cap_mode_current = false;
+    sub->bufmon.info.cap_mode_peak = false;
+    sub->bufmon.info.cap_snapshot_on_threshold_trigger = false;
+    sub->bufmon.info.cap_threshold_trigger_collection = false;
+}
+
+extern "C" const YamlLedType *
+yaml_get_led_type(YamlConfigHandle handle, const char *subsyst,
+                                    unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if ((size_t)idx >= sub->led_types.size()) {
+        return(NULL);
+    }
+    return(&sub->led_types[idx]);
+}
+
+extern "C" const YamlLedInfo *
+yaml_get_led_info(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    return(&sub->led_info);
+}
+
+extern "C" const YamlLed *
+yaml_get_led(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string sub_str = subsyst;
 
     YamlSubsystem *sub = NULL;
 
@@ -1316,69 +2032,1472 @@ yaml_find_device(YamlConfigHandle handle, const char *subsyst, const char *dev_n
         return(NULL);
     }
 
-    try {
-        return(&sub->device_map.at(name));
-    } catch(...) {
-        return(NULL);
-    }
+    if ((size_t)idx >= sub->leds.size()) {
+        return(NULL);
+    }
+    return(&sub->leds[idx]);
+}
+
+extern "C" int
+yaml_get_led_type_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->led_types.size());
+}
+
+extern "C" int
+yaml_get_led_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->leds.size());
+}
+
+extern "C" const YamlLed *
+yaml_get_leds_array(YamlConfigHandle handle, const char *subsyst,
+                    unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if (sub->leds.empty()) {
+        return(NULL);
+    }
+
+    *count = sub->leds.size();
+    return(&sub->leds[0]);
+}
+
+extern "C" const YamlPsuInfo *
+yaml_get_psu_info(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    return(&sub->psu_info);
+}
+
+extern "C" const YamlFruInfo *
+yaml_get_fru_info(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    return(&sub->fru_info);
+}
+
+extern "C" const YamlPsu *
+yaml_get_psu(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if ((size_t)idx >= sub->psus.size()) {
+        return(NULL);
+    }
+    return(&sub->psus[idx]);
+}
+
+extern "C" int
+yaml_get_psu_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    string sub_str = subsyst;
+
+    YamlSubsystem *sub = NULL;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->psus.size());
+}
+
+extern "C" const YamlPsu *
+yaml_get_psus_array(YamlConfigHandle handle, const char *subsyst,
+                    unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if (sub->psus.empty()) {
+        return(NULL);
+    }
+
+    *count = sub->psus.size();
+    return(&sub->psus[0]);
+}
+
+extern "C" const YamlDevice *
+yaml_find_device(YamlConfigHandle handle, const char *subsyst, const char *dev_name)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    string name = dev_name;
+    string sub_str = subsyst;
+    string::size_type colon = name.find(':');
+
+    YamlSubsystem *sub = NULL;
+
+    // <subsystem>:<device> names a device of another subsystem
+    if (colon != string::npos) {
+        sub_str = name.substr(0, colon);
+        name = name.substr(colon + 1);
+    }
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    try {
+        return(&sub->device_map.at(name));
+    } catch(...) {
+        return(NULL);
+    }
+}
+
+extern "C" const YamlDevice *
+yaml_get_device(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if (idx >= sub->device_map.size()) {
+        return(NULL);
+    }
+
+    map<string, YamlDevice>::iterator it = sub->device_map.begin();
+    advance(it, idx);
+
+    return(&it->second);
+}
+
+extern "C" int
+yaml_get_device_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->device_map.size());
+}
+
+extern "C" const YamlSensor *
+yaml_get_sensor(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if ((size_t)idx >= sub->sensors.size()) {
+        return(NULL);
+    }
+    return(&sub->sensors[idx]);
+}
+
+/* Decodes a port of yaml_parse_ports_lazy() on first use. The document is
+ * released once every port is decoded. Returns false if the entry is
+ * malformed. */
+static bool
+decode_port(YamlSubsystem *sub, size_t idx)
+{
+    bool decoded = true;
+
+    if (sub->port_decoded.empty() ||
+            __atomic_load_n(&sub->port_decoded[idx], __ATOMIC_ACQUIRE)) {
+        return(true);
+    }
+
+    pthread_mutex_lock(&sub->ports_lock);
+
+    if (!sub->port_decoded[idx]) {
+        try {
+            YamlPort port;
+
+            *sub->port_nodes[idx] >> port;
+            sub->ports[idx] = port;
+            __atomic_store_n(&sub->port_decoded[idx], 1, __ATOMIC_RELEASE);
+
+            if (--sub->ports_pending == 0) {
+                release_document(sub->ports_doc);
+                sub->ports_doc = NULL;
+                sub->port_nodes.clear();
+            }
+        } catch (...) {
+            decoded = false;
+        }
+    }
+
+    pthread_mutex_unlock(&sub->ports_lock);
+
+    return(decoded);
+}
+
+extern "C" const YamlPort *
+yaml_get_port(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if ((size_t)idx >= sub->ports.size() || !decode_port(sub, idx)) {
+        return(NULL);
+    }
+    return(&sub->ports[idx]);
+}
+
+extern "C" int
+yaml_get_port_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->ports.size());
+}
+
+extern "C" const YamlPort *
+yaml_get_ports_array(YamlConfigHandle handle, const char *subsyst,
+                     unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if (sub->ports.empty()) {
+        return(NULL);
+    }
+
+    // the array needs every port
+    for (size_t idx = 0; idx < sub->ports.size(); idx++) {
+        if (!decode_port(sub, idx)) {
+            return(NULL);
+        }
+    }
+
+    *count = sub->ports.size();
+    return(&sub->ports[0]);
+}
+
+extern "C" YamlPortInfo *
+yaml_get_port_info(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    return(&sub->port_info);
+}
+
+extern "C" int
+yaml_get_sensor_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->sensors.size());
+}
+
+extern "C" const YamlSensor *
+yaml_get_sensors_array(YamlConfigHandle handle, const char *subsyst,
+                       unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if (sub->sensors.empty()) {
+        return(NULL);
+    }
+
+    *count = sub->sensors.size();
+    return(&sub->sensors[0]);
+}
+
+extern "C" const YamlFanFru *
+yaml_get_fan_fru(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if ((size_t)idx >= sub->fan_frus.size()) {
+        return(NULL);
+    }
+    return(&sub->fan_frus[idx]);
+}
+
+extern "C" int
+yaml_get_fan_fru_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->fan_frus.size());
+}
+
+extern "C" const YamlFanFru *
+yaml_get_fan_frus_array(YamlConfigHandle handle, const char *subsyst,
+                        unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    if (sub->fan_frus.empty()) {
+        return(NULL);
+    }
+
+    *count = sub->fan_frus.size();
+    return(&sub->fan_frus[0]);
+}
+
+extern "C" const YamlFanInfo *
+yaml_get_fan_info(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    return(&sub->fan_info);
+}
+
+extern "C" const YamlThermalInfo *
+yaml_get_thermal_info(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
+    }
+
+    return &sub->thermal;
+}
+
+/*======*/
+/* Parse cache. */
+/*======*/
+struct ParsedDocument {
+    unsigned long long  hash;
+    string              key;        // content, without comment lines
+    size_t              size;       // of the file
+    YAML::Node          doc;        // never changed once cached
+    unsigned int        refs;
+    list<ParsedDocument *>::iterator idle_pos;  // if refs is 0
+};
+
+static pthread_mutex_t parse_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static multimap<unsigned long long, ParsedDocument *> parse_cache;
+static list<ParsedDocument *> parse_cache_idle;    // unused, oldest first
+static YamlParseCacheStats parse_cache_stats;
+
+/* Removes a document from the cache and frees it. Called with the lock
+ * held. */
+static void
+drop_document(ParsedDocument *parsed)
+{
+    multimap<unsigned long long, ParsedDocument *>::iterator it;
+
+    for (it = parse_cache.lower_bound(parsed->hash);
+            it != parse_cache.end() && it->first == parsed->hash; ++it) {
+        if (it->second == parsed) {
+            parse_cache.erase(it);
+            break;
+        }
+    }
+    parse_cache_stats.entries--;
+    parse_cache_stats.bytes -= parsed->size;
+    delete parsed;
+}
+
+/* Returns true if a line starts a literal or folded block scalar, whose
+ * lines starting with '#' are content, not comments */
+static bool
+starts_block_scalar(const string &line)
+{
+    size_t end = line.find_last_not_of(" \t\r");
+
+    if (end == string::npos) {
+        return(false);
+    }
+    if (end > 0 && (line[end] == '-' || line[end] == '+')) {
+        end--;
+    }
+
+    return(line[end] == '|' || line[end] == '>');
+}
+
+/* Returns the cache key of a file: its content without comment-only and
+ * blank lines, which don't change the document. Files with block scalars
+ * are kept whole. */
+static string
+document_key(const string &content)
+{
+    string key;
+    size_t pos = 0;
+
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        string line;
+        size_t first;
+
+        if (end == string::npos) {
+            end = content.size();
+        }
+        line = content.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (starts_block_scalar(line)) {
+            return(content);
+        }
+
+        first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') {
+            continue;
+        }
+
+        key += line;
+        key += '\n';
+    }
+
+    return(key);
+}
+
+/* FNV-1a */
+static unsigned long long
+hash_key(const string &key)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (size_t idx = 0; idx < key.size(); idx++) {
+        hash = (hash ^ (unsigned char)key[idx]) * 1099511628211ULL;
+    }
+
+    return(hash);
+}
+
+/* Returns a cached document with the content of key, taking a reference,
+ * else NULL. Called with the lock held. */
+static ParsedDocument *
+find_document(unsigned long long hash, const string &key)
+{
+    multimap<unsigned long long, ParsedDocument *>::iterator it;
+
+    for (it = parse_cache.lower_bound(hash);
+            it != parse_cache.end() && it->first == hash; ++it) {
+        if (it->second->key == key) {
+            if (it->second->refs++ == 0) {
+                parse_cache_idle.erase(it->second->idle_pos);
+            }
+            return(it->second);
+        }
+    }
+
+    return(NULL);
+}
+
+/* Returns the parsed document of a file, from the cache if a file with the
+ * same content was parsed before, else NULL. Release it with
+ * release_document(). */
+static ParsedDocument *
+acquire_document(const string &file_name)
+{
+    ParsedDocument *parsed;
+    ParsedDocument *cached;
+
+    ifstream fin(file_name.c_str());
+    if (fin.fail()) {
+        return(NULL);
+    }
+
+    string content((istreambuf_iterator<char>(fin)),
+                   istreambuf_iterator<char>());
+    string key = document_key(content);
+    unsigned long long hash = hash_key(key);
+
+    pthread_mutex_lock(&parse_cache_lock);
+    cached = find_document(hash, key);
+    if (cached != NULL) {
+        parse_cache_stats.hits++;
+    } else {
+        parse_cache_stats.misses++;
+    }
+    pthread_mutex_unlock(&parse_cache_lock);
+
+    if (cached != NULL) {
+        return(cached);
+    }
+
+    // parse without the lock, so subsystems are parsed in parallel
+    parsed = new ParsedDocument;
+    parsed->hash = hash;
+    parsed->key = key;
+    parsed->size = content.size();
+    parsed->refs = 1;
+
+    try {
+        istringstream in(content);
+        YAML::Parser parser(in);
+        parser.GetNextDocument(parsed->doc);
+    } catch (...) {
+        pthread_mutex_lock(&parse_cache_lock);
+        parse_cache_stats.parse_errors++;
+        pthread_mutex_unlock(&parse_cache_lock);
+        delete parsed;
+        return(NULL);
+    }
+
+    // another thread may have parsed the same content meanwhile
+    pthread_mutex_lock(&parse_cache_lock);
+    cached = find_document(hash, key);
+    if (cached == NULL) {
+        parse_cache.insert(make_pair(hash, parsed));
+        parse_cache_stats.entries++;
+        parse_cache_stats.bytes += parsed->size;
+    }
+    pthread_mutex_unlock(&parse_cache_lock);
+
+    if (cached != NULL) {
+        delete parsed;
+        return(cached);
+    }
+
+    return(parsed);
+}
+
+static void
+release_document(ParsedDocument *parsed)
+{
+    if (parsed == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&parse_cache_lock);
+    if (--parsed->refs == 0) {
+        parsed->idle_pos = parse_cache_idle.insert(parse_cache_idle.end(),
+                                                   parsed);
+        while (parse_cache_idle.size() > YAML_PARSE_CACHE_MAX_IDLE) {
+            ParsedDocument *oldest = parse_cache_idle.front();
+
+            parse_cache_idle.pop_front();
+            drop_document(oldest);
+        }
+    }
+    pthread_mutex_unlock(&parse_cache_lock);
+}
+
+/* Holds a parsed document for the scope of a parse function */
+class DocumentRef {
+public:
+    DocumentRef(const string &file_name)
+        : m_parsed(acquire_document(file_name)) {}
+    ~DocumentRef() { release_document(m_parsed); }
+    const YAML::Node *get() const
+    {
+        return(m_parsed == NULL ? NULL : &m_parsed->doc);
+    }
+
+private:
+    DocumentRef(const DocumentRef &);
+    DocumentRef &operator=(const DocumentRef &);
+
+    ParsedDocument  *m_parsed;
+};
+
+// Drops the routes through a subsystem while its buses or devices are
+// parsed: once before, and again when the parse returns, since a route
+// resolved in between may have been built from the old maps.
+class RouteInvalidation {
+public:
+    RouteInvalidation(YamlI2cRoutes *routes, const char *subsyst)
+        : m_routes(routes), m_subsyst(subsyst)
+    {
+        yaml_i2c_routes_invalidate(m_routes, m_subsyst);
+    }
+    ~RouteInvalidation() { yaml_i2c_routes_invalidate(m_routes, m_subsyst); }
+
+private:
+    RouteInvalidation(const RouteInvalidation &);
+    RouteInvalidation &operator=(const RouteInvalidation &);
+
+    YamlI2cRoutes   *m_routes;
+    const char      *m_subsyst;
+};
+
+extern "C" void
+yaml_get_parse_cache_stats(YamlParseCacheStats *stats)
+{
+    pthread_mutex_lock(&parse_cache_lock);
+    *stats = parse_cache_stats;
+    pthread_mutex_unlock(&parse_cache_lock);
+}
+
+extern "C" void
+yaml_parse_cache_clear(void)
+{
+    pthread_mutex_lock(&parse_cache_lock);
+    // documents in use, e.g. by lazy ports, stay
+    while (!parse_cache_idle.empty()) {
+        ParsedDocument *oldest = parse_cache_idle.front();
+
+        parse_cache_idle.pop_front();
+        drop_document(oldest);
+    }
+    parse_cache_stats.hits = 0;
+    parse_cache_stats.misses = 0;
+    parse_cache_stats.parse_errors = 0;
+    pthread_mutex_unlock(&parse_cache_lock);
+}
+
+/*======*/
+/* Platform catalog. */
+/*======*/
+typedef struct {
+    string                      manufacturer;
+    string                      product_name;
+    string                      dir;
+    vector<pair<string, string> > files;    // name, filename
+    vector<unsigned long long>  hashes;
+} CatalogEntry;
+
+/* Returns the sorted names of the subdirectories of a directory */
+static vector<string>
+list_dirs(const string &dir_name)
+{
+    vector<string> names;
+    DIR *dir = opendir(dir_name.c_str());
+    struct dirent *entry;
+
+    if (dir == NULL) {
+        return(names);
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        string path = dir_name + '/' + entry->d_name;
+
+        if (entry->d_name[0] != '.' && stat(path.c_str(), &st) == 0 &&
+                S_ISDIR(st.st_mode)) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    sort(names.begin(), names.end());
+
+    return(names);
+}
+
+/* Reads the identity and files of a platform from its manifest. Returns 0
+ * or errno. */
+static int
+scan_manifest(const string &dir, CatalogEntry &entry)
+{
+    DocumentRef ref(dir + '/' + YAML_MANIFEST_FILENAME);
+    if (ref.get() == NULL) {
+        return(EINVAL);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    entry.dir = dir;
+
+    try {
+        const YAML::Node &files = doc["files"];
+
+        doc["manufacturer"] >> entry.manufacturer;
+        doc["product_name"] >> entry.product_name;
+
+        for (size_t idx = 0; idx < files.size(); idx++) {
+            string name;
+            string filename;
+
+            files[idx]["name"] >> name;
+            files[idx]["filename"] >> filename;
+            entry.files.push_back(make_pair(name, filename));
+        }
+    } catch (...) {
+        return(EINVAL);
+    }
+
+    for (size_t idx = 0; idx < entry.files.size(); idx++) {
+        unsigned long long hash;
+        string path = dir + '/' + entry.files[idx].second;
+        int rc = yaml_catalog_hash_file(path.c_str(), &hash);
+
+        if (rc != 0) {
+            return(rc);
+        }
+        entry.hashes.push_back(hash);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_catalog_build(const char *root, const char *index_file)
+{
+    vector<CatalogEntry> entries;
+    vector<YamlCatalogPlatform> platforms;
+    vector<YamlCatalogFile> files;
+    vector<string> vendors;
+    size_t file_idx = 0;
+    struct stat st;
+
+    if (root == NULL || index_file == NULL) {
+        return(EINVAL);
+    }
+    if (stat(root, &st) != 0) {
+        return(errno);
+    }
+
+    vendors = list_dirs(root);
+    for (size_t vendor = 0; vendor < vendors.size(); vendor++) {
+        string vendor_dir = string(root) + '/' + vendors[vendor];
+        vector<string> names = list_dirs(vendor_dir);
+
+        for (size_t idx = 0; idx < names.size(); idx++) {
+            string dir = vendor_dir + '/' + names[idx];
+            string manifest = dir + '/' + YAML_MANIFEST_FILENAME;
+            int rc;
+
+            // not every directory is a platform
+            if (access(manifest.c_str(), F_OK) != 0) {
+                continue;
+            }
+
+            entries.push_back(CatalogEntry());
+            rc = scan_manifest(dir, entries.back());
+            if (rc != 0) {
+                return(rc);
+            }
+        }
+    }
+
+    // the entries are complete, so the pointers into them stay valid
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+        for (size_t file = 0; file < entries[idx].files.size(); file++) {
+            YamlCatalogFile catalog_file;
+
+            catalog_file.name = entries[idx].files[file].first.c_str();
+            catalog_file.filename = entries[idx].files[file].second.c_str();
+            catalog_file.hash = entries[idx].hashes[file];
+            files.push_back(catalog_file);
+        }
+    }
+
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+        YamlCatalogPlatform platform;
+
+        platform.manufacturer = entries[idx].manufacturer.c_str();
+        platform.product_name = entries[idx].product_name.c_str();
+        platform.dir = entries[idx].dir.c_str();
+        platform.file_count = entries[idx].files.size();
+        platform.files = platform.file_count == 0 ? NULL : &files[file_idx];
+        file_idx += platform.file_count;
+        platforms.push_back(platform);
+    }
+
+    return(yaml_catalog_write(index_file,
+                              platforms.empty() ? NULL : &platforms[0],
+                              platforms.size()));
+}
+
+extern "C" int
+yaml_parse_manifest(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // The name of the manifest file is fixed.
+    string file_name = sub->dir_name + YAML_MANIFEST_FILENAME;
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    string str;
+    doc["subsystem_info"] >> str;
+    sub->subsys_info.info = strdup(str.c_str());
+
+    try {
+        doc["files"] >> sub->file_map;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_parse_buses(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // the routes may go through the buses and devices being replaced
+    RouteInvalidation invalidation(priv_hand->i2c_routes, subsyst);
+
+    // Get the name for the devices file
+    yfile = yaml_find_file(handle, subsyst, YAML_DEVICES_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["buses"] >> sub->bus_map;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_parse_devices(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // the routes may go through the buses and devices being replaced
+    RouteInvalidation invalidation(priv_hand->i2c_routes, subsyst);
+
+    // Get the name for the devices file
+    yfile = yaml_find_file(handle, subsyst, YAML_DEVICES_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["devices"] >> sub->device_map;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    try {
+        doc["init"] >> sub->init_ops;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+    // also parse the buses, which must be in the same file
+    return yaml_parse_buses(handle, subsyst);
+}
+
+extern "C" int
+yaml_parse_thermal(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // Get the name for the thermal file
+    yfile = yaml_find_file(handle, subsyst, YAML_THERMAL_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["thermal_info"]["polling_period"] >> sub->thermal.polling_period;
+        doc["thermal_info"]["auto_shutdown"] >> sub->thermal.auto_shutdown;
+        doc["sensors"] >> sub->sensors;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
+}
+
+/* Drops the state of yaml_parse_ports_lazy() */
+static void
+drop_lazy_ports(YamlSubsystem *sub)
+{
+    release_document(sub->ports_doc);
+    sub->ports_doc = NULL;
+    sub->port_nodes.clear();
+    sub->port_decoded.clear();
+    sub->ports_pending = 0;
+}
+
+static int
+parse_ports(YamlConfigHandle handle, const char *subsyst, bool lazy)
+{
+    ParsedDocument *parsed;
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // Get the name for the ports file
+    yfile = yaml_find_file(handle, subsyst, YAML_PORTS_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    parsed = acquire_document(file_name);
+    if (parsed == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = parsed->doc;
+
+    // ports of an earlier lazy parse are placeholders
+    if (sub->ports_doc != NULL) {
+        sub->ports.clear();
+        drop_lazy_ports(sub);
+    }
+
+    try {
+        doc["port_info"] >> sub->port_info;
+
+        if (!lazy) {
+            doc["ports"] >> sub->ports;
+        } else {
+            const YAML::Node &ports = doc["ports"];
+            YamlPort placeholder;
+
+            // only index the entries; yaml_get_port() decodes them
+            memset(&placeholder, 0, sizeof(placeholder));
+            sub->ports.assign(ports.size(), placeholder);
+            sub->port_decoded.assign(ports.size(), 0);
+            for (size_t idx = 0; idx < ports.size(); idx++) {
+                sub->port_nodes.push_back(&ports[idx]);
+            }
+            sub->ports_pending = ports.size();
+        }
+    } catch (YAML::RepresentationException &re) {
+        // placeholders must not pass for decoded ports
+        if (lazy) {
+            sub->ports.clear();
+        }
+        drop_lazy_ports(sub);
+        release_document(parsed);
+        return(-1);
+    } catch (...) {
+        if (lazy) {
+            sub->ports.clear();
+        }
+        drop_lazy_ports(sub);
+        release_document(parsed);
+        return(-1);
+    }
+
+    // the cached document holds the indexed entries
+    if (lazy && sub->ports_pending != 0) {
+        sub->ports_doc = parsed;
+    } else {
+        drop_lazy_ports(sub);
+        release_document(parsed);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_parse_ports(YamlConfigHandle handle, const char *subsyst)
+{
+    return(parse_ports(handle, subsyst, false));
+}
+
+extern "C" int
+yaml_parse_ports_lazy(YamlConfigHandle handle, const char *subsyst)
+{
+    return(parse_ports(handle, subsyst, true));
+}
+
+extern "C" int
+yaml_parse_fans(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // Get the name for the fans file
+    yfile = yaml_find_file(handle, subsyst, YAML_FANS_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["fan_info"] >> sub->fan_info;
+        doc["fan_frus"] >> sub->fan_frus;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_parse_psus(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // Get the name for the power file
+    yfile = yaml_find_file(handle, subsyst, YAML_POWER_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["power_info"] >> sub->psu_info;
+        doc["psus"] >> sub->psus;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_parse_leds(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // Get the name for the leds file
+    yfile = yaml_find_file(handle, subsyst, YAML_LEDS_NAME);
+
+    if (yfile == NULL) {
+        return(0);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["led_info"] >> sub->led_info;
+        doc["led_types"] >> sub->led_types;
+        doc["leds"] >> sub->leds;
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
+}
+
+extern "C" int
+yaml_parse_fru(YamlConfigHandle handle, const char *subsyst)
+{
+    const YamlFile *yfile = NULL;
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_hand->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    // Get the name for the ports file
+    yfile = yaml_find_file(handle, subsyst, YAML_FRU_NAME);
+
+    if (yfile == NULL) {
+        return(-1);
+    }
+
+    string file_name = sub->dir_name + string(yfile->filename);
+
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
+    }
+    const YAML::Node &doc = *ref.get();
+
+    try {
+        doc["fru_info"] >> sub->fru_info;
+    } catch (YAML::KeyNotFound &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
+    }
+
+    return(0);
 }
 
-extern "C" const YamlSensor *
-yaml_get_sensor(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+/*======*/
+/* QOS. */
+/*======*/
+extern "C" int
+yaml_parse_qos(YamlConfigHandle handle, const char *subsyst)
 {
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    const YamlFile *yfile = NULL;
+
+    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_handle->subsystem_map.at(sub_str);
+        sub = priv_hand->subsystem_map.at(sub_str);
     } catch(...) {
-        return(NULL);
+        return(-1);
     }
 
-    if ((size_t)idx >= sub->sensors.size()) {
-        return(NULL);
+    // Get the name for the qos file
+    yfile = yaml_find_file(handle, subsyst, YAML_QOS_NAME);
+
+    if (yfile == NULL) {
+        return(0);
     }
-    return(&sub->sensors[idx]);
-}
 
-extern "C" const YamlPort *
-yaml_get_port(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
-{
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    string file_name = sub->dir_name + string(yfile->filename);
 
-    YamlSubsystem *sub = NULL;
-    string sub_str = subsyst;
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(NULL);
+    DocumentRef ref(file_name);
+    if (ref.get() == NULL) {
+        return(-1);
     }
+    const YAML::Node &doc = *ref.get();
 
-    if ((size_t)idx >= sub->ports.size()) {
-        return(NULL);
+    sub->cos_map_entries.clear();
+    sub->dscp_map_entries.clear();
+    sub->queue_profile_entries.clear();
+    sub->schedule_profile_entries.clear();
+    sub->queue_profiles.clear();
+    sub->schedule_profiles.clear();
+
+    try {
+        doc["qos_info"] >> sub->qos_info;
+        doc["cos_map_entries"] >> sub->cos_map_entries;
+        doc["dscp_map_entries"] >> sub->dscp_map_entries;
+        doc["queue_profile_entries"] >> sub->queue_profile_entries;
+        doc["schedule_profile_entries"] >> sub->schedule_profile_entries;
+
+        if (const YAML::Node *pNode = doc.FindValue("queue_profiles")) {
+            *pNode >> sub->queue_profiles;
+        }
+        if (const YAML::Node *pNode = doc.FindValue("schedule_profiles")) {
+            *pNode >> sub->schedule_profiles;
+        }
+    } catch (YAML::RepresentationException &re) {
+        return(-1);
+    } catch (...) {
+        return(-1);
     }
-    return(&sub->ports[idx]);
-}
 
-extern "C" int
-yaml_get_port_count(YamlConfigHandle handle, const char *subsyst)
-{
-    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    // The flat entry lists make up the profiles named by default_name
+    YamlQueueProfile queue_profile;
+    queue_profile.name = sub->qos_info.default_name;
+    queue_profile.entries = sub->queue_profile_entries;
+    sub->queue_profiles.push_back(queue_profile);
 
-    YamlSubsystem *sub = NULL;
-    string sub_str = subsyst;
-    try {
-        sub = priv_handle->subsystem_map.at(sub_str);
-    } catch(...) {
+    YamlScheduleProfile schedule_profile;
+    schedule_profile.name = sub->qos_info.default_name;
+    schedule_profile.entries = sub->schedule_profile_entries;
+    sub->schedule_profiles.push_back(schedule_profile);
+
+    if (!index_qos_profiles(sub->queue_profiles, sub->queue_profile_map,
+                            "queue") ||
+            !index_qos_profiles(sub->schedule_profiles,
+                                sub->schedule_profile_map, "schedule")) {
         return(-1);
     }
 
-    return(sub->ports.size());
+    sub->cos_map_table_valid = build_qos_map_table(sub->cos_map_entries,
+                                                   sub->cos_map_table,
+                                                   QOS_COS_MAP_SIZE, "COS");
+    sub->dscp_map_table_valid = build_qos_map_table(sub->dscp_map_entries,
+                                                    sub->dscp_map_table,
+                                                    QOS_DSCP_MAP_SIZE, "DSCP");
+
+    return(0);
 }
 
-extern "C" YamlPortInfo *
-yaml_get_port_info(YamlConfigHandle handle, const char *subsyst)
+extern "C" YamlQosInfo *
+yaml_get_qos_info(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -1390,11 +3509,11 @@ yaml_get_port_info(YamlConfigHandle handle, const char *subsyst)
         return(NULL);
     }
 
-    return(&sub->port_info);
+    return(&sub->qos_info);
 }
 
 extern "C" int
-yaml_get_sensor_count(YamlConfigHandle handle, const char *subsyst)
+yaml_get_cos_map_entry_count(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -1406,11 +3525,11 @@ yaml_get_sensor_count(YamlConfigHandle handle, const char *subsyst)
         return(-1);
     }
 
-    return(sub->sensors.size());
+    return(sub->cos_map_entries.size());
 }
 
-extern "C" const YamlFanFru *
-yaml_get_fan_fru(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
+extern "C" int
+yaml_get_dscp_map_entry_count(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -1419,17 +3538,14 @@ yaml_get_fan_fru(YamlConfigHandle handle, const char *subsyst, unsigned int idx)
     try {
         sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(NULL);
+        return(-1);
     }
 
-    if ((size_t)idx >= sub->fan_frus.size()) {
-        return(NULL);
-    }
-    return(&sub->fan_frus[idx]);
+    return(sub->dscp_map_entries.size());
 }
 
 extern "C" int
-yaml_get_fan_fru_count(YamlConfigHandle handle, const char *subsyst)
+yaml_get_schedule_profile_entry_count(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -1441,11 +3557,11 @@ yaml_get_fan_fru_count(YamlConfigHandle handle, const char *subsyst)
         return(-1);
     }
 
-    return(sub->fan_frus.size());
+    return(sub->schedule_profile_entries.size());
 }
 
-extern "C" const YamlFanInfo *
-yaml_get_fan_info(YamlConfigHandle handle, const char *subsyst)
+extern "C" int
+yaml_get_queue_profile_entry_count(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -1454,14 +3570,15 @@ yaml_get_fan_info(YamlConfigHandle handle, const char *subsyst)
     try {
         sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(NULL);
+        return(-1);
     }
 
-    return(&sub->fan_info);
+    return(sub->queue_profile_entries.size());
 }
 
-extern "C" const YamlThermalInfo *
-yaml_get_thermal_info(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlCosMapEntry *
+yaml_get_cos_map_entry(YamlConfigHandle handle,
+                       const char *subsyst, unsigned int idx)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -1473,472 +3590,389 @@ yaml_get_thermal_info(YamlConfigHandle handle, const char *subsyst)
         return(NULL);
     }
 
-    return &sub->thermal;
+    if ((size_t)idx >= sub->cos_map_entries.size()) {
+        return(NULL);
+    }
+    return(&sub->cos_map_entries[idx]);
 }
 
-extern "C" int
-yaml_parse_manifest(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlCosMapEntry *
+yaml_get_cos_map_entries_array(YamlConfigHandle handle, const char *subsyst,
+                               unsigned int *count)
 {
-    YAML::Node doc;
-
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
-    try {
-        sub = priv_hand->subsystem_map.at(sub_str);
-    } catch(...) {
-        return(-1);
-    }
 
-    // The name of the manifest file is fixed.
-    string file_name = sub->dir_name + YAML_MANIFEST_FILENAME;
-
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
-    }
+    *count = 0;
 
     try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
     }
 
-    string str;
-    doc["subsystem_info"] >> str;
-    sub->subsys_info.info = strdup(str.c_str());
-
-    try {
-        doc["files"] >> sub->file_map;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+    if (sub->cos_map_entries.empty()) {
+        return(NULL);
     }
 
-    return(0);
+    *count = sub->cos_map_entries.size();
+    return(&sub->cos_map_entries[0]);
 }
 
-extern "C" int
-yaml_parse_buses(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlDscpMapEntry *
+yaml_get_dscp_map_entry(YamlConfigHandle handle,
+                        const char *subsyst, unsigned int idx)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
+        return(NULL);
     }
 
-    // Get the name for the devices file
-    yfile = yaml_find_file(handle, subsyst, YAML_DEVICES_NAME);
-
-    if (yfile == NULL) {
-        return(0);
+    if ((size_t)idx >= sub->dscp_map_entries.size()) {
+        return(NULL);
     }
+    return(&sub->dscp_map_entries[idx]);
+}
 
-    string file_name = sub->dir_name + string(yfile->filename);
+extern "C" const YamlDscpMapEntry *
+yaml_get_dscp_map_entries_array(YamlConfigHandle handle, const char *subsyst,
+                                unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
-    }
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
 
     try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
     }
 
-    try {
-        doc["buses"] >> sub->bus_map;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+    if (sub->dscp_map_entries.empty()) {
+        return(NULL);
     }
 
-    return(0);
+    *count = sub->dscp_map_entries.size();
+    return(&sub->dscp_map_entries[0]);
 }
 
-extern "C" int
-yaml_parse_devices(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlQosMapValue *
+yaml_get_cos_map_value(YamlConfigHandle handle,
+                       const char *subsyst, unsigned int code_point)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
-    }
-
-    // Get the name for the devices file
-    yfile = yaml_find_file(handle, subsyst, YAML_DEVICES_NAME);
-
-    if (yfile == NULL) {
-        return(0);
-    }
-
-    string file_name = sub->dir_name + string(yfile->filename);
-
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
-    }
-
-    try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
-    }
-
-    try {
-        doc["devices"] >> sub->device_map;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+        return(NULL);
     }
 
-    try {
-        doc["init"] >> sub->init_ops;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+    if (!sub->cos_map_table_valid || code_point >= QOS_COS_MAP_SIZE) {
+        return(NULL);
     }
-    // also parse the buses, which must be in the same file
-    return yaml_parse_buses(handle, subsyst);
+    return(&sub->cos_map_table[code_point]);
 }
 
-extern "C" int
-yaml_parse_thermal(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlQosMapValue *
+yaml_get_dscp_map_value(YamlConfigHandle handle,
+                        const char *subsyst, unsigned int code_point)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
+        return(NULL);
     }
 
-    // Get the name for the thermal file
-    yfile = yaml_find_file(handle, subsyst, YAML_THERMAL_NAME);
-
-    if (yfile == NULL) {
-        return(0);
+    if (!sub->dscp_map_table_valid || code_point >= QOS_DSCP_MAP_SIZE) {
+        return(NULL);
     }
+    return(&sub->dscp_map_table[code_point]);
+}
 
-    string file_name = sub->dir_name + string(yfile->filename);
-
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
-    }
+extern "C" int
+yaml_export_cos_map(YamlConfigHandle handle, const char *subsyst,
+                    YamlQosMapValue *table, unsigned int size)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
     try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
         return(-1);
     }
 
-    try {
-        doc["thermal_info"]["polling_period"] >> sub->thermal.polling_period;
-        doc["thermal_info"]["auto_shutdown"] >> sub->thermal.auto_shutdown;
-        doc["sensors"] >> sub->sensors;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
+    if (!sub->cos_map_table_valid || table == NULL ||
+            size < QOS_COS_MAP_SIZE) {
         return(-1);
     }
 
-    return(0);
+    memcpy(table, sub->cos_map_table, sizeof(sub->cos_map_table));
+
+    return(QOS_COS_MAP_SIZE);
 }
 
 extern "C" int
-yaml_parse_ports(YamlConfigHandle handle, const char *subsyst)
+yaml_export_dscp_map(YamlConfigHandle handle, const char *subsyst,
+                     YamlQosMapValue *table, unsigned int size)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
         return(-1);
     }
 
-    // Get the name for the ports file
-    yfile = yaml_find_file(handle, subsyst, YAML_PORTS_NAME);
-
-    if (yfile == NULL) {
-        return(0);
-    }
-
-    string file_name = sub->dir_name + string(yfile->filename);
-
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
-    }
-
-    try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
+    if (!sub->dscp_map_table_valid || table == NULL ||
+            size < QOS_DSCP_MAP_SIZE) {
         return(-1);
     }
 
-    try {
-        doc["port_info"] >> sub->port_info;
-
-        doc["ports"] >> sub->ports;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
-    }
+    memcpy(table, sub->dscp_map_table, sizeof(sub->dscp_map_table));
 
-    return(0);
+    return(QOS_DSCP_MAP_SIZE);
 }
 
-extern "C" int
-yaml_parse_fans(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlScheduleProfileEntry *
+yaml_get_schedule_profile_entry(YamlConfigHandle handle,
+                                const char *subsyst, unsigned int idx)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
+        return(NULL);
     }
 
-    // Get the name for the fans file
-    yfile = yaml_find_file(handle, subsyst, YAML_FANS_NAME);
-
-    if (yfile == NULL) {
-        return(0);
+    if ((size_t)idx >= sub->schedule_profile_entries.size()) {
+        return(NULL);
     }
+    return(&sub->schedule_profile_entries[idx]);
+}
 
-    string file_name = sub->dir_name + string(yfile->filename);
+extern "C" const YamlQueueProfileEntry *
+yaml_get_queue_profile_entry(YamlConfigHandle handle,
+                             const char *subsyst, unsigned int idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
     }
 
-    try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+    if ((size_t)idx >= sub->queue_profile_entries.size()) {
+        return(NULL);
     }
+    return(&sub->queue_profile_entries[idx]);
+}
+
+extern "C" int
+yaml_get_schedule_profile_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
     try {
-        doc["fan_info"] >> sub->fan_info;
-        doc["fan_frus"] >> sub->fan_frus;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
         return(-1);
     }
 
-    return(0);
+    return(sub->schedule_profiles.size());
 }
 
-extern "C" int
-yaml_parse_psus(YamlConfigHandle handle, const char *subsyst)
+extern "C" const char *
+yaml_get_schedule_profile_name(YamlConfigHandle handle,
+                               const char *subsyst, unsigned int idx)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
+        return(NULL);
     }
 
-    // Get the name for the power file
-    yfile = yaml_find_file(handle, subsyst, YAML_POWER_NAME);
-
-    if (yfile == NULL) {
-        return(0);
+    if ((size_t)idx >= sub->schedule_profiles.size()) {
+        return(NULL);
     }
+    return(sub->schedule_profiles[idx].name.c_str());
+}
 
-    string file_name = sub->dir_name + string(yfile->filename);
+extern "C" const YamlScheduleProfileEntry *
+yaml_get_schedule_profile_entries(YamlConfigHandle handle, const char *subsyst,
+                                  const char *profile, unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
-    }
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
 
     try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
     }
 
-    try {
-        doc["power_info"] >> sub->psu_info;
-        doc["psus"] >> sub->psus;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+    const YamlScheduleProfile *prof =
+        find_qos_profile(sub, sub->schedule_profiles, sub->schedule_profile_map, profile);
+
+    if (prof == NULL || prof->entries.empty()) {
+        return(NULL);
     }
 
-    return(0);
+    *count = prof->entries.size();
+    return(&prof->entries[0]);
 }
 
-extern "C" int
-yaml_parse_leds(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlScheduleProfileEntry *
+yaml_find_schedule_profile_entry(YamlConfigHandle handle, const char *subsyst,
+                                 const char *profile, unsigned int queue)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
-    }
-
-    // Get the name for the leds file
-    yfile = yaml_find_file(handle, subsyst, YAML_LEDS_NAME);
-
-    if (yfile == NULL) {
-        return(0);
+        return(NULL);
     }
 
-    string file_name = sub->dir_name + string(yfile->filename);
+    const YamlScheduleProfile *prof =
+        find_qos_profile(sub, sub->schedule_profiles, sub->schedule_profile_map, profile);
 
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return -1;
+    if (prof == NULL || (size_t)queue >= prof->queue_index.size() ||
+            prof->queue_index[queue] < 0) {
+        return(NULL);
     }
+    return(&prof->entries[prof->queue_index[queue]]);
+}
 
-    try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
-    }
+extern "C" int
+yaml_get_queue_profile_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
     try {
-        doc["led_info"] >> sub->led_info;
-        doc["led_types"] >> sub->led_types;
-        doc["leds"] >> sub->leds;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
         return(-1);
     }
 
-    return(0);
+    return(sub->queue_profiles.size());
 }
 
-extern "C" int
-yaml_parse_fru(YamlConfigHandle handle, const char *subsyst)
+extern "C" const char *
+yaml_get_queue_profile_name(YamlConfigHandle handle,
+                            const char *subsyst, unsigned int idx)
 {
-    YAML::Node doc;
-    const YamlFile *yfile = NULL;
-    YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
-        sub = priv_hand->subsystem_map.at(sub_str);
+        sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(-1);
+        return(NULL);
     }
 
-    // Get the name for the ports file
-    yfile = yaml_find_file(handle, subsyst, YAML_FRU_NAME);
-
-    if (yfile == NULL) {
-        return(-1);
+    if ((size_t)idx >= sub->queue_profiles.size()) {
+        return(NULL);
     }
+    return(sub->queue_profiles[idx].name.c_str());
+}
 
-    string file_name = sub->dir_name + string(yfile->filename);
+extern "C" const YamlQueueProfileEntry *
+yaml_get_queue_profile_entries(YamlConfigHandle handle, const char *subsyst,
+                               const char *profile, unsigned int *count)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
-    ifstream fin(file_name.c_str());
-    if (fin.fail()) {
-        return(-1);
-    }
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    *count = 0;
 
     try {
-        YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
-    } catch (YAML::ParserException &pe) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
     }
 
+    const YamlQueueProfile *prof =
+        find_qos_profile(sub, sub->queue_profiles, sub->queue_profile_map, profile);
+
+    if (prof == NULL || prof->entries.empty()) {
+        return(NULL);
+    }
+
+    *count = prof->entries.size();
+    return(&prof->entries[0]);
+}
+
+extern "C" const YamlQueueProfileEntry *
+yaml_find_queue_profile_entry(YamlConfigHandle handle, const char *subsyst,
+                              const char *profile, unsigned int queue)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
     try {
-        doc["fru_info"] >> sub->fru_info;
-    } catch (YAML::KeyNotFound &re) {
-        return(-1);
-    } catch (...) {
-        return(-1);
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(NULL);
     }
 
-    return(0);
+    const YamlQueueProfile *prof =
+        find_qos_profile(sub, sub->queue_profiles, sub->queue_profile_map, profile);
+
+    if (prof == NULL || (size_t)queue >= prof->queue_index.size() ||
+            prof->queue_index[queue] < 0) {
+        return(NULL);
+    }
+    return(&prof->entries[prof->queue_index[queue]]);
 }
 
-/*======*/
-/* QOS. */
-/*======*/
 extern "C" int
-yaml_parse_qos(YamlConfigHandle handle, const char *subsyst)
+yaml_parse_bufmon(YamlConfigHandle handle, const char *subsyst)
 {
-    YAML::Node doc;
     const YamlFile *yfile = NULL;
 
     YamlConfigHandlePrivate *priv_hand = (YamlConfigHandlePrivate *)handle;
@@ -1951,8 +3985,8 @@ yaml_parse_qos(YamlConfigHandle handle, const char *subsyst)
         return(-1);
     }
 
-    // Get the name for the qos file
-    yfile = yaml_find_file(handle, subsyst, YAML_QOS_NAME);
+    // Get the name for the buffer monitoring file
+    yfile = yaml_find_file(handle, subsyst, YAML_BUFMON_NAME);
 
     if (yfile == NULL) {
         return(0);
@@ -1965,32 +3999,35 @@ yaml_parse_qos(YamlConfigHandle handle, const char *subsyst)
         return -1;
     }
 
+    // Parse into a new table, so a bad file leaves the old one in place
+    YamlBufmon bufmon;
+    bufmon.info.cap_mode_current = false;
+    bufmon.info.cap_mode_peak = false;
+    bufmon.info.cap_snapshot_on_threshold_trigger = false;
+    bufmon.info.cap_threshold_trigger_collection = false;
+
+    BufmonEventHandler handler(bufmon);
+
     try {
         YAML::Parser parser(fin);
-        parser.GetNextDocument(doc);
+        parser.HandleNextDocument(handler);
     } catch (YAML::ParserException &pe) {
         return(-1);
     } catch (...) {
         return(-1);
     }
 
-    try {
-        doc["qos_info"] >> sub->qos_info;
-        doc["cos_map_entries"] >> sub->cos_map_entries;
-        doc["dscp_map_entries"] >> sub->dscp_map_entries;
-        doc["queue_profile_entries"] >> sub->queue_profile_entries;
-        doc["schedule_profile_entries"] >> sub->schedule_profile_entries;
-    } catch (YAML::RepresentationException &re) {
-        return(-1);
-    } catch (...) {
+    if (handler.failed() || !index_bufmon(bufmon)) {
         return(-1);
     }
 
+    swap(sub->bufmon, bufmon);
+
     return(0);
 }
 
-extern "C" YamlQosInfo *
-yaml_get_qos_info(YamlConfigHandle handle, const char *subsyst)
+extern "C" const YamlBufmonInfo *
+yaml_get_bufmon_info(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -2002,11 +4039,11 @@ yaml_get_qos_info(YamlConfigHandle handle, const char *subsyst)
         return(NULL);
     }
 
-    return(&sub->qos_info);
+    return(&sub->bufmon.info);
 }
 
 extern "C" int
-yaml_get_cos_map_entry_count(YamlConfigHandle handle, const char *subsyst)
+yaml_get_bufmon_counter_count(YamlConfigHandle handle, const char *subsyst)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -2018,11 +4055,12 @@ yaml_get_cos_map_entry_count(YamlConfigHandle handle, const char *subsyst)
         return(-1);
     }
 
-    return(sub->cos_map_entries.size());
+    return(sub->bufmon.name_key.size());
 }
 
 extern "C" int
-yaml_get_dscp_map_entry_count(YamlConfigHandle handle, const char *subsyst)
+yaml_get_bufmon_counter(YamlConfigHandle handle, const char *subsyst,
+                        unsigned int idx, YamlBufmonCounter *counter)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -2034,11 +4072,30 @@ yaml_get_dscp_map_entry_count(YamlConfigHandle handle, const char *subsyst)
         return(-1);
     }
 
-    return(sub->dscp_map_entries.size());
+    const YamlBufmon &bufmon = sub->bufmon;
+
+    if ((size_t)idx >= bufmon.name_key.size()) {
+        return(-1);
+    }
+
+    for (int seg = 0; seg < BUFMON_NAME_SEGMENTS; seg++) {
+        counter->name[seg] = bufmon_name_segment(bufmon, idx, seg);
+    }
+    counter->counter_name = bufmon.strings[bufmon.counter_name[idx]].c_str();
+    counter->port = bufmon.port[idx];
+    counter->priority_group = bufmon.priority_group[idx];
+    counter->queue = bufmon.queue[idx];
+    counter->service_pool = bufmon.service_pool[idx];
+    counter->hw_unit_id = bufmon.hw_unit_id[idx];
+    counter->trigger_threshold = bufmon.trigger_threshold[idx];
+    counter->enabled = bufmon.enabled[idx];
+
+    return(0);
 }
 
 extern "C" int
-yaml_get_schedule_profile_entry_count(YamlConfigHandle handle, const char *subsyst)
+yaml_get_bufmon_counter_name(YamlConfigHandle handle, const char *subsyst,
+                             unsigned int idx, char *buf, unsigned int size)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -2050,13 +4107,30 @@ yaml_get_schedule_profile_entry_count(YamlConfigHandle handle, const char *subsy
         return(-1);
     }
 
-    return(sub->schedule_profile_entries.size());
+    const YamlBufmon &bufmon = sub->bufmon;
+
+    if ((size_t)idx >= bufmon.name_key.size()) {
+        return(-1);
+    }
+
+    int len = snprintf(buf, size, "%s/%s/%s/%s",
+                       bufmon_name_segment(bufmon, idx, 0),
+                       bufmon_name_segment(bufmon, idx, 1),
+                       bufmon_name_segment(bufmon, idx, 2),
+                       bufmon_name_segment(bufmon, idx, 3));
+
+    if (len < 0 || (unsigned int)len >= size) {
+        return(-1);
+    }
+    return(len);
 }
 
 extern "C" int
-yaml_get_queue_profile_entry_count(YamlConfigHandle handle, const char *subsyst)
+yaml_find_bufmon_counter(YamlConfigHandle handle, const char *subsyst,
+                         const char *name)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    unsigned long long key;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
@@ -2066,72 +4140,152 @@ yaml_get_queue_profile_entry_count(YamlConfigHandle handle, const char *subsyst)
         return(-1);
     }
 
-    return(sub->queue_profile_entries.size());
+    YamlBufmon &bufmon = sub->bufmon;
+
+    if (name == NULL || !bufmon_name_key(bufmon, name, false, key)) {
+        return(-1);
+    }
+
+    vector<unsigned int>::const_iterator it =
+        lower_bound(bufmon.name_index.begin(), bufmon.name_index.end(), key,
+                    BufmonNameLess(bufmon));
+
+    if (it == bufmon.name_index.end() || bufmon.name_key[*it] != key) {
+        return(-1);
+    }
+    return(*it);
 }
 
-extern "C" const YamlCosMapEntry *
-yaml_get_cos_map_entry(YamlConfigHandle handle,
-                       const char *subsyst, unsigned int idx)
+extern "C" const unsigned int *
+yaml_get_bufmon_port_counters(YamlConfigHandle handle, const char *subsyst,
+                              int port, int priority_group,
+                              unsigned int *count)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
+
+    *count = 0;
+
     try {
         sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
         return(NULL);
     }
 
-    if ((size_t)idx >= sub->cos_map_entries.size()) {
+    const YamlBufmon &bufmon = sub->bufmon;
+    pair<vector<unsigned int>::const_iterator,
+         vector<unsigned int>::const_iterator> range;
+
+    range = equal_range(bufmon.port_index.begin(), bufmon.port_index.end(),
+                        BufmonPortKey(port, priority_group),
+                        BufmonPortLess(bufmon));
+
+    if (range.first == range.second) {
         return(NULL);
     }
-    return(&sub->cos_map_entries[idx]);
+
+    *count = range.second - range.first;
+    return(&*range.first);
 }
 
-extern "C" const YamlDscpMapEntry *
-yaml_get_dscp_map_entry(YamlConfigHandle handle,
-                        const char *subsyst, unsigned int idx)
+extern "C" const unsigned int *
+yaml_get_bufmon_sorted_counters(YamlConfigHandle handle, const char *subsyst,
+                                unsigned int *count)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
+
+    *count = 0;
+
     try {
         sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
         return(NULL);
     }
 
-    if ((size_t)idx >= sub->dscp_map_entries.size()) {
+    if (sub->bufmon.name_index.empty()) {
         return(NULL);
     }
-    return(&sub->dscp_map_entries[idx]);
+
+    *count = sub->bufmon.name_index.size();
+    return(&sub->bufmon.name_index[0]);
 }
 
-extern "C" const YamlScheduleProfileEntry *
-yaml_get_schedule_profile_entry(YamlConfigHandle handle,
-                                const char *subsyst, unsigned int idx)
+extern "C" int
+yaml_query_bufmon_counters(YamlConfigHandle handle, const char *subsyst,
+                           const char *pattern, YamlBufmonRange *ranges,
+                           unsigned int max_ranges)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    unsigned int ids[BUFMON_NAME_SEGMENTS];
+    vector<YamlBufmonRange> found;
 
     YamlSubsystem *sub = NULL;
     string sub_str = subsyst;
     try {
         sub = priv_handle->subsystem_map.at(sub_str);
     } catch(...) {
-        return(NULL);
+        return(-1);
     }
 
-    if ((size_t)idx >= sub->schedule_profile_entries.size()) {
-        return(NULL);
+    const YamlBufmon &bufmon = sub->bufmon;
+
+    if (pattern == NULL) {
+        return(-1);
     }
-    return(&sub->schedule_profile_entries[idx]);
+
+    // Translate the pattern into string ids, one per segment
+    string str = pattern;
+    size_t start = 0;
+    bool unknown = false;
+
+    for (int seg = 0; seg < BUFMON_NAME_SEGMENTS; seg++) {
+        ids[seg] = BUFMON_WILDCARD;
+    }
+
+    for (int seg = 0; start <= str.size(); seg++) {
+        size_t end = str.find('/', start);
+        string segment = str.substr(start, end == string::npos ?
+                                           string::npos : end - start);
+
+        if (seg >= BUFMON_NAME_SEGMENTS || segment.empty()) {
+            return(-1);
+        }
+
+        if (segment != "*") {
+            map<string, unsigned int>::const_iterator it =
+                                        bufmon.string_map.find(segment);
+            if (it == bufmon.string_map.end()) {
+                unknown = true;
+            } else {
+                ids[seg] = it->second;
+            }
+        }
+
+        if (end == string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    if (!unknown) {
+        query_bufmon(bufmon, ids, 0, 0, bufmon.name_index.size(), found);
+    }
+
+    for (size_t idx = 0; idx < found.size() && idx < max_ranges; idx++) {
+        ranges[idx] = found[idx];
+    }
+
+    return(found.size());
 }
 
-extern "C" const YamlQueueProfileEntry *
-yaml_get_queue_profile_entry(YamlConfigHandle handle,
-                             const char *subsyst, unsigned int idx)
+extern "C" YamlBufmonEngine *
+yaml_new_bufmon_engine(YamlConfigHandle handle, const char *subsyst,
+                       YamlBufmonMode mode)
 {
     YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
 
@@ -2143,10 +4297,38 @@ yaml_get_queue_profile_entry(YamlConfigHandle handle,
         return(NULL);
     }
 
-    if ((size_t)idx >= sub->queue_profile_entries.size()) {
+    const YamlBufmon &bufmon = sub->bufmon;
+    size_t count = bufmon.trigger_threshold.size();
+
+    // vector<bool> is packed, so copy the flags into a plain array
+    bool *enabled = new bool[count + 1];
+    for (size_t idx = 0; idx < count; idx++) {
+        enabled[idx] = bufmon.enabled[idx];
+    }
+
+    YamlBufmonEngine *engine = bufmon_engine_new(count,
+                                    count ? &bufmon.trigger_threshold[0] : NULL,
+                                    enabled, mode);
+    delete [] enabled;
+
+    return(engine);
+}
+
+extern "C" YamlThermalEngine *
+yaml_new_thermal_engine(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
         return(NULL);
     }
-    return(&sub->queue_profile_entries[idx]);
+
+    return(thermal_engine_new(sub->sensors.size(),
+                              sub->sensors.empty() ? NULL : &sub->sensors[0]));
 }
 /*======*/
 /*======*/
@@ -2156,9 +4338,45 @@ yaml_new_config_handle(void)
 {
     YamlConfigHandlePrivate *handle = new YamlConfigHandlePrivate;
 
+    handle->i2c_backend = NULL;
+    handle->i2c_stats = yaml_i2c_stats_new();
+    handle->i2c_routes = yaml_i2c_routes_new();
+
     return((YamlConfigHandle)handle);
 }
 
+extern "C" void
+yaml_set_i2c_backend(YamlConfigHandle handle, const YamlI2cBackend *backend)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    priv_handle->i2c_backend = backend;
+}
+
+extern "C" const YamlI2cBackend *
+yaml_get_i2c_backend(YamlConfigHandle handle)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    return(priv_handle->i2c_backend);
+}
+
+extern "C" YamlI2cStats *
+yaml_get_i2c_stats(YamlConfigHandle handle)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    return(priv_handle->i2c_stats);
+}
+
+extern "C" YamlI2cRoutes *
+yaml_get_i2c_routes(YamlConfigHandle handle)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+
+    return(priv_handle->i2c_routes);
+}
+
 extern "C" int
 yaml_add_subsystem(YamlConfigHandle handle, const char *subsyst,
                                                 const char *dir_name)
@@ -2175,6 +4393,10 @@ yaml_add_subsystem(YamlConfigHandle handle, const char *subsyst,
 
     priv_hand->subsystem_map[sub_str] = sub;
 
+    sub->ports_doc = NULL;
+    sub->ports_pending = 0;
+    pthread_mutex_init(&sub->ports_lock, NULL);
+
     init_info_fields(sub);
 
     string str = dir_name;
@@ -2274,20 +4496,241 @@ yaml_init_devices(YamlConfigHandle handle, const char *subsystem)
         return -1;
     }
 
-    for (size_t idx = 0; idx < sub->init_ops.size(); idx++) {
-        int rc;
-        i2c_op **ops = (i2c_op **)malloc(sizeof(i2c_op *) * 2);
-        i2c_op op = sub->init_ops.at(idx);
-        const YamlDevice *device;
-        ops[0] = &op;
-        ops[1] = NULL;
+    if (sub->init_ops.empty()) {
+        sub->init_op_status.clear();
+        return (0);
+    }
+
+    // the list is copied for the mutable ops argument only; the copies
+    // share their data buffers with the config
+    vector<i2c_op> ops = sub->init_ops;
+    vector<int> status(ops.size(), 0);
+
+    // an init op may enable a device on another adapter, so keep the order
+    int rc = i2c_execute_list_ordered(handle, subsystem, &ops[0], ops.size(),
+                                      &status[0]);
+
+    sub->init_op_status.swap(status);
+
+    return (rc);
+}
+
+extern "C" int
+yaml_get_init_op_count(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    return(sub->init_ops.size());
+}
+
+extern "C" int
+yaml_get_init_op_status(YamlConfigHandle handle, const char *subsyst, size_t idx)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    YamlSubsystem *sub = NULL;
+    string sub_str = subsyst;
+
+    try {
+        sub = priv_handle->subsystem_map.at(sub_str);
+    } catch(...) {
+        return(-1);
+    }
+
+    if (idx >= sub->init_op_status.size()) {
+        return(-1);
+    }
+
+    return(sub->init_op_status[idx]);
+}
+
+// The subsystems of one yaml_init_subsystems() call. Workers take the next
+// subsystem from the shared index until all of them have been done, first
+// to parse them, then to initialize their devices.
+struct SubsystemInitWork {
+    YamlConfigHandle            handle;
+    YamlSubsystemInitResult     *results;
+    unsigned int                count;
+    unsigned int                next;
+    bool                        init;       // else parse
+    pthread_mutex_t             lock;
+};
+
+static unsigned long long
+elapsed_usec(const struct timespec &start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return((now.tv_sec - start.tv_sec) * 1000000ULL +
+           (now.tv_nsec - start.tv_nsec) / 1000);
+}
+
+// Description files parsed by yaml_init_subsystems(), if in the manifest
+static const struct {
+    const char  *name;
+    int         (*parse)(YamlConfigHandle handle, const char *subsyst);
+} subsystem_parse_fns[] = {
+    { YAML_DEVICES_NAME, yaml_parse_devices },
+    { YAML_THERMAL_NAME, yaml_parse_thermal },
+    { YAML_PORTS_NAME, yaml_parse_ports },
+    { YAML_FANS_NAME, yaml_parse_fans },
+    { YAML_POWER_NAME, yaml_parse_psus },
+    { YAML_LEDS_NAME, yaml_parse_leds },
+    { YAML_FRU_NAME, yaml_parse_fru },
+    { YAML_QOS_NAME, yaml_parse_qos },
+    { YAML_BUFMON_NAME, yaml_parse_bufmon },
+};
+
+static void
+parse_subsystem(YamlConfigHandle handle, YamlSubsystemInitResult *result)
+{
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    result->parse_rc = 0;
+    for (size_t idx = 0;
+            idx < sizeof(subsystem_parse_fns) / sizeof(subsystem_parse_fns[0]);
+            idx++) {
+        if (yaml_find_file(handle, result->subsyst,
+                           subsystem_parse_fns[idx].name) == NULL) {
+            continue;
+        }
+        if (subsystem_parse_fns[idx].parse(handle, result->subsyst) != 0) {
+            result->parse_rc = -1;
+            break;
+        }
+    }
+    result->parse_usec = elapsed_usec(start);
+}
+
+static void
+init_subsystem(YamlConfigHandle handle, YamlSubsystemInitResult *result)
+{
+    struct timespec start;
+
+    // devices are not touched when their description failed to parse
+    if (result->parse_rc != 0) {
+        result->init_rc = -1;
+        result->init_usec = 0;
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    result->init_rc = yaml_init_devices(handle, result->subsyst);
+    result->init_usec = elapsed_usec(start);
+}
+
+static void *
+subsystem_init_worker(void *arg)
+{
+    SubsystemInitWork *work = (SubsystemInitWork *)arg;
+
+    for (;;) {
+        unsigned int idx;
+
+        pthread_mutex_lock(&work->lock);
+        idx = work->next++;
+        pthread_mutex_unlock(&work->lock);
+
+        if (idx >= work->count) {
+            break;
+        }
+
+        if (work->init) {
+            init_subsystem(work->handle, &work->results[idx]);
+        } else {
+            parse_subsystem(work->handle, &work->results[idx]);
+        }
+    }
+
+    return(NULL);
+}
+
+// Runs the work on the calling thread and up to workers - 1 others
+static void
+run_subsystem_workers(SubsystemInitWork *work, unsigned int workers)
+{
+    vector<pthread_t> threads;
+
+    work->next = 0;
+
+    for (unsigned int idx = 1; idx < workers; idx++) {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, subsystem_init_worker, work) != 0) {
+            std::cout << "config-yaml|ERR|yaml_init_subsystems: " <<
+                "unable to start worker " << idx << std::endl;
+            break;
+        }
+        threads.push_back(thread);
+    }
+
+    subsystem_init_worker(work);
+
+    for (size_t idx = 0; idx < threads.size(); idx++) {
+        pthread_join(threads[idx], NULL);
+    }
+}
+
+extern "C" int
+yaml_init_subsystems(YamlConfigHandle handle, unsigned int workers,
+                     YamlSubsystemInitResult *results, unsigned int max_results)
+{
+    YamlConfigHandlePrivate *priv_handle = (YamlConfigHandlePrivate *)handle;
+    vector<YamlSubsystemInitResult> all;
+    SubsystemInitWork work;
+
+    if (handle == NULL || (results == NULL && max_results != 0)) {
+        return(-1);
+    }
+
+    // the parse functions only modify their own subsystem, so the map
+    // itself is read-only while the workers run. Routes read the devices
+    // of parent subsystems, so every subsystem is parsed before any
+    // devices are initialized.
+    for (map<string, YamlSubsystem *>::iterator it =
+                priv_handle->subsystem_map.begin();
+            it != priv_handle->subsystem_map.end(); it++) {
+        YamlSubsystemInitResult result;
+
+        memset(&result, 0, sizeof(result));
+        result.subsyst = it->first.c_str();
+        all.push_back(result);
+    }
+
+    if (all.empty()) {
+        return(0);
+    }
+
+    if (workers == 0 || workers > all.size()) {
+        workers = all.size();
+    }
+
+    work.handle = handle;
+    work.results = &all[0];
+    work.count = all.size();
+    pthread_mutex_init(&work.lock, NULL);
 
-        device = yaml_find_device(handle, subsystem, op.device);
+    work.init = false;
+    run_subsystem_workers(&work, workers);
+    work.init = true;
+    run_subsystem_workers(&work, workers);
 
-        rc = i2c_execute(handle, subsystem, device, ops);
+    pthread_mutex_destroy(&work.lock);
 
-        free(ops);
+    for (size_t idx = 0; idx < all.size() && idx < max_results; idx++) {
+        results[idx] = all[idx];
     }
 
-    return (0);
+    return(all.size());
 }
@@ -0,0 +1,273 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Module EEPROM cache. The 256 byte EEPROM page of each pluggable port's
+ * module_eeprom device is split into a static region (identity and vendor
+ * data) and a diagnostic region (monitors and flags):
+ *  - SFP+ (SFF-8472): A0h is all static. The A2h diagnostics are at another
+ *    address, which devices.yaml doesn't describe.
+ *  - QSFP+ and QSFP28 (SFF-8436/8636): bytes 0-127 are diagnostic, the
+ *    upper page 00h at 128-255 is static.
+ * The static region is read once per presence generation of the port. The
+ * generation changes when the module presence toggles or the port is
+ * invalidated, e.g. after a module reset. The diagnostic region is read
+ * again when it is older than diag_refresh_ms.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config-yaml.h"
+
+#define EEPROM_PAGE_SIZE        256
+#define EEPROM_UPPER_PAGE       128
+
+typedef struct {
+    unsigned int        start;
+    unsigned int        end;
+    bool                diagnostic;
+    bool                valid;
+    unsigned long long  read_ms;
+} eeprom_region;
+
+typedef struct {
+    const char          *device;        /* NULL if not pluggable */
+    unsigned int        generation;
+    eeprom_region       regions[2];
+    unsigned int        region_count;
+    unsigned char       data[EEPROM_PAGE_SIZE];
+} eeprom_port;
+
+struct YamlEepromCache {
+    YamlConfigHandle    handle;
+    char                *subsyst;
+    unsigned int        diag_refresh_ms;
+    eeprom_port         *ports;
+    unsigned int        port_count;
+    pthread_mutex_t     lock;
+};
+
+static unsigned long long
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+
+static void
+add_region(eeprom_port *port, unsigned int start, unsigned int end,
+           bool diagnostic)
+{
+    eeprom_region *region = &port->regions[port->region_count++];
+
+    region->start = start;
+    region->end = end;
+    region->diagnostic = diagnostic;
+}
+
+YamlEepromCache *
+yaml_eeprom_cache_new(YamlConfigHandle handle, const char *subsyst,
+                      unsigned int diag_refresh_ms)
+{
+    YamlEepromCache *cache;
+    const YamlPort *ports;
+    unsigned int count;
+    unsigned int idx;
+
+    if (handle == NULL || subsyst == NULL) {
+        return(NULL);
+    }
+
+    ports = yaml_get_ports_array(handle, subsyst, &count);
+    if (ports == NULL) {
+        return(NULL);
+    }
+
+    cache = (YamlEepromCache *)calloc(1, sizeof(YamlEepromCache));
+    if (cache == NULL) {
+        return(NULL);
+    }
+
+    cache->handle = handle;
+    cache->subsyst = strdup(subsyst);
+    cache->diag_refresh_ms = diag_refresh_ms;
+    cache->port_count = count;
+    cache->ports = (eeprom_port *)calloc(count, sizeof(eeprom_port));
+    if (cache->subsyst == NULL || cache->ports == NULL) {
+        free(cache->ports);
+        free(cache->subsyst);
+        free(cache);
+        return(NULL);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        eeprom_port *port = &cache->ports[idx];
+
+        if (!ports[idx].pluggable || ports[idx].module_eeprom == NULL ||
+                ports[idx].connector == NULL) {
+            continue;
+        }
+
+        port->device = ports[idx].module_eeprom;
+
+        if (strcmp(ports[idx].connector, QSFPP) == 0 ||
+                strcmp(ports[idx].connector, QSFP28) == 0) {
+            add_region(port, 0, EEPROM_UPPER_PAGE, true);
+            add_region(port, EEPROM_UPPER_PAGE, EEPROM_PAGE_SIZE, false);
+        } else {
+            add_region(port, 0, EEPROM_PAGE_SIZE, false);
+        }
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return(cache);
+}
+
+void
+yaml_eeprom_cache_free(YamlEepromCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->ports);
+    free(cache->subsyst);
+    free(cache);
+}
+
+/* Reads a region if it isn't cached. Called with the lock held. */
+static int
+load_region(YamlEepromCache *cache, eeprom_port *port, eeprom_region *region,
+            unsigned long long now)
+{
+    int rc;
+
+    if (region->valid && (!region->diagnostic ||
+                          (cache->diag_refresh_ms != 0 &&
+                           now - region->read_ms < cache->diag_refresh_ms))) {
+        return(0);
+    }
+
+    rc = yaml_register_read_block(cache->handle, cache->subsyst,
+                                  port->device, region->start,
+                                  &port->data[region->start],
+                                  region->end - region->start);
+
+    region->valid = (rc == 0);
+    region->read_ms = now;
+
+    return(rc);
+}
+
+int
+yaml_eeprom_read(YamlEepromCache *cache, unsigned int port_idx,
+                 unsigned int offset, unsigned int length,
+                 unsigned char *data)
+{
+    unsigned long long now = now_ms();
+    eeprom_port *port;
+    unsigned int idx;
+    int rc = 0;
+
+    if (cache == NULL || data == NULL || port_idx >= cache->port_count ||
+            length == 0 || offset + length > EEPROM_PAGE_SIZE) {
+        return(EINVAL);
+    }
+
+    port = &cache->ports[port_idx];
+    if (port->device == NULL) {
+        return(EINVAL);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    // only the regions the caller asked for are read
+    for (idx = 0; idx < port->region_count && rc == 0; idx++) {
+        eeprom_region *region = &port->regions[idx];
+
+        if (offset < region->end && offset + length > region->start) {
+            rc = load_region(cache, port, region, now);
+        }
+    }
+
+    if (rc == 0) {
+        memcpy(data, &port->data[offset], length);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return(rc);
+}
+
+void
+yaml_eeprom_invalidate(YamlEepromCache *cache, unsigned int port_idx)
+{
+    eeprom_port *port;
+    unsigned int idx;
+
+    if (cache == NULL || port_idx >= cache->port_count) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    port = &cache->ports[port_idx];
+    port->generation++;
+    for (idx = 0; idx < port->region_count; idx++) {
+        port->regions[idx].valid = false;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void
+yaml_eeprom_presence_changed(YamlEepromCache *cache,
+                             const YamlPresenceEdge *edges, unsigned int count)
+{
+    unsigned int idx;
+
+    if (edges == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        yaml_eeprom_invalidate(cache, edges[idx].port);
+    }
+}
+
+unsigned int
+yaml_eeprom_get_generation(YamlEepromCache *cache, unsigned int port_idx)
+{
+    unsigned int generation;
+
+    if (cache == NULL || port_idx >= cache->port_count) {
+        return(0);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    generation = cache->ports[port_idx].generation;
+    pthread_mutex_unlock(&cache->lock);
+
+    return(generation);
+}
@@ -20,11 +20,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
-#include <sys/file.h>
+#include <pthread.h>
 
 #include <linux/i2c-dev-user.h>
 
+#ifndef I2C_RDRW_IOCTL_MAX_MSGS
+#define I2C_RDRW_IOCTL_MAX_MSGS 42
+#endif
+
 #include "config-yaml.h"
 
 static int
@@ -39,131 +44,472 @@ count_ops(i2c_op **ops)
     return(count);
 }
 
+/* Performs one command on an SMBus adapter. Returns 0 or errno. */
 static int
-count_post(YamlConfigHandle *handle, const char *subsyst, const YamlDevice *dev)
+smbus_execute_cmd(int fd, const YamlDevice *dev, i2c_op *cmd)
 {
-    int count = 0;
+    int rc;
+
+    rc = ioctl(fd, I2C_SLAVE, (long)dev->address);
 
-    if (dev == NULL || dev->post == NULL) {
-        return(0);
+    if (rc < 0) {
+        return errno;
     }
 
-    count += count_ops(dev->post);
+    if (cmd->direction) {
+        // write
+        if (1 == cmd->byte_count) {
+            long data;
+            data = (long)cmd->data[0];
+            rc = i2c_smbus_write_byte_data(
+                    fd,
+                    cmd->register_address,
+                    data);
+            if (rc < 0) {
+                return errno;
+            }
+        } else if (2 == cmd->byte_count) {
+            long data;
+            data = (long)(*(unsigned short *)cmd->data);
+            rc = i2c_smbus_write_word_data(
+                    fd,
+                    cmd->register_address,
+                    data);
+            if (rc < 0) {
+                return errno;
+            }
+        } else {
+            // NOT IMPLEMENTED
+            return EINVAL;
+        }
+    } else {
+        // read
+        if (1 == cmd->byte_count) {
+            long data;
+            data = i2c_smbus_read_byte_data(
+                        fd,
+                        cmd->register_address);
+            if (data < 0) {
+                return errno;
+            } else {
+                cmd->data[0] = (unsigned char)data;
+            }
+        } else if (2 == cmd->byte_count) {
+            long data;
+            data = i2c_smbus_read_word_data(
+                        fd,
+                        cmd->register_address);
+            if (data < 0) {
+                return errno;
+            } else {
+                *(unsigned short *)cmd->data = (unsigned short)data;
+            }
+        } else {
+            size_t remaining = cmd->byte_count;
+            while (remaining != 0) {
+                unsigned char *buffer;
+                long data;
+                size_t count = remaining;
+                size_t offset = (cmd->byte_count - remaining);
+
+                if (count > 1) {
+                    count = 1;
+                }
 
-    if (count != 0) {
-        dev = yaml_find_device(handle, subsyst, dev->post[0]->device);
-        count += count_post(handle, subsyst, dev);
+                buffer = cmd->data + offset;
+
+                data = i2c_smbus_read_byte_data(
+                        fd,
+                        cmd->register_address + offset);
+
+                if (data < 0) {
+                    return errno;
+                }
+
+                *buffer = (unsigned char)data;
+
+                remaining -= count;
+            }
+        }
     }
 
-    return(count);
+    return 0;
 }
 
+/* Locks an adapter of the Linux i2c-dev backend. The descriptor stays open
+ * and the holder can lock it again, see yaml_bus_lock(). */
 static int
-count_pre(YamlConfigHandle *handle, const char *subsyst, const YamlDevice *dev)
+linux_open_bus(void *context, const YamlBus *bus, void **bus_handle)
 {
-    int count = 0;
+    YamlBusLock *lock;
+    int rc;
 
-    if (dev == NULL || dev->pre == NULL) {
-        return(0);
+    rc = yaml_bus_lock(bus->devname, &lock);
+
+    if (rc != 0) {
+        return rc;
     }
 
-    count += count_ops(dev->pre);
+    *bus_handle = lock;
 
-    if (count != 0) {
-        dev = yaml_find_device(handle, subsyst, dev->pre[0]->device);
-        count += count_pre(handle, subsyst, dev);
-    }
+    return 0;
+}
 
-    return(count);
+static void
+linux_close_bus(void *context, void *bus_handle)
+{
+    yaml_bus_unlock((YamlBusLock *)bus_handle);
 }
 
+/* Performs a list of commands on an open and locked adapter. If cmd_rc is
+ * not NULL, it receives the status of each command. Returns 0 or the errno
+ * of the last failure. */
 static int
-add_post(
-    YamlConfigHandle *handle,
+linux_transfer(
+    void *context,
+    void *bus_handle,
+    YamlConfigHandle handle,
     const char *subsyst,
-    const YamlDevice *dev,
+    const YamlBus *bus,
     i2c_op **cmds,
-    int idx)
+    unsigned int count,
+    int *cmd_rc)
 {
-    int i;
+    const YamlDevice *dev;
+    int fd = yaml_bus_lock_fd((YamlBusLock *)bus_handle);
+    unsigned int idx;
+    int rc;
+    int final_rc = 0;
+
+    if (!bus->smbus) {
+        struct i2c_msg *msgbuf;
+        struct i2c_rdwr_ioctl_data msgioctl;
+
+        msgbuf = (struct i2c_msg *)calloc(sizeof(struct i2c_msg), count);
+
+        if (msgbuf == NULL) {
+            final_rc = ENOMEM;
+        } else {
+            msgioctl.nmsgs = count;
+            msgioctl.msgs = msgbuf;
+
+            for (idx = 0; idx < count; idx++) {
+                dev = yaml_find_device(handle, subsyst, cmds[idx]->device);
+                msgbuf[idx].flags = cmds[idx]->direction ? 0 : I2C_M_RD;
+                msgbuf[idx].len = cmds[idx]->byte_count;
+                msgbuf[idx].addr = dev->address;
+                msgbuf[idx].buf = (char *)cmds[idx]->data;
+            }
+
+            do {
+                rc = ioctl(fd, I2C_RDWR, &msgioctl);
+            } while (rc < 0 && EINTR == errno);
+
+            if (rc < 0) {
+                final_rc = errno;
+            }
+
+            free(msgbuf);
+        }
+
+        // a combined transfer succeeds or fails as a whole
+        if (cmd_rc != NULL) {
+            for (idx = 0; idx < count; idx++) {
+                cmd_rc[idx] = final_rc;
+            }
+        }
+    } else {
+        for (idx = 0; idx < count; idx++) {
+            dev = yaml_find_device(handle, subsyst, cmds[idx]->device);
 
-    const YamlDevice *post_dev;
+            rc = smbus_execute_cmd(fd, dev, cmds[idx]);
 
-    if (dev->post == NULL || dev->post[0] == NULL) {
-        return(idx);
+            if (rc != 0) {
+                final_rc = rc;
+            }
+            if (cmd_rc != NULL) {
+                cmd_rc[idx] = rc;
+            }
+        }
     }
 
-    post_dev = yaml_find_device(handle, subsyst, dev->post[0]->device);
+    return final_rc;
+}
 
-    for (i = 0; dev->post[i] != NULL; i++) {
-        cmds[idx] = dev->post[i];
-        idx++;
+static const YamlI2cBackend linux_backend = {
+    NULL,
+    linux_open_bus,
+    linux_close_bus,
+    linux_transfer
+};
+
+const YamlI2cBackend *
+yaml_i2c_default_backend(void)
+{
+    return &linux_backend;
+}
+
+/* Returns the backend installed on the handle, else the Linux one */
+static const YamlI2cBackend *
+get_backend(YamlConfigHandle handle)
+{
+    const YamlI2cBackend *backend = yaml_get_i2c_backend(handle);
+
+    return backend != NULL ? backend : &linux_backend;
+}
+
+static unsigned long long
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Accounts the time of a phase to a bus and, if not NULL, a device */
+static void
+add_time(
+    YamlI2cStats *stats,
+    const YamlBus *bus,
+    const YamlDevice *dev,
+    YamlI2cPhase phase,
+    unsigned long long ns)
+{
+    yaml_i2c_stats_add_time(stats, bus, bus->name, true, phase, ns);
+    if (dev != NULL) {
+        yaml_i2c_stats_add_time(stats, dev, dev->name, false, phase, ns);
     }
+}
 
-    idx = add_post(handle, subsyst, post_dev, cmds, idx);
+static unsigned int
+count_bytes(i2c_op **cmds, unsigned int count)
+{
+    unsigned int bytes = 0;
+    unsigned int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        if (cmds[idx]->byte_count > 0) {
+            bytes += cmds[idx]->byte_count;
+        }
+    }
 
-    return(idx);
+    return bytes;
 }
 
+/* Performs npre mux selection commands, the payload and npost mux
+ * deselection commands, timing each phase. The pre and post phases are
+ * accounted to dev, the payload to the device of each command. On an
+ * I2C_RDWR bus the commands are one combined transfer, which can't be
+ * split: it's accounted as payload. Returns 0 or errno of the last
+ * failure. */
 static int
-add_pre(
-    YamlConfigHandle *handle,
+timed_transfer(
+    const YamlI2cBackend *backend,
+    void *bus_handle,
+    YamlConfigHandle handle,
     const char *subsyst,
+    const YamlBus *bus,
     const YamlDevice *dev,
     i2c_op **cmds,
-    int idx)
+    unsigned int count,
+    unsigned int npre,
+    unsigned int npost,
+    int *cmd_rc)
 {
-    int i;
+    YamlI2cStats *stats = yaml_get_i2c_stats(handle);
+    unsigned long long start;
+    unsigned long long end;
+    unsigned int idx;
+    int rc;
+    int final_rc = 0;
 
-    const YamlDevice *pre_dev;
+    if (!bus->smbus) {
+        start = now_ns();
+        final_rc = backend->transfer(backend->context, bus_handle, handle,
+                                     subsyst, bus, cmds, count, cmd_rc);
+        end = now_ns();
+
+        add_time(stats, bus, NULL, YAML_I2C_PHASE_PAYLOAD, end - start);
+        for (idx = npre; idx < count - npost; idx++) {
+            if (idx == npre ||
+                    strcmp(cmds[idx]->device, cmds[idx - 1]->device) != 0) {
+                add_time(stats, bus,
+                         yaml_find_device(handle, subsyst, cmds[idx]->device),
+                         YAML_I2C_PHASE_PAYLOAD, end - start);
+            }
+        }
 
-    if (dev->pre == NULL || dev->pre[0] == NULL) {
-        return(idx);
+        return final_rc;
     }
 
-    pre_dev = yaml_find_device(handle, subsyst, dev->pre[0]->device);
+    // SMBus commands are separate transactions, so each is timed alone
+    for (idx = 0; idx < count; idx++) {
+        YamlI2cPhase phase = YAML_I2C_PHASE_PAYLOAD;
+        const YamlDevice *cmd_dev = dev;
+
+        if (idx < npre) {
+            phase = YAML_I2C_PHASE_PRE;
+        } else if (idx >= count - npost) {
+            phase = YAML_I2C_PHASE_POST;
+        } else {
+            cmd_dev = yaml_find_device(handle, subsyst, cmds[idx]->device);
+        }
 
-    idx = add_pre(handle, subsyst, pre_dev, cmds, idx);
+        start = now_ns();
+        rc = backend->transfer(backend->context, bus_handle, handle, subsyst,
+                               bus, &cmds[idx], 1,
+                               cmd_rc == NULL ? NULL : &cmd_rc[idx]);
+        add_time(stats, bus, cmd_dev, phase, now_ns() - start);
 
-    for (i = 0; dev->pre[i] != NULL; i++) {
-        cmds[idx] = dev->pre[i];
-        idx++;
+        if (rc != 0) {
+            final_rc = rc;
+        }
     }
 
-    return(idx);
+    return final_rc;
 }
 
+/* Performs ops of devices that share the route of dev, between the pre
+ * and post ops of the route. A combined I2C_RDWR transfer is limited to
+ * I2C_RDRW_IOCTL_MAX_MSGS messages, so on such a bus a long list is split
+ * into chunks that each select and deselect the muxes. results, if not
+ * NULL, receives the status of each op; a failed mux selection fails
+ * every op behind it. Returns 0 or errno of the last failure. */
 static int
-add_cmds(i2c_op **ops, i2c_op **cmds, int idx)
+transfer_ops(
+    const YamlI2cBackend *backend,
+    void *bus_handle,
+    YamlConfigHandle handle,
+    const char *subsyst,
+    const YamlI2cRoute *route,
+    const YamlDevice *dev,
+    i2c_op **ops,
+    unsigned int count,
+    int *results)
 {
-    int i;
+    YamlI2cStats *stats = yaml_get_i2c_stats(handle);
+    const YamlBus *bus = route->bus;
+    unsigned int npre = route->npre;
+    unsigned int npost = route->npost;
+    unsigned int chunk = count;
+    unsigned int first;
+    unsigned int idx;
+    unsigned int n;
+    i2c_op **cmds;
+    int *cmd_rc;
+    int rc = 0;
+    int final_rc = 0;
 
-    for (i = 0; ops[i] != NULL; i++) {
-        cmds[idx] = ops[i];
-        idx++;
+    if (!bus->smbus) {
+        if (npre + npost >= I2C_RDRW_IOCTL_MAX_MSGS) {
+            rc = EINVAL;
+        } else if (chunk > I2C_RDRW_IOCTL_MAX_MSGS - npre - npost) {
+            chunk = I2C_RDRW_IOCTL_MAX_MSGS - npre - npost;
+        }
+    }
+
+    cmds = (i2c_op **)calloc(sizeof(i2c_op *), npre + chunk + npost);
+    cmd_rc = (int *)calloc(sizeof(int), npre + chunk + npost);
+
+    if (rc == 0 && (cmds == NULL || cmd_rc == NULL)) {
+        rc = ENOMEM;
+    }
+
+    if (rc != 0) {
+        for (idx = 0; results != NULL && idx < count; idx++) {
+            results[idx] = rc;
+        }
+        free(cmds);
+        free(cmd_rc);
+        return rc;
+    }
+
+    // the pre ops never move; the ops and post ops follow them
+    memcpy(cmds, route->pre, npre * sizeof(i2c_op *));
+
+    for (first = 0; first < count; first += n) {
+        unsigned int pos;
+
+        n = count - first < chunk ? count - first : chunk;
+
+        // a register select write stays in the transfer of its read
+        if (n > 1 && first + n < count &&
+                ops[first + n - 1]->direction == WRITE &&
+                ops[first + n]->direction == READ &&
+                strcmp(ops[first + n - 1]->device,
+                       ops[first + n]->device) == 0) {
+            n--;
+        }
+        pos = npre + n + npost;
+
+        memcpy(&cmds[npre], &ops[first], n * sizeof(i2c_op *));
+        memcpy(&cmds[npre + n], route->post, npost * sizeof(i2c_op *));
+
+        rc = timed_transfer(backend, bus_handle, handle, subsyst, bus, dev,
+                            cmds, pos, npre, npost, cmd_rc);
+        yaml_i2c_stats_add_transaction(stats, bus, bus->name, true, pos,
+                                       count_bytes(cmds, pos), rc);
+        if (rc != 0) {
+            final_rc = rc;
+        }
+
+        rc = 0;
+        for (idx = 0; idx < npre; idx++) {
+            if (cmd_rc[idx] != 0) {
+                rc = cmd_rc[idx];
+            }
+        }
+        for (idx = 0; results != NULL && idx < n; idx++) {
+            results[first + idx] = rc != 0 ? rc : cmd_rc[npre + idx];
+        }
     }
 
-    return(idx);
+    free(cmds);
+    free(cmd_rc);
+
+    return final_rc;
 }
 
-int
-i2c_execute(
+/* Returns true if every command is sent through the adapter of route */
+static bool
+same_adapter(
+    YamlConfigHandle handle,
+    const char *subsyst,
+    const YamlI2cRoute *route,
+    i2c_op **cmds)
+{
+    const YamlI2cRoute *cmd_route;
+    unsigned int idx;
+
+    for (idx = 0; cmds[idx] != NULL; idx++) {
+        cmd_route = yaml_i2c_route(handle, subsyst,
+                                   yaml_find_device(handle, subsyst,
+                                                    cmds[idx]->device));
+        if (cmd_route == NULL || cmd_route->bus != route->bus) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int
+execute(
     YamlConfigHandle handle,
     const char *subsyst,
     const YamlDevice *dev,
     i2c_op **cmds)
 {
-    i2c_op **all_cmds;
-    unsigned int count = 0;
-    unsigned int idx = 0;
-    char *bus_name;
-    int fd = -1;
-    unsigned int i;
+    unsigned int count;
+    void *bus_handle;
     int rc;
     int final_rc;
-    struct i2c_msg *msgbuf;
-    struct i2c_rdwr_ioctl_data msgioctl;
-    char *dev_name;
+    const YamlI2cRoute *route;
+    const YamlBus *bus;
+    const YamlI2cBackend *backend;
+    YamlI2cStats *stats;
+    unsigned long long start;
 
     if (dev == NULL || handle == NULL) {
         return EINVAL;
@@ -173,197 +519,383 @@ i2c_execute(
         return EINVAL;
     }
 
-    // OPS_TODO: need better i2c_op array functions to avoid
-    // having to count operations before accumulating them.
-    count += count_pre(handle, subsyst, dev);
-    count += count_ops(cmds);
-    count += count_post(handle, subsyst, dev);
+    // the route has the muxes of every subsystem on the way, and the
+    // adapter at its root, where all commands must go
+    route = yaml_i2c_route(handle, subsyst, dev);
+
+    if (route == NULL || !same_adapter(handle, subsyst, route, cmds)) {
+        return EINVAL;
+    }
+
+    count = count_ops(cmds);
+    bus = route->bus;
+    backend = get_backend(handle);
+    stats = yaml_get_i2c_stats(handle);
+
+    start = now_ns();
+    rc = backend->open_bus(backend->context, bus, &bus_handle);
+    add_time(stats, bus, dev, YAML_I2C_PHASE_LOCK_WAIT, now_ns() - start);
 
-    all_cmds = (i2c_op **)calloc(sizeof(i2c_op *), count);
+    if (rc != 0) {
+        yaml_i2c_stats_add_transaction(stats, dev, dev->name, false, 0, 0, rc);
+        return rc;
+    }
 
-    // OPS_TODO: need to look at bus to see if it crosses a subsystem boundary
-    // and jump to the other subsystem (recursively) to pick up any pre and
-    // post operations that may be required.
-    idx = add_pre(handle, subsyst, dev, all_cmds, idx);
-    idx = add_cmds(cmds, all_cmds, idx);
-    idx = add_post(handle, subsyst, dev, all_cmds, idx);
+    final_rc = transfer_ops(backend, bus_handle, handle, subsyst, route, dev,
+                            cmds, count, NULL);
 
-    // verify that all operations are to the same bus
-    // OPS_TODO: bus may change as we cross the boundary between subsystems
+    backend->close_bus(backend->context, bus_handle);
 
-    dev = yaml_find_device(handle, subsyst, all_cmds[0]->device);
+    yaml_i2c_stats_add_transaction(stats, dev, dev->name, false,
+                                   route->npre + count + route->npost,
+                                   count_bytes(route->pre, route->npre) +
+                                   count_bytes(cmds, count) +
+                                   count_bytes(route->post, route->npost),
+                                   final_rc);
 
-    if (dev == NULL) {
-        return EINVAL;
+    return final_rc;
+}
+
+/* Returns true if two op lists perform the same i2c transactions */
+static bool
+same_ops(i2c_op **a, i2c_op **b)
+{
+    int idx;
+
+    if (a == b) {
+        return true;
     }
 
-    bus_name = dev->bus;
+    if (a == NULL || b == NULL) {
+        return (a == NULL || a[0] == NULL) && (b == NULL || b[0] == NULL);
+    }
 
-    for (idx = 0; idx < count; idx++) {
-        dev = yaml_find_device(handle, subsyst, all_cmds[idx]->device);
-        if (strcmp(dev->bus, bus_name) != 0) {
-            free(all_cmds);
-            return EINVAL;
+    for (idx = 0; a[idx] != NULL && b[idx] != NULL; idx++) {
+        if (strcmp(a[idx]->device, b[idx]->device) != 0 ||
+                a[idx]->direction != b[idx]->direction ||
+                a[idx]->register_address != b[idx]->register_address ||
+                a[idx]->byte_count != b[idx]->byte_count ||
+                memcmp(a[idx]->data, b[idx]->data, a[idx]->byte_count) != 0) {
+            return false;
         }
     }
 
-    const YamlBus *bus = yaml_find_bus(handle, subsyst, bus_name);
+    return a[idx] == NULL && b[idx] == NULL;
+}
 
-    if (bus == NULL) {
-        free(all_cmds);
-        return EINVAL;
+/* Devices share a mux path if their routes have the same pre and post
+ * operations */
+static bool
+same_mux_path(const YamlI2cRoute *a, const YamlI2cRoute *b)
+{
+    return a == b || (same_ops(a->pre, b->pre) && same_ops(a->post, b->post));
+}
+
+/* The ops of one bus for i2c_execute_list(), in list order */
+typedef struct {
+    YamlConfigHandle    handle;
+    const char          *subsyst;
+    const YamlBus       *bus;       /* adapter of the routes */
+    i2c_op              *ops;
+    const YamlI2cRoute  **routes;   /* of every op of the list */
+    unsigned int        *op_idx;
+    unsigned int        count;
+    int                 *results;
+    pthread_t           thread;
+    bool                started;    /* thread runs the batch */
+} bus_batch;
+
+/* Performs the ops of one bus. Consecutive ops that share a mux path are
+ * sent as one command list, chunked on an I2C_RDWR bus, so the mux is set
+ * up once for all of them, or once per chunk. */
+static void
+execute_bus_batch(bus_batch *batch)
+{
+    YamlConfigHandle handle = batch->handle;
+    const char *subsyst = batch->subsyst;
+    const YamlI2cBackend *backend = get_backend(handle);
+    YamlI2cStats *stats = yaml_get_i2c_stats(handle);
+    const YamlBus *bus = batch->bus;
+    i2c_op **cmds = NULL;
+    unsigned long long start;
+    int *cmd_rc = NULL;
+    unsigned int first;
+    unsigned int idx;
+    void *bus_handle = NULL;
+    int rc = 0;
+
+    // the batch waits for the bus once, for all of its devices
+    start = now_ns();
+    rc = backend->open_bus(backend->context, bus, &bus_handle);
+    add_time(stats, bus, NULL, YAML_I2C_PHASE_LOCK_WAIT, now_ns() - start);
+
+    if (rc != 0) {
+        for (idx = 0; idx < batch->count; idx++) {
+            batch->results[batch->op_idx[idx]] = rc;
+        }
+        return;
     }
 
-    dev_name = bus->devname;
+    for (first = 0; first < batch->count; ) {
+        const YamlDevice *dev;
+        const YamlI2cRoute *route;
+        unsigned int last;
 
-    fd = open(dev_name, O_RDWR);
+        dev = yaml_find_device(handle, subsyst,
+                               batch->ops[batch->op_idx[first]].device);
+        route = batch->routes[batch->op_idx[first]];
 
-    if (fd < 0) {
-        rc = errno;
-        free(all_cmds);
-        return rc;
+        // extend the batch while the mux path is unchanged
+        for (last = first + 1; last < batch->count; last++) {
+            if (!same_mux_path(route, batch->routes[batch->op_idx[last]])) {
+                break;
+            }
+        }
+
+        cmds = (i2c_op **)calloc(sizeof(i2c_op *), last - first);
+        cmd_rc = (int *)calloc(sizeof(int), last - first);
+
+        if (cmds == NULL || cmd_rc == NULL) {
+            for (idx = first; idx < last; idx++) {
+                batch->results[batch->op_idx[idx]] = ENOMEM;
+            }
+        } else {
+            for (idx = first; idx < last; idx++) {
+                cmds[idx - first] = &batch->ops[batch->op_idx[idx]];
+            }
+
+            transfer_ops(backend, bus_handle, handle, subsyst, route, dev,
+                         cmds, last - first, cmd_rc);
+
+            for (idx = first; idx < last; idx++) {
+                i2c_op *op = cmds[idx - first];
+                const YamlDevice *op_dev;
+
+                batch->results[batch->op_idx[idx]] = cmd_rc[idx - first];
+
+                // the entry keeps the name, so it must be the config's
+                op_dev = yaml_find_device(handle, subsyst, op->device);
+                if (op_dev == NULL) {
+                    continue;
+                }
+                yaml_i2c_stats_add_transaction(stats, op_dev, op_dev->name,
+                                               false, 1, count_bytes(&op, 1),
+                                               cmd_rc[idx - first]);
+            }
+        }
+
+        free(cmds);
+        free(cmd_rc);
+        first = last;
     }
 
-    rc = 0;
-    final_rc = 0;
+    backend->close_bus(backend->context, bus_handle);
+}
 
+static void *
+bus_batch_thread(void *arg)
+{
+    execute_bus_batch((bus_batch *)arg);
+    return NULL;
+}
 
-    flock(fd, LOCK_EX);
+/* Performs a list of ops in bus batches. Unordered, the ops of each
+ * adapter form one batch and the batches run in parallel. Ordered, each
+ * run of consecutive ops on an adapter forms a batch and the batches run
+ * one after another in this thread, so the list order holds across
+ * adapters. */
+static int
+execute_list(YamlConfigHandle handle, const char *subsyst, i2c_op *ops,
+             unsigned int count, int *results, bool ordered)
+{
+    bus_batch *batches;
+    unsigned int nbatches = 0;
+    const YamlI2cRoute **routes;
+    unsigned int *op_batch;
+    unsigned int *op_idx;
+    unsigned int idx;
+    unsigned int b;
+    int final_rc = 0;
+
+    if (handle == NULL || ops == NULL || results == NULL) {
+        return EINVAL;
+    }
 
-    if (!bus->smbus) {
-        msgbuf = (struct i2c_msg *)calloc(sizeof(struct i2c_msg), count);
+    if (count == 0) {
+        return 0;
+    }
 
-        msgioctl.nmsgs = count;
-        msgioctl.msgs = msgbuf;
+    batches = (bus_batch *)calloc(sizeof(bus_batch), count);
+    routes = (const YamlI2cRoute **)calloc(sizeof(YamlI2cRoute *), count);
+    op_batch = (unsigned int *)calloc(sizeof(unsigned int), count);
+    op_idx = (unsigned int *)calloc(sizeof(unsigned int), count);
+
+    if (batches == NULL || routes == NULL || op_batch == NULL ||
+            op_idx == NULL) {
+        free(batches);
+        free(routes);
+        free(op_batch);
+        free(op_idx);
+        return ENOMEM;
+    }
 
-        for (i = 0; i < count; i++) {
-            dev = yaml_find_device(handle, subsyst, all_cmds[i]->device);
-            msgbuf[i].flags = all_cmds[i]->direction ? 0 : I2C_M_RD;
-            msgbuf[i].len = all_cmds[i]->byte_count;
-            msgbuf[i].addr = dev->address;
-            msgbuf[i].buf = (char *)all_cmds[i]->data;
-            idx++;
+    // group the ops by adapter, keeping list order within each adapter;
+    // the routes are looked up once, as the cache may change meanwhile
+    for (idx = 0; idx < count; idx++) {
+        const YamlI2cRoute *route;
+
+        results[idx] = 0;
+
+        route = yaml_i2c_route(handle, subsyst,
+                               yaml_find_device(handle, subsyst,
+                                                ops[idx].device));
+        routes[idx] = route;
+        if (route == NULL) {
+            results[idx] = EINVAL;
+            continue;
         }
 
-        do {
-            rc = ioctl(fd, I2C_RDWR, &msgioctl);
-        } while (rc < 0 && EINTR == errno);
+        if (ordered) {
+            b = nbatches > 0 && batches[nbatches - 1].bus == route->bus ?
+                nbatches - 1 : nbatches;
+        } else {
+            for (b = 0; b < nbatches; b++) {
+                if (batches[b].bus == route->bus) {
+                    break;
+                }
+            }
+        }
 
-        if (rc < 0) {
-            rc = errno;
-            final_rc = rc;
+        if (b == nbatches) {
+            batches[b].handle = handle;
+            batches[b].subsyst = subsyst;
+            batches[b].bus = route->bus;
+            batches[b].ops = ops;
+            batches[b].routes = routes;
+            batches[b].results = results;
+            nbatches++;
         }
 
-        free(msgbuf);
-    } else {
+        op_batch[idx] = b;
+        batches[b].count++;
+    }
 
-        for (idx = 0; idx < count; idx++) {
-            i2c_op *cmd = all_cmds[idx];
-            dev = yaml_find_device(handle, subsyst, cmd->device);
+    // give each bus a slice of op_idx
+    for (b = 0, idx = 0; b < nbatches; b++) {
+        batches[b].op_idx = &op_idx[idx];
+        idx += batches[b].count;
+        batches[b].count = 0;
+    }
 
-            rc = ioctl(fd, I2C_SLAVE, (long)dev->address);
+    for (idx = 0; idx < count; idx++) {
+        if (results[idx] != 0) {
+            continue;
+        }
 
-            if (rc < 0) {
-                rc = errno;
-                final_rc = rc;
-                continue;
+        b = op_batch[idx];
+        batches[b].op_idx[batches[b].count++] = idx;
+    }
+
+    // the bus of a session can only be locked again by this thread
+    if (ordered || yaml_i2c_bus_session_active()) {
+        for (b = 0; b < nbatches; b++) {
+            execute_bus_batch(&batches[b]);
+        }
+    } else {
+        // independent buses run in parallel; the first runs in this thread
+        for (b = 1; b < nbatches; b++) {
+            batches[b].started = pthread_create(&batches[b].thread, NULL,
+                                                bus_batch_thread,
+                                                &batches[b]) == 0;
+            if (!batches[b].started) {
+                execute_bus_batch(&batches[b]);
             }
+        }
 
-            if (cmd->direction) {
-                // write
-                if (1 == cmd->byte_count) {
-                    long data;
-                    data = (long)cmd->data[0];
-                    rc = i2c_smbus_write_byte_data(
-                            fd,
-                            cmd->register_address,
-                            data);
-                    if (rc < 0) {
-                        rc = errno;
-                        final_rc = rc;
-                        continue;
-                    }
-                } else if (2 == cmd->byte_count) {
-                    long data;
-                    data = (long)(*(unsigned short *)cmd->data);
-                    rc = i2c_smbus_write_word_data(
-                            fd,
-                            cmd->register_address,
-                            data);
-                    if (rc < 0) {
-                        rc = errno;
-                        final_rc = rc;
-                        continue;
-                    }
-                } else {
-                    // NOT IMPLEMENTED
-                    rc = EINVAL;
-                    final_rc = rc;
-                    continue;
-                }
-            } else {
-                // read
-                if (1 == cmd->byte_count) {
-                    long data;
-                    data = i2c_smbus_read_byte_data(
-                                fd,
-                                cmd->register_address);
-                    if (data < 0) {
-                        rc = errno;
-                        final_rc = rc;
-                        continue;
-                    } else {
-                        cmd->data[0] = (unsigned char)data;
-                    }
-                } else if (2 == cmd->byte_count) {
-                    long data;
-                    data = i2c_smbus_read_word_data(
-                                fd,
-                                cmd->register_address);
-                    if (data < 0) {
-                        rc = errno;
-                        final_rc = rc;
-                        continue;
-                    } else {
-                        *(unsigned short *)cmd->data = (unsigned short)data;
-                    }
-                } else {
-                    size_t remaining = cmd->byte_count;
-                    while (remaining != 0) {
-                        unsigned char *buffer;
-                        long data;
-                        size_t count = remaining;
-                        size_t offset = (cmd->byte_count - remaining);
-
-                        if (count > 1) {
-                            count = 1;
-                        }
-
-                        buffer = cmd->data + offset;
-
-                        data = i2c_smbus_read_byte_data(
-                                fd,
-                                cmd->register_address + offset);
-
-                        if (data < 0) {
-                            rc = errno;
-                            final_rc = rc;
-                            break;
-                        }
-
-                        *buffer = (unsigned char)data;
-
-                        remaining -= count;
-                    }
-                }
+        if (nbatches > 0) {
+            execute_bus_batch(&batches[0]);
+        }
+
+        for (b = 1; b < nbatches; b++) {
+            if (batches[b].started) {
+                pthread_join(batches[b].thread, NULL);
             }
         }
     }
-    flock(fd, LOCK_UN);
 
-    free(all_cmds);
+    for (idx = 0; idx < count; idx++) {
+        if (final_rc == 0 && results[idx] != 0) {
+            final_rc = results[idx];
+        }
+    }
 
-    close(fd);
+    free(batches);
+    free(routes);
+    free(op_batch);
+    free(op_idx);
 
     return final_rc;
 }
+
+/* The routes found during a call are kept until it returns, even if
+ * another thread parses their subsystem meanwhile */
+static YamlI2cRoutes *
+enter_routes(YamlConfigHandle handle)
+{
+    YamlI2cRoutes *routes = handle == NULL ? NULL :
+                            yaml_get_i2c_routes(handle);
+
+    yaml_i2c_routes_enter(routes);
+
+    return routes;
+}
+
+int
+i2c_execute(
+    YamlConfigHandle handle,
+    const char *subsyst,
+    const YamlDevice *dev,
+    i2c_op **cmds)
+{
+    YamlI2cRoutes *routes = enter_routes(handle);
+    int rc;
+
+    rc = execute(handle, subsyst, dev, cmds);
+    yaml_i2c_routes_leave(routes);
+
+    return rc;
+}
+
+int
+i2c_execute_list(
+    YamlConfigHandle handle,
+    const char *subsyst,
+    i2c_op *ops,
+    unsigned int count,
+    int *results)
+{
+    YamlI2cRoutes *routes = enter_routes(handle);
+    int rc;
+
+    rc = execute_list(handle, subsyst, ops, count, results, false);
+    yaml_i2c_routes_leave(routes);
+
+    return rc;
+}
+
+int
+i2c_execute_list_ordered(
+    YamlConfigHandle handle,
+    const char *subsyst,
+    i2c_op *ops,
+    unsigned int count,
+    int *results)
+{
+    YamlI2cRoutes *routes = enter_routes(handle);
+    int rc;
+
+    rc = execute_list(handle, subsyst, ops, count, results, true);
+    yaml_i2c_routes_leave(routes);
+
+    return rc;
+}
@@ -0,0 +1,530 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * i2c routes. The route of a device is the adapter it is reached through
+ * and the flat list of pre and post operations of every mux on the way,
+ * following the pre operations within a subsystem and the parent device of
+ * a bus across subsystems. Routes are resolved on first use and kept in a
+ * fixed open addressing table keyed by the YamlDevice pointer, published
+ * with a compare-and-swap, so finding a route takes no lock. Parsing a
+ * subsystem again replaces the routes through it with a tombstone, which
+ * lookups skip and inserts reuse. Threads that use routes count themselves
+ * in yaml_i2c_routes_enter(), and the dropped routes are freed once no
+ * thread is in.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+#define ROUTE_SLOTS         1024
+#define ROUTE_MAX_HOPS      16      /* muxes or parents, to stop loops */
+
+typedef struct {
+    i2c_op              **ops;
+    unsigned int        count;
+    unsigned int        size;
+} op_list;
+
+typedef struct route_entry {
+    const YamlDevice    *key;
+    char                *subsyst;   /* of the device */
+    char                *parents[ROUTE_MAX_HOPS];   /* subsystems on the way */
+    unsigned int        nparents;
+    YamlI2cRoute        route;
+    op_list             owned;      /* copies naming other subsystems */
+    struct route_entry  *next;      /* on the retired list */
+} route_entry;
+
+struct YamlI2cRoutes {
+    route_entry         *slots[ROUTE_SLOTS];
+    route_entry         *retired;   /* out of the table, maybe in use */
+    unsigned int        readers;    /* threads between enter and leave */
+};
+
+/* Marks a slot whose route was dropped */
+static route_entry tombstone;
+
+#define TOMBSTONE   (&tombstone)
+
+
+/* Appends an op, keeping the list NULL terminated. Returns false if out
+ * of memory. */
+static bool
+op_list_add(op_list *list, i2c_op *op)
+{
+    if (list->count + 2 > list->size) {
+        unsigned int size = list->size == 0 ? 8 : list->size * 2;
+        i2c_op **ops = (i2c_op **)realloc(list->ops, size * sizeof(i2c_op *));
+
+        if (ops == NULL) {
+            return(false);
+        }
+        list->ops = ops;
+        list->size = size;
+    }
+
+    list->ops[list->count++] = op;
+    list->ops[list->count] = NULL;
+
+    return(true);
+}
+
+static void
+free_entry(route_entry *entry)
+{
+    unsigned int idx;
+
+    if (entry == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < entry->owned.count; idx++) {
+        free(entry->owned.ops[idx]->device);
+        free(entry->owned.ops[idx]);
+    }
+    free(entry->owned.ops);
+    free(entry->subsyst);
+    for (idx = 0; idx < entry->nparents; idx++) {
+        free(entry->parents[idx]);
+    }
+    free((char *)entry->route.root_subsyst);
+    free(entry->route.pre);
+    free(entry->route.post);
+    free(entry);
+}
+
+/* Adds an op of subsyst to a route of another subsystem, if qualify, as a
+ * copy naming its device <subsyst>:<device> */
+static bool
+add_op(route_entry *entry, op_list *list, const char *subsyst, i2c_op *op,
+       bool qualify)
+{
+    i2c_op *copy;
+
+    if (!qualify || strchr(op->device, ':') != NULL) {
+        return(op_list_add(list, op));
+    }
+
+    copy = (i2c_op *)malloc(sizeof(i2c_op));
+    if (copy == NULL) {
+        return(false);
+    }
+    *copy = *op;
+    copy->device = (char *)malloc(strlen(subsyst) + strlen(op->device) + 2);
+    if (copy->device == NULL || !op_list_add(&entry->owned, copy)) {
+        free(copy->device);
+        free(copy);
+        return(false);
+    }
+    strcpy(copy->device, subsyst);
+    strcat(copy->device, ":");
+    strcat(copy->device, op->device);
+
+    return(op_list_add(list, copy));
+}
+
+/* Collects the devices of a pre (or post) chain, dev first. Every mux must
+ * be on the bus of dev. Returns the number of devices, 0 on failure. */
+static unsigned int
+mux_chain(YamlConfigHandle handle, const char *subsyst, const YamlDevice *dev,
+          bool pre, const YamlDevice **chain)
+{
+    unsigned int count = 0;
+    const char *bus = dev->bus;
+
+    while (dev != NULL) {
+        i2c_op **ops = pre ? dev->pre : dev->post;
+
+        if (count == ROUTE_MAX_HOPS) {
+            return(0);
+        }
+        chain[count++] = dev;
+
+        if (ops == NULL || ops[0] == NULL) {
+            return(count);
+        }
+
+        dev = yaml_find_device(handle, subsyst, ops[0]->device);
+        if (dev == NULL || strcmp(dev->bus, bus) != 0) {
+            return(0);
+        }
+    }
+
+    return(0);
+}
+
+/* Adds the route of dev in subsyst to entry: the pre operations and the
+ * post operations, both outermost first; new_entry() reverses the post
+ * operations. Returns 0 or errno. */
+static int
+resolve(YamlConfigHandle handle, const char *top_subsyst, const char *subsyst,
+        const YamlDevice *dev, unsigned int hops, route_entry *entry,
+        op_list *pre, op_list *post)
+{
+    const YamlDevice *chain[ROUTE_MAX_HOPS];
+    const YamlBus *bus;
+    bool qualify = strcmp(subsyst, top_subsyst) != 0;
+    unsigned int count;
+    int idx;
+    int op;
+    int rc;
+
+    bus = yaml_find_bus(handle, subsyst, dev->bus);
+    if (bus == NULL) {
+        return(EINVAL);
+    }
+
+    // the muxes of the parent subsystem come first
+    if (bus->parent_device != NULL) {
+        const YamlDevice *parent;
+
+        if (hops == ROUTE_MAX_HOPS) {
+            return(ELOOP);
+        }
+
+        parent = yaml_find_device(handle, bus->parent_subsyst,
+                                  bus->parent_device);
+        if (parent == NULL) {
+            return(EINVAL);
+        }
+
+        entry->parents[entry->nparents] = strdup(bus->parent_subsyst);
+        if (entry->parents[entry->nparents] == NULL) {
+            return(ENOMEM);
+        }
+        entry->nparents++;
+
+        rc = resolve(handle, top_subsyst, bus->parent_subsyst, parent,
+                     hops + 1, entry, pre, post);
+        if (rc != 0) {
+            return(rc);
+        }
+    } else {
+        entry->route.bus = bus;
+        entry->route.root_subsyst = strdup(subsyst);
+        if (entry->route.root_subsyst == NULL) {
+            return(ENOMEM);
+        }
+    }
+
+    count = mux_chain(handle, subsyst, dev, true, chain);
+    if (count == 0) {
+        return(EINVAL);
+    }
+    for (idx = count - 1; idx >= 0; idx--) {
+        for (op = 0; chain[idx]->pre != NULL && chain[idx]->pre[op] != NULL;
+                op++) {
+            if (!add_op(entry, pre, subsyst, chain[idx]->pre[op], qualify)) {
+                return(ENOMEM);
+            }
+        }
+    }
+
+    count = mux_chain(handle, subsyst, dev, false, chain);
+    if (count == 0) {
+        return(EINVAL);
+    }
+    for (idx = count - 1; idx >= 0; idx--) {
+        for (op = 0; chain[idx]->post != NULL &&
+                     chain[idx]->post[op] != NULL; op++) {
+        }
+        while (--op >= 0) {
+            if (!add_op(entry, post, subsyst, chain[idx]->post[op],
+                        qualify)) {
+                return(ENOMEM);
+            }
+        }
+    }
+
+    return(0);
+}
+
+/* Resolves the route of a device into a new entry, NULL on failure */
+static route_entry *
+new_entry(YamlConfigHandle handle, const char *subsyst, const YamlDevice *dev)
+{
+    route_entry *entry;
+    op_list pre;
+    op_list post;
+    unsigned int idx;
+
+    // a route is cached by device, so it must be resolved in the device's
+    // own subsystem
+    if (yaml_find_device(handle, subsyst, dev->name) != dev) {
+        return(NULL);
+    }
+
+    entry = (route_entry *)calloc(1, sizeof(route_entry));
+    if (entry == NULL) {
+        return(NULL);
+    }
+    entry->key = dev;
+    entry->subsyst = strdup(subsyst);
+    if (entry->subsyst == NULL) {
+        free(entry);
+        return(NULL);
+    }
+
+    memset(&pre, 0, sizeof(pre));
+    memset(&post, 0, sizeof(post));
+
+    if (resolve(handle, subsyst, subsyst, dev, 0, entry, &pre, &post) != 0) {
+        entry->route.pre = pre.ops;
+        entry->route.post = post.ops;
+        free_entry(entry);
+        return(NULL);
+    }
+
+    // the releases were collected outermost first; undo them innermost first
+    for (idx = 0; idx < post.count / 2; idx++) {
+        i2c_op *op = post.ops[idx];
+
+        post.ops[idx] = post.ops[post.count - 1 - idx];
+        post.ops[post.count - 1 - idx] = op;
+    }
+
+    entry->route.pre = pre.ops;
+    entry->route.npre = pre.count;
+    entry->route.post = post.ops;
+    entry->route.npost = post.count;
+
+    return(entry);
+}
+
+YamlI2cRoutes *
+yaml_i2c_routes_new(void)
+{
+    return((YamlI2cRoutes *)calloc(1, sizeof(YamlI2cRoutes)));
+}
+
+void
+yaml_i2c_routes_free(YamlI2cRoutes *routes)
+{
+    route_entry *entry;
+    unsigned int idx;
+
+    if (routes == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < ROUTE_SLOTS; idx++) {
+        if (routes->slots[idx] != TOMBSTONE) {
+            free_entry(routes->slots[idx]);
+        }
+    }
+    while (routes->retired != NULL) {
+        entry = routes->retired;
+        routes->retired = entry->next;
+        free_entry(entry);
+    }
+    free(routes);
+}
+
+/* Returns true if the route of entry goes through subsyst */
+static bool
+passes_through(const route_entry *entry, const char *subsyst)
+{
+    unsigned int idx;
+
+    if (strcmp(entry->subsyst, subsyst) == 0) {
+        return(true);
+    }
+    for (idx = 0; idx < entry->nparents; idx++) {
+        if (strcmp(entry->parents[idx], subsyst) == 0) {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+/* Puts a list of dropped entries on the retired list */
+static void
+retire(YamlI2cRoutes *routes, route_entry *first)
+{
+    route_entry *last = first;
+
+    while (last->next != NULL) {
+        last = last->next;
+    }
+
+    last->next = __atomic_load_n(&routes->retired, __ATOMIC_SEQ_CST);
+    while (!__atomic_compare_exchange_n(&routes->retired, &last->next, first,
+                                        false, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_SEQ_CST)) {
+    }
+}
+
+/* Frees the retired entries if no thread can hold one. An entry was out
+ * of the table before it was retired, so only a thread that was already
+ * in when the list is taken can hold it. */
+static void
+reclaim(YamlI2cRoutes *routes)
+{
+    route_entry *entry;
+
+    entry = __atomic_exchange_n(&routes->retired, NULL, __ATOMIC_SEQ_CST);
+    if (entry == NULL) {
+        return;
+    }
+
+    // the last thread to leave frees them
+    if (__atomic_load_n(&routes->readers, __ATOMIC_SEQ_CST) != 0) {
+        retire(routes, entry);
+        return;
+    }
+
+    while (entry != NULL) {
+        route_entry *next = entry->next;
+
+        free_entry(entry);
+        entry = next;
+    }
+}
+
+void
+yaml_i2c_routes_enter(YamlI2cRoutes *routes)
+{
+    if (routes != NULL) {
+        __atomic_add_fetch(&routes->readers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void
+yaml_i2c_routes_leave(YamlI2cRoutes *routes)
+{
+    if (routes != NULL &&
+            __atomic_sub_fetch(&routes->readers, 1, __ATOMIC_SEQ_CST) == 0) {
+        reclaim(routes);
+    }
+}
+
+void
+yaml_i2c_routes_invalidate(YamlI2cRoutes *routes, const char *subsyst)
+{
+    unsigned int idx;
+
+    if (routes == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < ROUTE_SLOTS; idx++) {
+        route_entry *entry = __atomic_load_n(&routes->slots[idx],
+                                             __ATOMIC_SEQ_CST);
+
+        if (entry == NULL || entry == TOMBSTONE ||
+                (subsyst != NULL && !passes_through(entry, subsyst))) {
+            continue;
+        }
+
+        // the tombstone keeps the probe chains through the slot intact
+        if (!__atomic_compare_exchange_n(&routes->slots[idx], &entry,
+                                         TOMBSTONE, false, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_SEQ_CST)) {
+            continue;
+        }
+
+        // a thread may have found it just before
+        entry->next = NULL;
+        retire(routes, entry);
+    }
+
+    reclaim(routes);
+}
+
+void
+yaml_i2c_routes_clear(YamlI2cRoutes *routes)
+{
+    yaml_i2c_routes_invalidate(routes, NULL);
+}
+
+const YamlI2cRoute *
+yaml_i2c_route(YamlConfigHandle handle, const char *subsyst,
+               const YamlDevice *dev)
+{
+    YamlI2cRoutes *routes;
+    route_entry *created = NULL;
+    route_entry *seen;
+    unsigned int start;
+    unsigned int idx;
+    unsigned int probe;
+    int free_slot;
+
+    if (handle == NULL || subsyst == NULL || dev == NULL) {
+        return(NULL);
+    }
+
+    routes = yaml_get_i2c_routes(handle);
+    if (routes == NULL) {
+        return(NULL);
+    }
+
+    start = ((uintptr_t)dev >> 4) * 2654435761u % ROUTE_SLOTS;
+
+    for (;;) {
+        free_slot = -1;
+        seen = NULL;
+
+        // the chain ends at an empty slot; the first free slot is reused
+        for (probe = 0, idx = start; probe < ROUTE_SLOTS;
+                probe++, idx = (idx + 1) % ROUTE_SLOTS) {
+            route_entry *entry = __atomic_load_n(&routes->slots[idx],
+                                                 __ATOMIC_SEQ_CST);
+
+            if (entry == NULL || entry == TOMBSTONE) {
+                if (free_slot < 0) {
+                    free_slot = idx;
+                    seen = entry;
+                }
+                if (entry == NULL) {
+                    break;
+                }
+                continue;
+            }
+
+            if (entry->key == dev) {
+                free_entry(created);
+                return(strcmp(entry->subsyst, subsyst) == 0 ? &entry->route :
+                       NULL);
+            }
+        }
+
+        if (free_slot < 0) {
+            free_entry(created);
+            return(NULL);
+        }
+
+        // unresolvable routes aren't cached, so a fix is picked up
+        if (created == NULL) {
+            created = new_entry(handle, subsyst, dev);
+            if (created == NULL) {
+                return(NULL);
+            }
+        }
+
+        if (__atomic_compare_exchange_n(&routes->slots[free_slot], &seen,
+                                        created, false, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_SEQ_CST)) {
+            return(&created->route);
+        }
+        // another thread took the slot, maybe for this device; look again
+    }
+}
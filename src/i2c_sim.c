@@ -0,0 +1,593 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Simulated i2c backend. Every device of devices.yaml gets a 256 byte
+ * register file and a register pointer:
+ *  - an SMBus command with a register accesses the register file there;
+ *    without a register, it writes or reads the pointer (a mux control
+ *    byte).
+ *  - an I2C_RDWR write sets the pointer to its first byte and stores the
+ *    rest from there; a read returns bytes from the pointer on.
+ * A command goes to the device at its bus and address whose pre operations
+ * are in effect, like a real mux channel, else it fails with ENXIO.
+ *
+ * The bus time of each transfer is modeled from the bytes on the wire
+ * (9 clocks each) and a fixed cost per transaction, and is either
+ * accounted or slept, with the bus held, so parallel buses overlap.
+ * Like the kernel, a combined transfer of more than 42 messages fails.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config-yaml.h"
+
+#define SIM_REGISTERS       256
+#define SIM_DEFAULT_KHZ     100
+#define SIM_CLOCKS_PER_BYTE 9
+#define SIM_RDWR_MAX_MSGS   42      /* I2C_RDRW_IOCTL_MAX_MSGS */
+
+typedef struct {
+    const YamlDevice    *dev;
+    unsigned char       regs[SIM_REGISTERS];
+    unsigned char       pointer;
+} sim_device;
+
+typedef struct {
+    const char          *name;
+    pthread_mutex_t     lock;       /* held while the bus is open;
+                                       recursive for bus sessions */
+} sim_bus;
+
+typedef struct {
+    const sim_device    *device;
+    int                 register_address;   /* -1 for all */
+    int                 error;
+    unsigned int        remaining;          /* 0 until cleared */
+} sim_fault;
+
+struct YamlI2cSim {
+    YamlConfigHandle    handle;
+    char                *subsyst;
+    YamlI2cSimConfig    config;
+    YamlI2cBackend      backend;
+    sim_device          *devices;
+    unsigned int        device_count;
+    sim_bus             *buses;
+    unsigned int        bus_count;
+    sim_fault           *faults;
+    unsigned int        fault_count;
+    YamlI2cSimStats     stats;
+    pthread_mutex_t     lock;       /* registers, faults and stats */
+};
+
+/* Bus time of a number of transactions and bytes */
+static unsigned long long
+bus_ns(const YamlI2cSim *sim, unsigned long long transactions,
+       unsigned long long bytes)
+{
+    return(transactions * sim->config.transaction_ns +
+           bytes * SIM_CLOCKS_PER_BYTE * 1000000ULL / sim->config.bus_khz);
+}
+
+static sim_device *
+find_device(YamlI2cSim *sim, const char *name)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < sim->device_count; idx++) {
+        if (strcmp(sim->devices[idx].dev->name, name) == 0) {
+            return(&sim->devices[idx]);
+        }
+    }
+
+    return(NULL);
+}
+
+/* Returns true if a pre operation is in effect, i.e. its bytes are what
+ * the device would return */
+static bool
+op_in_effect(YamlI2cSim *sim, const i2c_op *op, bool rdwr)
+{
+    const sim_device *device = find_device(sim, op->device);
+    int idx;
+
+    if (device == NULL || op->data == NULL || op->byte_count == 0) {
+        return(false);
+    }
+
+    if (!rdwr && op->set_register) {
+        for (idx = 0; idx < op->byte_count; idx++) {
+            if (device->regs[(op->register_address + idx) % SIM_REGISTERS] !=
+                    op->data[idx]) {
+                return(false);
+            }
+        }
+        return(true);
+    }
+
+    if (op->byte_count == 1) {
+        return(device->pointer == op->data[0]);
+    }
+
+    for (idx = 1; idx < op->byte_count; idx++) {
+        if (device->regs[(op->data[0] + idx - 1) % SIM_REGISTERS] !=
+                op->data[idx]) {
+            return(false);
+        }
+    }
+
+    return(true);
+}
+
+/* Returns the device that answers at an address of a bus */
+static sim_device *
+route(YamlI2cSim *sim, const char *bus, int address, bool rdwr)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < sim->device_count; idx++) {
+        sim_device *device = &sim->devices[idx];
+        int pre;
+
+        if (device->dev->address != address ||
+                strcmp(device->dev->bus, bus) != 0) {
+            continue;
+        }
+
+        for (pre = 0; device->dev->pre != NULL &&
+                      device->dev->pre[pre] != NULL; pre++) {
+            if (!op_in_effect(sim, device->dev->pre[pre], rdwr)) {
+                break;
+            }
+        }
+        if (device->dev->pre == NULL || device->dev->pre[pre] == NULL) {
+            return(device);
+        }
+    }
+
+    return(NULL);
+}
+
+/* Returns the injected error for a command, else 0 */
+static int
+check_faults(YamlI2cSim *sim, const sim_device *device, int register_address)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < sim->fault_count; idx++) {
+        sim_fault *fault = &sim->faults[idx];
+        int error = fault->error;
+
+        if (fault->device != device || fault->error == 0 ||
+                (fault->register_address >= 0 &&
+                 fault->register_address != register_address)) {
+            continue;
+        }
+
+        if (fault->remaining != 0 && --fault->remaining == 0) {
+            fault->error = 0;
+        }
+
+        return(error);
+    }
+
+    return(0);
+}
+
+/* Performs one command. Called with the lock held. */
+static int
+execute_cmd(YamlI2cSim *sim, YamlConfigHandle handle, const char *subsyst,
+            const YamlBus *bus, i2c_op *cmd)
+{
+    const YamlDevice *dev;
+    sim_device *device;
+    bool rdwr = !bus->smbus;
+    bool write = cmd->direction;
+    unsigned char reg;
+    int count = cmd->byte_count;
+    int idx;
+    int rc;
+
+    // the wire cost is paid even if no device answers
+    if (rdwr) {
+        sim->stats.bytes += 1 + count;
+    } else if (!cmd->set_register) {
+        sim->stats.transactions++;
+        sim->stats.bytes += 1 + count;
+    } else if (!write && count > 2) {
+        // an SMBus block read is a byte read per byte
+        sim->stats.transactions += count;
+        sim->stats.bytes += 4 * count;
+    } else {
+        sim->stats.transactions++;
+        sim->stats.bytes += (write ? 2 : 3) + count;
+    }
+    sim->stats.messages++;
+
+    dev = yaml_find_device(handle, subsyst, cmd->device);
+    if (dev == NULL || count <= 0 || cmd->data == NULL) {
+        return(EINVAL);
+    }
+
+    device = route(sim, bus->name, dev->address, rdwr);
+    if (device == NULL) {
+        return(ENXIO);
+    }
+
+    if (rdwr) {
+        reg = write ? cmd->data[0] : device->pointer;
+    } else {
+        reg = cmd->set_register ? cmd->register_address : device->pointer;
+    }
+
+    rc = check_faults(sim, device, reg);
+    if (rc != 0) {
+        return(rc);
+    }
+
+    if (!rdwr && cmd->set_register) {
+        for (idx = 0; idx < count; idx++) {
+            unsigned char *r = &device->regs[(reg + idx) % SIM_REGISTERS];
+
+            if (write) {
+                *r = cmd->data[idx];
+            } else {
+                cmd->data[idx] = *r;
+            }
+        }
+    } else if (write) {
+        device->pointer = cmd->data[0];
+        for (idx = 1; idx < count; idx++) {
+            device->regs[device->pointer++] = cmd->data[idx];
+        }
+    } else if (!rdwr) {
+        for (idx = 0; idx < count; idx++) {
+            cmd->data[idx] = device->pointer;
+        }
+    } else {
+        for (idx = 0; idx < count; idx++) {
+            cmd->data[idx] = device->regs[device->pointer++];
+        }
+    }
+
+    return(0);
+}
+
+static int
+sim_open_bus(void *context, const YamlBus *bus, void **bus_handle)
+{
+    YamlI2cSim *sim = (YamlI2cSim *)context;
+    unsigned int idx;
+
+    for (idx = 0; idx < sim->bus_count; idx++) {
+        if (strcmp(sim->buses[idx].name, bus->name) == 0) {
+            pthread_mutex_lock(&sim->buses[idx].lock);
+            *bus_handle = &sim->buses[idx];
+            return(0);
+        }
+    }
+
+    return(ENODEV);
+}
+
+static void
+sim_close_bus(void *context, void *bus_handle)
+{
+    pthread_mutex_unlock(&((sim_bus *)bus_handle)->lock);
+}
+
+static int
+sim_transfer(void *context, void *bus_handle, YamlConfigHandle handle,
+             const char *subsyst, const YamlBus *bus, i2c_op **cmds,
+             unsigned int count, int *cmd_rc)
+{
+    YamlI2cSim *sim = (YamlI2cSim *)context;
+    unsigned long long transactions;
+    unsigned long long bytes;
+    unsigned long long ns;
+    unsigned int idx;
+    int rc = 0;
+    int final_rc = 0;
+
+    pthread_mutex_lock(&sim->lock);
+
+    transactions = sim->stats.transactions;
+    bytes = sim->stats.bytes;
+
+    if (!bus->smbus && count > SIM_RDWR_MAX_MSGS) {
+        // the kernel rejects the ioctl before touching the bus
+        sim->stats.faults += count;
+        for (idx = 0; cmd_rc != NULL && idx < count; idx++) {
+            cmd_rc[idx] = EINVAL;
+        }
+        final_rc = EINVAL;
+    } else if (!bus->smbus) {
+        sim->stats.transactions++;
+
+        // the transfer stops at the first failed message
+        for (idx = 0; idx < count && final_rc == 0; idx++) {
+            final_rc = execute_cmd(sim, handle, subsyst, bus, cmds[idx]);
+        }
+        if (final_rc != 0) {
+            sim->stats.faults += count;
+        }
+        for (idx = 0; cmd_rc != NULL && idx < count; idx++) {
+            cmd_rc[idx] = final_rc;
+        }
+    } else {
+        for (idx = 0; idx < count; idx++) {
+            rc = execute_cmd(sim, handle, subsyst, bus, cmds[idx]);
+            if (rc != 0) {
+                sim->stats.faults++;
+                final_rc = rc;
+            }
+            if (cmd_rc != NULL) {
+                cmd_rc[idx] = rc;
+            }
+        }
+    }
+
+    ns = bus_ns(sim, sim->stats.transactions - transactions,
+                sim->stats.bytes - bytes);
+    sim->stats.elapsed_ns += ns;
+
+    pthread_mutex_unlock(&sim->lock);
+
+    // the bus is still held, like the real adapter
+    if (sim->config.realtime && ns != 0) {
+        struct timespec ts;
+
+        ts.tv_sec = ns / 1000000000ULL;
+        ts.tv_nsec = ns % 1000000000ULL;
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        }
+    }
+
+    return(final_rc);
+}
+
+YamlI2cSim *
+yaml_i2c_sim_new(YamlConfigHandle handle, const char *subsyst,
+                 const YamlI2cSimConfig *config)
+{
+    YamlI2cSim *sim;
+    pthread_mutexattr_t attr;
+    int count;
+    int idx;
+
+    if (handle == NULL || subsyst == NULL) {
+        return(NULL);
+    }
+
+    count = yaml_get_device_count(handle, subsyst);
+    if (count <= 0) {
+        return(NULL);
+    }
+
+    sim = (YamlI2cSim *)calloc(1, sizeof(YamlI2cSim));
+    if (sim == NULL) {
+        return(NULL);
+    }
+
+    sim->handle = handle;
+    sim->subsyst = strdup(subsyst);
+    if (config != NULL) {
+        sim->config = *config;
+    }
+    if (sim->config.bus_khz == 0) {
+        sim->config.bus_khz = SIM_DEFAULT_KHZ;
+    }
+
+    sim->backend.context = sim;
+    sim->backend.open_bus = sim_open_bus;
+    sim->backend.close_bus = sim_close_bus;
+    sim->backend.transfer = sim_transfer;
+
+    sim->devices = (sim_device *)calloc(count, sizeof(sim_device));
+    sim->buses = (sim_bus *)calloc(count, sizeof(sim_bus));
+    if (sim->subsyst == NULL || sim->devices == NULL || sim->buses == NULL) {
+        free(sim->buses);
+        free(sim->devices);
+        free(sim->subsyst);
+        free(sim);
+        return(NULL);
+    }
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+
+    for (idx = 0; idx < count; idx++) {
+        const YamlDevice *dev = yaml_get_device(handle, subsyst, idx);
+        unsigned int bus;
+
+        if (dev == NULL || dev->bus == NULL) {
+            continue;
+        }
+
+        sim->devices[sim->device_count++].dev = dev;
+
+        for (bus = 0; bus < sim->bus_count; bus++) {
+            if (strcmp(sim->buses[bus].name, dev->bus) == 0) {
+                break;
+            }
+        }
+        if (bus == sim->bus_count) {
+            sim->buses[bus].name = dev->bus;
+            pthread_mutex_init(&sim->buses[bus].lock, &attr);
+            sim->bus_count++;
+        }
+    }
+
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&sim->lock, NULL);
+
+    return(sim);
+}
+
+void
+yaml_i2c_sim_free(YamlI2cSim *sim)
+{
+    unsigned int idx;
+
+    if (sim == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < sim->bus_count; idx++) {
+        pthread_mutex_destroy(&sim->buses[idx].lock);
+    }
+
+    pthread_mutex_destroy(&sim->lock);
+    free(sim->faults);
+    free(sim->buses);
+    free(sim->devices);
+    free(sim->subsyst);
+    free(sim);
+}
+
+const YamlI2cBackend *
+yaml_i2c_sim_backend(YamlI2cSim *sim)
+{
+    return(sim == NULL ? NULL : &sim->backend);
+}
+
+int
+yaml_i2c_sim_set_register(YamlI2cSim *sim, const char *device,
+                          unsigned char register_address, unsigned char value)
+{
+    sim_device *dev;
+
+    if (sim == NULL || device == NULL) {
+        return(EINVAL);
+    }
+
+    dev = find_device(sim, device);
+    if (dev == NULL) {
+        return(EINVAL);
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    dev->regs[register_address] = value;
+    pthread_mutex_unlock(&sim->lock);
+
+    return(0);
+}
+
+int
+yaml_i2c_sim_get_register(YamlI2cSim *sim, const char *device,
+                          unsigned char register_address,
+                          unsigned char *value)
+{
+    sim_device *dev;
+
+    if (sim == NULL || device == NULL || value == NULL) {
+        return(EINVAL);
+    }
+
+    dev = find_device(sim, device);
+    if (dev == NULL) {
+        return(EINVAL);
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    *value = dev->regs[register_address];
+    pthread_mutex_unlock(&sim->lock);
+
+    return(0);
+}
+
+int
+yaml_i2c_sim_inject_fault(YamlI2cSim *sim, const char *device,
+                          int register_address, int error,
+                          unsigned int count)
+{
+    sim_device *dev;
+    sim_fault *faults;
+
+    if (sim == NULL || device == NULL || error == 0 ||
+            register_address >= SIM_REGISTERS) {
+        return(EINVAL);
+    }
+
+    dev = find_device(sim, device);
+    if (dev == NULL) {
+        return(EINVAL);
+    }
+
+    pthread_mutex_lock(&sim->lock);
+
+    faults = (sim_fault *)realloc(sim->faults,
+                                  (sim->fault_count + 1) * sizeof(sim_fault));
+    if (faults == NULL) {
+        pthread_mutex_unlock(&sim->lock);
+        return(ENOMEM);
+    }
+    sim->faults = faults;
+
+    faults[sim->fault_count].device = dev;
+    faults[sim->fault_count].register_address =
+        register_address < 0 ? -1 : register_address;
+    faults[sim->fault_count].error = error;
+    faults[sim->fault_count].remaining = count;
+    sim->fault_count++;
+
+    pthread_mutex_unlock(&sim->lock);
+
+    return(0);
+}
+
+void
+yaml_i2c_sim_clear_faults(YamlI2cSim *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    free(sim->faults);
+    sim->faults = NULL;
+    sim->fault_count = 0;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void
+yaml_i2c_sim_get_stats(YamlI2cSim *sim, YamlI2cSimStats *stats)
+{
+    if (sim == NULL || stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    *stats = sim->stats;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void
+yaml_i2c_sim_reset_stats(YamlI2cSim *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    memset(&sim->stats, 0, sizeof(sim->stats));
+    pthread_mutex_unlock(&sim->lock);
+}
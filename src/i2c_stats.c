@@ -0,0 +1,361 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * i2c latency histograms and counters, per bus and per device. The entries
+ * live in a fixed open addressing table keyed by the YamlBus or YamlDevice
+ * pointer. An entry is created on first use and published with a
+ * compare-and-swap; the counters are updated with relaxed atomic adds, so
+ * recording takes no lock and costs a few atomic operations.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+#define STATS_SLOTS         1024
+#define HISTOGRAM_SUB_BITS  3
+#define HISTOGRAM_SUB       (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_NS    ((1ULL << 36) - 1)
+
+typedef struct {
+    const void          *key;
+    YamlI2cStatsEntry   stats;
+} stats_entry;
+
+struct YamlI2cStats {
+    stats_entry         *slots[STATS_SLOTS];
+};
+
+#define ATOMIC_ADD(ptr, value) \
+    __atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED)
+
+/* Returns the bucket of a duration */
+static unsigned int
+bucket_of(unsigned long long ns)
+{
+    unsigned int msb;
+
+    if (ns > HISTOGRAM_MAX_NS) {
+        ns = HISTOGRAM_MAX_NS;
+    }
+    if (ns < HISTOGRAM_SUB) {
+        return(ns);
+    }
+
+    msb = 63 - __builtin_clzll(ns);
+
+    return((msb - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB +
+           ((ns >> (msb - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB - 1)));
+}
+
+/* Returns the lowest duration of a bucket */
+static unsigned long long
+bucket_floor(unsigned int bucket)
+{
+    unsigned int msb;
+
+    if (bucket < HISTOGRAM_SUB) {
+        return(bucket);
+    }
+
+    msb = bucket / HISTOGRAM_SUB + HISTOGRAM_SUB_BITS - 1;
+
+    return((unsigned long long)(HISTOGRAM_SUB + bucket % HISTOGRAM_SUB) <<
+           (msb - HISTOGRAM_SUB_BITS));
+}
+
+YamlI2cStats *
+yaml_i2c_stats_new(void)
+{
+    return((YamlI2cStats *)calloc(1, sizeof(YamlI2cStats)));
+}
+
+void
+yaml_i2c_stats_free(YamlI2cStats *stats)
+{
+    unsigned int idx;
+
+    if (stats == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < STATS_SLOTS; idx++) {
+        free(stats->slots[idx]);
+    }
+    free(stats);
+}
+
+/* Returns the entry of a bus or device, creating it on first use. NULL if
+ * the table is full. */
+static stats_entry *
+get_entry(YamlI2cStats *stats, const void *key, const char *name, bool bus)
+{
+    unsigned int idx = ((uintptr_t)key >> 4) * 2654435761u % STATS_SLOTS;
+    unsigned int probe;
+
+    for (probe = 0; probe < STATS_SLOTS; probe++) {
+        stats_entry *entry = __atomic_load_n(&stats->slots[idx],
+                                             __ATOMIC_ACQUIRE);
+
+        if (entry == NULL) {
+            stats_entry *created;
+
+            created = (stats_entry *)calloc(1, sizeof(stats_entry));
+            if (created == NULL) {
+                return(NULL);
+            }
+            created->key = key;
+            created->stats.name = name;
+            created->stats.bus = bus;
+
+            if (__atomic_compare_exchange_n(&stats->slots[idx], &entry,
+                                            created, false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                return(created);
+            }
+
+            // another thread took the slot; entry is now its entry
+            free(created);
+        }
+
+        if (entry->key == key) {
+            return(entry);
+        }
+
+        idx = (idx + 1) % STATS_SLOTS;
+    }
+
+    return(NULL);
+}
+
+void
+yaml_i2c_stats_add_time(YamlI2cStats *stats, const void *key,
+                        const char *name, bool bus, YamlI2cPhase phase,
+                        unsigned long long ns)
+{
+    YamlI2cHistogram *histogram;
+    stats_entry *entry;
+    unsigned long long max;
+
+    if (stats == NULL || key == NULL || phase >= YAML_I2C_PHASE_COUNT) {
+        return;
+    }
+
+    entry = get_entry(stats, key, name, bus);
+    if (entry == NULL) {
+        return;
+    }
+
+    histogram = &entry->stats.phases[phase];
+    ATOMIC_ADD(&histogram->count, 1);
+    ATOMIC_ADD(&histogram->total_ns, ns);
+    ATOMIC_ADD(&histogram->buckets[bucket_of(ns)], 1);
+
+    max = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+    while (ns > max &&
+            !__atomic_compare_exchange_n(&histogram->max_ns, &max, ns, true,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void
+yaml_i2c_stats_add_transaction(YamlI2cStats *stats, const void *key,
+                               const char *name, bool bus,
+                               unsigned int commands, unsigned int bytes,
+                               int rc)
+{
+    stats_entry *entry;
+
+    if (stats == NULL || key == NULL) {
+        return;
+    }
+
+    entry = get_entry(stats, key, name, bus);
+    if (entry == NULL) {
+        return;
+    }
+
+    ATOMIC_ADD(&entry->stats.transactions, 1);
+    ATOMIC_ADD(&entry->stats.commands, commands);
+    ATOMIC_ADD(&entry->stats.bytes, bytes);
+
+    if (rc != 0) {
+        if (rc < 0) {
+            rc = -rc;
+        }
+        if (rc >= YAML_I2C_STATS_ERRNOS) {
+            rc = YAML_I2C_STATS_ERRNOS - 1;
+        }
+        ATOMIC_ADD(&entry->stats.errors[rc], 1);
+    }
+}
+
+/* Copies counters one at a time, so concurrent adds aren't torn */
+static void
+load_counters(unsigned long long *dst, unsigned long long *src,
+              unsigned int count)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        dst[idx] = __atomic_load_n(&src[idx], __ATOMIC_RELAXED);
+    }
+}
+
+static void
+zero_counters(unsigned long long *counters, unsigned int count)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        __atomic_store_n(&counters[idx], 0, __ATOMIC_RELAXED);
+    }
+}
+
+static void
+copy_entry(YamlI2cStatsEntry *dst, YamlI2cStatsEntry *src)
+{
+    unsigned int phase;
+
+    dst->name = src->name;
+    dst->bus = src->bus;
+
+    load_counters(&dst->transactions, &src->transactions, 1);
+    load_counters(&dst->commands, &src->commands, 1);
+    load_counters(&dst->bytes, &src->bytes, 1);
+    load_counters(dst->errors, src->errors, YAML_I2C_STATS_ERRNOS);
+
+    for (phase = 0; phase < YAML_I2C_PHASE_COUNT; phase++) {
+        YamlI2cHistogram *d = &dst->phases[phase];
+        YamlI2cHistogram *s = &src->phases[phase];
+
+        load_counters(&d->count, &s->count, 1);
+        load_counters(&d->total_ns, &s->total_ns, 1);
+        load_counters(&d->max_ns, &s->max_ns, 1);
+        load_counters(d->buckets, s->buckets, YAML_I2C_HISTOGRAM_BUCKETS);
+    }
+}
+
+static void
+reset_entry(YamlI2cStatsEntry *entry)
+{
+    unsigned int phase;
+
+    zero_counters(&entry->transactions, 1);
+    zero_counters(&entry->commands, 1);
+    zero_counters(&entry->bytes, 1);
+    zero_counters(entry->errors, YAML_I2C_STATS_ERRNOS);
+
+    for (phase = 0; phase < YAML_I2C_PHASE_COUNT; phase++) {
+        YamlI2cHistogram *histogram = &entry->phases[phase];
+
+        zero_counters(&histogram->count, 1);
+        zero_counters(&histogram->total_ns, 1);
+        zero_counters(&histogram->max_ns, 1);
+        zero_counters(histogram->buckets, YAML_I2C_HISTOGRAM_BUCKETS);
+    }
+}
+
+int
+yaml_i2c_stats_snapshot(YamlI2cStats *stats, YamlI2cStatsEntry *entries,
+                        unsigned int max_entries)
+{
+    unsigned int count = 0;
+    unsigned int idx;
+
+    if (stats == NULL) {
+        return(0);
+    }
+
+    for (idx = 0; idx < STATS_SLOTS; idx++) {
+        stats_entry *entry = __atomic_load_n(&stats->slots[idx],
+                                             __ATOMIC_ACQUIRE);
+
+        if (entry == NULL) {
+            continue;
+        }
+        if (entries != NULL && count < max_entries) {
+            copy_entry(&entries[count], &entry->stats);
+        }
+        count++;
+    }
+
+    return(count);
+}
+
+void
+yaml_i2c_stats_reset(YamlI2cStats *stats)
+{
+    unsigned int idx;
+
+    if (stats == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < STATS_SLOTS; idx++) {
+        stats_entry *entry = __atomic_load_n(&stats->slots[idx],
+                                             __ATOMIC_ACQUIRE);
+
+        if (entry != NULL) {
+            reset_entry(&entry->stats);
+        }
+    }
+}
+
+unsigned long long
+yaml_i2c_histogram_percentile(const YamlI2cHistogram *histogram,
+                              double percentile)
+{
+    unsigned long long target;
+    unsigned long long seen = 0;
+    unsigned long long upper;
+    unsigned int idx;
+
+    if (histogram == NULL || histogram->count == 0) {
+        return(0);
+    }
+
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+
+    target = (unsigned long long)(histogram->count * percentile / 100 + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    for (idx = 0; idx < YAML_I2C_HISTOGRAM_BUCKETS; idx++) {
+        seen += histogram->buckets[idx];
+        if (seen >= target) {
+            break;
+        }
+    }
+    if (idx == YAML_I2C_HISTOGRAM_BUCKETS) {
+        return(histogram->max_ns);
+    }
+
+    upper = idx + 1 < YAML_I2C_HISTOGRAM_BUCKETS ?
+            bucket_floor(idx + 1) - 1 : HISTOGRAM_MAX_NS;
+
+    // the largest value is known exactly
+    return(upper < histogram->max_ns ? upper : histogram->max_ns);
+}
@@ -0,0 +1,566 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * i2c transaction record and replay. The recorder is a backend that wraps
+ * the backend of a handle and logs every transfer to a binary trace:
+ *
+ *  header:    "I2CT" version(1) 0 0 0
+ *  name:      1 id(2) length(1) name          bus and device names, once
+ *  transfer:  2 bus(2) count(2) delta_us(4) duration_us(4), then per
+ *             command: device(2) address(1) flags(1) register(1)
+ *             byte_count(2) status(1) [written bytes]
+ *
+ * Integers are little endian. delta_us is the time from the start of the
+ * previous transfer. Read data isn't logged, written data is, so mux
+ * selections are replayed.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config-yaml.h"
+
+#define TRACE_MAGIC         "I2CT"
+#define TRACE_VERSION       1
+
+#define TRACE_NAME          1
+#define TRACE_TRANSFER      2
+
+#define TRACE_WRITE         0x01
+#define TRACE_SET_REGISTER  0x02
+#define TRACE_COMBINED      0x04
+
+#define TRACE_MAX_NAMES     0xffff
+
+struct YamlI2cRecorder {
+    YamlConfigHandle        handle;
+    const YamlI2cBackend    *previous;  /* installed before, may be NULL */
+    const YamlI2cBackend    *inner;     /* previous, else the default */
+    YamlI2cBackend          backend;
+    FILE                    *file;
+    char                    **names;
+    unsigned int            name_count;
+    unsigned long long      last_usec;  /* start of the previous transfer */
+    pthread_mutex_t         lock;
+};
+
+static unsigned long long
+now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static void
+put_u16(unsigned char *buf, unsigned int value)
+{
+    buf[0] = value & 0xff;
+    buf[1] = (value >> 8) & 0xff;
+}
+
+static void
+put_u32(unsigned char *buf, unsigned long long value)
+{
+    if (value > 0xffffffffULL) {
+        value = 0xffffffffULL;
+    }
+    put_u16(buf, value & 0xffff);
+    put_u16(buf + 2, value >> 16);
+}
+
+/* Returns the id of a name, logging it the first time. Called with the
+ * lock held. */
+static int
+name_id(YamlI2cRecorder *recorder, const char *name)
+{
+    unsigned char buf[4];
+    unsigned int length = strlen(name);
+    unsigned int idx;
+    char **names;
+
+    for (idx = 0; idx < recorder->name_count; idx++) {
+        if (strcmp(recorder->names[idx], name) == 0) {
+            return(idx);
+        }
+    }
+
+    if (idx == TRACE_MAX_NAMES || length > 0xff) {
+        return(-1);
+    }
+
+    names = (char **)realloc(recorder->names, (idx + 1) * sizeof(char *));
+    if (names == NULL) {
+        return(-1);
+    }
+    recorder->names = names;
+    names[idx] = strdup(name);
+    if (names[idx] == NULL) {
+        return(-1);
+    }
+    recorder->name_count++;
+
+    buf[0] = TRACE_NAME;
+    put_u16(&buf[1], idx);
+    buf[3] = length;
+    fwrite(buf, sizeof(buf), 1, recorder->file);
+    fwrite(name, length, 1, recorder->file);
+
+    return(idx);
+}
+
+/* Logs a transfer. Called with the lock held. */
+static void
+log_transfer(YamlI2cRecorder *recorder, YamlConfigHandle handle,
+             const char *subsyst, const YamlBus *bus, i2c_op **cmds,
+             unsigned int count, const int *cmd_rc,
+             unsigned long long start, unsigned long long duration)
+{
+    unsigned char buf[13];
+    unsigned int idx;
+    int bus_id;
+
+    bus_id = name_id(recorder, bus->name);
+    if (bus_id < 0 || count > 0xffff) {
+        return;
+    }
+
+    // names first, so the transfer record stays in one piece
+    for (idx = 0; idx < count; idx++) {
+        if (name_id(recorder, cmds[idx]->device) < 0) {
+            return;
+        }
+    }
+
+    buf[0] = TRACE_TRANSFER;
+    put_u16(&buf[1], bus_id);
+    put_u16(&buf[3], count);
+    put_u32(&buf[5], start > recorder->last_usec ?
+                     start - recorder->last_usec : 0);
+    put_u32(&buf[9], duration);
+    fwrite(buf, sizeof(buf), 1, recorder->file);
+
+    // concurrent transfers on other buses may be logged out of order
+    if (start > recorder->last_usec) {
+        recorder->last_usec = start;
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        const i2c_op *cmd = cmds[idx];
+        const YamlDevice *dev = yaml_find_device(handle, subsyst, cmd->device);
+        int rc = cmd_rc[idx];
+
+        put_u16(&buf[0], name_id(recorder, cmd->device));
+        buf[2] = dev == NULL ? 0 : dev->address;
+        buf[3] = (cmd->direction == WRITE ? TRACE_WRITE : 0) |
+                 (cmd->set_register ? TRACE_SET_REGISTER : 0) |
+                 (bus->smbus ? 0 : TRACE_COMBINED);
+        buf[4] = cmd->register_address;
+        put_u16(&buf[5], cmd->byte_count < 0 ? 0 : cmd->byte_count);
+        buf[7] = rc < 0 || rc > 0xff ? 0xff : rc;
+        fwrite(buf, 8, 1, recorder->file);
+
+        if (cmd->direction == WRITE && cmd->byte_count > 0 &&
+                cmd->data != NULL) {
+            fwrite(cmd->data, cmd->byte_count, 1, recorder->file);
+        }
+    }
+}
+
+static int
+rec_open_bus(void *context, const YamlBus *bus, void **bus_handle)
+{
+    YamlI2cRecorder *recorder = (YamlI2cRecorder *)context;
+
+    return(recorder->inner->open_bus(recorder->inner->context, bus,
+                                     bus_handle));
+}
+
+static void
+rec_close_bus(void *context, void *bus_handle)
+{
+    YamlI2cRecorder *recorder = (YamlI2cRecorder *)context;
+
+    recorder->inner->close_bus(recorder->inner->context, bus_handle);
+}
+
+static int
+rec_transfer(void *context, void *bus_handle, YamlConfigHandle handle,
+             const char *subsyst, const YamlBus *bus, i2c_op **cmds,
+             unsigned int count, int *cmd_rc)
+{
+    YamlI2cRecorder *recorder = (YamlI2cRecorder *)context;
+    unsigned long long start;
+    unsigned long long end;
+    int *rcs = cmd_rc;
+    int rc;
+
+    // the status of each command is logged, even if the caller ignores it
+    if (rcs == NULL) {
+        rcs = (int *)calloc(count == 0 ? 1 : count, sizeof(int));
+        if (rcs == NULL) {
+            return(ENOMEM);
+        }
+    }
+
+    start = now_usec();
+    rc = recorder->inner->transfer(recorder->inner->context, bus_handle,
+                                   handle, subsyst, bus, cmds, count, rcs);
+    end = now_usec();
+
+    pthread_mutex_lock(&recorder->lock);
+    log_transfer(recorder, handle, subsyst, bus, cmds, count, rcs, start,
+                 end - start);
+    pthread_mutex_unlock(&recorder->lock);
+
+    if (rcs != cmd_rc) {
+        free(rcs);
+    }
+
+    return(rc);
+}
+
+/* Returns the backend that a chain of recorders ends in */
+static const YamlI2cBackend *
+end_backend(const YamlI2cBackend *backend)
+{
+    while (backend->open_bus == rec_open_bus) {
+        backend = ((YamlI2cRecorder *)backend->context)->inner;
+    }
+
+    return(backend);
+}
+
+YamlI2cRecorder *
+yaml_i2c_recorder_new(YamlConfigHandle handle, const char *subsyst,
+                      const char *path)
+{
+    YamlI2cRecorder *recorder;
+    unsigned char header[8] = { 'I', '2', 'C', 'T', TRACE_VERSION, 0, 0, 0 };
+
+    if (handle == NULL || subsyst == NULL || path == NULL) {
+        return(NULL);
+    }
+
+    recorder = (YamlI2cRecorder *)calloc(1, sizeof(YamlI2cRecorder));
+    if (recorder == NULL) {
+        return(NULL);
+    }
+
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL ||
+            fwrite(header, sizeof(header), 1, recorder->file) != 1) {
+        if (recorder->file != NULL) {
+            fclose(recorder->file);
+        }
+        free(recorder);
+        return(NULL);
+    }
+
+    recorder->handle = handle;
+    recorder->previous = yaml_get_i2c_backend(handle);
+    recorder->inner = recorder->previous != NULL ?
+                      recorder->previous : yaml_i2c_default_backend();
+    recorder->last_usec = now_usec();
+
+    recorder->backend.context = recorder;
+    recorder->backend.open_bus = rec_open_bus;
+    recorder->backend.close_bus = rec_close_bus;
+    recorder->backend.transfer = rec_transfer;
+
+    pthread_mutex_init(&recorder->lock, NULL);
+
+    yaml_set_i2c_backend(handle, &recorder->backend);
+
+    return(recorder);
+}
+
+void
+yaml_i2c_recorder_free(YamlI2cRecorder *recorder)
+{
+    unsigned int idx;
+
+    if (recorder == NULL) {
+        return;
+    }
+
+    yaml_set_i2c_backend(recorder->handle, recorder->previous);
+
+    fclose(recorder->file);
+    for (idx = 0; idx < recorder->name_count; idx++) {
+        free(recorder->names[idx]);
+    }
+    free(recorder->names);
+    pthread_mutex_destroy(&recorder->lock);
+    free(recorder);
+}
+
+static bool
+get_bytes(FILE *file, unsigned char *buf, size_t count)
+{
+    return(count == 0 || fread(buf, count, 1, file) == 1);
+}
+
+static unsigned int
+get_u16(const unsigned char *buf)
+{
+    return(buf[0] | (buf[1] << 8));
+}
+
+static unsigned long long
+get_u32(const unsigned char *buf)
+{
+    return(get_u16(buf) | ((unsigned long long)get_u16(buf + 2) << 16));
+}
+
+/* Sleeps until a point of the replay */
+static void
+pace(unsigned long long start, unsigned long long offset_usec)
+{
+    unsigned long long at = start + offset_usec;
+    struct timespec ts;
+
+    ts.tv_sec = at / 1000000;
+    ts.tv_nsec = (at % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+            EINTR) {
+    }
+}
+
+static void
+free_cmds(i2c_op *ops, unsigned int count)
+{
+    unsigned int idx;
+
+    for (idx = 0; ops != NULL && idx < count; idx++) {
+        free(ops[idx].data);
+    }
+    free(ops);
+}
+
+/* Reads the commands of a transfer record */
+static int
+read_cmds(FILE *file, YamlConfigHandle handle, const char *subsyst,
+          char **names, unsigned int name_count, i2c_op *ops, int *status,
+          unsigned int count)
+{
+    unsigned char buf[8];
+    unsigned int idx;
+    unsigned int id;
+
+    for (idx = 0; idx < count; idx++) {
+        i2c_op *op = &ops[idx];
+
+        if (!get_bytes(file, buf, sizeof(buf))) {
+            return(EINVAL);
+        }
+
+        id = get_u16(&buf[0]);
+        if (id >= name_count || names[id] == NULL ||
+                yaml_find_device(handle, subsyst, names[id]) == NULL) {
+            return(EINVAL);
+        }
+
+        op->device = names[id];
+        op->direction = (buf[3] & TRACE_WRITE) != 0;
+        op->set_register = (buf[3] & TRACE_SET_REGISTER) != 0;
+        op->register_address = buf[4];
+        op->byte_count = get_u16(&buf[5]);
+        status[idx] = buf[7];
+
+        op->data = (unsigned char *)calloc(op->byte_count == 0 ?
+                                           1 : op->byte_count, 1);
+        if (op->data == NULL) {
+            return(ENOMEM);
+        }
+        if (op->direction == WRITE &&
+                !get_bytes(file, op->data, op->byte_count)) {
+            return(EINVAL);
+        }
+    }
+
+    return(0);
+}
+
+int
+yaml_i2c_trace_replay(YamlConfigHandle handle, const char *subsyst,
+                      const char *path, unsigned int speedup,
+                      YamlI2cReplayStats *stats)
+{
+    const YamlI2cBackend *backend;
+    YamlI2cReplayStats result;
+    unsigned char buf[13];
+    unsigned long long start;
+    unsigned long long offset = 0;
+    char **names = NULL;
+    unsigned int name_count = 0;
+    unsigned int idx;
+    FILE *file;
+    int rc = 0;
+
+    if (handle == NULL || subsyst == NULL || path == NULL) {
+        return(EINVAL);
+    }
+
+    // never replay writes on the real adapters, even through recorders
+    backend = yaml_get_i2c_backend(handle);
+    if (backend == NULL || end_backend(backend) == yaml_i2c_default_backend()) {
+        return(EINVAL);
+    }
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return(errno);
+    }
+
+    if (!get_bytes(file, buf, 8) || memcmp(buf, TRACE_MAGIC, 4) != 0 ||
+            buf[4] != TRACE_VERSION) {
+        fclose(file);
+        return(EINVAL);
+    }
+
+    memset(&result, 0, sizeof(result));
+    start = now_usec();
+
+    while (rc == 0 && get_bytes(file, buf, 1)) {
+        if (buf[0] == TRACE_NAME) {
+            unsigned int id;
+            char **grown;
+
+            if (!get_bytes(file, &buf[1], 3)) {
+                rc = EINVAL;
+                break;
+            }
+            id = get_u16(&buf[1]);
+            if (id >= name_count) {
+                grown = (char **)realloc(names, (id + 1) * sizeof(char *));
+                if (grown == NULL) {
+                    rc = ENOMEM;
+                    break;
+                }
+                names = grown;
+                memset(&names[name_count], 0,
+                       (id + 1 - name_count) * sizeof(char *));
+                name_count = id + 1;
+            }
+            free(names[id]);
+            names[id] = (char *)calloc(buf[3] + 1, 1);
+            if (names[id] == NULL) {
+                rc = ENOMEM;
+            } else if (!get_bytes(file, (unsigned char *)names[id], buf[3])) {
+                rc = EINVAL;
+            }
+        } else if (buf[0] == TRACE_TRANSFER) {
+            const YamlBus *bus = NULL;
+            unsigned int count;
+            unsigned int bus_id;
+            i2c_op *ops;
+            i2c_op **cmds;
+            int *status;
+            int *cmd_rc;
+            void *bus_handle;
+
+            if (!get_bytes(file, &buf[1], 12)) {
+                rc = EINVAL;
+                break;
+            }
+            bus_id = get_u16(&buf[1]);
+            count = get_u16(&buf[3]);
+            if (bus_id < name_count && names[bus_id] != NULL) {
+                bus = yaml_find_bus(handle, subsyst, names[bus_id]);
+            }
+            if (bus == NULL || count == 0) {
+                rc = EINVAL;
+                break;
+            }
+
+            ops = (i2c_op *)calloc(count, sizeof(i2c_op));
+            cmds = (i2c_op **)calloc(count, sizeof(i2c_op *));
+            status = (int *)calloc(count, sizeof(int));
+            cmd_rc = (int *)calloc(count, sizeof(int));
+            if (ops == NULL || cmds == NULL || status == NULL ||
+                    cmd_rc == NULL) {
+                rc = ENOMEM;
+            } else {
+                rc = read_cmds(file, handle, subsyst, names, name_count, ops,
+                               status, count);
+            }
+
+            if (rc == 0) {
+                if (result.transfers != 0) {
+                    offset += get_u32(&buf[5]);
+                }
+                if (speedup != 0) {
+                    pace(start, offset / speedup);
+                }
+
+                for (idx = 0; idx < count; idx++) {
+                    cmds[idx] = &ops[idx];
+                }
+
+                if (backend->open_bus(backend->context, bus,
+                                      &bus_handle) == 0) {
+                    backend->transfer(backend->context, bus_handle, handle,
+                                      subsyst, bus, cmds, count, cmd_rc);
+                    backend->close_bus(backend->context, bus_handle);
+                } else {
+                    for (idx = 0; idx < count; idx++) {
+                        cmd_rc[idx] = ENODEV;
+                    }
+                }
+
+                for (idx = 0; idx < count; idx++) {
+                    if ((cmd_rc[idx] < 0 || cmd_rc[idx] > 0xff ?
+                         0xff : cmd_rc[idx]) != status[idx]) {
+                        result.mismatches++;
+                    }
+                }
+
+                result.transfers++;
+                result.messages += count;
+                result.recorded_usec += get_u32(&buf[9]);
+                result.span_usec = offset;
+            }
+
+            free_cmds(ops, count);
+            free(cmds);
+            free(status);
+            free(cmd_rc);
+        } else {
+            rc = EINVAL;
+        }
+    }
+
+    result.elapsed_usec = now_usec() - start;
+
+    fclose(file);
+    for (idx = 0; idx < name_count; idx++) {
+        free(names[idx]);
+    }
+    free(names);
+
+    if (stats != NULL) {
+        *stats = result;
+    }
+
+    return(rc);
+}
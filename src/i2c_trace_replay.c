@@ -0,0 +1,93 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Replays an i2c trace of yaml_i2c_recorder_new() on the i2c simulator of
+ * a platform, and reports the recorded and modeled bus time.
+ *
+ * Usage: ops-i2c-trace-replay <directory with manifest.yaml> <trace>
+ *                             [speedup] [kHz] [transaction ns]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+#define REPLAY_SUBSYSTEM    "replay"
+
+int
+main(int argc, char **argv)
+{
+    YamlConfigHandle handle;
+    YamlI2cSimConfig config;
+    YamlI2cSimStats sim_stats;
+    YamlI2cReplayStats stats;
+    YamlI2cSim *sim;
+    unsigned int speedup = 0;
+    int rc;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <directory> <trace> [speedup] [kHz] "
+                "[transaction ns]\n", argv[0]);
+        return(1);
+    }
+    if (argc > 3) {
+        speedup = strtoul(argv[3], NULL, 0);
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.bus_khz = argc > 4 ? strtoul(argv[4], NULL, 0) : 100;
+    config.transaction_ns = argc > 5 ? strtoul(argv[5], NULL, 0) : 20000;
+    config.realtime = speedup != 0;
+
+    handle = yaml_new_config_handle();
+    if (yaml_add_subsystem(handle, REPLAY_SUBSYSTEM, argv[1]) != 0 ||
+            yaml_parse_devices(handle, REPLAY_SUBSYSTEM) != 0) {
+        fprintf(stderr, "%s: can't parse the devices of %s\n", argv[0],
+                argv[1]);
+        return(1);
+    }
+
+    sim = yaml_i2c_sim_new(handle, REPLAY_SUBSYSTEM, &config);
+    if (sim == NULL) {
+        return(1);
+    }
+    yaml_set_i2c_backend(handle, yaml_i2c_sim_backend(sim));
+
+    rc = yaml_i2c_trace_replay(handle, REPLAY_SUBSYSTEM, argv[2], speedup,
+                               &stats);
+    if (rc != 0) {
+        fprintf(stderr, "%s: replay of %s failed: %s\n", argv[0], argv[2],
+                strerror(rc));
+    }
+
+    yaml_i2c_sim_get_stats(sim, &sim_stats);
+
+    printf("transfers        %llu\n", stats.transfers);
+    printf("commands         %llu\n", stats.messages);
+    printf("mismatches       %llu\n", stats.mismatches);
+    printf("recorded span    %.3f ms\n", stats.span_usec / 1e3);
+    printf("recorded busy    %.3f ms\n", stats.recorded_usec / 1e3);
+    printf("modeled busy     %.3f ms\n", sim_stats.elapsed_ns / 1e6);
+    printf("replay time      %.3f ms\n", stats.elapsed_usec / 1e3);
+
+    yaml_set_i2c_backend(handle, NULL);
+    yaml_i2c_sim_free(sim);
+
+    return(rc == 0 ? 0 : 1);
+}
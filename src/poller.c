@@ -0,0 +1,547 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Platform poller. Subscribers register the registers and bit ops they want
+ * to read, each with a period. The periods are multiples of a shared tick
+ * (the gcd of all periods), and each tick reads every register that is due
+ * exactly once, with one yaml_register_read_list() call, then passes the
+ * value to every subscriber of that register.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config-yaml.h"
+
+#define POLLER_MAX_REGISTER_SIZE    4
+
+typedef struct {
+    bool                in_use;
+    bool                bit_op;
+    char                *device;
+    unsigned char       register_address;
+    unsigned char       register_size;
+    unsigned int        bit_mask;
+    bool                negative_polarity;
+    unsigned int        period_ms;
+    YamlPollerCallback  callback;
+    void                *context;
+    unsigned int        generation; /* of the slot, bumped on reuse */
+} poller_sub;
+
+/* A due subscription, copied so the tick runs without the lock */
+typedef struct {
+    int                 id;
+    unsigned int        generation;
+    int                 read;
+    bool                bit_op;
+    unsigned int        bit_mask;
+    bool                negative_polarity;
+    YamlPollerCallback  callback;
+    void                *context;
+} poller_call;
+
+struct YamlPoller {
+    YamlConfigHandle    handle;
+    char                *subsyst;
+    unsigned int        granularity_ms;
+    unsigned int        tick_ms;
+    unsigned long long  now_ms;
+    poller_sub          *subs;
+    unsigned int        sub_count;
+    pthread_mutex_t     lock;
+    pthread_cond_t      wake;       /* signalled to stop the thread */
+    pthread_cond_t      idle;       /* signalled at the end of a tick */
+    bool                ticking;
+    pthread_t           tick_thread;
+    pthread_t           thread;
+    bool                running;
+    bool                stop;
+};
+
+static unsigned int
+gcd(unsigned int a, unsigned int b)
+{
+    while (b != 0) {
+        unsigned int t = a % b;
+        a = b;
+        b = t;
+    }
+    return(a);
+}
+
+/* Recomputes the shared tick. Called with the lock held. */
+static void
+update_tick(YamlPoller *poller)
+{
+    unsigned int tick = 0;
+    unsigned int idx;
+
+    for (idx = 0; idx < poller->sub_count; idx++) {
+        if (poller->subs[idx].in_use) {
+            tick = gcd(poller->subs[idx].period_ms, tick);
+        }
+    }
+
+    poller->tick_ms = tick;
+
+    // a subscription is due when now_ms is a multiple of its period, so
+    // now_ms must stay a multiple of the tick when the tick grows
+    if (tick != 0) {
+        poller->now_ms = (poller->now_ms + tick - 1) / tick * tick;
+    }
+}
+
+YamlPoller *
+yaml_poller_new(YamlConfigHandle handle, const char *subsyst,
+                unsigned int granularity_ms)
+{
+    YamlPoller *poller;
+    pthread_condattr_t attr;
+
+    if (handle == NULL || subsyst == NULL) {
+        return(NULL);
+    }
+
+    poller = (YamlPoller *)calloc(1, sizeof(YamlPoller));
+    if (poller == NULL) {
+        return(NULL);
+    }
+
+    poller->handle = handle;
+    poller->subsyst = strdup(subsyst);
+    poller->granularity_ms = granularity_ms == 0 ? 1 : granularity_ms;
+
+    pthread_mutex_init(&poller->lock, NULL);
+
+    // the wakeups are on the monotonic clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&poller->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&poller->idle, NULL);
+
+    return(poller);
+}
+
+void
+yaml_poller_free(YamlPoller *poller)
+{
+    unsigned int idx;
+
+    if (poller == NULL) {
+        return;
+    }
+
+    yaml_poller_stop(poller);
+
+    for (idx = 0; idx < poller->sub_count; idx++) {
+        free(poller->subs[idx].device);
+    }
+
+    pthread_cond_destroy(&poller->wake);
+    pthread_cond_destroy(&poller->idle);
+    pthread_mutex_destroy(&poller->lock);
+    free(poller->subs);
+    free(poller->subsyst);
+    free(poller);
+}
+
+static int
+add_sub(YamlPoller *poller, const poller_sub *sub)
+{
+    poller_sub *subs;
+    unsigned int generation;
+    unsigned int idx;
+
+    if (sub->register_size == 0 ||
+            sub->register_size > POLLER_MAX_REGISTER_SIZE ||
+            sub->callback == NULL ||
+            yaml_find_device(poller->handle, poller->subsyst,
+                             sub->device) == NULL) {
+        return(-1);
+    }
+
+    pthread_mutex_lock(&poller->lock);
+
+    // reuse the slot of an unsubscribed entry, so ids stay small
+    for (idx = 0; idx < poller->sub_count; idx++) {
+        if (!poller->subs[idx].in_use) {
+            break;
+        }
+    }
+
+    if (idx == poller->sub_count) {
+        subs = (poller_sub *)realloc(poller->subs,
+                                     (idx + 1) * sizeof(poller_sub));
+        if (subs == NULL) {
+            pthread_mutex_unlock(&poller->lock);
+            return(-1);
+        }
+        poller->subs = subs;
+        poller->sub_count++;
+        memset(&poller->subs[idx], 0, sizeof(poller_sub));
+    }
+
+    // a tick that copied the old subscription of the slot skips it
+    generation = poller->subs[idx].generation + 1;
+    poller->subs[idx] = *sub;
+    poller->subs[idx].device = strdup(sub->device);
+    poller->subs[idx].in_use = true;
+    poller->subs[idx].generation = generation;
+
+    // round the period up to the granularity
+    poller->subs[idx].period_ms =
+        (sub->period_ms + poller->granularity_ms - 1) /
+        poller->granularity_ms * poller->granularity_ms;
+    if (poller->subs[idx].period_ms == 0) {
+        poller->subs[idx].period_ms = poller->granularity_ms;
+    }
+
+    update_tick(poller);
+
+    pthread_mutex_unlock(&poller->lock);
+
+    return(idx);
+}
+
+int
+yaml_poller_subscribe_bit_op(YamlPoller *poller, const i2c_bit_op *op,
+                             unsigned int period_ms,
+                             YamlPollerCallback callback, void *context)
+{
+    poller_sub sub;
+
+    if (poller == NULL || op == NULL || op->device == NULL) {
+        return(-1);
+    }
+
+    memset(&sub, 0, sizeof(sub));
+    sub.bit_op = true;
+    sub.device = op->device;
+    sub.register_address = op->register_address;
+    sub.register_size = op->register_size == 0 ? 1 : op->register_size;
+    sub.bit_mask = op->bit_mask;
+    sub.negative_polarity = op->negative_polarity;
+    sub.period_ms = period_ms;
+    sub.callback = callback;
+    sub.context = context;
+
+    return(add_sub(poller, &sub));
+}
+
+int
+yaml_poller_subscribe_register(YamlPoller *poller, const char *device,
+                               unsigned char register_address,
+                               unsigned char register_size,
+                               unsigned int period_ms,
+                               YamlPollerCallback callback, void *context)
+{
+    poller_sub sub;
+
+    if (poller == NULL || device == NULL) {
+        return(-1);
+    }
+
+    memset(&sub, 0, sizeof(sub));
+    sub.device = (char *)device;
+    sub.register_address = register_address;
+    sub.register_size = register_size;
+    sub.period_ms = period_ms;
+    sub.callback = callback;
+    sub.context = context;
+
+    return(add_sub(poller, &sub));
+}
+
+int
+yaml_poller_unsubscribe(YamlPoller *poller, int id)
+{
+    if (poller == NULL || id < 0) {
+        return(-1);
+    }
+
+    pthread_mutex_lock(&poller->lock);
+
+    if ((unsigned int)id >= poller->sub_count || !poller->subs[id].in_use) {
+        pthread_mutex_unlock(&poller->lock);
+        return(-1);
+    }
+
+    poller->subs[id].in_use = false;
+    free(poller->subs[id].device);
+    poller->subs[id].device = NULL;
+
+    update_tick(poller);
+
+    // the callback may be running; once this returns it won't be called
+    while (poller->ticking &&
+            !pthread_equal(poller->tick_thread, pthread_self())) {
+        pthread_cond_wait(&poller->idle, &poller->lock);
+    }
+
+    pthread_mutex_unlock(&poller->lock);
+
+    return(0);
+}
+
+unsigned int
+yaml_poller_get_tick(YamlPoller *poller)
+{
+    unsigned int tick;
+
+    if (poller == NULL) {
+        return(0);
+    }
+
+    pthread_mutex_lock(&poller->lock);
+    tick = poller->tick_ms;
+    pthread_mutex_unlock(&poller->lock);
+
+    return(tick);
+}
+
+/* Returns the read for a register, adding it if it isn't in the tick yet.
+ * The read gets its own copy of the device name, as the subscription may
+ * be removed during the tick. */
+static int
+find_read(YamlRegisterRead *reads, int *read_count, const poller_sub *sub)
+{
+    int idx;
+
+    for (idx = 0; idx < *read_count; idx++) {
+        if (reads[idx].register_address == sub->register_address &&
+                reads[idx].register_size == sub->register_size &&
+                strcmp(reads[idx].device, sub->device) == 0) {
+            return(idx);
+        }
+    }
+
+    memset(&reads[idx], 0, sizeof(YamlRegisterRead));
+    reads[idx].device = strdup(sub->device);
+    if (reads[idx].device == NULL) {
+        return(-1);
+    }
+    reads[idx].register_address = sub->register_address;
+    reads[idx].register_size = sub->register_size;
+    (*read_count)++;
+
+    return(idx);
+}
+
+/* Returns true if a copied subscription is still subscribed */
+static bool
+still_subscribed(YamlPoller *poller, const poller_call *call)
+{
+    bool subscribed;
+
+    pthread_mutex_lock(&poller->lock);
+    subscribed = poller->subs[call->id].in_use &&
+                 poller->subs[call->id].generation == call->generation;
+    pthread_mutex_unlock(&poller->lock);
+
+    return(subscribed);
+}
+
+int
+yaml_poller_tick(YamlPoller *poller)
+{
+    YamlRegisterRead *reads = NULL;
+    poller_call *calls = NULL;
+    unsigned long long now;
+    int read_count = 0;
+    int call_count = 0;
+    int rc;
+    int idx;
+
+    if (poller == NULL) {
+        return(-1);
+    }
+
+    pthread_mutex_lock(&poller->lock);
+
+    // one tick at a time; a callback can't tick
+    if (poller->ticking &&
+            pthread_equal(poller->tick_thread, pthread_self())) {
+        pthread_mutex_unlock(&poller->lock);
+        return(-1);
+    }
+    while (poller->ticking) {
+        pthread_cond_wait(&poller->idle, &poller->lock);
+    }
+
+    if (poller->tick_ms == 0) {
+        pthread_mutex_unlock(&poller->lock);
+        return(0);
+    }
+
+    reads = (YamlRegisterRead *)calloc(poller->sub_count,
+                                       sizeof(YamlRegisterRead));
+    calls = (poller_call *)calloc(poller->sub_count, sizeof(poller_call));
+    if (reads == NULL || calls == NULL) {
+        pthread_mutex_unlock(&poller->lock);
+        free(reads);
+        free(calls);
+        return(-1);
+    }
+
+    // the clock moves on now, so a change of tick during the sweep
+    // realigns the next tick
+    now = poller->now_ms;
+    poller->now_ms += poller->tick_ms;
+
+    // collect the registers that are due, once each, and their subscribers
+    for (idx = 0; idx < (int)poller->sub_count; idx++) {
+        poller_sub *sub = &poller->subs[idx];
+        poller_call *call = &calls[call_count];
+
+        if (!sub->in_use || now % sub->period_ms != 0) {
+            continue;
+        }
+
+        call->read = find_read(reads, &read_count, sub);
+        if (call->read < 0) {
+            continue;
+        }
+        call->id = idx;
+        call->generation = sub->generation;
+        call->bit_op = sub->bit_op;
+        call->bit_mask = sub->bit_mask;
+        call->negative_polarity = sub->negative_polarity;
+        call->callback = sub->callback;
+        call->context = sub->context;
+        call_count++;
+    }
+
+    poller->ticking = true;
+    poller->tick_thread = pthread_self();
+
+    pthread_mutex_unlock(&poller->lock);
+
+    // the sweep and the callbacks run unlocked
+    rc = yaml_register_read_list(poller->handle, poller->subsyst, reads,
+                                 read_count);
+
+    // fan the values out to the subscribers
+    for (idx = 0; rc != ENOMEM && idx < call_count; idx++) {
+        poller_call *call = &calls[idx];
+        unsigned int value = reads[call->read].value;
+
+        if (!still_subscribed(poller, call)) {
+            continue;
+        }
+
+        if (call->bit_op) {
+            value = ((value & call->bit_mask) != 0) != call->negative_polarity;
+        }
+
+        call->callback(call->id, reads[call->read].rc, value, call->context);
+    }
+
+    pthread_mutex_lock(&poller->lock);
+    poller->ticking = false;
+    pthread_cond_broadcast(&poller->idle);
+    pthread_mutex_unlock(&poller->lock);
+
+    for (idx = 0; idx < read_count; idx++) {
+        free((char *)reads[idx].device);
+    }
+    free(reads);
+    free(calls);
+
+    return(rc == ENOMEM ? -1 : read_count);
+}
+
+static void
+add_ms(struct timespec *ts, unsigned int ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void *
+poller_thread(void *arg)
+{
+    YamlPoller *poller = (YamlPoller *)arg;
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    pthread_mutex_lock(&poller->lock);
+
+    while (!poller->stop) {
+        unsigned int tick;
+
+        pthread_mutex_unlock(&poller->lock);
+        yaml_poller_tick(poller);
+        pthread_mutex_lock(&poller->lock);
+
+        // absolute wakeups, so slow sweeps don't make the ticks drift
+        tick = poller->tick_ms;
+        add_ms(&next, tick == 0 ? poller->granularity_ms : tick);
+
+        while (!poller->stop &&
+                pthread_cond_timedwait(&poller->wake, &poller->lock,
+                                       &next) != ETIMEDOUT) {
+        }
+    }
+
+    pthread_mutex_unlock(&poller->lock);
+
+    return(NULL);
+}
+
+int
+yaml_poller_start(YamlPoller *poller)
+{
+    if (poller == NULL || poller->running) {
+        return(-1);
+    }
+
+    poller->stop = false;
+
+    if (pthread_create(&poller->thread, NULL, poller_thread, poller) != 0) {
+        return(-1);
+    }
+
+    poller->running = true;
+
+    return(0);
+}
+
+void
+yaml_poller_stop(YamlPoller *poller)
+{
+    if (poller == NULL || !poller->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&poller->lock);
+    poller->stop = true;
+    pthread_cond_signal(&poller->wake);
+    pthread_mutex_unlock(&poller->lock);
+
+    pthread_join(poller->thread, NULL);
+    poller->running = false;
+}
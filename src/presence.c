@@ -0,0 +1,399 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Interrupt-gated module presence scan. The interrupt bits of the pluggable
+ * ports are aggregated in a few CPLD registers. A scan reads those first,
+ * and reads the presence registers only of the ports whose interrupt is
+ * asserted, or that have no interrupt bit. Every full_sweep_ms all presence
+ * registers are read anyway, in case an interrupt was missed.
+ *
+ * A port whose interrupt stays asserted without a presence change (e.g. a
+ * module alarm on the shared interrupt line) has its interrupt masked, if
+ * the port has a mask bit, until the next full sweep.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config-yaml.h"
+
+typedef struct {
+    unsigned int        port;
+    unsigned int        present_read;   /* index in YamlPresenceScan.reads */
+    unsigned int        present_mask;
+    bool                present_negative;
+    int                 int_read;       /* -1 if the port has no interrupt */
+    unsigned int        int_mask;
+    bool                int_negative;
+    const i2c_bit_op    *mask_op;       /* NULL if it can't be masked */
+    bool                masked;
+    bool                known;          /* presence was read at least once */
+    bool                present;
+} scan_port;
+
+struct YamlPresenceScan {
+    YamlConfigHandle    handle;
+    char                *subsyst;
+    unsigned int        full_sweep_ms;
+    unsigned long long  last_full_ms;
+    bool                swept;          /* a full sweep was done */
+
+    /* the interrupt registers, then the presence registers */
+    YamlRegisterRead    *reads;
+    unsigned int        int_count;
+    unsigned int        read_count;
+
+    /* presence registers of a gated scan */
+    YamlRegisterRead    *gated;
+    int                 *gated_of;      /* presence read -> gated, or -1 */
+
+    scan_port           *ports;
+    unsigned int        port_count;
+
+    /* interrupt mask writes of a scan */
+    scan_port           **mask_ports;
+    const i2c_bit_op    **mask_ops;
+    unsigned int        *mask_values;
+    int                 *mask_results;
+};
+
+static unsigned long long
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+
+/* Returns the read of a bit op's register among reads[first..count),
+ * adding it if needed */
+static unsigned int
+find_read(YamlPresenceScan *scan, unsigned int first, const i2c_bit_op *op)
+{
+    unsigned char size = op->register_size == 0 ? 1 : op->register_size;
+    unsigned int idx;
+
+    for (idx = first; idx < scan->read_count; idx++) {
+        if (scan->reads[idx].register_address == op->register_address &&
+                scan->reads[idx].register_size == size &&
+                strcmp(scan->reads[idx].device, op->device) == 0) {
+            return(idx);
+        }
+    }
+
+    scan->reads[idx].device = op->device;
+    scan->reads[idx].register_address = op->register_address;
+    scan->reads[idx].register_size = size;
+    scan->read_count++;
+
+    return(idx);
+}
+
+/* Finds the presence, interrupt and interrupt mask bit ops of a port */
+static bool
+port_signals(const YamlPort *port, const i2c_bit_op **present,
+             const i2c_bit_op **interrupt, const i2c_bit_op **mask)
+{
+    *present = NULL;
+    *interrupt = NULL;
+    *mask = NULL;
+
+    if (!port->pluggable || port->connector == NULL) {
+        return(false);
+    }
+
+    if (strcmp(port->connector, SFPP) == 0) {
+        *present = port->module_signals.sfp.sfpp_mod_present;
+        *interrupt = port->module_signals.sfp.sfpp_interrupt;
+    } else if (strcmp(port->connector, QSFPP) == 0) {
+        *present = port->module_signals.qsfp.qsfpp_mod_present;
+        *interrupt = port->module_signals.qsfp.qsfpp_interrupt;
+    } else if (strcmp(port->connector, QSFP28) == 0) {
+        *present = port->module_signals.qsfp28.qsfp28p_mod_present;
+        *interrupt = port->module_signals.qsfp28.qsfp28p_interrupt;
+        *mask = port->module_signals.qsfp28.qsfp28p_interrupt_mask;
+    }
+
+    if (*interrupt != NULL && (*interrupt)->device == NULL) {
+        *interrupt = NULL;
+    }
+    if (*mask != NULL && ((*mask)->device == NULL || *interrupt == NULL)) {
+        *mask = NULL;
+    }
+
+    return(*present != NULL && (*present)->device != NULL);
+}
+
+YamlPresenceScan *
+yaml_presence_scan_new(YamlConfigHandle handle, const char *subsyst,
+                       unsigned int full_sweep_ms)
+{
+    YamlPresenceScan *scan;
+    const YamlPort *ports;
+    const i2c_bit_op *present;
+    const i2c_bit_op *interrupt;
+    const i2c_bit_op *mask;
+    unsigned int count;
+    unsigned int idx;
+
+    if (handle == NULL || subsyst == NULL) {
+        return(NULL);
+    }
+
+    ports = yaml_get_ports_array(handle, subsyst, &count);
+    if (ports == NULL) {
+        return(NULL);
+    }
+
+    scan = (YamlPresenceScan *)calloc(1, sizeof(YamlPresenceScan));
+    if (scan == NULL) {
+        return(NULL);
+    }
+
+    scan->handle = handle;
+    scan->subsyst = strdup(subsyst);
+    scan->full_sweep_ms = full_sweep_ms;
+    scan->reads = (YamlRegisterRead *)calloc(2 * count,
+                                             sizeof(YamlRegisterRead));
+    scan->gated = (YamlRegisterRead *)calloc(count, sizeof(YamlRegisterRead));
+    scan->gated_of = (int *)calloc(2 * count, sizeof(int));
+    scan->ports = (scan_port *)calloc(count, sizeof(scan_port));
+    scan->mask_ports = (scan_port **)calloc(count, sizeof(scan_port *));
+    scan->mask_ops = (const i2c_bit_op **)calloc(count,
+                                                 sizeof(i2c_bit_op *));
+    scan->mask_values = (unsigned int *)calloc(count, sizeof(unsigned int));
+    scan->mask_results = (int *)calloc(count, sizeof(int));
+
+    if (scan->subsyst == NULL || scan->reads == NULL || scan->gated == NULL ||
+            scan->gated_of == NULL || scan->ports == NULL ||
+            scan->mask_ports == NULL || scan->mask_ops == NULL ||
+            scan->mask_values == NULL || scan->mask_results == NULL) {
+        yaml_presence_scan_free(scan);
+        return(NULL);
+    }
+
+    // the interrupt registers come first, so a gated scan reads a prefix
+    for (idx = 0; idx < count; idx++) {
+        if (port_signals(&ports[idx], &present, &interrupt, &mask) &&
+                interrupt != NULL) {
+            find_read(scan, 0, interrupt);
+        }
+    }
+    scan->int_count = scan->read_count;
+
+    for (idx = 0; idx < count; idx++) {
+        scan_port *port;
+
+        if (!port_signals(&ports[idx], &present, &interrupt, &mask)) {
+            continue;
+        }
+
+        port = &scan->ports[scan->port_count++];
+        port->port = idx;
+        port->present_read = find_read(scan, scan->int_count, present);
+        port->present_mask = present->bit_mask;
+        port->present_negative = present->negative_polarity;
+        port->int_read = -1;
+        if (interrupt != NULL) {
+            port->int_read = find_read(scan, 0, interrupt);
+            port->int_mask = interrupt->bit_mask;
+            port->int_negative = interrupt->negative_polarity;
+        }
+        port->mask_op = mask;
+        // the mask state is unknown, so the first sweep unmasks
+        port->masked = (mask != NULL);
+    }
+
+    return(scan);
+}
+
+void
+yaml_presence_scan_free(YamlPresenceScan *scan)
+{
+    if (scan == NULL) {
+        return;
+    }
+
+    free(scan->mask_results);
+    free(scan->mask_values);
+    free(scan->mask_ops);
+    free(scan->mask_ports);
+    free(scan->ports);
+    free(scan->gated_of);
+    free(scan->gated);
+    free(scan->reads);
+    free(scan->subsyst);
+    free(scan);
+}
+
+static bool
+interrupt_asserted(const YamlPresenceScan *scan, const scan_port *port)
+{
+    const YamlRegisterRead *read = &scan->reads[port->int_read];
+
+    return(read->rc == 0 &&
+           ((read->value & port->int_mask) != 0) != port->int_negative);
+}
+
+/* Reads the presence registers of the ports that have to be read. Returns
+ * errno of the first failed read. */
+static int
+read_gated(YamlPresenceScan *scan)
+{
+    unsigned int gated_count = 0;
+    unsigned int idx;
+    int rc;
+
+    for (idx = scan->int_count; idx < scan->read_count; idx++) {
+        scan->gated_of[idx] = -1;
+        scan->reads[idx].rc = EAGAIN;
+    }
+
+    for (idx = 0; idx < scan->port_count; idx++) {
+        scan_port *port = &scan->ports[idx];
+        unsigned int read = port->present_read;
+
+        if (scan->gated_of[read] >= 0) {
+            continue;
+        }
+        if (port->int_read >= 0 &&
+                (port->masked || !interrupt_asserted(scan, port))) {
+            continue;
+        }
+
+        scan->gated[gated_count] = scan->reads[read];
+        scan->gated_of[read] = gated_count++;
+    }
+
+    rc = yaml_register_read_list(scan->handle, scan->subsyst, scan->gated,
+                                 gated_count);
+
+    for (idx = scan->int_count; idx < scan->read_count; idx++) {
+        if (scan->gated_of[idx] >= 0) {
+            scan->reads[idx] = scan->gated[scan->gated_of[idx]];
+        }
+    }
+
+    return(rc);
+}
+
+int
+yaml_presence_scan(YamlPresenceScan *scan, YamlPresenceEdge *edges,
+                   unsigned int max_edges, unsigned int *edge_count)
+{
+    unsigned long long now = now_ms();
+    unsigned int count = 0;
+    unsigned int mask_count = 0;
+    unsigned int idx;
+    bool full;
+    int rc;
+
+    if (scan == NULL || edge_count == NULL ||
+            (edges == NULL && max_edges != 0)) {
+        return(EINVAL);
+    }
+
+    *edge_count = 0;
+
+    full = !scan->swept || (scan->full_sweep_ms != 0 &&
+                            now - scan->last_full_ms >= scan->full_sweep_ms);
+
+    if (full) {
+        rc = yaml_register_read_list(scan->handle, scan->subsyst,
+                                     scan->reads, scan->read_count);
+    } else {
+        rc = yaml_register_read_list(scan->handle, scan->subsyst,
+                                     scan->reads, scan->int_count);
+        if (rc != ENOMEM) {
+            int gated_rc = read_gated(scan);
+
+            rc = rc != 0 ? rc : gated_rc;
+        }
+    }
+    if (rc == ENOMEM) {
+        return(rc);
+    }
+
+    if (full && rc == 0) {
+        scan->swept = true;
+        scan->last_full_ms = now;
+    }
+
+    for (idx = 0; idx < scan->port_count; idx++) {
+        scan_port *port = &scan->ports[idx];
+        const YamlRegisterRead *read = &scan->reads[port->present_read];
+        bool asserted = port->int_read >= 0 && interrupt_asserted(scan, port);
+        bool present;
+
+        if (read->rc != 0) {
+            continue;
+        }
+
+        present = ((read->value & port->present_mask) != 0) !=
+                  port->present_negative;
+
+        if (port->mask_op != NULL) {
+            bool mask = !full && asserted && port->known &&
+                        present == port->present;
+
+            if (mask != port->masked && (full || mask)) {
+                scan->mask_ports[mask_count] = port;
+                scan->mask_ops[mask_count] = port->mask_op;
+                scan->mask_values[mask_count] = mask;
+                mask_count++;
+            }
+        }
+
+        if (port->known && present == port->present) {
+            continue;
+        }
+
+        // no room: keep the old state, so the edge is reported next time
+        if (count == max_edges) {
+            continue;
+        }
+
+        port->known = true;
+        port->present = present;
+
+        edges[count].port = port->port;
+        edges[count].present = present;
+        count++;
+    }
+
+    if (mask_count != 0) {
+        int mask_rc = yaml_bit_op_write_list(scan->handle, scan->subsyst,
+                                             scan->mask_ops, mask_count,
+                                             scan->mask_values,
+                                             scan->mask_results);
+
+        for (idx = 0; idx < mask_count; idx++) {
+            if (scan->mask_results[idx] == 0) {
+                scan->mask_ports[idx]->masked = scan->mask_values[idx];
+            }
+        }
+
+        rc = rc != 0 ? rc : mask_rc;
+    }
+
+    *edge_count = count;
+
+    return(rc);
+}
@@ -0,0 +1,199 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * PSU status sweep. The status bit ops of all power supplies are usually in
+ * one or two CPLD registers. The sweep reads each distinct register once,
+ * decodes every status bit from it, and reports only the bits that changed
+ * as edges in the caller's array. Everything is set up when the sweep is
+ * created, so a sweep where nothing changed is one register read.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+typedef struct {
+    unsigned int        psu;
+    YamlPsuStatus       status;
+    unsigned int        read;       /* index in YamlPsuSweep.reads */
+    unsigned int        bit_mask;
+    bool                negative_polarity;
+    bool                known;      /* value was read at least once */
+    bool                value;
+} psu_bit;
+
+struct YamlPsuSweep {
+    YamlConfigHandle    handle;
+    char                *subsyst;
+    YamlRegisterRead    *reads;
+    unsigned int        read_count;
+    psu_bit             *bits;
+    unsigned int        bit_count;
+};
+
+/* Returns the read of a bit op's register, adding it if needed */
+static unsigned int
+find_read(YamlPsuSweep *sweep, const i2c_bit_op *op)
+{
+    unsigned char size = op->register_size == 0 ? 1 : op->register_size;
+    unsigned int idx;
+
+    for (idx = 0; idx < sweep->read_count; idx++) {
+        if (sweep->reads[idx].register_address == op->register_address &&
+                sweep->reads[idx].register_size == size &&
+                strcmp(sweep->reads[idx].device, op->device) == 0) {
+            return(idx);
+        }
+    }
+
+    sweep->reads[idx].device = op->device;
+    sweep->reads[idx].register_address = op->register_address;
+    sweep->reads[idx].register_size = size;
+    sweep->read_count++;
+
+    return(idx);
+}
+
+YamlPsuSweep *
+yaml_psu_sweep_new(YamlConfigHandle handle, const char *subsyst)
+{
+    YamlPsuSweep *sweep;
+    const YamlPsu *psus;
+    unsigned int count;
+    unsigned int idx;
+
+    if (handle == NULL || subsyst == NULL) {
+        return(NULL);
+    }
+
+    psus = yaml_get_psus_array(handle, subsyst, &count);
+    if (psus == NULL) {
+        return(NULL);
+    }
+
+    sweep = (YamlPsuSweep *)calloc(1, sizeof(YamlPsuSweep));
+    if (sweep == NULL) {
+        return(NULL);
+    }
+
+    sweep->handle = handle;
+    sweep->subsyst = strdup(subsyst);
+    sweep->reads = (YamlRegisterRead *)calloc(count * PSU_STATUS_COUNT,
+                                              sizeof(YamlRegisterRead));
+    sweep->bits = (psu_bit *)calloc(count * PSU_STATUS_COUNT, sizeof(psu_bit));
+    if (sweep->subsyst == NULL || sweep->reads == NULL ||
+            sweep->bits == NULL) {
+        yaml_psu_sweep_free(sweep);
+        return(NULL);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        const i2c_bit_op *ops[PSU_STATUS_COUNT];
+        int status;
+
+        ops[PSU_STATUS_PRESENT] = psus[idx].psu_present;
+        ops[PSU_STATUS_INPUT_OK] = psus[idx].psu_input_ok;
+        ops[PSU_STATUS_OUTPUT_OK] = psus[idx].psu_output_ok;
+
+        for (status = 0; status < PSU_STATUS_COUNT; status++) {
+            psu_bit *bit;
+
+            // a PSU may not describe every status bit
+            if (ops[status] == NULL || ops[status]->device == NULL) {
+                continue;
+            }
+
+            bit = &sweep->bits[sweep->bit_count++];
+            bit->psu = idx;
+            bit->status = (YamlPsuStatus)status;
+            bit->read = find_read(sweep, ops[status]);
+            bit->bit_mask = ops[status]->bit_mask;
+            bit->negative_polarity = ops[status]->negative_polarity;
+        }
+    }
+
+    return(sweep);
+}
+
+void
+yaml_psu_sweep_free(YamlPsuSweep *sweep)
+{
+    if (sweep == NULL) {
+        return;
+    }
+
+    free(sweep->bits);
+    free(sweep->reads);
+    free(sweep->subsyst);
+    free(sweep);
+}
+
+int
+yaml_psu_sweep(YamlPsuSweep *sweep, YamlPsuEdge *edges,
+               unsigned int max_edges, unsigned int *edge_count)
+{
+    unsigned int count = 0;
+    unsigned int idx;
+    int rc;
+
+    if (sweep == NULL || edge_count == NULL ||
+            (edges == NULL && max_edges != 0)) {
+        return(EINVAL);
+    }
+
+    *edge_count = 0;
+
+    rc = yaml_register_read_list(sweep->handle, sweep->subsyst, sweep->reads,
+                                 sweep->read_count);
+    if (rc == ENOMEM) {
+        return(rc);
+    }
+
+    for (idx = 0; idx < sweep->bit_count; idx++) {
+        psu_bit *bit = &sweep->bits[idx];
+        const YamlRegisterRead *read = &sweep->reads[bit->read];
+        bool value;
+
+        if (read->rc != 0) {
+            continue;
+        }
+
+        value = ((read->value & bit->bit_mask) != 0) != bit->negative_polarity;
+        if (bit->known && value == bit->value) {
+            continue;
+        }
+
+        // no room: keep the old value, so the edge is reported next time
+        if (count == max_edges) {
+            continue;
+        }
+
+        bit->known = true;
+        bit->value = value;
+
+        edges[count].psu = bit->psu;
+        edges[count].status = bit->status;
+        edges[count].value = value;
+        count++;
+    }
+
+    *edge_count = count;
+
+    return(rc);
+}
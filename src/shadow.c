@@ -0,0 +1,278 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Shadow register write cache. Bit op writes (fan speed, LEDs) are staged
+ * per (device, register), and yaml_shadow_flush() performs at most one
+ * read-modify-write per register. The read is skipped while the shadow copy
+ * is fresh, and the write is skipped when the masked bits don't change.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config-yaml.h"
+
+#define SHADOW_MAX_REGISTER_SIZE    4
+
+typedef struct {
+    char                *device;
+    unsigned char       register_address;
+    unsigned char       register_size;
+    bool                valid;          /* value matches the hardware */
+    unsigned int        value;
+    unsigned long long  synced_ms;      /* when value was read */
+    unsigned int        pending_mask;   /* bits staged since the last flush */
+    unsigned int        pending_value;
+} shadow_reg;
+
+struct YamlShadowCache {
+    YamlConfigHandle    handle;
+    char                *subsyst;
+    unsigned int        resync_ms;
+    shadow_reg          *regs;
+    unsigned int        count;
+    pthread_mutex_t     lock;
+};
+
+static unsigned long long
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+
+YamlShadowCache *
+yaml_shadow_new(YamlConfigHandle handle, const char *subsyst,
+                unsigned int resync_ms)
+{
+    YamlShadowCache *cache;
+
+    if (handle == NULL || subsyst == NULL) {
+        return(NULL);
+    }
+
+    cache = (YamlShadowCache *)calloc(1, sizeof(YamlShadowCache));
+    if (cache == NULL) {
+        return(NULL);
+    }
+
+    cache->handle = handle;
+    cache->subsyst = strdup(subsyst);
+    cache->resync_ms = resync_ms;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return(cache);
+}
+
+void
+yaml_shadow_free(YamlShadowCache *cache)
+{
+    unsigned int idx;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < cache->count; idx++) {
+        free(cache->regs[idx].device);
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->regs);
+    free(cache->subsyst);
+    free(cache);
+}
+
+/* Returns the shadow of a register, adding it if needed. Called with the
+ * lock held. */
+static shadow_reg *
+find_reg(YamlShadowCache *cache, const i2c_bit_op *op)
+{
+    shadow_reg *regs;
+    shadow_reg *reg;
+    unsigned char size = op->register_size == 0 ? 1 : op->register_size;
+    unsigned int idx;
+
+    for (idx = 0; idx < cache->count; idx++) {
+        reg = &cache->regs[idx];
+        if (reg->register_address == op->register_address &&
+                reg->register_size == size &&
+                strcmp(reg->device, op->device) == 0) {
+            return(reg);
+        }
+    }
+
+    regs = (shadow_reg *)realloc(cache->regs,
+                                 (cache->count + 1) * sizeof(shadow_reg));
+    if (regs == NULL) {
+        return(NULL);
+    }
+    cache->regs = regs;
+
+    reg = &cache->regs[cache->count++];
+    memset(reg, 0, sizeof(shadow_reg));
+    reg->device = strdup(op->device);
+    reg->register_address = op->register_address;
+    reg->register_size = size;
+
+    return(reg);
+}
+
+int
+yaml_shadow_set(YamlShadowCache *cache, const i2c_bit_op *op,
+                unsigned int value)
+{
+    shadow_reg *reg;
+
+    if (cache == NULL || op == NULL || op->device == NULL ||
+            op->register_size > SHADOW_MAX_REGISTER_SIZE ||
+            yaml_find_device(cache->handle, cache->subsyst,
+                             op->device) == NULL) {
+        return(-1);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    reg = find_reg(cache, op);
+    if (reg == NULL) {
+        pthread_mutex_unlock(&cache->lock);
+        return(-1);
+    }
+
+    // a later write to the same bits replaces the earlier one
+    reg->pending_value = (reg->pending_value & ~op->bit_mask) |
+                         (value & op->bit_mask);
+    reg->pending_mask |= op->bit_mask;
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return(0);
+}
+
+int
+yaml_shadow_get(YamlShadowCache *cache, const i2c_bit_op *op,
+                unsigned int *value)
+{
+    shadow_reg *reg;
+    unsigned int idx;
+    int rc = -1;
+
+    if (cache == NULL || op == NULL || op->device == NULL || value == NULL) {
+        return(-1);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    for (idx = 0; idx < cache->count; idx++) {
+        reg = &cache->regs[idx];
+        if (reg->valid && reg->register_address == op->register_address &&
+                strcmp(reg->device, op->device) == 0) {
+            *value = reg->value & op->bit_mask;
+            rc = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return(rc);
+}
+
+int
+yaml_shadow_flush(YamlShadowCache *cache)
+{
+    unsigned long long now = now_ms();
+    unsigned int idx;
+    int writes = 0;
+    int failed = 0;
+
+    if (cache == NULL) {
+        return(-1);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    for (idx = 0; idx < cache->count; idx++) {
+        shadow_reg *reg = &cache->regs[idx];
+        unsigned int value;
+
+        if (reg->pending_mask == 0) {
+            continue;
+        }
+
+        // the register may have been changed behind our back, so the
+        // shadow is refreshed every resync_ms
+        if (!reg->valid || (cache->resync_ms != 0 &&
+                            now - reg->synced_ms >= cache->resync_ms)) {
+            if (yaml_register_read(cache->handle, cache->subsyst, reg->device,
+                                   reg->register_address, reg->register_size,
+                                   &reg->value) != 0) {
+                reg->valid = false;
+                failed++;
+                continue;
+            }
+            reg->valid = true;
+            reg->synced_ms = now;
+        }
+
+        value = (reg->value & ~reg->pending_mask) |
+                (reg->pending_value & reg->pending_mask);
+
+        if (value != reg->value) {
+            // the staged bits are kept, so the next flush retries
+            if (yaml_register_write(cache->handle, cache->subsyst,
+                                    reg->device, reg->register_address,
+                                    reg->register_size, value) != 0) {
+                reg->valid = false;
+                failed++;
+                continue;
+            }
+            reg->value = value;
+            writes++;
+        }
+
+        reg->pending_mask = 0;
+        reg->pending_value = 0;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return(failed ? -1 : writes);
+}
+
+void
+yaml_shadow_invalidate(YamlShadowCache *cache)
+{
+    unsigned int idx;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    for (idx = 0; idx < cache->count; idx++) {
+        cache->regs[idx].valid = false;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,219 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Thermal policy engine. The alarm and fan thresholds of the thermal.yaml
+ * sensors are kept as one 32 byte aligned float array per threshold, and a
+ * temperature array in sensor order is evaluated against them in a single
+ * branch-free loop that the compiler can vectorize. The loop doesn't
+ * allocate, so it can be called from the control loop.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+#define THERMAL_ALIGN           32
+
+enum {
+    EMERGENCY_ON,
+    EMERGENCY_OFF,
+    CRITICAL_ON,
+    CRITICAL_OFF,
+    ALARM_MAX_ON,
+    ALARM_MAX_OFF,
+    ALARM_MIN,
+    LOW_CRIT,
+    FAN_MAX_ON,
+    FAN_MAX_OFF,
+    FAST_ON,
+    FAST_OFF,
+    MEDIUM_ON,
+    MEDIUM_OFF,
+    THRESHOLD_COUNT
+};
+
+struct YamlThermalEngine {
+    unsigned int        count;
+    float               *thresholds[THRESHOLD_COUNT];
+};
+
+static float *
+alloc_thresholds(unsigned int count)
+{
+    void *ptr = NULL;
+    size_t size = (count + 1) * sizeof(float);
+
+    if (posix_memalign(&ptr, THERMAL_ALIGN, size) != 0) {
+        return(NULL);
+    }
+    memset(ptr, 0, size);
+    return((float *)ptr);
+}
+
+YamlThermalEngine *
+thermal_engine_new(unsigned int count, const YamlSensor *sensors)
+{
+    YamlThermalEngine *engine;
+    unsigned int idx;
+
+    if (sensors == NULL && count != 0) {
+        return(NULL);
+    }
+
+    engine = (YamlThermalEngine *)calloc(1, sizeof(YamlThermalEngine));
+    if (engine == NULL) {
+        return(NULL);
+    }
+
+    engine->count = count;
+
+    for (idx = 0; idx < THRESHOLD_COUNT; idx++) {
+        engine->thresholds[idx] = alloc_thresholds(count);
+        if (engine->thresholds[idx] == NULL) {
+            thermal_engine_free(engine);
+            return(NULL);
+        }
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        const YamlAlarmThresholds *alarm = &sensors[idx].alarm_thresholds;
+        const YamlFanThresholds *fan = &sensors[idx].fan_thresholds;
+
+        engine->thresholds[EMERGENCY_ON][idx] = alarm->emergency_on;
+        engine->thresholds[EMERGENCY_OFF][idx] = alarm->emergency_off;
+        engine->thresholds[CRITICAL_ON][idx] = alarm->critical_on;
+        engine->thresholds[CRITICAL_OFF][idx] = alarm->critical_off;
+        engine->thresholds[ALARM_MAX_ON][idx] = alarm->max_on;
+        engine->thresholds[ALARM_MAX_OFF][idx] = alarm->max_off;
+        engine->thresholds[ALARM_MIN][idx] = alarm->min;
+        engine->thresholds[LOW_CRIT][idx] = alarm->low_crit;
+        engine->thresholds[FAN_MAX_ON][idx] = fan->max_on;
+        engine->thresholds[FAN_MAX_OFF][idx] = fan->max_off;
+        engine->thresholds[FAST_ON][idx] = fan->fast_on;
+        engine->thresholds[FAST_OFF][idx] = fan->fast_off;
+        engine->thresholds[MEDIUM_ON][idx] = fan->medium_on;
+        engine->thresholds[MEDIUM_OFF][idx] = fan->medium_off;
+    }
+
+    return(engine);
+}
+
+void
+thermal_engine_free(YamlThermalEngine *engine)
+{
+    unsigned int idx;
+
+    if (engine == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < THRESHOLD_COUNT; idx++) {
+        free(engine->thresholds[idx]);
+    }
+    free(engine);
+}
+
+unsigned int
+thermal_engine_get_count(const YamlThermalEngine *engine)
+{
+    return(engine == NULL ? 0 : engine->count);
+}
+
+/*
+ * A level is entered when the temperature reaches its "on" threshold, and
+ * is kept while the previous state was at or above it and the temperature
+ * is still above its "off" threshold. Higher levels are tested last, so
+ * they win. Every test is a select, so the loop has no branches. The
+ * compares can't raise FP exceptions on the finite temperatures, and
+ * without trapping math GCC is free to vectorize them.
+ */
+__attribute__((optimize("no-trapping-math")))
+int
+thermal_engine_evaluate(const YamlThermalEngine *engine, const float *temps,
+                        int *alarms, int *fan_speeds, unsigned int count)
+{
+    const float *restrict emergency_on;
+    const float *restrict emergency_off;
+    const float *restrict critical_on;
+    const float *restrict critical_off;
+    const float *restrict max_on;
+    const float *restrict max_off;
+    const float *restrict min;
+    const float *restrict low_crit;
+    const float *restrict fan_max_on;
+    const float *restrict fan_max_off;
+    const float *restrict fast_on;
+    const float *restrict fast_off;
+    const float *restrict medium_on;
+    const float *restrict medium_off;
+    int demand = NORMAL;
+    unsigned int idx;
+
+    if (engine == NULL || temps == NULL || alarms == NULL ||
+            fan_speeds == NULL || count != engine->count) {
+        return(-1);
+    }
+
+    emergency_on = engine->thresholds[EMERGENCY_ON];
+    emergency_off = engine->thresholds[EMERGENCY_OFF];
+    critical_on = engine->thresholds[CRITICAL_ON];
+    critical_off = engine->thresholds[CRITICAL_OFF];
+    max_on = engine->thresholds[ALARM_MAX_ON];
+    max_off = engine->thresholds[ALARM_MAX_OFF];
+    min = engine->thresholds[ALARM_MIN];
+    low_crit = engine->thresholds[LOW_CRIT];
+    fan_max_on = engine->thresholds[FAN_MAX_ON];
+    fan_max_off = engine->thresholds[FAN_MAX_OFF];
+    fast_on = engine->thresholds[FAST_ON];
+    fast_off = engine->thresholds[FAST_OFF];
+    medium_on = engine->thresholds[MEDIUM_ON];
+    medium_off = engine->thresholds[MEDIUM_OFF];
+
+    for (idx = 0; idx < count; idx++) {
+        float t = temps[idx];
+        int prev = alarms[idx];
+        int prev_fan = fan_speeds[idx];
+        int alarm = THERMAL_ALARM_NORMAL;
+        int fan = NORMAL;
+
+        alarm = (t <= min[idx]) ? THERMAL_ALARM_MIN : alarm;
+        alarm = (t <= low_crit[idx]) ? THERMAL_ALARM_LOW_CRITICAL : alarm;
+        alarm = ((t >= max_on[idx]) |
+                 ((prev >= THERMAL_ALARM_MAX) & (t > max_off[idx]))) ?
+                THERMAL_ALARM_MAX : alarm;
+        alarm = ((t >= critical_on[idx]) |
+                 ((prev >= THERMAL_ALARM_CRITICAL) & (t > critical_off[idx]))) ?
+                THERMAL_ALARM_CRITICAL : alarm;
+        alarm = ((t >= emergency_on[idx]) |
+                 ((prev >= THERMAL_ALARM_EMERGENCY) & (t > emergency_off[idx]))) ?
+                THERMAL_ALARM_EMERGENCY : alarm;
+
+        fan = ((t >= medium_on[idx]) |
+               ((prev_fan >= MEDIUM) & (t > medium_off[idx]))) ? MEDIUM : fan;
+        fan = ((t >= fast_on[idx]) |
+               ((prev_fan >= FAST) & (t > fast_off[idx]))) ? FAST : fan;
+        fan = ((t >= fan_max_on[idx]) |
+               ((prev_fan >= MAX) & (t > fan_max_off[idx]))) ? MAX : fan;
+
+        alarms[idx] = alarm;
+        fan_speeds[idx] = fan;
+        demand = fan > demand ? fan : demand;
+    }
+
+    return(demand);
+}
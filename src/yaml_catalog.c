@@ -0,0 +1,91 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Builds and queries the platform catalog index, for the installer.
+ *
+ * Usage: ops-yaml-catalog build <root> <index>
+ *        ops-yaml-catalog find <index> <product name> [manufacturer]
+ *        ops-yaml-catalog list <index>
+ *
+ * find prints the subsystem directory of the product, and fails if it is
+ * unknown.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+static int
+usage(const char *name)
+{
+    fprintf(stderr, "usage: %s build <root> <index>\n"
+            "       %s find <index> <product name> [manufacturer]\n"
+            "       %s list <index>\n", name, name, name);
+    return(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    const YamlCatalogPlatform *platform;
+    YamlCatalog *catalog;
+    unsigned int count;
+    unsigned int idx;
+    int rc;
+
+    if (argc == 4 && strcmp(argv[1], "build") == 0) {
+        rc = yaml_catalog_build(argv[2], argv[3]);
+        if (rc != 0) {
+            fprintf(stderr, "%s: can't build %s from %s: %s\n", argv[0],
+                    argv[3], argv[2], strerror(rc));
+            return(1);
+        }
+        return(0);
+    }
+
+    if (!((argc == 4 || argc == 5) && strcmp(argv[1], "find") == 0) &&
+            !(argc == 3 && strcmp(argv[1], "list") == 0)) {
+        return(usage(argv[0]));
+    }
+
+    catalog = yaml_catalog_open(argv[2]);
+    if (catalog == NULL) {
+        perror(argv[2]);
+        return(1);
+    }
+
+    if (strcmp(argv[1], "list") == 0) {
+        platform = yaml_catalog_get_platforms(catalog, &count);
+        for (idx = 0; idx < count; idx++) {
+            printf("%s\t%s\t%s\n", platform[idx].manufacturer,
+                   platform[idx].product_name, platform[idx].dir);
+        }
+        rc = 0;
+    } else {
+        platform = yaml_catalog_find(catalog, argc == 5 ? argv[4] : NULL,
+                                     argv[3]);
+        if (platform != NULL) {
+            printf("%s\n", platform->dir);
+        }
+        rc = platform != NULL ? 0 : 1;
+    }
+
+    yaml_catalog_close(catalog);
+
+    return(rc);
+}
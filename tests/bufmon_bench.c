@@ -0,0 +1,122 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Benchmark for the buffer monitoring threshold engine. It evaluates
+ * 10240 counters, about the size of the AS5712-54X bufmond.yaml file, with
+ * each supported implementation and in both evaluation modes.
+ *
+ * Usage: bufmon_bench [counters] [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config-yaml.h"
+
+static const char *impl_names[] = { "scalar", "sse2", "avx2" };
+static const char *mode_names[] = { "current", "peak" };
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((double)ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned int count = 10240;
+    unsigned int iterations = 10000;
+    unsigned long long *thresholds;
+    unsigned long long *samples;
+    unsigned long long *bitmap;
+    bool *enabled;
+    unsigned int words;
+    unsigned int idx;
+    int mode;
+    int impl;
+
+    if (argc > 1) {
+        count = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        iterations = strtoul(argv[2], NULL, 0);
+    }
+
+    words = (count + 63) / 64;
+    thresholds = malloc(count * sizeof(*thresholds));
+    samples = malloc(count * sizeof(*samples));
+    enabled = malloc(count * sizeof(*enabled));
+    bitmap = malloc(words * sizeof(*bitmap));
+
+    if (thresholds == NULL || samples == NULL || enabled == NULL ||
+            bitmap == NULL) {
+        return(1);
+    }
+
+    srand(1);
+    for (idx = 0; idx < count; idx++) {
+        thresholds[idx] = 3407664;
+        samples[idx] = rand() % 3600000;
+        enabled[idx] = (idx % 16) != 0;
+    }
+
+    for (mode = BUFMON_MODE_CURRENT; mode <= BUFMON_MODE_PEAK; mode++) {
+        for (impl = BUFMON_IMPL_SCALAR; impl <= BUFMON_IMPL_AVX2; impl++) {
+            YamlBufmonEngine *engine;
+            double start;
+            double elapsed;
+            int crossed = 0;
+            unsigned int iter;
+
+            engine = bufmon_engine_new(count, thresholds, enabled, mode);
+            if (engine == NULL) {
+                return(1);
+            }
+            if (bufmon_engine_set_impl(engine, impl) != 0) {
+                printf("%-8s %-7s not supported\n", mode_names[mode],
+                       impl_names[impl]);
+                bufmon_engine_free(engine);
+                continue;
+            }
+
+            start = now_ns();
+            for (iter = 0; iter < iterations; iter++) {
+                crossed = bufmon_engine_evaluate(engine, samples, count,
+                                                 bitmap, words);
+            }
+            elapsed = now_ns() - start;
+
+            printf("%-8s %-7s %8.1f ns/eval %6.3f ns/counter (%d crossed)\n",
+                   mode_names[mode], impl_names[impl], elapsed / iterations,
+                   elapsed / iterations / count, crossed);
+
+            bufmon_engine_free(engine);
+        }
+    }
+
+    free(thresholds);
+    free(samples);
+    free(enabled);
+    free(bitmap);
+
+    return(0);
+}
@@ -14,6 +14,11 @@
  *    under the License.
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+
 #include <gtest/gtest.h>
 
 #include "../include/config-yaml.h"
@@ -24,9 +29,11 @@
 #define GOOD_MANIFEST "good.manifest.yaml"
 #define BAD_MANIFEST "bad.manifest.yaml"
 #define EMPTY_MANIFEST "empty.manifest.yaml"
+#define BAD_QOS_MANIFEST "bad_qos.manifest.yaml"
 #define MANIFEST_FILE "manifest.yaml"
 
 int ops_cnt;
+unsigned char read_byte;
 
 int
 unlink_file(const char *dir, const char *filename)
@@ -48,6 +55,85 @@ link_file(const char *dir, const char *filename, const char *linkname)
     return (system(cmd));
 }
 
+/* Records the poller callbacks of cfg_017 */
+struct PollerCalls {
+    int             count;
+    int             last_id;
+    unsigned int    values[8];
+};
+
+static void
+poller_callback(int id, int rc, unsigned int value, void *context)
+{
+    PollerCalls *calls = (PollerCalls *)context;
+
+    if (rc == 0 && id >= 0 && id < 8) {
+        calls->values[id] = value;
+    }
+    calls->last_id = id;
+    calls->count++;
+}
+
+/* A cfg_017 subscriber that calls back into the poller */
+struct PollerSelf {
+    YamlPoller      *poller;
+    const char      *device;
+    PollerCalls     *calls;
+    int             other_id;
+    int             new_id;
+    int             tick_rc;
+    int             count;
+};
+
+static void
+poller_self_callback(int id, int rc, unsigned int value, void *context)
+{
+    PollerSelf *self = (PollerSelf *)context;
+
+    self->count++;
+    self->tick_rc = yaml_poller_tick(self->poller);
+    yaml_poller_unsubscribe(self->poller, self->other_id);
+    self->new_id = yaml_poller_subscribe_register(self->poller, self->device,
+                                                  0, 2, 5000, poller_callback,
+                                                  self->calls);
+    yaml_poller_unsubscribe(self->poller, id);
+}
+
+/* Reference thermal policy for cfg_018, one sensor at a time */
+static void
+thermal_reference(const YamlSensor *sensor, float t, int *alarm, int *fan)
+{
+    const YamlAlarmThresholds *a = &sensor->alarm_thresholds;
+    const YamlFanThresholds *f = &sensor->fan_thresholds;
+
+    if (t >= a->emergency_on ||
+            (*alarm >= THERMAL_ALARM_EMERGENCY && t > a->emergency_off)) {
+        *alarm = THERMAL_ALARM_EMERGENCY;
+    } else if (t >= a->critical_on ||
+            (*alarm >= THERMAL_ALARM_CRITICAL && t > a->critical_off)) {
+        *alarm = THERMAL_ALARM_CRITICAL;
+    } else if (t >= a->max_on ||
+            (*alarm >= THERMAL_ALARM_MAX && t > a->max_off)) {
+        *alarm = THERMAL_ALARM_MAX;
+    } else if (t <= a->low_crit) {
+        *alarm = THERMAL_ALARM_LOW_CRITICAL;
+    } else if (t <= a->min) {
+        *alarm = THERMAL_ALARM_MIN;
+    } else {
+        *alarm = THERMAL_ALARM_NORMAL;
+    }
+
+    if (t >= f->max_on || (*fan >= MAX && t > f->max_off)) {
+        *fan = MAX;
+    } else if (t >= f->fast_on || (*fan >= FAST && t > f->fast_off)) {
+        *fan = FAST;
+    } else if (t >= f->medium_on || (*fan >= MEDIUM && t > f->medium_off)) {
+        *fan = MEDIUM;
+    } else {
+        *fan = NORMAL;
+    }
+}
+
 /* Define Test Suite class for customer setup and teardown functions. */
 class CfgYamlTestSuite : public testing::Test
 {
@@ -422,6 +508,2482 @@ TEST_F(CfgYamlTestSuite, cfg_007_yaml_parse_unspecified_bad_files) {
     unlink_file(cwd, MANIFEST_FILE);
 }
 
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the yaml_get_*_array APIs
+ * - fail with an invalid subsystem
+ * - return the same elements as the per-index getters
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_008_yaml_get_arrays) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int count = 0;
+    unsigned int idx;
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    /* Try creating a subsystem. It should PASS. */
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+
+    ASSERT_EQ(yaml_parse_thermal(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_ports(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_fans(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_psus(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_leds(cy_handle, BASE_SUBSYSTEM), 0);
+
+    /* An unknown subsystem returns NULL and a zero count */
+    printf("Get port array with invalid subsystem.\n");
+    count = 1;
+    ASSERT_TRUE(yaml_get_ports_array(cy_handle, "junk_subsystem", &count) == NULL);
+    ASSERT_EQ(count, 0u);
+
+    /* Arrays must alias the same storage as the per-index getters */
+    printf("Compare arrays against per-index getters.\n");
+    const YamlPort *ports = yaml_get_ports_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_port_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&ports[idx], yaml_get_port(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    const YamlSensor *sensors = yaml_get_sensors_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_sensor_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&sensors[idx], yaml_get_sensor(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    const YamlPsu *psus = yaml_get_psus_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_psu_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&psus[idx], yaml_get_psu(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    const YamlLed *leds = yaml_get_leds_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_led_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&leds[idx], yaml_get_led(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    const YamlFanFru *frus = yaml_get_fan_frus_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_fan_fru_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&frus[idx], yaml_get_fan_fru(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    ASSERT_EQ(yaml_parse_qos(cy_handle, BASE_SUBSYSTEM), 0);
+
+    const YamlCosMapEntry *cos = yaml_get_cos_map_entries_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_cos_map_entry_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&cos[idx], yaml_get_cos_map_entry(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    const YamlDscpMapEntry *dscp = yaml_get_dscp_map_entries_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_EQ((int)count, yaml_get_dscp_map_entry_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&dscp[idx], yaml_get_dscp_map_entry(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the COS and DSCP lookup tables
+ * - match the parsed map entries for a good qos file
+ * - export in code point order
+ * - are unavailable when a map does not cover every code point
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_009_yaml_qos_map_tables) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     idx;
+    YamlQosMapValue table[QOS_DSCP_MAP_SIZE];
+    const YamlQosMapValue *value;
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+
+    printf("Parse qos with valid yaml.\n");
+    rc = yaml_parse_qos(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    /* Every DSCP entry is reachable through its code point */
+    printf("Look up every DSCP map entry by code point.\n");
+    for (idx = 0; idx < yaml_get_dscp_map_entry_count(cy_handle, BASE_SUBSYSTEM); idx++) {
+        const YamlDscpMapEntry *entry = yaml_get_dscp_map_entry(cy_handle, BASE_SUBSYSTEM, idx);
+        value = yaml_get_dscp_map_value(cy_handle, BASE_SUBSYSTEM, entry->code_point);
+        ASSERT_TRUE(value != NULL);
+        ASSERT_EQ(value->local_priority, entry->local_priority);
+        ASSERT_EQ(strcmp(entry->color, "green") == 0, value->color == QOS_COLOR_GREEN);
+        ASSERT_EQ(strcmp(entry->color, "yellow") == 0, value->color == QOS_COLOR_YELLOW);
+        ASSERT_EQ(strcmp(entry->color, "red") == 0, value->color == QOS_COLOR_RED);
+    }
+    ASSERT_TRUE(yaml_get_dscp_map_value(cy_handle, BASE_SUBSYSTEM, QOS_DSCP_MAP_SIZE) == NULL);
+
+    /* Export is in code point order */
+    printf("Export the DSCP and COS maps.\n");
+    ASSERT_EQ(yaml_export_dscp_map(cy_handle, BASE_SUBSYSTEM, table, QOS_DSCP_MAP_SIZE),
+              QOS_DSCP_MAP_SIZE);
+    for (idx = 0; idx < QOS_DSCP_MAP_SIZE; idx++) {
+        value = yaml_get_dscp_map_value(cy_handle, BASE_SUBSYSTEM, idx);
+        ASSERT_EQ(table[idx].local_priority, value->local_priority);
+        ASSERT_EQ(table[idx].color, value->color);
+    }
+    ASSERT_EQ(yaml_export_dscp_map(cy_handle, BASE_SUBSYSTEM, table, QOS_DSCP_MAP_SIZE - 1), -1);
+
+    ASSERT_EQ(yaml_export_cos_map(cy_handle, BASE_SUBSYSTEM, table, QOS_COS_MAP_SIZE),
+              QOS_COS_MAP_SIZE);
+    for (idx = 0; idx < yaml_get_cos_map_entry_count(cy_handle, BASE_SUBSYSTEM); idx++) {
+        const YamlCosMapEntry *entry = yaml_get_cos_map_entry(cy_handle, BASE_SUBSYSTEM, idx);
+        ASSERT_EQ(table[entry->code_point].local_priority, entry->local_priority);
+    }
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, BAD_MANIFEST, MANIFEST_FILE);
+
+    /* The bad qos file is missing a DSCP code point */
+    printf("Create a SUBSYSTEM with an incomplete DSCP map.\n");
+    rc = yaml_add_subsystem(cy_handle, "bad", cwd);
+    ASSERT_EQ(rc, 0);
+    rc = yaml_parse_qos(cy_handle, "bad");
+    ASSERT_EQ(rc, 0);
+    ASSERT_TRUE(yaml_get_dscp_map_value(cy_handle, "bad", 0) == NULL);
+    ASSERT_EQ(yaml_export_dscp_map(cy_handle, "bad", table, QOS_DSCP_MAP_SIZE), -1);
+    ASSERT_TRUE(yaml_get_cos_map_value(cy_handle, "bad", 0) != NULL);
+
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+TEST_F(CfgYamlTestSuite, cfg_010_yaml_qos_named_profiles) {
+    char    cwd[1024];
+    char    copy_dir[] = "/tmp/cfg_yaml_ut.XXXXXX";
+    char    cmd[4096];
+    int     rc = 0;
+    int     idx;
+    unsigned int count;
+    const YamlScheduleProfileEntry *sched;
+    const YamlQueueProfileEntry *queue;
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+
+    printf("Parse qos with valid yaml.\n");
+    rc = yaml_parse_qos(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    /* The flat entry lists are the profile named by default_name */
+    printf("Verify the default schedule and queue profiles.\n");
+    ASSERT_EQ(yaml_get_schedule_profile_count(cy_handle, BASE_SUBSYSTEM), 2);
+    ASSERT_EQ(yaml_get_queue_profile_count(cy_handle, BASE_SUBSYSTEM), 2);
+    ASSERT_STREQ(yaml_get_schedule_profile_name(cy_handle, BASE_SUBSYSTEM, 1), "default");
+    ASSERT_STREQ(yaml_get_queue_profile_name(cy_handle, BASE_SUBSYSTEM, 1), "default");
+    ASSERT_TRUE(yaml_get_schedule_profile_name(cy_handle, BASE_SUBSYSTEM, 2) == NULL);
+
+    sched = yaml_get_schedule_profile_entries(cy_handle, BASE_SUBSYSTEM, NULL, &count);
+    ASSERT_TRUE(sched != NULL);
+    ASSERT_EQ((int)count, yaml_get_schedule_profile_entry_count(cy_handle, BASE_SUBSYSTEM));
+    for (idx = 0; idx < (int)count; idx++) {
+        const YamlScheduleProfileEntry *entry =
+            yaml_get_schedule_profile_entry(cy_handle, BASE_SUBSYSTEM, idx);
+        sched = yaml_find_schedule_profile_entry(cy_handle, BASE_SUBSYSTEM,
+                                                 "default", entry->queue);
+        ASSERT_TRUE(sched != NULL);
+        ASSERT_EQ(sched->queue, entry->queue);
+        ASSERT_STREQ(sched->algorithm, entry->algorithm);
+    }
+
+    queue = yaml_get_queue_profile_entries(cy_handle, BASE_SUBSYSTEM, "default", &count);
+    ASSERT_TRUE(queue != NULL);
+    ASSERT_EQ((int)count, yaml_get_queue_profile_entry_count(cy_handle, BASE_SUBSYSTEM));
+
+    /* Named profile entries are sorted by queue */
+    printf("Verify the named schedule and queue profiles.\n");
+    sched = yaml_get_schedule_profile_entries(cy_handle, BASE_SUBSYSTEM, "strict", &count);
+    ASSERT_TRUE(sched != NULL);
+    ASSERT_EQ(count, 3u);
+    ASSERT_EQ(sched[0].queue, 0);
+    ASSERT_EQ(sched[1].queue, 3);
+    ASSERT_EQ(sched[2].queue, 7);
+
+    sched = yaml_find_schedule_profile_entry(cy_handle, BASE_SUBSYSTEM, "strict", 7);
+    ASSERT_TRUE(sched != NULL);
+    ASSERT_STREQ(sched->algorithm, "strict");
+    ASSERT_TRUE(yaml_find_schedule_profile_entry(cy_handle, BASE_SUBSYSTEM, "strict", 1) == NULL);
+    ASSERT_TRUE(yaml_find_schedule_profile_entry(cy_handle, BASE_SUBSYSTEM, "strict", 100) == NULL);
+
+    queue = yaml_find_queue_profile_entry(cy_handle, BASE_SUBSYSTEM, "single-queue", 0);
+    ASSERT_TRUE(queue != NULL);
+    ASSERT_EQ(queue->local_priority, 0);
+
+    /* Unknown profiles and subsystems */
+    printf("Request an unknown profile.\n");
+    ASSERT_TRUE(yaml_get_schedule_profile_entries(cy_handle, BASE_SUBSYSTEM, "none", &count) == NULL);
+    ASSERT_EQ(count, 0u);
+    ASSERT_TRUE(yaml_find_queue_profile_entry(cy_handle, BASE_SUBSYSTEM, "none", 0) == NULL);
+    ASSERT_EQ(yaml_get_queue_profile_count(cy_handle, "unknown"), -1);
+
+    /* A queue number past the hardware queues is rejected, not allocated */
+    printf("Parse qos with a huge queue number.\n");
+    ASSERT_TRUE(mkdtemp(copy_dir) != NULL);
+    snprintf(cmd, sizeof(cmd),
+             "cp %s/%s %s/%s && sed '0,/queue: *0$/s//queue: 2000000000/' "
+             "%s/qos.yaml > %s/qos.yaml", cwd, GOOD_MANIFEST, copy_dir,
+             MANIFEST_FILE, cwd, copy_dir);
+    ASSERT_EQ(system(cmd), 0);
+    rc = yaml_add_subsystem(cy_handle, "huge", copy_dir);
+    ASSERT_EQ(rc, 0);
+    rc = yaml_parse_qos(cy_handle, "huge");
+    ASSERT_EQ(rc, -1);
+
+    snprintf(cmd, sizeof(cmd), "/bin/rm -rf %s", copy_dir);
+    system(cmd);
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the QOS trust, algorithm and color strings
+ * - are decoded at parse time for a good qos file
+ * - fail the parse when a color, algorithm or trust value is unknown
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_011_yaml_qos_enum_values) {
+    char    cwd[1024];
+    char    copy_dir[] = "/tmp/cfg_yaml_ut.XXXXXX";
+    char    cmd[4096];
+    int     rc = 0;
+    int     idx;
+    const YamlQosInfo *qos_info;
+    static const char *bad_values[] = {
+        "0,/algorithm: *dwrr$/s//algorithm: fifo/",
+        "s/default_qos_trust: *none$/default_qos_trust: vlan/",
+    };
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+
+    printf("Parse qos with valid yaml.\n");
+    rc = yaml_parse_qos(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    /* The decoded values agree with the strings */
+    printf("Verify the decoded trust, algorithm and color values.\n");
+    qos_info = yaml_get_qos_info(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_TRUE(qos_info != NULL);
+    ASSERT_STREQ(qos_info->trust, "none");
+    ASSERT_EQ(qos_info->trust_id, QOS_TRUST_NONE);
+
+    for (idx = 0; idx < yaml_get_schedule_profile_entry_count(cy_handle, BASE_SUBSYSTEM); idx++) {
+        const YamlScheduleProfileEntry *entry =
+            yaml_get_schedule_profile_entry(cy_handle, BASE_SUBSYSTEM, idx);
+        ASSERT_EQ(strcmp(entry->algorithm, "dwrr") == 0,
+                  entry->algorithm_id == QOS_ALGORITHM_DWRR);
+        ASSERT_EQ(strcmp(entry->algorithm, "strict") == 0,
+                  entry->algorithm_id == QOS_ALGORITHM_STRICT);
+    }
+
+    for (idx = 0; idx < yaml_get_cos_map_entry_count(cy_handle, BASE_SUBSYSTEM); idx++) {
+        const YamlCosMapEntry *entry = yaml_get_cos_map_entry(cy_handle, BASE_SUBSYSTEM, idx);
+        ASSERT_EQ(strcmp(entry->color, "green") == 0, entry->color_id == QOS_COLOR_GREEN);
+        ASSERT_EQ(strcmp(entry->color, "yellow") == 0, entry->color_id == QOS_COLOR_YELLOW);
+        ASSERT_EQ(strcmp(entry->color, "red") == 0, entry->color_id == QOS_COLOR_RED);
+    }
+
+    for (idx = 0; idx < yaml_get_dscp_map_entry_count(cy_handle, BASE_SUBSYSTEM); idx++) {
+        const YamlDscpMapEntry *entry = yaml_get_dscp_map_entry(cy_handle, BASE_SUBSYSTEM, idx);
+        ASSERT_EQ(strcmp(entry->color, "green") == 0, entry->color_id == QOS_COLOR_GREEN);
+        ASSERT_EQ(strcmp(entry->color, "yellow") == 0, entry->color_id == QOS_COLOR_YELLOW);
+        ASSERT_EQ(strcmp(entry->color, "red") == 0, entry->color_id == QOS_COLOR_RED);
+    }
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, BAD_QOS_MANIFEST, MANIFEST_FILE);
+
+    /* The bad qos file has an unknown COS map color */
+    printf("Parse qos with an unknown color.\n");
+    rc = yaml_add_subsystem(cy_handle, "bad", cwd);
+    ASSERT_EQ(rc, 0);
+    rc = yaml_parse_qos(cy_handle, "bad");
+    ASSERT_EQ(rc, -1);
+
+    /* Copies of the good qos file with an unknown algorithm, then trust */
+    printf("Parse qos with an unknown algorithm and an unknown trust.\n");
+    ASSERT_TRUE(mkdtemp(copy_dir) != NULL);
+    for (idx = 0; idx < (int)(sizeof(bad_values) / sizeof(bad_values[0]));
+            idx++) {
+        char subsyst[32];
+
+        snprintf(cmd, sizeof(cmd),
+                 "cp %s/%s %s/%s && sed '%s' %s/qos.yaml > %s/qos.yaml && "
+                 "! cmp -s %s/qos.yaml %s/qos.yaml", cwd, GOOD_MANIFEST,
+                 copy_dir, MANIFEST_FILE, bad_values[idx], cwd, copy_dir,
+                 cwd, copy_dir);
+        ASSERT_EQ(system(cmd), 0);
+
+        snprintf(subsyst, sizeof(subsyst), "bad%d", idx);
+        rc = yaml_add_subsystem(cy_handle, subsyst, copy_dir);
+        ASSERT_EQ(rc, 0);
+        rc = yaml_parse_qos(cy_handle, subsyst);
+        ASSERT_EQ(rc, -1);
+    }
+
+    snprintf(cmd, sizeof(cmd), "/bin/rm -rf %s", copy_dir);
+    system(cmd);
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+TEST_F(CfgYamlTestSuite, cfg_012_yaml_parse_bufmon) {
+    char    cwd[1024];
+    char    name[128];
+    int     rc = 0;
+    int     idx;
+    unsigned int count;
+    const unsigned int *counters;
+    const YamlBufmonInfo *info;
+    YamlBufmonCounter counter;
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+
+    printf("Parse bufmon with valid yaml.\n");
+    rc = yaml_parse_bufmon(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    info = yaml_get_bufmon_info(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_TRUE(info != NULL);
+    ASSERT_TRUE(info->cap_mode_current);
+    ASSERT_FALSE(info->cap_mode_peak);
+    ASSERT_EQ(yaml_get_bufmon_counter_count(cy_handle, BASE_SUBSYSTEM), 7);
+
+    /* Every counter can be found by its formatted name */
+    printf("Look up every counter by name.\n");
+    for (idx = 0; idx < yaml_get_bufmon_counter_count(cy_handle, BASE_SUBSYSTEM); idx++) {
+        rc = yaml_get_bufmon_counter_name(cy_handle, BASE_SUBSYSTEM, idx, name, sizeof(name));
+        ASSERT_GT(rc, 0);
+        ASSERT_EQ(yaml_find_bufmon_counter(cy_handle, BASE_SUBSYSTEM, name), idx);
+    }
+    ASSERT_EQ(yaml_get_bufmon_counter_name(cy_handle, BASE_SUBSYSTEM, 0, name, 4), -1);
+
+    idx = yaml_find_bufmon_counter(cy_handle, BASE_SUBSYSTEM,
+                    "ingress-port-priority-group/um-headroom-buffer-count/1/1");
+    ASSERT_EQ(idx, 3);
+    ASSERT_EQ(yaml_get_bufmon_counter(cy_handle, BASE_SUBSYSTEM, idx, &counter), 0);
+    ASSERT_STREQ(counter.name[0], "ingress-port-priority-group");
+    ASSERT_STREQ(counter.name[3], "1");
+    ASSERT_STREQ(counter.counter_name, "um-headroom-buffer-count");
+    ASSERT_EQ(counter.port, 1);
+    ASSERT_EQ(counter.priority_group, 1);
+    ASSERT_EQ(counter.queue, -1);
+    ASSERT_EQ(counter.trigger_threshold, 851760ULL);
+    ASSERT_FALSE(counter.enabled);
+
+    ASSERT_EQ(yaml_get_bufmon_counter(cy_handle, BASE_SUBSYSTEM, 6, &counter), 0);
+    ASSERT_EQ(counter.queue, 1);
+    ASSERT_EQ(counter.port, -1);
+    ASSERT_EQ(counter.hw_unit_id, 1);
+    ASSERT_EQ(yaml_get_bufmon_counter(cy_handle, BASE_SUBSYSTEM, 7, &counter), -1);
+
+    ASSERT_EQ(yaml_find_bufmon_counter(cy_handle, BASE_SUBSYSTEM, "device/data/NONE"), -1);
+    ASSERT_EQ(yaml_find_bufmon_counter(cy_handle, BASE_SUBSYSTEM, "device/data/NONE/1"), -1);
+    ASSERT_EQ(yaml_find_bufmon_counter(cy_handle, BASE_SUBSYSTEM, "device/data/NONE/NONE/NONE"), -1);
+
+    /* Port iteration is ordered by priority group, then file order */
+    printf("Iterate over the counters of a port.\n");
+    counters = yaml_get_bufmon_port_counters(cy_handle, BASE_SUBSYSTEM, 1, -1, &count);
+    ASSERT_TRUE(counters != NULL);
+    ASSERT_EQ(count, 4u);
+    ASSERT_EQ(counters[0], 5u);
+    ASSERT_EQ(counters[1], 3u);
+    ASSERT_EQ(counters[2], 4u);
+    ASSERT_EQ(counters[3], 2u);
+
+    counters = yaml_get_bufmon_port_counters(cy_handle, BASE_SUBSYSTEM, 1, 1, &count);
+    ASSERT_TRUE(counters != NULL);
+    ASSERT_EQ(count, 2u);
+    ASSERT_EQ(counters[0], 3u);
+    ASSERT_EQ(counters[1], 4u);
+
+    counters = yaml_get_bufmon_port_counters(cy_handle, BASE_SUBSYSTEM, 2, -1, &count);
+    ASSERT_EQ(count, 1u);
+    ASSERT_EQ(counters[0], 1u);
+
+    counters = yaml_get_bufmon_port_counters(cy_handle, BASE_SUBSYSTEM, 3, -1, &count);
+    ASSERT_TRUE(counters == NULL);
+    ASSERT_EQ(count, 0u);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, BAD_MANIFEST, MANIFEST_FILE);
+
+    /* The bad bufmon file has a duplicate counter name */
+    printf("Parse bufmon with a duplicate counter name.\n");
+    rc = yaml_add_subsystem(cy_handle, "bad", cwd);
+    ASSERT_EQ(rc, 0);
+    rc = yaml_parse_bufmon(cy_handle, "bad");
+    ASSERT_EQ(rc, -1);
+    ASSERT_EQ(yaml_get_bufmon_counter_count(cy_handle, "bad"), 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+TEST_F(CfgYamlTestSuite, cfg_013_bufmon_engine) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int idx;
+    unsigned long long bitmap[2];
+    unsigned long long expect[2];
+    unsigned long long samples[100];
+    unsigned long long thresholds[100];
+    bool    enabled[100];
+    YamlBufmonEngine *engine;
+    const YamlBufmonImpl impls[] = {
+        BUFMON_IMPL_SCALAR, BUFMON_IMPL_SSE2, BUFMON_IMPL_AVX2
+    };
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    rc = yaml_parse_bufmon(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    /* Counter 3 is disabled, so it never reports a crossing */
+    printf("Evaluate the counters of the bufmon file.\n");
+    engine = yaml_new_bufmon_engine(cy_handle, BASE_SUBSYSTEM, BUFMON_MODE_CURRENT);
+    ASSERT_TRUE(engine != NULL);
+    for (idx = 0; idx < 7; idx++) {
+        samples[idx] = 3407665;
+    }
+    samples[3] = 851761;
+    ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 7, bitmap, 1), 1);
+    ASSERT_EQ(bitmap[0], 1ULL << 6);
+    ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 6, bitmap, 1), -1);
+    bufmon_engine_free(engine);
+
+    /* Every implementation gives the same result, including values that
+     * differ only in the top bit */
+    printf("Compare the implementations.\n");
+    srand(13);
+    for (idx = 0; idx < 100; idx++) {
+        thresholds[idx] = ((unsigned long long)rand() << 40) ^ rand();
+        if (idx % 5 == 0) {
+            thresholds[idx] |= 1ULL << 63;
+        }
+        enabled[idx] = (idx % 7) != 0;
+    }
+
+    for (idx = 0; idx < sizeof(impls) / sizeof(impls[0]); idx++) {
+        engine = bufmon_engine_new(100, thresholds, enabled, BUFMON_MODE_CURRENT);
+        ASSERT_TRUE(engine != NULL);
+        if (bufmon_engine_set_impl(engine, impls[idx]) != 0) {
+            printf("Implementation %u is not supported.\n", idx);
+            bufmon_engine_free(engine);
+            continue;
+        }
+
+        for (int round = 0; round < 20; round++) {
+            unsigned int ctr;
+            int crossed = 0;
+
+            memset(expect, 0, sizeof(expect));
+            for (ctr = 0; ctr < 100; ctr++) {
+                switch (rand() % 4) {
+                case 0: samples[ctr] = thresholds[ctr]; break;
+                case 1: samples[ctr] = thresholds[ctr] + 1; break;
+                case 2: samples[ctr] = thresholds[ctr] ^ (1ULL << 63); break;
+                default: samples[ctr] = thresholds[ctr] - 1; break;
+                }
+                if (enabled[ctr] && samples[ctr] > thresholds[ctr]) {
+                    expect[ctr / 64] |= 1ULL << (ctr % 64);
+                    crossed++;
+                }
+            }
+            ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 100, bitmap, 2), crossed);
+            ASSERT_EQ(bitmap[0], expect[0]);
+            ASSERT_EQ(bitmap[1], expect[1]);
+        }
+        bufmon_engine_free(engine);
+    }
+
+    /* Peak mode keeps reporting a crossing until the peaks are reset */
+    printf("Evaluate in peak mode.\n");
+    for (idx = 0; idx < sizeof(impls) / sizeof(impls[0]); idx++) {
+        engine = bufmon_engine_new(100, thresholds, NULL, BUFMON_MODE_PEAK);
+        ASSERT_TRUE(engine != NULL);
+        if (bufmon_engine_set_impl(engine, impls[idx]) != 0) {
+            bufmon_engine_free(engine);
+            continue;
+        }
+
+        memset(samples, 0, sizeof(samples));
+        samples[9] = thresholds[9] + 1;
+        ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 100, bitmap, 2), 1);
+        samples[9] = 0;
+        ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 100, bitmap, 2), 1);
+        ASSERT_EQ(bitmap[0], 1ULL << 9);
+        ASSERT_EQ(bufmon_engine_get_peaks(engine)[9], thresholds[9] + 1);
+
+        bufmon_engine_reset_peaks(engine);
+        ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 100, bitmap, 2), 0);
+
+        ASSERT_EQ(bufmon_engine_set_threshold(engine, 9, 0, false), 0);
+        samples[9] = 1;
+        ASSERT_EQ(bufmon_engine_evaluate(engine, samples, 100, bitmap, 2), 0);
+        ASSERT_EQ(bufmon_engine_set_threshold(engine, 100, 0, false), -1);
+        bufmon_engine_free(engine);
+    }
+
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+static bool
+bufmon_pattern_match(const YamlBufmonCounter *counter, const char *pattern)
+{
+    char    buf[128];
+    char    *save = NULL;
+    char    *seg;
+    int     idx = 0;
+
+    snprintf(buf, sizeof(buf), "%s", pattern);
+    for (seg = strtok_r(buf, "/", &save); seg != NULL;
+            seg = strtok_r(NULL, "/", &save), idx++) {
+        if (strcmp(seg, "*") != 0 && strcmp(seg, counter->name[idx]) != 0) {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+TEST_F(CfgYamlTestSuite, cfg_014_yaml_query_bufmon) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int idx;
+    unsigned int count;
+    const unsigned int *sorted;
+    YamlBufmonRange ranges[8];
+    YamlBufmonCounter counter;
+    const char *patterns[] = {
+        "ingress-port-priority-group",
+        "ingress-port-priority-group/*/1",
+        "*/*/1",
+        "*/*/*/2",
+        "*/um-share-buffer-count",
+        "*/*/1/NONE",
+        "*",
+        "egress-uc-queue/uc-buffer-count/1/NONE",
+    };
+
+    /* Test YAML files are stored in ./yaml_files dir. */
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    printf("Create a new base SUBSYSTEM.\n");
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    rc = yaml_parse_bufmon(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    sorted = yaml_get_bufmon_sorted_counters(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_TRUE(sorted != NULL);
+    ASSERT_EQ(count, 7u);
+
+    /* Each query selects exactly the counters a full scan would */
+    printf("Compare queries with a full scan.\n");
+    for (idx = 0; idx < sizeof(patterns) / sizeof(patterns[0]); idx++) {
+        bool selected[7] = { false };
+        int nranges;
+
+        nranges = yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM,
+                                             patterns[idx], ranges, 8);
+        ASSERT_GT(nranges, 0);
+        ASSERT_LE(nranges, 8);
+        for (int range = 0; range < nranges; range++) {
+            for (unsigned int pos = ranges[range].first;
+                    pos < ranges[range].first + ranges[range].count; pos++) {
+                selected[sorted[pos]] = true;
+            }
+        }
+        for (unsigned int ctr = 0; ctr < count; ctr++) {
+            ASSERT_EQ(yaml_get_bufmon_counter(cy_handle, BASE_SUBSYSTEM, ctr, &counter), 0);
+            ASSERT_EQ(selected[ctr], bufmon_pattern_match(&counter, patterns[idx]))
+                << patterns[idx] << " counter " << ctr;
+        }
+    }
+
+    /* A realm is a single range */
+    printf("Verify the range of a realm.\n");
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM,
+                "ingress-port-priority-group", ranges, 8), 1);
+    ASSERT_EQ(ranges[0].count, 4u);
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM,
+                "*/um-share-buffer-count", ranges, 1), 2);
+
+    /* Unknown segments match nothing, malformed patterns fail */
+    printf("Query unknown and malformed patterns.\n");
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM, "nope", ranges, 8), 0);
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM, "*/*/99", ranges, 8), 0);
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM, "a/b/c/d/e", ranges, 8), -1);
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM, "", ranges, 8), -1);
+    ASSERT_EQ(yaml_query_bufmon_counters(cy_handle, BASE_SUBSYSTEM, "device//NONE", ranges, 8), -1);
+
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that yaml_init_devices()
+ * - sends all init ops as one list.
+ * - keeps a status for each init op.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_015_yaml_init_op_status) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     idx;
+    int     count;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+
+    rc = yaml_parse_devices(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+
+    count = yaml_get_init_op_count(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(count, 3);
+
+    /* No status before the devices are initialized */
+    ASSERT_EQ(yaml_get_init_op_status(cy_handle, BASE_SUBSYSTEM, 0), -1);
+
+    ops_cnt = 0;
+    rc = yaml_init_devices(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(ops_cnt, count);
+
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(yaml_get_init_op_status(cy_handle, BASE_SUBSYSTEM, idx), 0);
+    }
+    ASSERT_EQ(yaml_get_init_op_status(cy_handle, BASE_SUBSYSTEM, count), -1);
+
+    /* Unknown subsystem */
+    ASSERT_EQ(yaml_init_devices(cy_handle, "no_such_subsystem"), -1);
+    ASSERT_EQ(yaml_get_init_op_count(cy_handle, "no_such_subsystem"), -1);
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that yaml_init_subsystems()
+ * - parses and initializes every subsystem.
+ * - gives the same results for any number of workers.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_016_yaml_init_subsystems) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int workers;
+    const char *names[] = { "card1", "card2", "card3" };
+    YamlSubsystemInitResult results[3];
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    /* No subsystems */
+    ASSERT_EQ(yaml_init_subsystems(cy_handle, 0, results, 3), 0);
+    ASSERT_EQ(yaml_init_subsystems(NULL, 0, results, 3), -1);
+
+    for (workers = 0; workers <= 3; workers++) {
+        YamlConfigHandle handle = yaml_new_config_handle();
+        unsigned int idx;
+
+        for (idx = 0; idx < 3; idx++) {
+            rc = yaml_add_subsystem(handle, names[idx], cwd);
+            ASSERT_EQ(rc, 0);
+        }
+
+        ops_cnt = 0;
+        memset(results, 0xff, sizeof(results));
+        rc = yaml_init_subsystems(handle, workers, results, 3);
+        ASSERT_EQ(rc, 3);
+        /* 3 init ops for each subsystem */
+        ASSERT_EQ(ops_cnt, 9);
+
+        for (idx = 0; idx < 3; idx++) {
+            ASSERT_STREQ(results[idx].subsyst, names[idx]);
+            ASSERT_EQ(results[idx].parse_rc, 0);
+            ASSERT_EQ(results[idx].init_rc, 0);
+            ASSERT_EQ(yaml_get_init_op_status(handle, names[idx], 0), 0);
+            ASSERT_GT(yaml_get_sensor_count(handle, names[idx]), 0);
+        }
+
+        /* A short results array still returns the subsystem count */
+        ASSERT_EQ(yaml_init_subsystems(handle, workers, results, 1), 3);
+    }
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the poller
+ * - ticks at the gcd of the subscription periods.
+ * - reads each register that is due once per tick.
+ * - passes the value to every subscriber.
+ * - keeps every subscription due when an unsubscribe grows the tick.
+ * - lets a callback subscribe and unsubscribe, but not tick.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_017_yaml_poller) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     ids[4];
+    const YamlPsu *psu1;
+    const YamlPsu *psu2;
+    const YamlSensor *sensor;
+    YamlPoller *poller;
+    PollerCalls calls;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_thermal(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_psus(cy_handle, BASE_SUBSYSTEM), 0);
+
+    psu1 = yaml_get_psu(cy_handle, BASE_SUBSYSTEM, 0);
+    psu2 = yaml_get_psu(cy_handle, BASE_SUBSYSTEM, 1);
+    sensor = yaml_get_sensor(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(psu1 != NULL && psu2 != NULL && sensor != NULL);
+
+    poller = yaml_poller_new(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(poller != NULL);
+    ASSERT_EQ(yaml_poller_get_tick(poller), 0u);
+    ASSERT_EQ(yaml_poller_tick(poller), 0);
+
+    memset(&calls, 0, sizeof(calls));
+
+    /* All PSU signals are on the same CPLD register */
+    ids[0] = yaml_poller_subscribe_bit_op(poller, psu1->psu_present, 5000,
+                                          poller_callback, &calls);
+    ids[1] = yaml_poller_subscribe_bit_op(poller, psu1->psu_output_ok, 5000,
+                                          poller_callback, &calls);
+    ids[2] = yaml_poller_subscribe_bit_op(poller, psu2->psu_present, 10000,
+                                          poller_callback, &calls);
+    ids[3] = yaml_poller_subscribe_register(poller, sensor->device, 0, 2, 2500,
+                                            poller_callback, &calls);
+    ASSERT_EQ(ids[0], 0);
+    ASSERT_EQ(ids[1], 1);
+    ASSERT_EQ(ids[2], 2);
+    ASSERT_EQ(ids[3], 3);
+    ASSERT_EQ(yaml_poller_get_tick(poller), 2500u);
+
+    /* Bad subscriptions */
+    ASSERT_EQ(yaml_poller_subscribe_register(poller, "no_such_device", 0, 1,
+                                             1000, poller_callback, &calls), -1);
+    ASSERT_EQ(yaml_poller_subscribe_register(poller, sensor->device, 0, 5,
+                                             1000, poller_callback, &calls), -1);
+    ASSERT_EQ(yaml_poller_subscribe_register(poller, sensor->device, 0, 1,
+                                             1000, NULL, NULL), -1);
+
+    /* 0ms: everything is due, the CPLD register is read once */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_poller_tick(poller), 2);
+    ASSERT_EQ(ops_cnt, 2);
+    ASSERT_EQ(calls.count, 4);
+    /* The fake reads 0: present is negative polarity, output_ok isn't */
+    ASSERT_EQ(calls.values[0], 1u);
+    ASSERT_EQ(calls.values[1], 0u);
+    ASSERT_EQ(calls.values[2], 1u);
+    ASSERT_EQ(calls.values[3], 0u);
+
+    /* 2500ms: only the sensor */
+    calls.count = 0;
+    ASSERT_EQ(yaml_poller_tick(poller), 1);
+    ASSERT_EQ(calls.count, 1);
+    ASSERT_EQ(calls.last_id, ids[3]);
+
+    /* 5000ms: the sensor and PSU 1 */
+    calls.count = 0;
+    ASSERT_EQ(yaml_poller_tick(poller), 2);
+    ASSERT_EQ(calls.count, 3);
+
+    /* 7500ms and 10000ms */
+    ASSERT_EQ(yaml_poller_tick(poller), 1);
+    calls.count = 0;
+    ASSERT_EQ(yaml_poller_tick(poller), 2);
+    ASSERT_EQ(calls.count, 4);
+
+    /* Without the sensor, the tick goes back to the PSU period */
+    ASSERT_EQ(yaml_poller_unsubscribe(poller, ids[3]), 0);
+    ASSERT_EQ(yaml_poller_unsubscribe(poller, ids[3]), -1);
+    ASSERT_EQ(yaml_poller_get_tick(poller), 5000u);
+    ASSERT_EQ(yaml_poller_subscribe_register(poller, sensor->device, 0, 2, 2500,
+                                             poller_callback, &calls), ids[3]);
+
+    /* The poller thread ticks right away */
+    calls.count = 0;
+    ASSERT_EQ(yaml_poller_start(poller), 0);
+    ASSERT_EQ(yaml_poller_start(poller), -1);
+    usleep(100000);
+    yaml_poller_stop(poller);
+    ASSERT_GT(calls.count, 0);
+
+    yaml_poller_free(poller);
+
+    /* A growing tick realigns the clock to the new tick */
+    poller = yaml_poller_new(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(poller != NULL);
+    ids[0] = yaml_poller_subscribe_bit_op(poller, psu1->psu_present, 5000,
+                                          poller_callback, &calls);
+    ids[1] = yaml_poller_subscribe_register(poller, sensor->device, 0, 2, 3000,
+                                            poller_callback, &calls);
+    ASSERT_EQ(yaml_poller_get_tick(poller), 1000u);
+    for (int tick = 0; tick < 7; tick++) {
+        ASSERT_GE(yaml_poller_tick(poller), 0);
+    }
+    ASSERT_EQ(yaml_poller_unsubscribe(poller, ids[1]), 0);
+    ASSERT_EQ(yaml_poller_get_tick(poller), 5000u);
+
+    /* 7000ms is rounded up to 10000ms, then every tick is due */
+    calls.count = 0;
+    for (int tick = 0; tick < 4; tick++) {
+        ASSERT_EQ(yaml_poller_tick(poller), 1);
+    }
+    ASSERT_EQ(calls.count, 4);
+    ASSERT_EQ(calls.last_id, ids[0]);
+
+    yaml_poller_free(poller);
+
+    /* A callback can change the subscriptions, but not tick */
+    PollerSelf self;
+
+    memset(&self, 0, sizeof(self));
+    poller = yaml_poller_new(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(poller != NULL);
+    self.poller = poller;
+    self.device = sensor->device;
+    self.calls = &calls;
+    ids[0] = yaml_poller_subscribe_bit_op(poller, psu1->psu_present, 5000,
+                                          poller_self_callback, &self);
+    ids[1] = yaml_poller_subscribe_bit_op(poller, psu1->psu_output_ok, 5000,
+                                          poller_callback, &calls);
+    self.other_id = ids[1];
+
+    /* The removed subscriber isn't called, nor the one that reuses its id */
+    calls.count = 0;
+    ASSERT_EQ(yaml_poller_tick(poller), 1);
+    ASSERT_EQ(self.count, 1);
+    ASSERT_EQ(self.tick_rc, -1);
+    ASSERT_EQ(self.new_id, ids[1]);
+    ASSERT_EQ(calls.count, 0);
+
+    /* The next tick only calls the new subscriber */
+    ASSERT_EQ(yaml_poller_tick(poller), 1);
+    ASSERT_EQ(self.count, 1);
+    ASSERT_EQ(calls.count, 1);
+    ASSERT_EQ(calls.last_id, ids[1]);
+
+    yaml_poller_free(poller);
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the thermal policy engine
+ * - applies the alarm and fan hysteresis of each sensor.
+ * - matches a one sensor at a time reference.
+ * - returns the highest fan speed required.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_018_thermal_engine) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int count;
+    unsigned int idx;
+    int     step;
+    const YamlSensor *sensors;
+    YamlThermalEngine *engine;
+    float   temps[8];
+    int     alarms[8];
+    int     fans[8];
+    int     ref_alarms[8];
+    int     ref_fans[8];
+    const float walk[] = { 60, 55, 52, 76, 72, 68, 63, -15 };
+    const int walk_alarms[] = {
+        THERMAL_ALARM_MAX, THERMAL_ALARM_MAX, THERMAL_ALARM_NORMAL,
+        THERMAL_ALARM_EMERGENCY, THERMAL_ALARM_EMERGENCY,
+        THERMAL_ALARM_CRITICAL, THERMAL_ALARM_CRITICAL,
+        THERMAL_ALARM_LOW_CRITICAL };
+    const int walk_fans[] = { MAX, MAX, FAST, MAX, MAX, MAX, MAX, NORMAL };
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_thermal(cy_handle, BASE_SUBSYSTEM), 0);
+
+    sensors = yaml_get_sensors_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_TRUE(sensors != NULL);
+    ASSERT_LE(count, 8u);
+
+    engine = yaml_new_thermal_engine(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_TRUE(engine != NULL);
+    ASSERT_EQ(thermal_engine_get_count(engine), count);
+
+    for (idx = 0; idx < count; idx++) {
+        alarms[idx] = ref_alarms[idx] = THERMAL_ALARM_NORMAL;
+        fans[idx] = ref_fans[idx] = NORMAL;
+        temps[idx] = 25;
+    }
+
+    /* Wrong sensor count */
+    ASSERT_EQ(thermal_engine_evaluate(engine, temps, alarms, fans, count + 1), -1);
+
+    /* Walk sensor 0 through the hysteresis, the others stay cool */
+    for (step = 0; step < (int)(sizeof(walk) / sizeof(walk[0])); step++) {
+        temps[0] = walk[step];
+        rc = thermal_engine_evaluate(engine, temps, alarms, fans, count);
+        ASSERT_EQ(alarms[0], walk_alarms[step]);
+        ASSERT_EQ(fans[0], walk_fans[step]);
+        ASSERT_EQ(rc, walk_fans[step]);
+        for (idx = 1; idx < count; idx++) {
+            ASSERT_EQ(alarms[idx], THERMAL_ALARM_NORMAL);
+            ASSERT_EQ(fans[idx], NORMAL);
+        }
+    }
+
+    /* Random walks must match the reference */
+    srand(18);
+    for (idx = 0; idx < count; idx++) {
+        alarms[idx] = ref_alarms[idx] = THERMAL_ALARM_NORMAL;
+        fans[idx] = ref_fans[idx] = NORMAL;
+        temps[idx] = 40;
+    }
+    for (step = 0; step < 10000; step++) {
+        int demand = NORMAL;
+
+        for (idx = 0; idx < count; idx++) {
+            temps[idx] += (float)(rand() % 11 - 5);
+            if (temps[idx] < -20 || temps[idx] > 90) {
+                temps[idx] = 40;
+            }
+            thermal_reference(&sensors[idx], temps[idx],
+                              &ref_alarms[idx], &ref_fans[idx]);
+            if (ref_fans[idx] > demand) {
+                demand = ref_fans[idx];
+            }
+        }
+
+        rc = thermal_engine_evaluate(engine, temps, alarms, fans, count);
+        ASSERT_EQ(rc, demand);
+        for (idx = 0; idx < count; idx++) {
+            ASSERT_EQ(alarms[idx], ref_alarms[idx]);
+            ASSERT_EQ(fans[idx], ref_fans[idx]);
+        }
+    }
+
+    thermal_engine_free(engine);
+
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the shadow register write cache
+ * - merges bit op writes to a register into one read-modify-write.
+ * - skips writes that don't change the register.
+ * - reads the register again after invalidation or resync_ms.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_019_yaml_shadow_cache) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int value;
+    const YamlFanInfo *fan_info;
+    const YamlLed *led;
+    const YamlFanFru *fru1;
+    const YamlFanFru *fru2;
+    YamlShadowCache *cache;
+    i2c_bit_op bad_op;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_fans(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_leds(cy_handle, BASE_SUBSYSTEM), 0);
+
+    fan_info = yaml_get_fan_info(cy_handle, BASE_SUBSYSTEM);
+    led = yaml_get_led(cy_handle, BASE_SUBSYSTEM, 0);
+    fru1 = yaml_get_fan_fru(cy_handle, BASE_SUBSYSTEM, 0);
+    fru2 = yaml_get_fan_fru(cy_handle, BASE_SUBSYSTEM, 1);
+    ASSERT_TRUE(fan_info != NULL && led != NULL && fru1 != NULL && fru2 != NULL);
+
+    cache = yaml_shadow_new(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(cache != NULL);
+
+    memset(&bad_op, 0, sizeof(bad_op));
+    bad_op.device = (char *)"no_such_device";
+    bad_op.bit_mask = 0x01;
+    ASSERT_EQ(yaml_shadow_set(cache, &bad_op, 1), -1);
+    ASSERT_EQ(yaml_shadow_get(cache, fan_info->fan_speed_control, &value), -1);
+
+    /* First flush: one read and one write per register */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_shadow_set(cache, fan_info->fan_speed_control, 0x08), 0);
+    ASSERT_EQ(yaml_shadow_set(cache, led->led_access, 0x10), 0);
+    ASSERT_EQ(yaml_shadow_flush(cache), 2);
+    ASSERT_EQ(ops_cnt, 4);
+    ASSERT_EQ(yaml_shadow_get(cache, fan_info->fan_speed_control, &value), 0);
+    ASSERT_EQ(value, 0x08u);
+
+    /* Same values again: no i2c traffic */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_shadow_set(cache, fan_info->fan_speed_control, 0x08), 0);
+    ASSERT_EQ(yaml_shadow_set(cache, led->led_access, 0x10), 0);
+    ASSERT_EQ(yaml_shadow_flush(cache), 0);
+    ASSERT_EQ(ops_cnt, 0);
+
+    /* Both fan FRU LEDs share a register: one read-modify-write */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_shadow_set(cache, fru1->fan_leds, 0x01), 0);
+    ASSERT_EQ(yaml_shadow_set(cache, fru2->fan_leds, 0x08), 0);
+    ASSERT_EQ(yaml_shadow_flush(cache), 1);
+    ASSERT_EQ(ops_cnt, 2);
+    ASSERT_EQ(yaml_shadow_get(cache, fru2->fan_leds, &value), 0);
+    ASSERT_EQ(value, 0x08u);
+
+    /* After invalidation the register is read again; the fake reads 0 */
+    yaml_shadow_invalidate(cache);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_shadow_set(cache, fan_info->fan_speed_control, 0x08), 0);
+    ASSERT_EQ(yaml_shadow_flush(cache), 1);
+    ASSERT_EQ(ops_cnt, 2);
+
+    yaml_shadow_free(cache);
+
+    /* With resync_ms, a stale register is read again */
+    cache = yaml_shadow_new(cy_handle, BASE_SUBSYSTEM, 1);
+    ASSERT_TRUE(cache != NULL);
+    ASSERT_EQ(yaml_shadow_set(cache, fan_info->fan_speed_control, 0x08), 0);
+    ASSERT_EQ(yaml_shadow_flush(cache), 1);
+    usleep(5000);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_shadow_set(cache, fan_info->fan_speed_control, 0x08), 0);
+    ASSERT_EQ(yaml_shadow_flush(cache), 1);
+    ASSERT_EQ(ops_cnt, 2);
+    yaml_shadow_free(cache);
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the bit op executors
+ * - decode the masked bits and apply negative polarity.
+ * - read each distinct register of a bit op list once.
+ * - write a register shared by several bit ops once.
+ * - reject unknown devices.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_020_yaml_bit_op_executors) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     idx;
+    int     count;
+    unsigned int value;
+    unsigned int values[6];
+    int     results[6];
+    const i2c_bit_op *ops[6];
+    const YamlFanInfo *fan_info;
+    const YamlFanFru *fru1;
+    const YamlFanFru *fru2;
+    i2c_bit_op bad_op;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_fans(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_psus(cy_handle, BASE_SUBSYSTEM), 0);
+
+    count = yaml_get_psu_count(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(count, 2);
+
+    /* The fake reads 0, so a negative polarity bit reads as asserted */
+    ops_cnt = 0;
+    rc = yaml_bit_op_read(cy_handle, BASE_SUBSYSTEM,
+                          yaml_get_psu(cy_handle, BASE_SUBSYSTEM, 0)->psu_present,
+                          &value);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(value, 1u);
+    ASSERT_EQ(ops_cnt, 1);
+
+    /* All PSU bits are in one register: a single read */
+    for (idx = 0; idx < count; idx++) {
+        const YamlPsu *psu = yaml_get_psu(cy_handle, BASE_SUBSYSTEM, idx);
+
+        ops[idx * 3] = psu->psu_present;
+        ops[idx * 3 + 1] = psu->psu_input_ok;
+        ops[idx * 3 + 2] = psu->psu_output_ok;
+    }
+
+    ops_cnt = 0;
+    rc = yaml_bit_op_read_list(cy_handle, BASE_SUBSYSTEM, ops, 6, values,
+                               results);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(ops_cnt, 1);
+    for (idx = 0; idx < 6; idx++) {
+        ASSERT_EQ(results[idx], 0);
+        ASSERT_EQ(values[idx], ops[idx]->negative_polarity ? 1u : 0u);
+    }
+
+    /* Read-modify-write of a multi-bit field */
+    fan_info = yaml_get_fan_info(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_TRUE(fan_info != NULL);
+    ops_cnt = 0;
+    rc = yaml_bit_op_write(cy_handle, BASE_SUBSYSTEM,
+                           fan_info->fan_speed_control, 0x08);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(ops_cnt, 2);
+
+    /* Both fan FRU LEDs share a register: one read and one write */
+    fru1 = yaml_get_fan_fru(cy_handle, BASE_SUBSYSTEM, 0);
+    fru2 = yaml_get_fan_fru(cy_handle, BASE_SUBSYSTEM, 1);
+    ASSERT_TRUE(fru1 != NULL && fru2 != NULL);
+    ops[0] = fru1->fan_leds;
+    ops[1] = fru2->fan_leds;
+    values[0] = 1;
+    values[1] = 2;
+    ops_cnt = 0;
+    rc = yaml_bit_op_write_list(cy_handle, BASE_SUBSYSTEM, ops, 2, values,
+                                results);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(ops_cnt, 2);
+
+    /* Writing the value already in the register skips the write */
+    values[0] = 0;
+    values[1] = 0;
+    ops_cnt = 0;
+    rc = yaml_bit_op_write_list(cy_handle, BASE_SUBSYSTEM, ops, 2, values,
+                                results);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(ops_cnt, 1);
+
+    /* Unknown device */
+    memset(&bad_op, 0, sizeof(bad_op));
+    bad_op.device = (char *)"no_such_device";
+    bad_op.bit_mask = 0x01;
+    ASSERT_EQ(yaml_bit_op_read(cy_handle, BASE_SUBSYSTEM, &bad_op, &value),
+              EINVAL);
+    ASSERT_EQ(yaml_bit_op_write(cy_handle, BASE_SUBSYSTEM, &bad_op, 1),
+              EINVAL);
+    ops[0] = &bad_op;
+    rc = yaml_bit_op_read_list(cy_handle, BASE_SUBSYSTEM, ops, 2, values,
+                               results);
+    ASSERT_EQ(rc, EINVAL);
+    ASSERT_EQ(results[0], EINVAL);
+    ASSERT_EQ(results[1], 0);
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that yaml_psu_sweep()
+ * - reads the shared PSU status register once.
+ * - returns every status bit on the first sweep.
+ * - returns only the status bits that changed afterwards.
+ * - keeps the edges that don't fit for the next sweep.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_021_yaml_psu_sweep) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int count;
+    YamlPsuEdge edges[8];
+    YamlPsuSweep *sweep;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+
+    /* No PSUs parsed yet */
+    ASSERT_TRUE(yaml_psu_sweep_new(cy_handle, BASE_SUBSYSTEM) == NULL);
+    ASSERT_EQ(yaml_parse_psus(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_TRUE(yaml_psu_sweep_new(cy_handle, "no_such_subsystem") == NULL);
+
+    sweep = yaml_psu_sweep_new(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_TRUE(sweep != NULL);
+    ASSERT_EQ(yaml_psu_sweep(NULL, edges, 8, &count), EINVAL);
+
+    /* First sweep: every status bit, from one register read */
+    read_byte = 0x00;
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 8, &count), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(count, 6u);
+    ASSERT_EQ(edges[0].psu, 0u);
+    ASSERT_EQ(edges[0].status, PSU_STATUS_PRESENT);
+    ASSERT_TRUE(edges[0].value);
+    ASSERT_EQ(edges[2].status, PSU_STATUS_OUTPUT_OK);
+    ASSERT_FALSE(edges[2].value);
+    ASSERT_EQ(edges[5].psu, 1u);
+
+    /* Nothing changed */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 8, &count), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(count, 0u);
+
+    /* Both outputs come up */
+    read_byte = 0x22;
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 8, &count), 0);
+    ASSERT_EQ(count, 2u);
+    ASSERT_EQ(edges[0].psu, 0u);
+    ASSERT_EQ(edges[0].status, PSU_STATUS_OUTPUT_OK);
+    ASSERT_TRUE(edges[0].value);
+    ASSERT_EQ(edges[1].psu, 1u);
+    ASSERT_EQ(edges[1].status, PSU_STATUS_OUTPUT_OK);
+    ASSERT_TRUE(edges[1].value);
+
+    /* The second PSU is removed (negative polarity) */
+    read_byte = 0x32;
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 8, &count), 0);
+    ASSERT_EQ(count, 1u);
+    ASSERT_EQ(edges[0].psu, 1u);
+    ASSERT_EQ(edges[0].status, PSU_STATUS_PRESENT);
+    ASSERT_FALSE(edges[0].value);
+
+    /* Three edges with room for one: the rest come with the next sweep */
+    read_byte = 0x00;
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 1, &count), 0);
+    ASSERT_EQ(count, 1u);
+    ASSERT_EQ(edges[0].psu, 0u);
+    ASSERT_EQ(edges[0].status, PSU_STATUS_OUTPUT_OK);
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 8, &count), 0);
+    ASSERT_EQ(count, 2u);
+    ASSERT_EQ(edges[0].psu, 1u);
+    ASSERT_EQ(edges[1].psu, 1u);
+    ASSERT_EQ(yaml_psu_sweep(sweep, edges, 8, &count), 0);
+    ASSERT_EQ(count, 0u);
+
+    yaml_psu_sweep_free(sweep);
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that yaml_presence_scan()
+ * - reads every presence register on the first scan.
+ * - reads only the presence registers of asserted interrupts after.
+ * - reads every presence register again every full_sweep_ms.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_022_yaml_presence_scan) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int idx;
+    unsigned int count;
+    YamlPresenceEdge edges[64];
+    YamlPresenceScan *scan;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+
+    /* No ports parsed yet */
+    ASSERT_TRUE(yaml_presence_scan_new(cy_handle, BASE_SUBSYSTEM, 0) == NULL);
+    ASSERT_EQ(yaml_parse_ports(cy_handle, BASE_SUBSYSTEM), 0);
+
+    scan = yaml_presence_scan_new(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(scan != NULL);
+    ASSERT_EQ(yaml_presence_scan(NULL, edges, 64, &count), EINVAL);
+
+    /*
+     * The 38 SFP+ and 6 QSFP+ ports have 6 interrupt registers and
+     * 6 presence registers, one of them for the QSFP+ ports. Presence and
+     * the SFP+ interrupts are active low, the QSFP+ interrupts active high.
+     */
+
+    /* First scan: all registers, all ports empty */
+    read_byte = 0xff;
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_presence_scan(scan, edges, 64, &count), 0);
+    ASSERT_EQ(ops_cnt, 12);
+    ASSERT_EQ(count, 44u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_FALSE(edges[idx].present);
+    }
+
+    /* The QSFP+ interrupts are asserted: one presence register */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_presence_scan(scan, edges, 64, &count), 0);
+    ASSERT_EQ(ops_cnt, 7);
+    ASSERT_EQ(count, 0u);
+
+    /* The SFP+ interrupts are asserted: their 5 presence registers */
+    read_byte = 0x00;
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_presence_scan(scan, edges, 64, &count), 0);
+    ASSERT_EQ(ops_cnt, 11);
+    ASSERT_EQ(count, 38u);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_TRUE(edges[idx].present);
+        ASSERT_STREQ(yaml_get_port(cy_handle, BASE_SUBSYSTEM,
+                                   edges[idx].port)->connector, SFPP);
+    }
+
+    yaml_presence_scan_free(scan);
+
+    /* A full sweep finds the modules whose interrupt was missed */
+    scan = yaml_presence_scan_new(cy_handle, BASE_SUBSYSTEM, 1);
+    ASSERT_TRUE(scan != NULL);
+    read_byte = 0xff;
+    ASSERT_EQ(yaml_presence_scan(scan, edges, 64, &count), 0);
+    ASSERT_EQ(count, 44u);
+    read_byte = 0x00;
+    usleep(5000);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_presence_scan(scan, edges, 64, &count), 0);
+    ASSERT_EQ(ops_cnt, 12);
+    ASSERT_EQ(count, 44u);
+    yaml_presence_scan_free(scan);
+
+    read_byte = 0x00;
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the module EEPROM cache
+ * - reads the static region once per presence generation.
+ * - reads the diagnostic region again after diag_refresh_ms.
+ * - rejects ports without a module and bad ranges.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_023_yaml_eeprom_cache) {
+    char    cwd[1024];
+    int     rc = 0;
+    unsigned int idx;
+    unsigned int count;
+    unsigned int sfp = 0;
+    unsigned int qsfp = 0;
+    unsigned char data[256];
+    const YamlPort *ports;
+    YamlPresenceEdge edge;
+    YamlEepromCache *cache;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_parse_ports(cy_handle, BASE_SUBSYSTEM), 0);
+
+    ports = yaml_get_ports_array(cy_handle, BASE_SUBSYSTEM, &count);
+    ASSERT_TRUE(ports != NULL);
+    for (idx = 0; idx < count; idx++) {
+        if (!ports[idx].pluggable) {
+            continue;
+        }
+        if (sfp == 0 && strcmp(ports[idx].connector, SFPP) == 0) {
+            sfp = idx;
+        }
+        if (qsfp == 0 && strcmp(ports[idx].connector, QSFPP) == 0) {
+            qsfp = idx;
+        }
+    }
+    ASSERT_TRUE(sfp != 0 && qsfp != 0);
+
+    cache = yaml_eeprom_cache_new(cy_handle, BASE_SUBSYSTEM, 60000);
+    ASSERT_TRUE(cache != NULL);
+
+    /* Bad requests */
+    ASSERT_EQ(yaml_eeprom_read(cache, 0, 0, 1, data), EINVAL);
+    ASSERT_EQ(yaml_eeprom_read(cache, sfp, 200, 100, data), EINVAL);
+    ASSERT_EQ(yaml_eeprom_read(cache, count, 0, 1, data), EINVAL);
+
+    /* SFP+: the whole page is read once */
+    read_byte = 0x11;
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_eeprom_read(cache, sfp, 20, 16, data), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(data[0], 0x11);
+    read_byte = 0x22;
+    ASSERT_EQ(yaml_eeprom_read(cache, sfp, 0, 256, data), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(data[255], 0x11);
+
+    /* A presence change starts a new generation */
+    ASSERT_EQ(yaml_eeprom_get_generation(cache, sfp), 0u);
+    edge.port = sfp;
+    edge.present = true;
+    yaml_eeprom_presence_changed(cache, &edge, 1);
+    ASSERT_EQ(yaml_eeprom_get_generation(cache, sfp), 1u);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_eeprom_read(cache, sfp, 20, 16, data), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(data[0], 0x22);
+
+    /* QSFP+: the static upper page and the diagnostics are separate */
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 148, 16, data), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 22, 2, data), 0);
+    ASSERT_EQ(ops_cnt, 2);
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 0, 256, data), 0);
+    ASSERT_EQ(ops_cnt, 2);
+
+    /* A reset invalidates the port */
+    yaml_eeprom_invalidate(cache, qsfp);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 0, 256, data), 0);
+    ASSERT_EQ(ops_cnt, 2);
+
+    yaml_eeprom_cache_free(cache);
+
+    /* With diag_refresh_ms 0, only the diagnostics are read every time */
+    cache = yaml_eeprom_cache_new(cy_handle, BASE_SUBSYSTEM, 0);
+    ASSERT_TRUE(cache != NULL);
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 0, 256, data), 0);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 0, 256, data), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(yaml_eeprom_read(cache, qsfp, 128, 128, data), 0);
+    ASSERT_EQ(ops_cnt, 1);
+    yaml_eeprom_cache_free(cache);
+
+    read_byte = 0x00;
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the i2c simulator
+ * - keeps a register file per device.
+ * - only reaches devices behind a selected mux channel.
+ * - models the bus time of each transaction.
+ * - fails commands with injected faults.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_024_yaml_i2c_sim) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     count;
+    int     cmd_rc[2];
+    unsigned char byte;
+    unsigned char data;
+    void    *bus_handle;
+    const YamlBus *bus;
+    const YamlDevice *sfpp1;
+    const YamlDevice *sfpp2;
+    const YamlI2cBackend *backend;
+    YamlI2cSimConfig config;
+    YamlI2cSimStats stats;
+    YamlI2cSim *sim;
+    i2c_op read_op;
+    i2c_op *cmds[2];
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+
+    count = yaml_get_device_count(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_GT(count, 0);
+    ASSERT_TRUE(yaml_get_device(cy_handle, BASE_SUBSYSTEM, 0) != NULL);
+    ASSERT_TRUE(yaml_get_device(cy_handle, BASE_SUBSYSTEM, count) == NULL);
+
+    memset(&config, 0, sizeof(config));
+    config.bus_khz = 100;
+    config.transaction_ns = 50000;
+    sim = yaml_i2c_sim_new(cy_handle, BASE_SUBSYSTEM, &config);
+    ASSERT_TRUE(sim != NULL);
+    backend = yaml_i2c_sim_backend(sim);
+    ASSERT_TRUE(backend != NULL);
+
+    /* The backend is installed on the handle */
+    ASSERT_TRUE(yaml_get_i2c_backend(cy_handle) == NULL);
+    yaml_set_i2c_backend(cy_handle, backend);
+    ASSERT_TRUE(yaml_get_i2c_backend(cy_handle) == backend);
+    yaml_set_i2c_backend(cy_handle, NULL);
+
+    sfpp1 = yaml_find_device(cy_handle, BASE_SUBSYSTEM, "sfpp1");
+    sfpp2 = yaml_find_device(cy_handle, BASE_SUBSYSTEM, "sfpp2");
+    ASSERT_TRUE(sfpp1 != NULL && sfpp2 != NULL);
+    bus = yaml_find_bus(cy_handle, BASE_SUBSYSTEM, sfpp1->bus);
+    ASSERT_TRUE(bus != NULL);
+
+    /* Deselect the QSFP+ mux channels, like the init ops do */
+    ASSERT_EQ(yaml_i2c_sim_set_register(sim, "cpld3", 0x02, 0xff), 0);
+    ASSERT_EQ(yaml_i2c_sim_set_register(sim, "sfpp1", 0x10, 0x5a), 0);
+    ASSERT_EQ(yaml_i2c_sim_set_register(sim, "no_such_device", 0, 0), EINVAL);
+
+    memset(&read_op, 0, sizeof(read_op));
+    read_op.direction = READ;
+    read_op.device = (char *)"sfpp1";
+    read_op.byte_count = 1;
+    read_op.set_register = true;
+    read_op.register_address = 0x10;
+    read_op.data = &data;
+
+    ASSERT_EQ(backend->open_bus(backend->context, bus, &bus_handle), 0);
+
+    /* sfpp1 is reached once its mux channel is selected */
+    cmds[0] = sfpp1->pre[0];
+    cmds[1] = &read_op;
+    data = 0;
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 2, cmd_rc), 0);
+    ASSERT_EQ(data, 0x5a);
+
+    /* ... and not after the post operation deselects it */
+    cmds[0] = sfpp1->post[0];
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 2, cmd_rc), ENXIO);
+    ASSERT_EQ(cmd_rc[0], 0);
+    ASSERT_EQ(cmd_rc[1], ENXIO);
+
+    /* sfpp2 has the same address and its own register file */
+    cmds[0] = sfpp2->pre[0];
+    data = 0xff;
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 2, cmd_rc), 0);
+    ASSERT_EQ(data, 0x00);
+
+    /* One SMBus byte read: 4 bytes on the wire */
+    yaml_i2c_sim_reset_stats(sim);
+    cmds[0] = &read_op;
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, cmd_rc), 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.transactions, 1u);
+    ASSERT_EQ(stats.bytes, 4u);
+    ASSERT_EQ(stats.elapsed_ns, 50000u + 4 * 9 * 10000u);
+
+    /* A fault fails the given number of commands */
+    ASSERT_EQ(yaml_i2c_sim_inject_fault(sim, "no_such_device", 0x10, EIO, 1),
+              EINVAL);
+    ASSERT_EQ(yaml_i2c_sim_inject_fault(sim, "sfpp2", 0x10, EIO, 1), 0);
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, cmd_rc), EIO);
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, cmd_rc), 0);
+    ASSERT_EQ(yaml_i2c_sim_inject_fault(sim, "sfpp2", -1, EIO, 0), 0);
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, cmd_rc), EIO);
+    yaml_i2c_sim_clear_faults(sim);
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, cmd_rc), 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.faults, 2u);
+
+    /* Writes land in the register file */
+    read_op.direction = WRITE;
+    byte = 0;
+    data = 0x33;
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, cmd_rc), 0);
+    ASSERT_EQ(yaml_i2c_sim_get_register(sim, "sfpp2", 0x10, &byte), 0);
+    ASSERT_EQ(byte, 0x33);
+
+    backend->close_bus(backend->context, bus_handle);
+
+    yaml_i2c_sim_free(sim);
+
+    ops_cnt = 0;
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the i2c recorder and replay
+ * - pass every transfer to the backend installed before.
+ * - refuse to replay on the real adapters, even through a recorder.
+ * - replay a trace into a simulator and count status mismatches.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_025_yaml_i2c_trace) {
+    char    cwd[1024];
+    char    path[1100];
+    char    rec_path[1100];
+    int     rc = 0;
+    int     cmd_rc[2];
+    unsigned char byte;
+    unsigned char data;
+    unsigned char value;
+    void    *bus_handle;
+    const YamlBus *bus;
+    const YamlDevice *sfpp1;
+    const YamlI2cBackend *backend;
+    YamlI2cSim *sim;
+    YamlI2cSim *replay_sim;
+    YamlI2cRecorder *recorder;
+    YamlI2cReplayStats stats;
+    i2c_op read_op;
+    i2c_op write_op;
+    i2c_op *cmds[2];
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+    snprintf(path, sizeof(path), "%s/%s", cwd, "i2c.trace");
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    rc = yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd);
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+
+    sfpp1 = yaml_find_device(cy_handle, BASE_SUBSYSTEM, "sfpp1");
+    ASSERT_TRUE(sfpp1 != NULL);
+    bus = yaml_find_bus(cy_handle, BASE_SUBSYSTEM, sfpp1->bus);
+    ASSERT_TRUE(bus != NULL);
+
+    memset(&read_op, 0, sizeof(read_op));
+    read_op.direction = READ;
+    read_op.device = (char *)"sfpp1";
+    read_op.byte_count = 1;
+    read_op.set_register = true;
+    read_op.register_address = 0x10;
+    read_op.data = &data;
+
+    write_op = read_op;
+    write_op.direction = WRITE;
+    write_op.register_address = 0x20;
+    write_op.data = &value;
+    value = 0x77;
+
+    /* Without a backend, the recorder wraps the default one */
+    recorder = yaml_i2c_recorder_new(cy_handle, BASE_SUBSYSTEM, path);
+    ASSERT_TRUE(recorder != NULL);
+    backend = yaml_get_i2c_backend(cy_handle);
+    ASSERT_TRUE(backend != NULL);
+    ops_cnt = 0;
+    read_byte = 0xa5;
+    cmds[0] = &read_op;
+    ASSERT_EQ(backend->open_bus(backend->context, bus, &bus_handle), 0);
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 1, NULL), 0);
+    backend->close_bus(backend->context, bus_handle);
+    ASSERT_EQ(ops_cnt, 1);
+    ASSERT_EQ(data, 0xa5);
+    read_byte = 0x00;
+    yaml_i2c_recorder_free(recorder);
+    ASSERT_TRUE(yaml_get_i2c_backend(cy_handle) == NULL);
+
+    /* Record transfers on a simulator */
+    sim = yaml_i2c_sim_new(cy_handle, BASE_SUBSYSTEM, NULL);
+    ASSERT_TRUE(sim != NULL);
+    ASSERT_EQ(yaml_i2c_sim_set_register(sim, "cpld3", 0x02, 0xff), 0);
+    ASSERT_EQ(yaml_i2c_sim_set_register(sim, "sfpp1", 0x10, 0x5a), 0);
+    yaml_set_i2c_backend(cy_handle, yaml_i2c_sim_backend(sim));
+
+    recorder = yaml_i2c_recorder_new(cy_handle, BASE_SUBSYSTEM, path);
+    ASSERT_TRUE(recorder != NULL);
+    backend = yaml_get_i2c_backend(cy_handle);
+    ASSERT_TRUE(backend != yaml_i2c_sim_backend(sim));
+
+    ASSERT_EQ(backend->open_bus(backend->context, bus, &bus_handle), 0);
+    cmds[0] = sfpp1->pre[0];
+    cmds[1] = &read_op;
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 2, cmd_rc), 0);
+    ASSERT_EQ(data, 0x5a);
+    cmds[0] = sfpp1->post[0];
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 2, cmd_rc), ENXIO);
+    cmds[0] = sfpp1->pre[0];
+    cmds[1] = &write_op;
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 2, NULL), 0);
+    backend->close_bus(backend->context, bus_handle);
+
+    /* Freeing the recorder reinstalls the simulator */
+    yaml_i2c_recorder_free(recorder);
+    ASSERT_TRUE(yaml_get_i2c_backend(cy_handle) == yaml_i2c_sim_backend(sim));
+
+    /* Replays need a backend other than the real adapters */
+    yaml_set_i2c_backend(cy_handle, NULL);
+    ASSERT_EQ(yaml_i2c_trace_replay(cy_handle, BASE_SUBSYSTEM, path, 0,
+                                    &stats), EINVAL);
+
+    /* Nor a recorder of the real adapters */
+    snprintf(rec_path, sizeof(rec_path), "%s/%s", cwd, "i2c2.trace");
+    recorder = yaml_i2c_recorder_new(cy_handle, BASE_SUBSYSTEM, rec_path);
+    ASSERT_TRUE(recorder != NULL);
+    ops_cnt = 0;
+    ASSERT_EQ(yaml_i2c_trace_replay(cy_handle, BASE_SUBSYSTEM, path, 0,
+                                    &stats), EINVAL);
+    ASSERT_EQ(ops_cnt, 0);
+    yaml_i2c_recorder_free(recorder);
+    unlink_file(cwd, "i2c2.trace");
+
+    /* Replay into a fresh simulator */
+    replay_sim = yaml_i2c_sim_new(cy_handle, BASE_SUBSYSTEM, NULL);
+    ASSERT_TRUE(replay_sim != NULL);
+    ASSERT_EQ(yaml_i2c_sim_set_register(replay_sim, "cpld3", 0x02, 0xff), 0);
+    yaml_set_i2c_backend(cy_handle, yaml_i2c_sim_backend(replay_sim));
+
+    ASSERT_EQ(yaml_i2c_trace_replay(cy_handle, BASE_SUBSYSTEM, path, 0,
+                                    &stats), 0);
+    ASSERT_EQ(stats.transfers, 3u);
+    ASSERT_EQ(stats.messages, 6u);
+    ASSERT_EQ(stats.mismatches, 0u);
+    byte = 0;
+    ASSERT_EQ(yaml_i2c_sim_get_register(replay_sim, "sfpp1", 0x20, &byte), 0);
+    ASSERT_EQ(byte, 0x77);
+
+    /* Statuses that differ from the recorded ones are counted */
+    ASSERT_EQ(yaml_i2c_sim_inject_fault(replay_sim, "sfpp1", -1, EIO, 0), 0);
+    ASSERT_EQ(yaml_i2c_trace_replay(cy_handle, BASE_SUBSYSTEM, path, 1000,
+                                    &stats), 0);
+    ASSERT_EQ(stats.transfers, 3u);
+    ASSERT_EQ(stats.mismatches, 2u);
+
+    /* Missing and malformed traces */
+    ASSERT_EQ(yaml_i2c_trace_replay(cy_handle, BASE_SUBSYSTEM,
+                                    "/nonexistent/i2c.trace", 0, &stats),
+              ENOENT);
+    snprintf(path, sizeof(path), "%s/%s", cwd, GOOD_MANIFEST);
+    ASSERT_EQ(yaml_i2c_trace_replay(cy_handle, BASE_SUBSYSTEM, path, 0,
+                                    &stats), EINVAL);
+
+    yaml_set_i2c_backend(cy_handle, NULL);
+    yaml_i2c_sim_free(replay_sim);
+    yaml_i2c_sim_free(sim);
+
+    ops_cnt = 0;
+    unlink_file(cwd, "i2c.trace");
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+static YamlI2cStats *thread_stats;
+static const char thread_key = 0;
+
+static void *
+add_times(void *arg)
+{
+    int idx;
+
+    for (idx = 0; idx < 10000; idx++) {
+        yaml_i2c_stats_add_time(thread_stats, &thread_key, "shared", false,
+                                YAML_I2C_PHASE_LOCK_WAIT, idx);
+    }
+
+    return(NULL);
+}
+
+TEST_F(CfgYamlTestSuite, cfg_026_yaml_i2c_stats) {
+    static const char bus_key = 0;
+    static const char dev_key = 0;
+    YamlI2cStatsEntry entries[4];
+    const YamlI2cStatsEntry *bus_entry = NULL;
+    const YamlI2cStatsEntry *dev_entry = NULL;
+    const YamlI2cHistogram *payload;
+    YamlI2cStats *stats;
+    unsigned long long p50;
+    pthread_t threads[4];
+    int count;
+    int idx;
+
+    /* Every handle has statistics */
+    ASSERT_TRUE(yaml_get_i2c_stats(cy_handle) != NULL);
+
+    stats = yaml_i2c_stats_new();
+    ASSERT_TRUE(stats != NULL);
+    ASSERT_EQ(yaml_i2c_stats_snapshot(stats, entries, 4), 0);
+
+    /* A NULL set is ignored */
+    yaml_i2c_stats_add_time(NULL, &bus_key, "i2c_0", true,
+                            YAML_I2C_PHASE_PAYLOAD, 1000);
+    yaml_i2c_stats_add_transaction(NULL, &bus_key, "i2c_0", true, 1, 1, 0);
+
+    for (idx = 0; idx < 99; idx++) {
+        yaml_i2c_stats_add_time(stats, &bus_key, "i2c_0", true,
+                                YAML_I2C_PHASE_PAYLOAD, 1000);
+    }
+    yaml_i2c_stats_add_time(stats, &bus_key, "i2c_0", true,
+                            YAML_I2C_PHASE_PAYLOAD, 100000);
+    yaml_i2c_stats_add_time(stats, &dev_key, "sfpp1", false,
+                            YAML_I2C_PHASE_PRE, 5);
+    yaml_i2c_stats_add_transaction(stats, &bus_key, "i2c_0", true, 3, 4, 0);
+    yaml_i2c_stats_add_transaction(stats, &dev_key, "sfpp1", false, 3, 4, EIO);
+    yaml_i2c_stats_add_transaction(stats, &dev_key, "sfpp1", false, 1, 1, EIO);
+    yaml_i2c_stats_add_transaction(stats, &dev_key, "sfpp1", false, 1, 1,
+                                   1000);
+
+    /* The snapshot has an entry per bus and device */
+    ASSERT_EQ(yaml_i2c_stats_snapshot(stats, NULL, 0), 2);
+    count = yaml_i2c_stats_snapshot(stats, entries, 4);
+    ASSERT_EQ(count, 2);
+    for (idx = 0; idx < count; idx++) {
+        if (entries[idx].bus) {
+            bus_entry = &entries[idx];
+        } else {
+            dev_entry = &entries[idx];
+        }
+    }
+    ASSERT_TRUE(bus_entry != NULL && dev_entry != NULL);
+    ASSERT_STREQ(bus_entry->name, "i2c_0");
+    ASSERT_STREQ(dev_entry->name, "sfpp1");
+
+    ASSERT_EQ(bus_entry->transactions, 1u);
+    ASSERT_EQ(bus_entry->commands, 3u);
+    ASSERT_EQ(bus_entry->bytes, 4u);
+    ASSERT_EQ(dev_entry->transactions, 3u);
+    ASSERT_EQ(dev_entry->errors[EIO], 2u);
+    ASSERT_EQ(dev_entry->errors[YAML_I2C_STATS_ERRNOS - 1], 1u);
+
+    /* Percentiles are within a bucket, 12.5%, of the value */
+    payload = &bus_entry->phases[YAML_I2C_PHASE_PAYLOAD];
+    ASSERT_EQ(payload->count, 100u);
+    ASSERT_EQ(payload->total_ns, 99 * 1000u + 100000u);
+    ASSERT_EQ(payload->max_ns, 100000u);
+    p50 = yaml_i2c_histogram_percentile(payload, 50);
+    ASSERT_GE(p50, 1000u);
+    ASSERT_LT(p50, 1125u);
+    ASSERT_EQ(yaml_i2c_histogram_percentile(payload, 99), p50);
+    ASSERT_EQ(yaml_i2c_histogram_percentile(payload, 100), 100000u);
+    ASSERT_EQ(yaml_i2c_histogram_percentile(
+                  &dev_entry->phases[YAML_I2C_PHASE_PRE], 50), 5u);
+    ASSERT_EQ(yaml_i2c_histogram_percentile(
+                  &dev_entry->phases[YAML_I2C_PHASE_POST], 50), 0u);
+
+    /* Reset zeroes the counters and keeps the entries */
+    yaml_i2c_stats_reset(stats);
+    ASSERT_EQ(yaml_i2c_stats_snapshot(stats, entries, 4), 2);
+    for (idx = 0; idx < 2; idx++) {
+        ASSERT_EQ(entries[idx].transactions, 0u);
+        ASSERT_EQ(entries[idx].phases[YAML_I2C_PHASE_PAYLOAD].count, 0u);
+        ASSERT_EQ(entries[idx].phases[YAML_I2C_PHASE_PAYLOAD].buckets[0], 0u);
+    }
+
+    /* Concurrent adds, including the creation of the entry, aren't lost */
+    thread_stats = stats;
+    for (idx = 0; idx < 4; idx++) {
+        ASSERT_EQ(pthread_create(&threads[idx], NULL, add_times, NULL), 0);
+    }
+    for (idx = 0; idx < 4; idx++) {
+        pthread_join(threads[idx], NULL);
+    }
+    count = yaml_i2c_stats_snapshot(stats, entries, 4);
+    ASSERT_EQ(count, 3);
+    for (idx = 0; idx < count; idx++) {
+        if (strcmp(entries[idx].name, "shared") == 0) {
+            ASSERT_EQ(entries[idx].phases[YAML_I2C_PHASE_LOCK_WAIT].count,
+                      40000u);
+            ASSERT_EQ(entries[idx].phases[YAML_I2C_PHASE_LOCK_WAIT].max_ns,
+                      9999u);
+        }
+    }
+
+    yaml_i2c_stats_free(stats);
+}
+
+static char lock_path[1100];
+
+static void *
+lock_bus(void *arg)
+{
+    YamlBusLock *lock;
+
+    if (yaml_bus_lock(lock_path, &lock) == 0) {
+        yaml_bus_unlock(lock);
+    }
+
+    return(NULL);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that bus locks
+ * - take flock() once for nested locks.
+ * - serialize threads and processes.
+ * - hand the flock over to a waiting thread.
+ * - give a forked child its own close-on-exec descriptor.
+ * - are held across transfers by a bus session.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_027_yaml_bus_lock) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     fd;
+    int     other_fd;
+    void    *bus_handle;
+    const YamlBus *bus;
+    const YamlI2cBackend *backend;
+    YamlBusLock *lock;
+    YamlBusLock *nested;
+    YamlBusLockStats stats;
+    YamlI2cBusSession *session;
+    YamlI2cSim *sim;
+    pthread_t thread;
+    pid_t pid;
+    int status;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    /* A regular file stands in for the bus device */
+    snprintf(lock_path, sizeof(lock_path), "%s/%s", cwd, "bus.lock");
+    fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    ASSERT_EQ(yaml_bus_lock("/nonexistent/i2c-0", &lock), ENOENT);
+    ASSERT_EQ(yaml_bus_lock_get_stats("/nonexistent/i2c-0", &stats), EINVAL);
+
+    /* The holder locks again without flock */
+    ASSERT_EQ(yaml_bus_lock(lock_path, &lock), 0);
+    ASSERT_GE(yaml_bus_lock_fd(lock), 0);
+    ASSERT_EQ(yaml_bus_lock(lock_path, &nested), 0);
+    ASSERT_TRUE(nested == lock);
+    ASSERT_EQ(yaml_bus_lock_get_stats(lock_path, &stats), 0);
+    ASSERT_EQ(stats.acquisitions, 1u);
+    ASSERT_EQ(stats.nested, 1u);
+    ASSERT_EQ(stats.flocks, 1u);
+
+    /* Other processes are locked out until the outermost unlock */
+    other_fd = open(lock_path, O_RDWR);
+    ASSERT_GE(other_fd, 0);
+    yaml_bus_unlock(nested);
+    ASSERT_NE(flock(other_fd, LOCK_EX | LOCK_NB), 0);
+    yaml_bus_unlock(lock);
+    ASSERT_EQ(flock(other_fd, LOCK_EX | LOCK_NB), 0);
+
+    /* ... and the next lock waits for them */
+    ASSERT_EQ(pthread_create(&thread, NULL, lock_bus, NULL), 0);
+    do {
+        usleep(1000);
+        ASSERT_EQ(yaml_bus_lock_get_stats(lock_path, &stats), 0);
+    } while (stats.flock_contended == 0);
+    flock(other_fd, LOCK_UN);
+    pthread_join(thread, NULL);
+    close(other_fd);
+    ASSERT_EQ(yaml_bus_lock_get_stats(lock_path, &stats), 0);
+    ASSERT_EQ(stats.acquisitions, 2u);
+    ASSERT_EQ(stats.flock_contended, 1u);
+    ASSERT_EQ(stats.contended, 0u);
+
+    /* Threads of the process wait on the mutex */
+    ASSERT_EQ(yaml_bus_lock(lock_path, &lock), 0);
+    ASSERT_EQ(pthread_create(&thread, NULL, lock_bus, NULL), 0);
+    usleep(50000);
+    yaml_bus_unlock(lock);
+    pthread_join(thread, NULL);
+    ASSERT_EQ(yaml_bus_lock_get_stats(lock_path, &stats), 0);
+    ASSERT_EQ(stats.acquisitions, 4u);
+    ASSERT_EQ(stats.contended, 1u);
+    ASSERT_GT(stats.wait_ns, 0u);
+
+    /* ... and the waiting thread is handed the flock over */
+    ASSERT_EQ(stats.flocks, 3u);
+    other_fd = open(lock_path, O_RDWR);
+    ASSERT_GE(other_fd, 0);
+    ASSERT_EQ(flock(other_fd, LOCK_EX | LOCK_NB), 0);
+    flock(other_fd, LOCK_UN);
+    close(other_fd);
+
+    /* A forked child has its own descriptor and waits for its parent */
+    ASSERT_EQ(yaml_bus_lock(lock_path, &lock), 0);
+    pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        YamlBusLockStats before;
+
+        yaml_bus_lock_get_stats(lock_path, &before);
+        if (yaml_bus_lock(lock_path, &lock) != 0) {
+            _exit(2);
+        }
+        yaml_bus_unlock(lock);
+        yaml_bus_lock_get_stats(lock_path, &stats);
+        _exit(stats.flock_contended == before.flock_contended + 1 ? 0 : 1);
+    }
+    usleep(50000);
+    yaml_bus_unlock(lock);
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    ASSERT_EQ(fcntl(yaml_bus_lock_fd(lock), F_GETFD) & FD_CLOEXEC,
+              FD_CLOEXEC);
+
+    /* A bus session holds the bus across transfers */
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd), 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+    bus = yaml_find_bus(cy_handle, BASE_SUBSYSTEM, "i2c_0");
+    ASSERT_TRUE(bus != NULL);
+
+    sim = yaml_i2c_sim_new(cy_handle, BASE_SUBSYSTEM, NULL);
+    ASSERT_TRUE(sim != NULL);
+    backend = yaml_i2c_sim_backend(sim);
+    yaml_set_i2c_backend(cy_handle, backend);
+
+    ASSERT_TRUE(yaml_i2c_bus_session_begin(cy_handle, BASE_SUBSYSTEM,
+                                           "no_such_bus") == NULL);
+    session = yaml_i2c_bus_session_begin(cy_handle, BASE_SUBSYSTEM, "i2c_0");
+    ASSERT_TRUE(session != NULL);
+    ASSERT_EQ(backend->open_bus(backend->context, bus, &bus_handle), 0);
+    backend->close_bus(backend->context, bus_handle);
+    yaml_i2c_bus_session_end(session);
+
+    yaml_set_i2c_backend(cy_handle, NULL);
+    yaml_i2c_sim_free(sim);
+
+    unlink_file(cwd, "bus.lock");
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Returns true if two bit ops of module signals are alike */
+static bool
+same_bit_op(const i2c_bit_op *a, const i2c_bit_op *b)
+{
+    if (a == NULL || b == NULL) {
+        return(a == b);
+    }
+
+    return(strcmp(a->device, b->device) == 0 &&
+           a->register_address == b->register_address &&
+           a->bit_mask == b->bit_mask &&
+           a->negative_polarity == b->negative_polarity);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that lazily parsed ports
+ * - give the count and port info without decoding the ports.
+ * - decode each port on first access like an eager parse.
+ * - replace the ports of an eager parse.
+ * - leave no placeholder ports after a malformed ports file.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_028_yaml_lazy_ports) {
+    char    cwd[1024];
+    int     rc = 0;
+    int     count;
+    int     idx;
+    unsigned int array_count;
+    YamlConfigHandle eager_handle;
+    const YamlPort *ports;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    eager_handle = yaml_new_config_handle();
+    ASSERT_EQ(yaml_add_subsystem(eager_handle, BASE_SUBSYSTEM, cwd), 0);
+    ASSERT_EQ(yaml_parse_ports(eager_handle, BASE_SUBSYSTEM), 0);
+
+    printf("Parse the ports lazily.\n");
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd), 0);
+    ASSERT_EQ(yaml_parse_ports_lazy(cy_handle, "junk_subsystem"), -1);
+    ASSERT_EQ(yaml_parse_ports_lazy(cy_handle, BASE_SUBSYSTEM), 0);
+
+    /* The count and port info don't need the ports */
+    count = yaml_get_port_count(cy_handle, BASE_SUBSYSTEM);
+    ASSERT_EQ(count, yaml_get_port_count(eager_handle, BASE_SUBSYSTEM));
+    ASSERT_GT(count, 0);
+    ASSERT_EQ(yaml_get_port_info(cy_handle, BASE_SUBSYSTEM)->number_ports,
+              yaml_get_port_info(eager_handle, BASE_SUBSYSTEM)->number_ports);
+    ASSERT_EQ(yaml_get_port_info(cy_handle, BASE_SUBSYSTEM)->max_port_speed,
+              yaml_get_port_info(eager_handle, BASE_SUBSYSTEM)->max_port_speed);
+
+    /* A port is decoded on first access, then kept */
+    printf("Decode the ports one at a time, last first.\n");
+    ASSERT_TRUE(yaml_get_port(cy_handle, BASE_SUBSYSTEM, count) == NULL);
+    for (idx = count - 1; idx >= 0; idx--) {
+        const YamlPort *lazy = yaml_get_port(cy_handle, BASE_SUBSYSTEM, idx);
+        const YamlPort *eager = yaml_get_port(eager_handle, BASE_SUBSYSTEM,
+                                              idx);
+        const i2c_bit_op * const *lazy_ops;
+        const i2c_bit_op * const *eager_ops;
+        unsigned int op;
+
+        ASSERT_TRUE(lazy != NULL && eager != NULL);
+        ASSERT_EQ(lazy, yaml_get_port(cy_handle, BASE_SUBSYSTEM, idx));
+        ASSERT_STREQ(lazy->name, eager->name);
+        ASSERT_STREQ(lazy->connector, eager->connector);
+        ASSERT_EQ(lazy->pluggable, eager->pluggable);
+        ASSERT_EQ(lazy->max_speed, eager->max_speed);
+        ASSERT_EQ(lazy->device, eager->device);
+        ASSERT_EQ(lazy->device_port, eager->device_port);
+        ASSERT_EQ(*lazy->speeds[0], *eager->speeds[0]);
+        ASSERT_EQ(lazy->subport_number, eager->subport_number);
+        if (eager->pluggable) {
+            ASSERT_STREQ(lazy->module_eeprom, eager->module_eeprom);
+        }
+
+        /* The module signals are bit op pointers, whatever the module */
+        lazy_ops = (const i2c_bit_op * const *)&lazy->module_signals;
+        eager_ops = (const i2c_bit_op * const *)&eager->module_signals;
+        for (op = 0; op < sizeof(YamlModuleSignals) / sizeof(i2c_bit_op *);
+                op++) {
+            ASSERT_TRUE(same_bit_op(lazy_ops[op], eager_ops[op]));
+        }
+    }
+
+    /* The array aliases the decoded ports */
+    ports = yaml_get_ports_array(cy_handle, BASE_SUBSYSTEM, &array_count);
+    ASSERT_EQ((int)array_count, count);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(&ports[idx], yaml_get_port(cy_handle, BASE_SUBSYSTEM, idx));
+    }
+
+    /* A lazy parse replaces the ports of an eager one */
+    ASSERT_EQ(yaml_parse_ports_lazy(eager_handle, BASE_SUBSYSTEM), 0);
+    ports = yaml_get_ports_array(eager_handle, BASE_SUBSYSTEM, &array_count);
+    ASSERT_EQ((int)array_count, count);
+    ASSERT_STREQ(ports[0].name,
+                 yaml_get_port(cy_handle, BASE_SUBSYSTEM, 0)->name);
+
+    /* Malformed port entries leave no placeholder ports behind */
+    printf("Parse a malformed ports file lazily.\n");
+    char copy_dir[] = "/tmp/cfg_yaml_ut.XXXXXX";
+    char cmd[4096];
+
+    ASSERT_TRUE(mkdtemp(copy_dir) != NULL);
+    snprintf(cmd, sizeof(cmd),
+             "cp %s/%s %s/%s && sed '/^ports:/,$d' %s/ports.yaml > "
+             "%s/ports.yaml && printf 'ports:\\n    bad: 1\\n' >> "
+             "%s/ports.yaml", cwd, GOOD_MANIFEST, copy_dir, MANIFEST_FILE,
+             cwd, copy_dir, copy_dir);
+    ASSERT_EQ(system(cmd), 0);
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, "bad", copy_dir), 0);
+    ASSERT_EQ(yaml_parse_ports_lazy(cy_handle, "bad"), -1);
+    ASSERT_TRUE(yaml_get_port(cy_handle, "bad", 0) == NULL);
+    ASSERT_TRUE(yaml_get_ports_array(cy_handle, "bad", &array_count) ==
+                NULL || array_count == 0);
+
+    snprintf(cmd, sizeof(cmd), "/bin/rm -rf %s", copy_dir);
+    system(cmd);
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+/* Test Fixture. */
+/*************************************************************//**
+ * Verify that the parse cache
+ * - shares the parsed document of files with the same content.
+ * - ignores comment and blank lines.
+ * - keeps documents in use, e.g. by lazy ports.
+ * - keeps a bounded number of documents that aren't in use.
+ ****************************************************************/
+TEST_F(CfgYamlTestSuite, cfg_029_yaml_parse_cache) {
+    char    cwd[1024];
+    char    copy_dir[] = "/tmp/cfg_yaml_ut.XXXXXX";
+    char    cmd[4096];
+    int     rc = 0;
+    unsigned int count;
+    YamlConfigHandle other_handle;
+    YamlParseCacheStats stats;
+
+    rc = snprintf(cwd, sizeof(cwd), "%s/%s", CFG_YAML_UT_FILE_DIR, "yaml_files");
+    ASSERT_GT(rc, 0);
+
+    unlink_file(cwd, MANIFEST_FILE);
+    link_file(cwd, GOOD_MANIFEST, MANIFEST_FILE);
+
+    yaml_parse_cache_clear();
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.hits, 0);
+    ASSERT_EQ(stats.misses, 0);
+    ASSERT_EQ(stats.entries, 0);
+
+    printf("Parse the manifest and fans on a first handle.\n");
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, cwd), 0);
+    ASSERT_EQ(yaml_parse_fans(cy_handle, BASE_SUBSYSTEM), 0);
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.hits, 0);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.entries, 2);
+    ASSERT_GT(stats.bytes, 0);
+
+    /* The same files on another handle share the parsed documents */
+    printf("Parse the same files on a second handle.\n");
+    other_handle = yaml_new_config_handle();
+    ASSERT_EQ(yaml_add_subsystem(other_handle, BASE_SUBSYSTEM, cwd), 0);
+    ASSERT_EQ(yaml_parse_fans(other_handle, BASE_SUBSYSTEM), 0);
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.hits, 2);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.entries, 2);
+    ASSERT_EQ(yaml_get_fan_fru_count(other_handle, BASE_SUBSYSTEM),
+              yaml_get_fan_fru_count(cy_handle, BASE_SUBSYSTEM));
+    ASSERT_EQ(yaml_get_fan_fru(other_handle, BASE_SUBSYSTEM, 0)->number,
+              yaml_get_fan_fru(cy_handle, BASE_SUBSYSTEM, 0)->number);
+
+    /* Comment lines and blank lines don't change the content */
+    printf("Parse a copy of the fans with more comments.\n");
+    ASSERT_TRUE(mkdtemp(copy_dir) != NULL);
+    snprintf(cmd, sizeof(cmd),
+             "cp %s/%s %s/%s && (echo '# a copy'; echo; cat %s/fans.yaml) "
+             "> %s/fans.yaml", cwd, GOOD_MANIFEST, copy_dir, MANIFEST_FILE,
+             cwd, copy_dir);
+    ASSERT_EQ(system(cmd), 0);
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, "copy", copy_dir), 0);
+    ASSERT_EQ(yaml_parse_fans(cy_handle, "copy"), 0);
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.hits, 4);
+    ASSERT_EQ(stats.misses, 2);
+
+    /* Other content is parsed */
+    snprintf(cmd, sizeof(cmd), "echo 'extra: 1' >> %s/fans.yaml", copy_dir);
+    ASSERT_EQ(system(cmd), 0);
+    ASSERT_EQ(yaml_parse_fans(cy_handle, "copy"), 0);
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.misses, 3);
+    ASSERT_EQ(stats.entries, 3);
+
+    /* Lazy ports hold their document until every port is decoded */
+    printf("Clear the cache while ports are decoded lazily.\n");
+    ASSERT_EQ(yaml_parse_ports_lazy(cy_handle, BASE_SUBSYSTEM), 0);
+    yaml_parse_cache_clear();
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.hits, 0);
+    ASSERT_EQ(stats.misses, 0);
+    ASSERT_EQ(stats.entries, 1);
+    ASSERT_TRUE(yaml_get_ports_array(cy_handle, BASE_SUBSYSTEM, &count) !=
+                NULL);
+    ASSERT_GT(count, 0);
+    yaml_parse_cache_clear();
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.entries, 0);
+    ASSERT_EQ(stats.bytes, 0);
+
+    ASSERT_EQ(yaml_parse_fans(other_handle, BASE_SUBSYSTEM), 0);
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.hits, 0);
+    ASSERT_EQ(stats.misses, 1);
+
+    /* Only the most recently used documents that aren't in use are kept */
+    printf("Parse more contents than the cache keeps.\n");
+    for (int idx = 0; idx < YAML_PARSE_CACHE_MAX_IDLE + 4; idx++) {
+        snprintf(cmd, sizeof(cmd), "echo 'extra%d: 1' >> %s/fans.yaml", idx,
+                 copy_dir);
+        ASSERT_EQ(system(cmd), 0);
+        ASSERT_EQ(yaml_parse_fans(cy_handle, "copy"), 0);
+    }
+    yaml_get_parse_cache_stats(&stats);
+    ASSERT_EQ(stats.entries, YAML_PARSE_CACHE_MAX_IDLE);
+
+    snprintf(cmd, sizeof(cmd), "/bin/rm -rf %s", copy_dir);
+    system(cmd);
+    unlink_file(cwd, MANIFEST_FILE);
+}
+
+TEST_F(CfgYamlTestSuite, cfg_030_yaml_catalog) {
+    char    root[] = "/tmp/cfg_yaml_ut.XXXXXX";
+    char    index_file[1024];
+    char    cmd[4096];
+    unsigned int count;
+    unsigned int idx;
+    unsigned long long hash;
+    YamlCatalog *catalog;
+    const YamlCatalogPlatform *platforms;
+    const YamlCatalogPlatform *platform;
+    YamlCatalogPlatform twins[2];
+    FILE    *fp;
+
+    ASSERT_TRUE(mkdtemp(root) != NULL);
+    snprintf(index_file, sizeof(index_file), "%s/catalog.idx", root);
+    snprintf(cmd, sizeof(cmd),
+             "mkdir %s/hwdesc && ln -s %s/../Accton %s/hwdesc/Accton && "
+             "ln -s %s/../Generic-x86 %s/hwdesc/Generic-x86 && "
+             "mkdir %s/hwdesc/OpenSwitch && "
+             "cp -r %s/../OpenSwitch/Appliance %s/hwdesc/OpenSwitch && "
+             "mkdir %s/hwdesc/empty", root, CFG_YAML_UT_SRC_DIR, root,
+             CFG_YAML_UT_SRC_DIR, root, root, CFG_YAML_UT_SRC_DIR, root, root);
+    ASSERT_EQ(system(cmd), 0);
+
+    printf("Build the catalog of the platforms.\n");
+    ASSERT_EQ(yaml_catalog_build(NULL, index_file), EINVAL);
+    ASSERT_EQ(yaml_catalog_build("/nonexistent", index_file), ENOENT);
+    snprintf(cmd, sizeof(cmd), "%s/hwdesc", root);
+    ASSERT_EQ(yaml_catalog_build(cmd, index_file), 0);
+
+    catalog = yaml_catalog_open(index_file);
+    ASSERT_TRUE(catalog != NULL);
+    platforms = yaml_catalog_get_platforms(catalog, &count);
+    ASSERT_EQ(count, 7);
+    for (idx = 1; idx < count; idx++) {
+        ASSERT_LT(strcmp(platforms[idx - 1].product_name,
+                         platforms[idx].product_name), 0);
+    }
+
+    /* The lookup gives the directory and files of the manifest */
+    printf("Find platforms by product name and manufacturer.\n");
+    platform = yaml_catalog_find(catalog, NULL, "7712-32X");
+    ASSERT_TRUE(platform != NULL);
+    ASSERT_STREQ(platform->manufacturer, "Accton");
+    ASSERT_TRUE(strstr(platform->dir, "/Accton/AS7712-32X") != NULL);
+    ASSERT_EQ(platform, yaml_catalog_find(catalog, "Accton", "7712-32X"));
+    ASSERT_TRUE(yaml_catalog_find(catalog, "Dell", "7712-32X") == NULL);
+    ASSERT_TRUE(yaml_catalog_find(catalog, NULL, "7712") == NULL);
+    ASSERT_TRUE(yaml_catalog_find(catalog, NULL, NULL) == NULL);
+    ASSERT_GT(platform->file_count, 0);
+    ASSERT_STREQ(platform->files[0].name, "manifest");
+    ASSERT_STREQ(platform->files[0].filename, MANIFEST_FILE);
+    snprintf(cmd, sizeof(cmd), "%s/%s", platform->dir, MANIFEST_FILE);
+    ASSERT_EQ(yaml_catalog_hash_file(cmd, &hash), 0);
+    ASSERT_EQ(hash, platform->files[0].hash);
+    ASSERT_EQ(yaml_catalog_verify(platform), 0);
+
+    /* The directory is a subsystem directory */
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, platform->dir), 0);
+
+    /* A changed file is detected */
+    printf("Change a file of a platform.\n");
+    platform = yaml_catalog_find(catalog, "OpenSwitch", "Appliance");
+    ASSERT_TRUE(platform != NULL);
+    ASSERT_EQ(yaml_catalog_verify(platform), 0);
+    snprintf(cmd, sizeof(cmd), "echo '# changed' >> %s/%s", platform->dir,
+             MANIFEST_FILE);
+    ASSERT_EQ(system(cmd), 0);
+    ASSERT_EQ(yaml_catalog_verify(platform), ESTALE);
+    yaml_catalog_close(catalog);
+
+    /* Two platforms for a product can't be told apart */
+    printf("Write two platforms with the same product.\n");
+    memset(twins, 0, sizeof(twins));
+    twins[0].manufacturer = twins[1].manufacturer = "Accton";
+    twins[0].product_name = twins[1].product_name = "7712-32X";
+    twins[0].dir = "/a";
+    twins[1].dir = "/b";
+    ASSERT_EQ(yaml_catalog_write(index_file, twins, 2), EEXIST);
+    twins[1].manufacturer = "Edgecore";
+    ASSERT_EQ(yaml_catalog_write(index_file, twins, 2), 0);
+    catalog = yaml_catalog_open(index_file);
+    ASSERT_TRUE(catalog != NULL);
+    ASSERT_STREQ(yaml_catalog_find(catalog, "Edgecore", "7712-32X")->dir, "/b");
+    ASSERT_STREQ(yaml_catalog_find(catalog, NULL, "7712-32X")->dir, "/a");
+    ASSERT_EQ(yaml_catalog_find(catalog, NULL, "7712-32X")->file_count, 0);
+    yaml_catalog_close(catalog);
+
+    /* A damaged index is rejected */
+    printf("Damage the index.\n");
+    fp = fopen(index_file, "r+");
+    ASSERT_TRUE(fp != NULL);
+    fseek(fp, -2, SEEK_END);
+    fputc('X', fp);
+    fclose(fp);
+    errno = 0;
+    ASSERT_TRUE(yaml_catalog_open(index_file) == NULL);
+    ASSERT_EQ(errno, EINVAL);
+    snprintf(cmd, sizeof(cmd), "%s/manifest.yaml", root);
+    fp = fopen(cmd, "w");
+    ASSERT_TRUE(fp != NULL);
+    fclose(fp);
+    ASSERT_TRUE(yaml_catalog_open(cmd) == NULL);
+    ASSERT_TRUE(yaml_catalog_open("/nonexistent") == NULL);
+    ASSERT_EQ(errno, ENOENT);
+
+    snprintf(cmd, sizeof(cmd), "/bin/rm -rf %s", root);
+    system(cmd);
+}
+
 GTEST_API_ int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,285 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Benchmark for the i2c access paths, on the i2c simulator. It loads the
+ * description files of a platform and compares the modeled bus time of the
+ * per bit op accesses with the PSU sweep, the presence scan and the EEPROM
+ * cache. The numbers come from the timing model, so they are reproducible.
+ *
+ * Usage: i2c_sim_bench <directory with manifest.yaml> [iterations] [kHz]
+ *                      [trace]
+ *
+ * The transactions are recorded to the trace file, if given, for
+ * ops-i2c-trace-replay.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+
+#define BENCH_SUBSYSTEM     "bench"
+
+static YamlConfigHandle handle;
+static YamlI2cSim *sim;
+
+static void
+report(const char *name, unsigned int iterations)
+{
+    YamlI2cSimStats stats;
+
+    yaml_i2c_sim_get_stats(sim, &stats);
+    printf("%-28s %10.1f transactions %10.1f bytes %10.3f ms "
+           "%6llu faults\n", name,
+           (double)stats.transactions / iterations,
+           (double)stats.bytes / iterations,
+           (double)stats.elapsed_ns / iterations / 1e6, stats.faults);
+    yaml_i2c_sim_reset_stats(sim);
+}
+
+static void
+bench_psus(unsigned int iterations)
+{
+    const YamlPsu *psus;
+    YamlPsuSweep *sweep;
+    YamlPsuEdge edges[64];
+    unsigned int count;
+    unsigned int idx;
+    unsigned int it;
+    unsigned int value;
+
+    psus = yaml_get_psus_array(handle, BENCH_SUBSYSTEM, &count);
+    if (psus == NULL) {
+        return;
+    }
+
+    for (it = 0; it < iterations; it++) {
+        for (idx = 0; idx < count; idx++) {
+            yaml_bit_op_read(handle, BENCH_SUBSYSTEM, psus[idx].psu_present,
+                             &value);
+            yaml_bit_op_read(handle, BENCH_SUBSYSTEM, psus[idx].psu_input_ok,
+                             &value);
+            yaml_bit_op_read(handle, BENCH_SUBSYSTEM, psus[idx].psu_output_ok,
+                             &value);
+        }
+    }
+    report("psu status, per bit op", iterations);
+
+    sweep = yaml_psu_sweep_new(handle, BENCH_SUBSYSTEM);
+    yaml_psu_sweep(sweep, edges, 64, &count);
+    yaml_i2c_sim_reset_stats(sim);
+    for (it = 0; it < iterations; it++) {
+        yaml_psu_sweep(sweep, edges, 64, &count);
+    }
+    report("psu status, sweep", iterations);
+    yaml_psu_sweep_free(sweep);
+}
+
+static const i2c_bit_op *
+presence_op(const YamlPort *port)
+{
+    if (!port->pluggable || port->connector == NULL) {
+        return(NULL);
+    } else if (strcmp(port->connector, SFPP) == 0) {
+        return(port->module_signals.sfp.sfpp_mod_present);
+    } else if (strcmp(port->connector, QSFPP) == 0) {
+        return(port->module_signals.qsfp.qsfpp_mod_present);
+    } else if (strcmp(port->connector, QSFP28) == 0) {
+        return(port->module_signals.qsfp28.qsfp28p_mod_present);
+    }
+    return(NULL);
+}
+
+static void
+bench_presence(unsigned int iterations)
+{
+    const YamlPort *ports;
+    YamlPresenceScan *scan;
+    YamlPresenceEdge *edges;
+    unsigned int count;
+    unsigned int edge_count;
+    unsigned int idx;
+    unsigned int it;
+    unsigned int value;
+
+    ports = yaml_get_ports_array(handle, BENCH_SUBSYSTEM, &count);
+    if (ports == NULL) {
+        return;
+    }
+
+    for (it = 0; it < iterations; it++) {
+        for (idx = 0; idx < count; idx++) {
+            const i2c_bit_op *op = presence_op(&ports[idx]);
+
+            if (op != NULL) {
+                yaml_bit_op_read(handle, BENCH_SUBSYSTEM, op, &value);
+            }
+        }
+    }
+    report("module presence, per port", iterations);
+
+    edges = (YamlPresenceEdge *)calloc(count, sizeof(YamlPresenceEdge));
+    scan = yaml_presence_scan_new(handle, BENCH_SUBSYSTEM, 0);
+    yaml_presence_scan(scan, edges, count, &edge_count);
+    yaml_i2c_sim_reset_stats(sim);
+    for (it = 0; it < iterations; it++) {
+        yaml_presence_scan(scan, edges, count, &edge_count);
+    }
+    report("module presence, scan", iterations);
+    yaml_presence_scan_free(scan);
+    free(edges);
+}
+
+static void
+bench_eeprom(unsigned int iterations)
+{
+    const YamlPort *ports;
+    YamlEepromCache *cache;
+    unsigned char data[256];
+    unsigned int count;
+    unsigned int idx;
+    unsigned int it;
+
+    ports = yaml_get_ports_array(handle, BENCH_SUBSYSTEM, &count);
+    if (ports == NULL) {
+        return;
+    }
+
+    for (it = 0; it < iterations; it++) {
+        for (idx = 0; idx < count; idx++) {
+            if (presence_op(&ports[idx]) != NULL) {
+                yaml_register_read_block(handle, BENCH_SUBSYSTEM,
+                                         ports[idx].module_eeprom, 0,
+                                         data, sizeof(data));
+            }
+        }
+    }
+    report("module eeprom, uncached", iterations);
+
+    cache = yaml_eeprom_cache_new(handle, BENCH_SUBSYSTEM, 0);
+    for (it = 0; it < iterations; it++) {
+        for (idx = 0; idx < count; idx++) {
+            if (presence_op(&ports[idx]) != NULL) {
+                yaml_eeprom_read(cache, idx, 0, sizeof(data), data);
+            }
+        }
+    }
+    report("module eeprom, cached", iterations);
+    yaml_eeprom_cache_free(cache);
+}
+
+/* Prints the latency of each phase on each bus, as measured by i2c.c */
+static void
+print_bus_stats(void)
+{
+    static const char *phases[YAML_I2C_PHASE_COUNT] = {
+        "lock wait", "pre", "payload", "post"
+    };
+    YamlI2cStatsEntry *entries;
+    int count;
+    int idx;
+    int phase;
+
+    count = yaml_i2c_stats_snapshot(yaml_get_i2c_stats(handle), NULL, 0);
+    entries = (YamlI2cStatsEntry *)calloc(count, sizeof(YamlI2cStatsEntry));
+    if (entries == NULL) {
+        return;
+    }
+    count = yaml_i2c_stats_snapshot(yaml_get_i2c_stats(handle), entries,
+                                    count);
+
+    for (idx = 0; idx < count; idx++) {
+        if (!entries[idx].bus) {
+            continue;
+        }
+        printf("%s: %llu transactions, %llu commands, %llu bytes\n",
+               entries[idx].name, entries[idx].transactions,
+               entries[idx].commands, entries[idx].bytes);
+        for (phase = 0; phase < YAML_I2C_PHASE_COUNT; phase++) {
+            const YamlI2cHistogram *histogram = &entries[idx].phases[phase];
+
+            printf("  %-10s %10llu  p50 %8llu ns  p99 %8llu ns  "
+                   "max %8llu ns\n", phases[phase], histogram->count,
+                   yaml_i2c_histogram_percentile(histogram, 50),
+                   yaml_i2c_histogram_percentile(histogram, 99),
+                   histogram->max_ns);
+        }
+    }
+
+    free(entries);
+}
+
+int
+main(int argc, char **argv)
+{
+    YamlI2cSimConfig config;
+    YamlI2cRecorder *recorder = NULL;
+    unsigned int iterations = 100;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <directory> [iterations] [kHz] [trace]\n",
+                argv[0]);
+        return(1);
+    }
+    if (argc > 2) {
+        iterations = strtoul(argv[2], NULL, 0);
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.bus_khz = argc > 3 ? strtoul(argv[3], NULL, 0) : 100;
+    config.transaction_ns = 20000;
+
+    handle = yaml_new_config_handle();
+    if (yaml_add_subsystem(handle, BENCH_SUBSYSTEM, argv[1]) != 0 ||
+            yaml_parse_devices(handle, BENCH_SUBSYSTEM) != 0) {
+        fprintf(stderr, "%s: can't parse the devices of %s\n", argv[0],
+                argv[1]);
+        return(1);
+    }
+    yaml_parse_ports(handle, BENCH_SUBSYSTEM);
+    yaml_parse_psus(handle, BENCH_SUBSYSTEM);
+
+    sim = yaml_i2c_sim_new(handle, BENCH_SUBSYSTEM, &config);
+    if (sim == NULL || iterations == 0) {
+        return(1);
+    }
+    yaml_set_i2c_backend(handle, yaml_i2c_sim_backend(sim));
+
+    if (argc > 4) {
+        recorder = yaml_i2c_recorder_new(handle, BENCH_SUBSYSTEM, argv[4]);
+        if (recorder == NULL) {
+            fprintf(stderr, "%s: can't record to %s\n", argv[0], argv[4]);
+            return(1);
+        }
+    }
+
+    yaml_init_devices(handle, BENCH_SUBSYSTEM);
+    report("init devices", 1);
+
+    bench_psus(iterations);
+    bench_presence(iterations);
+    bench_eeprom(iterations);
+
+    yaml_i2c_recorder_free(recorder);
+
+    print_bus_stats();
+    yaml_set_i2c_backend(handle, NULL);
+    yaml_i2c_sim_free(sim);
+
+    return(0);
+}
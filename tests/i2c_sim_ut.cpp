@@ -0,0 +1,520 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/*
+ * Tests of the i2c execution layer, i2c_execute() and i2c_execute_list(),
+ * on the i2c simulator. Unlike cfg_yaml_ut, they link the library itself
+ * rather than i2c fakes.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "config-yaml.h"
+
+#include "cfg_yaml_ut.h"
+
+#define GOOD_MANIFEST "good.manifest.yaml"
+#define MANIFEST_FILE "manifest.yaml"
+
+#define BATCH_OPS   1000
+
+#define LINECARD_SUBSYSTEM "linecard"
+
+/* Backend that records the commands it is given, and performs none */
+static struct {
+    std::vector<const YamlBus *>    buses;
+    std::vector<const YamlDevice *> devices;
+    std::vector<unsigned char>      data;
+} captured;
+
+static int
+capture_open_bus(void *context, const YamlBus *bus, void **bus_handle)
+{
+    *bus_handle = (void *)bus;
+    return(0);
+}
+
+static void
+capture_close_bus(void *context, void *bus_handle)
+{
+}
+
+static int
+capture_transfer(void *context, void *bus_handle, YamlConfigHandle handle,
+                 const char *subsyst, const YamlBus *bus, i2c_op **cmds,
+                 unsigned int count, int *cmd_rc)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        captured.buses.push_back(bus);
+        captured.devices.push_back(yaml_find_device(handle, subsyst,
+                                                    cmds[idx]->device));
+        captured.data.push_back(cmds[idx]->direction ? cmds[idx]->data[0] : 0);
+        if (cmd_rc != NULL) {
+            cmd_rc[idx] = 0;
+        }
+    }
+
+    return(0);
+}
+
+static const YamlI2cBackend capture_backend = {
+    NULL,
+    capture_open_bus,
+    capture_close_bus,
+    capture_transfer
+};
+
+class I2cSimTestSuite : public testing::Test
+{
+    public:
+        YamlConfigHandle    cy_handle;
+        YamlI2cSim          *sim;
+        char                dir[1024];
+        char                manifest[1100];
+        unsigned char       data[BATCH_OPS];
+        i2c_op              ops[BATCH_OPS];
+        i2c_op              *cmds[BATCH_OPS + 1];
+        int                 results[BATCH_OPS];
+
+    void SetUp(void) {
+        char target[1100];
+
+        snprintf(dir, sizeof(dir), "%s/%s", CFG_YAML_UT_FILE_DIR,
+                 "yaml_files");
+        snprintf(manifest, sizeof(manifest), "%s/%s", dir, MANIFEST_FILE);
+        snprintf(target, sizeof(target), "%s/%s", dir, GOOD_MANIFEST);
+        unlink(manifest);
+        ASSERT_EQ(symlink(target, manifest), 0);
+
+        cy_handle = yaml_new_config_handle();
+        ASSERT_NE(cy_handle, (YamlConfigHandle) NULL);
+        ASSERT_EQ(yaml_add_subsystem(cy_handle, BASE_SUBSYSTEM, dir), 0);
+        ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+
+        sim = yaml_i2c_sim_new(cy_handle, BASE_SUBSYSTEM, NULL);
+        ASSERT_TRUE(sim != NULL);
+        yaml_set_i2c_backend(cy_handle, yaml_i2c_sim_backend(sim));
+    }
+
+    void TearDown(void) {
+        yaml_set_i2c_backend(cy_handle, NULL);
+        yaml_i2c_sim_free(sim);
+        unlink(manifest);
+    }
+
+    /* Makes i2c_0 an SMBus or an I2C_RDWR bus */
+    void set_smbus(bool smbus) {
+        YamlBus *bus = (YamlBus *)yaml_find_bus(cy_handle, BASE_SUBSYSTEM,
+                                                "i2c_0");
+
+        ASSERT_TRUE(bus != NULL);
+        bus->smbus = smbus;
+    }
+
+    /* Fills the ops with one byte reads of a device from index first on */
+    void fill_reads(const char *device, unsigned int first,
+                    unsigned int count) {
+        unsigned int idx;
+
+        for (idx = first; idx < first + count; idx++) {
+            memset(&ops[idx], 0, sizeof(i2c_op));
+            ops[idx].direction = READ;
+            ops[idx].device = (char *)device;
+            ops[idx].byte_count = 1;
+            ops[idx].set_register = true;
+            ops[idx].register_address = idx & 0xff;
+            ops[idx].data = &data[idx];
+            cmds[idx] = &ops[idx];
+        }
+        cmds[first + count] = NULL;
+    }
+
+    /* Points the QSFP+ mux away from address 0x50, like the init ops */
+    void deselect_qsfp(void) {
+        const YamlDevice *cpld3 = yaml_find_device(cy_handle, BASE_SUBSYSTEM,
+                                                   "cpld3");
+        unsigned char value = 0xff;
+        i2c_op op;
+        i2c_op *op_list[2] = { &op, NULL };
+
+        ASSERT_TRUE(cpld3 != NULL);
+        memset(&op, 0, sizeof(op));
+        op.direction = WRITE;
+        op.device = (char *)"cpld3";
+        op.byte_count = 1;
+        op.data = &value;
+        ASSERT_EQ(i2c_execute(cy_handle, BASE_SUBSYSTEM, cpld3, op_list), 0);
+        ASSERT_EQ(yaml_i2c_sim_set_register(sim, "cpld3", 0x02, 0xff), 0);
+    }
+};
+
+TEST_F(I2cSimTestSuite, i2c_001_rdwr_chunking) {
+    const YamlDevice *sfpp1;
+    const YamlBus *bus;
+    const YamlI2cBackend *backend;
+    YamlI2cSimStats stats;
+    void *bus_handle;
+    unsigned int idx;
+
+    set_smbus(false);
+    deselect_qsfp();
+
+    sfpp1 = yaml_find_device(cy_handle, BASE_SUBSYSTEM, "sfpp1");
+    ASSERT_TRUE(sfpp1 != NULL);
+    bus = yaml_find_bus(cy_handle, BASE_SUBSYSTEM, sfpp1->bus);
+    ASSERT_TRUE(bus != NULL);
+
+    /* The simulated kernel rejects more than 42 messages */
+    fill_reads("sfpp1", 0, 43);
+    backend = yaml_i2c_sim_backend(sim);
+    ASSERT_EQ(backend->open_bus(backend->context, bus, &bus_handle), 0);
+    ASSERT_EQ(backend->transfer(backend->context, bus_handle, cy_handle,
+                                BASE_SUBSYSTEM, bus, cmds, 43, results),
+              EINVAL);
+    backend->close_bus(backend->context, bus_handle);
+
+    /* 1000 reads behind a mux: 25 transfers of pre, 40 reads and post */
+    fill_reads("sfpp1", 0, BATCH_OPS);
+    yaml_i2c_sim_reset_stats(sim);
+    ASSERT_EQ(i2c_execute(cy_handle, BASE_SUBSYSTEM, sfpp1, cmds), 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.transactions, 25u);
+    ASSERT_EQ(stats.messages, 25u * 42);
+    ASSERT_EQ(stats.faults, 0u);
+
+    yaml_i2c_sim_reset_stats(sim);
+    ASSERT_EQ(i2c_execute_list(cy_handle, BASE_SUBSYSTEM, ops, BATCH_OPS,
+                               results), 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.transactions, 25u);
+    for (idx = 0; idx < BATCH_OPS; idx++) {
+        ASSERT_EQ(results[idx], 0);
+    }
+
+    /* Each device of a list gets its own chunks */
+    fill_reads("sfpp1", 0, BATCH_OPS / 2);
+    fill_reads("sfpp2", BATCH_OPS / 2, BATCH_OPS / 2);
+    yaml_i2c_sim_reset_stats(sim);
+    ASSERT_EQ(i2c_execute_list(cy_handle, BASE_SUBSYSTEM, ops, BATCH_OPS,
+                               results), 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.transactions, 26u);
+    ASSERT_EQ(stats.faults, 0u);
+
+    /* A failed mux selection fails its chunk only */
+    fill_reads("sfpp1", 0, BATCH_OPS);
+    ASSERT_EQ(yaml_i2c_sim_inject_fault(sim, "cpld2", -1, EIO, 1), 0);
+    ASSERT_EQ(i2c_execute_list(cy_handle, BASE_SUBSYSTEM, ops, BATCH_OPS,
+                               results), EIO);
+    for (idx = 0; idx < BATCH_OPS; idx++) {
+        ASSERT_EQ(results[idx], idx < 40 ? EIO : 0);
+    }
+}
+
+TEST_F(I2cSimTestSuite, i2c_002_smbus_batch) {
+    const YamlDevice *sfpp1;
+    YamlI2cSimStats stats;
+    unsigned int idx;
+
+    set_smbus(true);
+    deselect_qsfp();
+
+    sfpp1 = yaml_find_device(cy_handle, BASE_SUBSYSTEM, "sfpp1");
+    ASSERT_TRUE(sfpp1 != NULL);
+    ASSERT_EQ(yaml_i2c_sim_set_register(sim, "sfpp1", 0x10, 0x5a), 0);
+
+    /* SMBus commands aren't chunked: the mux is selected once */
+    fill_reads("sfpp1", 0, BATCH_OPS);
+    yaml_i2c_sim_reset_stats(sim);
+    ASSERT_EQ(i2c_execute_list(cy_handle, BASE_SUBSYSTEM, ops, BATCH_OPS,
+                               results), 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.transactions, BATCH_OPS + 2u);
+    for (idx = 0; idx < BATCH_OPS; idx++) {
+        ASSERT_EQ(results[idx], 0);
+    }
+    ASSERT_EQ(data[0x10], 0x5a);
+}
+
+TEST_F(I2cSimTestSuite, i2c_003_cross_subsystem_route) {
+    char linecard[1100];
+    const YamlDevice *lc_temp;
+    const YamlDevice *lc_eeprom;
+    const YamlI2cRoute *route;
+    const YamlBus *i2c_0;
+    unsigned char value = 0;
+    i2c_op op;
+    i2c_op *op_list[2] = { &op, NULL };
+    i2c_op list_ops[2];
+    int list_results[2];
+
+    snprintf(linecard, sizeof(linecard), "%s/%s", dir, LINECARD_SUBSYSTEM);
+    ASSERT_EQ(yaml_add_subsystem(cy_handle, LINECARD_SUBSYSTEM, linecard), 0);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, LINECARD_SUBSYSTEM), 0);
+
+    i2c_0 = yaml_find_bus(cy_handle, BASE_SUBSYSTEM, "i2c_0");
+    lc_temp = yaml_find_device(cy_handle, LINECARD_SUBSYSTEM, "lc_temp");
+    lc_eeprom = yaml_find_device(cy_handle, LINECARD_SUBSYSTEM, "lc_eeprom");
+    ASSERT_TRUE(i2c_0 != NULL && lc_temp != NULL && lc_eeprom != NULL);
+
+    /* Devices of another subsystem can be named */
+    ASSERT_EQ(yaml_find_device(cy_handle, LINECARD_SUBSYSTEM, "base:cpld2"),
+              yaml_find_device(cy_handle, BASE_SUBSYSTEM, "cpld2"));
+
+    /* The route goes through the base mux channel of sfpp2, then the line
+     * card mux, on the base adapter */
+    route = yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM, lc_temp);
+    ASSERT_TRUE(route != NULL);
+    ASSERT_EQ(route->bus, i2c_0);
+    ASSERT_STREQ(route->root_subsyst, BASE_SUBSYSTEM);
+    ASSERT_EQ(route->npre, 2u);
+    ASSERT_EQ(route->npost, 2u);
+    ASSERT_STREQ(route->pre[0]->device, "base:cpld2");
+    ASSERT_STREQ(route->pre[1]->device, "lc_cpld");
+    ASSERT_TRUE(route->pre[2] == NULL);
+    ASSERT_STREQ(route->post[0]->device, "lc_cpld");
+    ASSERT_STREQ(route->post[1]->device, "base:cpld2");
+    ASSERT_EQ(yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM, lc_temp), route);
+
+    /* A route is only resolved in the subsystem of its device */
+    ASSERT_TRUE(yaml_i2c_route(cy_handle, BASE_SUBSYSTEM, lc_temp) == NULL);
+
+    /* Unknown parents and parent loops have no route */
+    ASSERT_TRUE(yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM,
+                    yaml_find_device(cy_handle, LINECARD_SUBSYSTEM,
+                                     "lc_orphan_dev")) == NULL);
+    ASSERT_TRUE(yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM,
+                    yaml_find_device(cy_handle, LINECARD_SUBSYSTEM,
+                                     "lc_loop_dev")) == NULL);
+
+    /* i2c_execute walks the route on the base adapter */
+    yaml_set_i2c_backend(cy_handle, &capture_backend);
+    memset(&op, 0, sizeof(op));
+    op.direction = READ;
+    op.device = (char *)"lc_temp";
+    op.byte_count = 1;
+    op.set_register = true;
+    op.data = &value;
+    ASSERT_EQ(i2c_execute(cy_handle, LINECARD_SUBSYSTEM, lc_temp, op_list), 0);
+    ASSERT_EQ(captured.devices.size(), 5u);
+    ASSERT_EQ(captured.devices[0],
+              yaml_find_device(cy_handle, BASE_SUBSYSTEM, "cpld2"));
+    ASSERT_EQ(captured.data[0], 0x01);
+    ASSERT_EQ(captured.devices[1],
+              yaml_find_device(cy_handle, LINECARD_SUBSYSTEM, "lc_cpld"));
+    ASSERT_EQ(captured.data[1], 0x02);
+    ASSERT_EQ(captured.devices[2], lc_temp);
+    ASSERT_EQ(captured.devices[3], captured.devices[1]);
+    ASSERT_EQ(captured.data[3], 0x00);
+    ASSERT_EQ(captured.devices[4], captured.devices[0]);
+    ASSERT_EQ(captured.data[4], 0xff);
+    for (unsigned int idx = 0; idx < captured.buses.size(); idx++) {
+        ASSERT_EQ(captured.buses[idx], i2c_0);
+    }
+
+    /* Devices that reach the same adapter through different muxes can be
+     * listed together; each gets its own mux path */
+    captured.devices.clear();
+    list_ops[0] = op;
+    list_ops[1] = op;
+    list_ops[1].device = (char *)"lc_eeprom";
+    ASSERT_EQ(i2c_execute_list(cy_handle, LINECARD_SUBSYSTEM, list_ops, 2,
+                               list_results), 0);
+    ASSERT_EQ(captured.devices.size(), 5u + 3u);
+    ASSERT_EQ(captured.devices[5 + 1], lc_eeprom);
+
+    /* Without a route the commands fail */
+    op.device = (char *)"lc_orphan_dev";
+    ASSERT_EQ(i2c_execute(cy_handle, LINECARD_SUBSYSTEM,
+                          yaml_find_device(cy_handle, LINECARD_SUBSYSTEM,
+                                           "lc_orphan_dev"), op_list),
+              EINVAL);
+
+    /* Commands for another adapter can't share a transfer */
+    op_list[0] = &list_ops[0];
+    list_ops[0].device = (char *)"sfpp1";
+    list_ops[0].data = &value;
+    ASSERT_EQ(i2c_execute(cy_handle, LINECARD_SUBSYSTEM, lc_temp, op_list),
+              EINVAL);
+
+    /* Parsing a subsystem again only drops the routes through it */
+    YamlI2cRoutes *routes = yaml_get_i2c_routes(cy_handle);
+    const YamlDevice *cpld3 = yaml_find_device(cy_handle, BASE_SUBSYSTEM,
+                                               "cpld3");
+    const YamlI2cRoute *base_route;
+
+    yaml_i2c_routes_enter(routes);
+    base_route = yaml_i2c_route(cy_handle, BASE_SUBSYSTEM, cpld3);
+    ASSERT_TRUE(base_route != NULL);
+    ASSERT_EQ(yaml_parse_devices(cy_handle, LINECARD_SUBSYSTEM), 0);
+    ASSERT_EQ(yaml_i2c_route(cy_handle, BASE_SUBSYSTEM, cpld3), base_route);
+    lc_temp = yaml_find_device(cy_handle, LINECARD_SUBSYSTEM, "lc_temp");
+    route = yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM, lc_temp);
+    ASSERT_TRUE(route != NULL);
+
+    /* The line card routes go through the base; a dropped route stays
+     * valid until the threads that may hold it have left */
+    ASSERT_EQ(yaml_parse_devices(cy_handle, BASE_SUBSYSTEM), 0);
+    ASSERT_NE(yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM, lc_temp), route);
+    ASSERT_EQ(route->npre, 2u);
+    ASSERT_STREQ(route->pre[0]->device, "base:cpld2");
+    yaml_i2c_routes_leave(routes);
+
+    /* Dropped routes don't use up the table */
+    cpld3 = yaml_find_device(cy_handle, BASE_SUBSYSTEM, "cpld3");
+    for (unsigned int idx = 0; idx < 5000; idx++) {
+        yaml_i2c_routes_invalidate(routes, BASE_SUBSYSTEM);
+        ASSERT_TRUE(yaml_i2c_route(cy_handle, BASE_SUBSYSTEM, cpld3) != NULL);
+        ASSERT_TRUE(yaml_i2c_route(cy_handle, LINECARD_SUBSYSTEM, lc_temp) !=
+                    NULL);
+    }
+
+    captured.buses.clear();
+    captured.devices.clear();
+    captured.data.clear();
+}
+
+TEST_F(I2cSimTestSuite, i2c_004_ordered_list) {
+    static const char *devices[] = {
+        "cpld1", "fru_eeprom", "cpld2", "cpld3", "i2c_mux1"
+    };
+    const unsigned int count = sizeof(devices) / sizeof(devices[0]);
+    unsigned char values[sizeof(devices) / sizeof(devices[0])];
+    unsigned int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        values[idx] = idx + 1;
+        memset(&ops[idx], 0, sizeof(i2c_op));
+        ops[idx].direction = WRITE;
+        ops[idx].device = (char *)devices[idx];
+        ops[idx].byte_count = 1;
+        ops[idx].data = &values[idx];
+    }
+
+    /* The runs of each adapter are performed in list order */
+    yaml_set_i2c_backend(cy_handle, &capture_backend);
+    ASSERT_EQ(i2c_execute_list_ordered(cy_handle, BASE_SUBSYSTEM, ops, count,
+                                       results), 0);
+    yaml_set_i2c_backend(cy_handle, yaml_i2c_sim_backend(sim));
+
+    ASSERT_EQ(captured.devices.size(), count);
+    for (idx = 0; idx < count; idx++) {
+        ASSERT_EQ(results[idx], 0);
+        ASSERT_EQ(captured.devices[idx],
+                  yaml_find_device(cy_handle, BASE_SUBSYSTEM, devices[idx]));
+        ASSERT_EQ(captured.data[idx], idx + 1);
+    }
+    ASSERT_EQ(captured.buses[2], captured.buses[3]);
+    ASSERT_NE(captured.buses[1], captured.buses[2]);
+
+    /* Device counters are named by the config, not by the ops */
+    YamlI2cStats *stats = yaml_get_i2c_stats(cy_handle);
+    const YamlDevice *cpld1 = yaml_find_device(cy_handle, BASE_SUBSYSTEM,
+                                               "cpld1");
+    std::vector<YamlI2cStatsEntry> entries;
+    char name[] = "cpld1";
+    bool found = false;
+
+    ops[0].device = name;
+    ASSERT_EQ(i2c_execute_list(cy_handle, BASE_SUBSYSTEM, ops, 1, results), 0);
+    memset(name, 'x', sizeof(name) - 1);
+    entries.resize(yaml_i2c_stats_snapshot(stats, NULL, 0));
+    ASSERT_EQ(yaml_i2c_stats_snapshot(stats, &entries[0], entries.size()),
+              (int)entries.size());
+    for (idx = 0; idx < entries.size(); idx++) {
+        ASSERT_NE(entries[idx].name, (const char *)name);
+        found |= !entries[idx].bus && entries[idx].name == cpld1->name;
+    }
+    ASSERT_TRUE(found);
+
+    captured.buses.clear();
+    captured.devices.clear();
+    captured.data.clear();
+}
+
+TEST_F(I2cSimTestSuite, i2c_005_list_in_session) {
+    YamlI2cBusSession *session;
+    YamlI2cSimStats stats;
+
+    ASSERT_FALSE(yaml_i2c_bus_session_active());
+    session = yaml_i2c_bus_session_begin(cy_handle, BASE_SUBSYSTEM, "i2c_1");
+    ASSERT_TRUE(session != NULL);
+    ASSERT_TRUE(yaml_i2c_bus_session_active());
+
+    /* The bus of the session isn't the first of the list */
+    fill_reads("cpld1", 0, 1);
+    fill_reads("fru_eeprom", 1, 1);
+    yaml_i2c_sim_reset_stats(sim);
+    ASSERT_EQ(i2c_execute_list(cy_handle, BASE_SUBSYSTEM, ops, 2, results), 0);
+    ASSERT_EQ(results[0], 0);
+    ASSERT_EQ(results[1], 0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.faults, 0u);
+
+    yaml_i2c_bus_session_end(session);
+    ASSERT_FALSE(yaml_i2c_bus_session_active());
+}
+
+TEST_F(I2cSimTestSuite, i2c_006_register_read_chunking) {
+    YamlDevice *sfpp1;
+    YamlRegisterRead reads[41];
+    YamlI2cSimStats stats;
+    i2c_op *no_post[1] = { NULL };
+    unsigned int idx;
+
+    set_smbus(false);
+    deselect_qsfp();
+
+    /* A mux with pre ops only leaves an odd chunk of 41 ops */
+    sfpp1 = (YamlDevice *)yaml_find_device(cy_handle, BASE_SUBSYSTEM, "sfpp1");
+    ASSERT_TRUE(sfpp1 != NULL);
+    sfpp1->post = no_post;
+
+    memset(reads, 0, sizeof(reads));
+    for (idx = 0; idx < 41; idx++) {
+        reads[idx].device = "sfpp1";
+        reads[idx].register_address = idx;
+        reads[idx].register_size = 1;
+        ASSERT_EQ(yaml_i2c_sim_set_register(sim, "sfpp1", idx, idx + 1), 0);
+    }
+
+    /* Each select write stays with its read: 40, 40 and 2 ops */
+    yaml_i2c_sim_reset_stats(sim);
+    ASSERT_EQ(yaml_register_read_list(cy_handle, BASE_SUBSYSTEM, reads, 41),
+              0);
+    yaml_i2c_sim_get_stats(sim, &stats);
+    ASSERT_EQ(stats.transactions, 3u);
+    ASSERT_EQ(stats.faults, 0u);
+    for (idx = 0; idx < 41; idx++) {
+        ASSERT_EQ(reads[idx].rc, 0);
+        ASSERT_EQ(reads[idx].value, idx + 1);
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}